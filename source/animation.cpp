@@ -0,0 +1,348 @@
+#include "animation.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <immintrin.h>
+#define ANIMATION_SSE
+#endif
+
+using namespace std;
+
+uint32_t get_joint_count(const skeleton& skeleton) {
+    return static_cast<uint32_t>(skeleton.parents.size());
+}
+
+float get_clip_duration(const animation_clip& clip) {
+    return clip.keys.size() / clip.key_rate;
+}
+
+void resize_pose(joint_pose& pose, uint32_t joint_count) {
+    auto padded = (joint_count + 3) & ~3u;
+    pose.rotation_x.assign(padded, 0);
+    pose.rotation_y.assign(padded, 0);
+    pose.rotation_z.assign(padded, 0);
+    pose.rotation_w.assign(padded, 1);
+    pose.translation_x.assign(padded, 0);
+    pose.translation_y.assign(padded, 0);
+    pose.translation_z.assign(padded, 0);
+}
+
+void blend_poses(
+    const joint_pose& a, const joint_pose& b, float weight, joint_pose& result
+) {
+    auto count = static_cast<uint32_t>(a.rotation_x.size());
+    if (b.rotation_x.size() != count) {
+        throw runtime_error("blended poses have different joint counts");
+    }
+    if (result.rotation_x.size() != count) {
+        resize_pose(result, count);
+    }
+#ifdef ANIMATION_SSE
+    __m128 t = _mm_set1_ps(weight);
+    __m128 sign_bit = _mm_set1_ps(-0.0f);
+    for (auto i = 0u; i < count; i += 4) {
+        __m128
+            ax = _mm_loadu_ps(&a.rotation_x[i]),
+            ay = _mm_loadu_ps(&a.rotation_y[i]),
+            az = _mm_loadu_ps(&a.rotation_z[i]),
+            aw = _mm_loadu_ps(&a.rotation_w[i]);
+        __m128
+            bx = _mm_loadu_ps(&b.rotation_x[i]),
+            by = _mm_loadu_ps(&b.rotation_y[i]),
+            bz = _mm_loadu_ps(&b.rotation_z[i]),
+            bw = _mm_loadu_ps(&b.rotation_w[i]);
+        // q and -q are the same rotation, b is flipped to the hemisphere
+        // of a for the shorter arc
+        __m128 dot = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)),
+            _mm_add_ps(_mm_mul_ps(az, bz), _mm_mul_ps(aw, bw))
+        );
+        __m128 flip = _mm_and_ps(dot, sign_bit);
+        bx = _mm_xor_ps(bx, flip);
+        by = _mm_xor_ps(by, flip);
+        bz = _mm_xor_ps(bz, flip);
+        bw = _mm_xor_ps(bw, flip);
+        __m128
+            x = _mm_add_ps(ax, _mm_mul_ps(_mm_sub_ps(bx, ax), t)),
+            y = _mm_add_ps(ay, _mm_mul_ps(_mm_sub_ps(by, ay), t)),
+            z = _mm_add_ps(az, _mm_mul_ps(_mm_sub_ps(bz, az), t)),
+            w = _mm_add_ps(aw, _mm_mul_ps(_mm_sub_ps(bw, aw), t));
+        __m128 length = _mm_sqrt_ps(_mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)),
+            _mm_add_ps(_mm_mul_ps(z, z), _mm_mul_ps(w, w))
+        ));
+        _mm_storeu_ps(&result.rotation_x[i], _mm_div_ps(x, length));
+        _mm_storeu_ps(&result.rotation_y[i], _mm_div_ps(y, length));
+        _mm_storeu_ps(&result.rotation_z[i], _mm_div_ps(z, length));
+        _mm_storeu_ps(&result.rotation_w[i], _mm_div_ps(w, length));
+
+        vector<float> joint_pose::* translations[]{
+            &joint_pose::translation_x, &joint_pose::translation_y,
+            &joint_pose::translation_z,
+        };
+        for (auto member : translations) {
+            __m128 from = _mm_loadu_ps(&(a.*member)[i]);
+            __m128 to = _mm_loadu_ps(&(b.*member)[i]);
+            _mm_storeu_ps(
+                &(result.*member)[i],
+                _mm_add_ps(from, _mm_mul_ps(_mm_sub_ps(to, from), t))
+            );
+        }
+    }
+#else
+    for (auto i = 0u; i < count; i++) {
+        float qa[4]{
+            a.rotation_x[i], a.rotation_y[i], a.rotation_z[i],
+            a.rotation_w[i],
+        };
+        float qb[4]{
+            b.rotation_x[i], b.rotation_y[i], b.rotation_z[i],
+            b.rotation_w[i],
+        };
+        float dot = qa[0] * qb[0] + qa[1] * qb[1] + qa[2] * qb[2] +
+            qa[3] * qb[3];
+        float q[4], length = 0;
+        for (auto j = 0u; j < 4; j++) {
+            auto target = dot < 0 ? -qb[j] : qb[j];
+            q[j] = qa[j] + (target - qa[j]) * weight;
+            length += q[j] * q[j];
+        }
+        length = sqrt(length);
+        result.rotation_x[i] = q[0] / length;
+        result.rotation_y[i] = q[1] / length;
+        result.rotation_z[i] = q[2] / length;
+        result.rotation_w[i] = q[3] / length;
+        auto lerp = [weight](float from, float to) {
+            return from + (to - from) * weight;
+        };
+        result.translation_x[i] =
+            lerp(a.translation_x[i], b.translation_x[i]);
+        result.translation_y[i] =
+            lerp(a.translation_y[i], b.translation_y[i]);
+        result.translation_z[i] =
+            lerp(a.translation_z[i], b.translation_z[i]);
+    }
+#endif
+}
+
+void sample_clip(const animation_clip& clip, float time, joint_pose& pose) {
+    auto count = static_cast<uint32_t>(clip.keys.size());
+    if (count == 0) {
+        throw runtime_error("animation clip has no keys");
+    }
+    auto position = fmod(time * clip.key_rate, float(count));
+    if (position < 0) {
+        position += count;
+    }
+    auto key = min(static_cast<uint32_t>(position), count - 1);
+    blend_poses(
+        clip.keys[key], clip.keys[(key + 1) % count], position - key, pose
+    );
+}
+
+// 3 by 4 row major matrices, the last row is implicitly 0 0 0 1
+static void multiply(const float* a, const float* b, float* result) {
+    for (auto row = 0u; row < 3; row++) {
+        auto r = a + row * 4;
+        for (auto column = 0u; column < 4; column++) {
+            result[row * 4 + column] =
+                r[0] * b[column] + r[1] * b[4 + column] +
+                r[2] * b[8 + column] + (column == 3 ? r[3] : 0);
+        }
+    }
+}
+
+static void get_local_matrix(
+    const joint_pose& pose, uint32_t joint, float* matrix
+) {
+    auto x = pose.rotation_x[joint], y = pose.rotation_y[joint];
+    auto z = pose.rotation_z[joint], w = pose.rotation_w[joint];
+    float local[palette_matrix_size]{
+        1 - 2 * (y * y + z * z), 2 * (x * y - w * z), 2 * (x * z + w * y),
+        pose.translation_x[joint],
+        2 * (x * y + w * z), 1 - 2 * (x * x + z * z), 2 * (y * z - w * x),
+        pose.translation_y[joint],
+        2 * (x * z - w * y), 2 * (y * z + w * x), 1 - 2 * (x * x + y * y),
+        pose.translation_z[joint],
+    };
+    copy(begin(local), end(local), matrix);
+}
+
+// model space matrices of all joints, parents first
+static void get_model_matrices(
+    const skeleton& skeleton, const joint_pose& pose, float* matrices
+) {
+    auto count = get_joint_count(skeleton);
+    if (count > max_joints) {
+        throw runtime_error("too many joints");
+    }
+    for (auto joint = 0u; joint < count; joint++) {
+        auto matrix = matrices + joint * palette_matrix_size;
+        auto parent = skeleton.parents[joint];
+        if (parent == no_joint) {
+            get_local_matrix(pose, joint, matrix);
+            continue;
+        }
+        float local[palette_matrix_size];
+        get_local_matrix(pose, joint, local);
+        multiply(matrices + parent * palette_matrix_size, local, matrix);
+    }
+}
+
+void get_joint_palette(
+    const skeleton& skeleton, const joint_pose& pose, float* palette
+) {
+    float model[max_joints * palette_matrix_size];
+    get_model_matrices(skeleton, pose, model);
+    for (auto joint = 0u; joint < get_joint_count(skeleton); joint++) {
+        multiply(
+            model + joint * palette_matrix_size,
+            &skeleton.inverse_bind_matrices[joint * palette_matrix_size],
+            palette + joint * palette_matrix_size
+        );
+    }
+}
+
+void skin_position(
+    const float* palette, uint32_t joints, uint32_t weights,
+    const float position[3], float result[3]
+) {
+    float matrix[palette_matrix_size]{};
+    for (auto i = 0u; i < joint_influences; i++) {
+        auto weight = ((weights >> (i * 8)) & 0xff) / 255.f;
+        if (weight == 0) {
+            continue;
+        }
+        auto joint = palette + ((joints >> (i * 8)) & 0xff) *
+            palette_matrix_size;
+        for (auto j = 0u; j < palette_matrix_size; j++) {
+            matrix[j] += joint[j] * weight;
+        }
+    }
+    for (auto row = 0u; row < 3; row++) {
+        auto r = matrix + row * 4;
+        result[row] =
+            r[0] * position[0] + r[1] * position[1] + r[2] * position[2] +
+            r[3];
+    }
+}
+
+uint32_t create_chain_skeleton(
+    span<const float> vertices, uint32_t vertex_stride,
+    uint32_t joint_count, skeleton& skeleton, vector<uint32_t>& weights
+) {
+    if (joint_count == 0 || joint_count > max_joints) {
+        throw runtime_error("joint count out of range");
+    }
+    auto vertex_count = static_cast<uint32_t>(vertices.size() / vertex_stride);
+    if (vertex_count == 0) {
+        throw runtime_error("can't rig a mesh without vertices");
+    }
+    float low[3]{INFINITY, INFINITY, INFINITY};
+    float high[3]{-INFINITY, -INFINITY, -INFINITY};
+    for (auto v = 0u; v < vertex_count; v++) {
+        for (auto i = 0u; i < 3; i++) {
+            low[i] = min(low[i], vertices[v * vertex_stride + i]);
+            high[i] = max(high[i], vertices[v * vertex_stride + i]);
+        }
+    }
+    uint32_t axis = 0;
+    for (auto i = 1u; i < 3; i++) {
+        if (high[i] - low[i] > high[axis] - low[axis]) {
+            axis = i;
+        }
+    }
+    auto segment = max((high[axis] - low[axis]) / joint_count, 1e-6f);
+
+    // the root is at the low end, centered on the other axes, each child
+    // one segment further along the axis
+    skeleton.parents.resize(joint_count);
+    resize_pose(skeleton.bind_pose, joint_count);
+    skeleton.inverse_bind_matrices.assign(
+        joint_count * palette_matrix_size, 0
+    );
+    vector<float>* translations[]{
+        &skeleton.bind_pose.translation_x, &skeleton.bind_pose.translation_y,
+        &skeleton.bind_pose.translation_z,
+    };
+    for (auto joint = 0u; joint < joint_count; joint++) {
+        skeleton.parents[joint] = joint == 0 ? no_joint : joint - 1;
+        auto inverse_bind =
+            &skeleton.inverse_bind_matrices[joint * palette_matrix_size];
+        for (auto i = 0u; i < 3; i++) {
+            float position = i == axis ?
+                low[i] + segment * joint : (low[i] + high[i]) / 2;
+            (*translations[i])[joint] =
+                joint == 0 ? position : i == axis ? segment : 0;
+            inverse_bind[i * 4 + i] = 1;
+            inverse_bind[i * 4 + 3] = -position;
+        }
+    }
+
+    // each joint owns one segment, vertices blend between the joints of
+    // the closest segment centers
+    weights.resize(vertex_count * 2);
+    for (auto v = 0u; v < vertex_count; v++) {
+        auto s = (vertices[v * vertex_stride + axis] - low[axis]) / segment -
+            0.5f;
+        auto first = floor(s);
+        auto fraction = s - first;
+        if (first < 0) {
+            first = 0;
+            fraction = 0;
+        } else if (first >= joint_count - 1) {
+            first = joint_count - 1;
+            fraction = 0;
+        }
+        auto joint = static_cast<uint32_t>(first);
+        auto next = min(joint + 1, joint_count - 1);
+        auto next_weight = static_cast<uint32_t>(lround(fraction * 255));
+        weights[v * 2] = joint | next << 8;
+        weights[v * 2 + 1] = (255 - next_weight) | next_weight << 8;
+    }
+    return axis;
+}
+
+static uint32_t get_depth(const skeleton& skeleton, uint32_t joint) {
+    uint32_t depth = 0;
+    while (skeleton.parents[joint] != no_joint) {
+        joint = skeleton.parents[joint];
+        depth++;
+    }
+    return depth;
+}
+
+void create_wave_clip(
+    const skeleton& skeleton, const float axis[3], float amplitude,
+    float duration, uint32_t key_count, animation_clip& clip
+) {
+    if (key_count == 0 || duration <= 0) {
+        throw runtime_error("animation clip has no keys");
+    }
+    auto length =
+        sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+    if (length == 0) {
+        throw runtime_error("rotation axis has no length");
+    }
+    const float pi = 3.14159265f;
+    // fraction of a period each joint lags behind its parent
+    const float lag = 0.1f;
+    clip.key_rate = key_count / duration;
+    clip.keys.assign(key_count, skeleton.bind_pose);
+    for (auto k = 0u; k < key_count; k++) {
+        auto& key = clip.keys[k];
+        for (auto joint = 0u; joint < get_joint_count(skeleton); joint++) {
+            auto phase =
+                float(k) / key_count - get_depth(skeleton, joint) * lag;
+            auto angle = amplitude * sin(2 * pi * phase);
+            auto s = sin(angle / 2) / length;
+            key.rotation_x[joint] = axis[0] * s;
+            key.rotation_y[joint] = axis[1] * s;
+            key.rotation_z[joint] = axis[2] * s;
+            key.rotation_w[joint] = cos(angle / 2);
+        }
+    }
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Skeletal animation on the CPU. Poses are the local rotations and
+// translations of all joints, stored as structure of arrays with the joint
+// count rounded up to a multiple of 4, so that blending poses interpolates
+// the quaternions of 4 joints at once with SSE. Clips are poses sampled at
+// a fixed rate and loop. Joint palettes are what the skinning shader reads,
+// the model space matrix of each joint times its inverse bind matrix, as 3
+// by 4 row major matrices.
+
+// joint indices of vertices are 8 bit, palettes are built on the stack
+const uint32_t max_joints = 64;
+// joints per vertex
+const uint32_t joint_influences = 4;
+const uint32_t no_joint = -1u;
+// floats per palette matrix
+const uint32_t palette_matrix_size = 12;
+
+struct joint_pose {
+    // rotations are unit quaternions, padding joints are the identity
+    std::vector<float>
+        rotation_x, rotation_y, rotation_z, rotation_w,
+        translation_x, translation_y, translation_z;
+};
+
+struct skeleton {
+    // parents come before their children, no_joint for roots
+    std::vector<uint32_t> parents;
+    joint_pose bind_pose;
+    // palette_matrix_size floats per joint, from model space to the space of
+    // the joint in the bind pose
+    std::vector<float> inverse_bind_matrices;
+};
+
+struct animation_clip {
+    // keys per second, the last key blends back into the first
+    float key_rate;
+    std::vector<joint_pose> keys;
+};
+
+uint32_t get_joint_count(const skeleton& skeleton);
+float get_clip_duration(const animation_clip& clip);
+
+// sets all joints to the identity
+void resize_pose(joint_pose& pose, uint32_t joint_count);
+
+// normalized linear interpolation of the rotations along the shorter arc
+// and linear interpolation of the translations, weight 0 is a and 1 is b.
+// All poses must have the same size, result may alias a or b.
+void blend_poses(
+    const joint_pose& a, const joint_pose& b, float weight, joint_pose& result
+);
+// time in seconds, wraps around
+void sample_clip(const animation_clip& clip, float time, joint_pose& pose);
+
+// writes palette_matrix_size floats per joint
+void get_joint_palette(
+    const skeleton& skeleton, const joint_pose& pose, float* palette
+);
+
+// applies the palette to a position with the packed joints and weights of
+// a vertex, like the skinning shader
+void skin_position(
+    const float* palette, uint32_t joints, uint32_t weights,
+    const float position[3], float result[3]
+);
+
+// Rigs a mesh without a skeleton of its own as a chain of joint_count
+// joints along the longest axis of its bounds, which is returned. Writes
+// two packed values per vertex, 4 8 bit joint indices, then 4 8 bit weights
+// that sum to 255. vertex_stride is in floats and vertices start with their
+// position.
+uint32_t create_chain_skeleton(
+    std::span<const float> vertices, uint32_t vertex_stride,
+    uint32_t joint_count, skeleton& skeleton, std::vector<uint32_t>& weights
+);
+
+// every joint bends around axis by up to amplitude radians, with a phase
+// that lags behind its parent, so that a wave travels along chains
+void create_wave_clip(
+    const skeleton& skeleton, const float axis[3], float amplitude,
+    float duration, uint32_t key_count, animation_clip& clip
+);
@@ -0,0 +1,67 @@
+#include <iostream>
+#include <chrono>
+#include <vector>
+
+#include "../animation.h"
+#include "timing.h"
+
+using namespace std;
+
+// measures quaternion blending in joints per millisecond and sampling two
+// clips into a joint palette in poses per millisecond, for a chain rig like
+// the one skin=<poses> creates
+
+int main() {
+    // a column of vertices along y
+    const uint32_t vertex_count = 1024, vertex_stride = 8;
+    vector<float> vertices(vertex_count * vertex_stride, 0);
+    for (auto i = 0u; i < vertex_count; i++) {
+        vertices[i * vertex_stride + 1] = float(i) / vertex_count;
+    }
+
+    for (auto joint_count : {8u, max_joints}) {
+        skeleton skeleton;
+        vector<uint32_t> weights;
+        create_chain_skeleton(
+            vertices, vertex_stride, joint_count, skeleton, weights
+        );
+        const float x[3]{1, 0, 0}, z[3]{0, 0, 1};
+        animation_clip a, b;
+        create_wave_clip(skeleton, x, 0.1f, 2, 32, a);
+        create_wave_clip(skeleton, z, 0.1f, 2, 32, b);
+
+        const unsigned blends = 100000;
+        joint_pose pose;
+        sample_clip(a, 0.3f, pose);
+        auto start = chrono::steady_clock::now();
+        for (auto i = 0u; i < blends; i++) {
+            blend_poses(pose, b.keys[i % b.keys.size()], 0.01f, pose);
+        }
+        auto blend_time = milliseconds_since(start);
+        cout <<
+            joint_count << " joints: " <<
+            blends * pose.rotation_x.size() / blend_time <<
+            " blended joints/ms" << endl;
+
+        const unsigned samples = 20000;
+        joint_pose from, to;
+        vector<float> palette(joint_count * palette_matrix_size);
+        start = chrono::steady_clock::now();
+        for (auto i = 0u; i < samples; i++) {
+            auto time = i * 0.001f;
+            sample_clip(a, time, from);
+            sample_clip(b, time, to);
+            blend_poses(from, to, 0.5f, from);
+            get_joint_palette(skeleton, from, palette.data());
+        }
+        auto sample_time = milliseconds_since(start);
+        // keeps the sampling from being optimized away
+        double checksum = 0;
+        for (auto value : palette) {
+            checksum += value;
+        }
+        cout <<
+            joint_count << " joints: " << samples / sample_time <<
+            " poses/ms (checksum " << checksum << ")" << endl;
+    }
+}
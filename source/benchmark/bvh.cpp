@@ -0,0 +1,186 @@
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <cmath>
+
+#include "../bvh.h"
+#include "timing.h"
+
+using namespace std;
+
+// measures building a BVH over a wavy grid mesh and over a field of its
+// instances, and picking rays per millisecond through both, checked
+// against testing every triangle
+
+// closest hit by testing every triangle, to check the BVH against
+static float intersect_all(
+    const vector<float>& vertices, uint32_t vertex_stride,
+    const vector<uint32_t>& indices, const bvh_ray& ray
+) {
+    auto closest = INFINITY;
+    auto& d = ray.direction;
+    for (auto t = 0u; t < indices.size(); t += 3) {
+        const float* corners[3];
+        for (auto i = 0u; i < 3; i++) {
+            corners[i] = &vertices[size_t(indices[t + i]) * vertex_stride];
+        }
+        float e1[3], e2[3], s[3];
+        for (auto i = 0u; i < 3; i++) {
+            e1[i] = corners[1][i] - corners[0][i];
+            e2[i] = corners[2][i] - corners[0][i];
+            s[i] = ray.origin[i] - corners[0][i];
+        }
+        float p[3]{
+            d[1] * e2[2] - d[2] * e2[1],
+            d[2] * e2[0] - d[0] * e2[2],
+            d[0] * e2[1] - d[1] * e2[0],
+        };
+        auto determinant = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+        if (determinant == 0) {
+            continue;
+        }
+        auto u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) / determinant;
+        float q[3]{
+            s[1] * e1[2] - s[2] * e1[1],
+            s[2] * e1[0] - s[0] * e1[2],
+            s[0] * e1[1] - s[1] * e1[0],
+        };
+        auto v = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) / determinant;
+        auto distance =
+            (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) / determinant;
+        if (u >= 0 && v >= 0 && u + v <= 1 && distance > 0) {
+            closest = min(closest, distance);
+        }
+    }
+    return closest;
+}
+
+int main() {
+    // a grid in the xy plane with waves along z, positions and normals
+    const uint32_t size = 512, vertex_stride = 6;
+    vector<float> vertices;
+    for (auto y = 0u; y <= size; y++) {
+        for (auto x = 0u; x <= size; x++) {
+            float u = float(x) / size, v = float(y) / size;
+            vertices.insert(vertices.end(), {
+                u, v, 0.05f * sin(u * 40) * cos(v * 30), 0, 0, 1
+            });
+        }
+    }
+    vector<uint32_t> indices;
+    for (auto y = 0u; y < size; y++) {
+        for (auto x = 0u; x < size; x++) {
+            auto i = y * (size + 1) + x;
+            indices.insert(indices.end(), {
+                i, i + 1, i + size + 1, i + 1, i + size + 2, i + size + 1
+            });
+        }
+    }
+    auto triangle_count = indices.size() / 3;
+
+    auto start = chrono::steady_clock::now();
+    mesh_bvh mesh;
+    build_mesh_bvh(vertices, vertex_stride, indices, mesh);
+    auto build_time = milliseconds_since(start);
+    cout <<
+        "mesh: " << triangle_count << " triangles, " << mesh.nodes.size() <<
+        " nodes built in " << build_time << " ms (" <<
+        triangle_count / build_time << " triangles/ms)" << endl;
+
+    // rays from above, slanted so that some miss the grid
+    mt19937 random(1);
+    uniform_real_distribution<float> unit(0, 1);
+    vector<bvh_ray> rays(1 << 20);
+    for (auto& ray : rays) {
+        ray = {
+            .origin = {unit(random) * 1.2f - 0.1f, unit(random), 1},
+            .direction = {
+                unit(random) * 0.2f - 0.1f, unit(random) * 0.2f - 0.1f, -1
+            },
+        };
+    }
+    const bvh_hit miss{.distance = INFINITY, .triangle = 0, .instance = 0};
+    const uint32_t checked = 1000;
+    uint32_t mismatches = 0;
+    for (auto i = 0u; i < checked; i++) {
+        bvh_hit hit = miss;
+        intersect_mesh_bvh(mesh, rays[i], hit);
+        auto expected = intersect_all(
+            vertices, vertex_stride, indices, rays[i]
+        );
+        if (fabs(hit.distance - expected) > 1e-5f) {
+            mismatches++;
+        }
+    }
+    uint32_t hits = 0;
+    start = chrono::steady_clock::now();
+    for (auto& ray : rays) {
+        bvh_hit hit = miss;
+        hits += intersect_mesh_bvh(mesh, ray, hit);
+    }
+    auto trace_time = milliseconds_since(start);
+    cout <<
+        "mesh: " << rays.size() / trace_time << " rays/ms, " <<
+        100.f * hits / rays.size() << "% hit, " << mismatches << " of " <<
+        checked << " differ from testing every triangle" << endl;
+
+    // instances on a grid, rotated around z and scaled
+    const uint32_t side = 64;
+    vector<uint32_t> instance_meshes(side * side, 0);
+    vector<float> matrices;
+    for (auto y = 0u; y < side; y++) {
+        for (auto x = 0u; x < side; x++) {
+            auto angle = unit(random) * 6.28f, scale = 0.5f + unit(random);
+            auto c = cos(angle) * scale, s = sin(angle) * scale;
+            matrices.insert(matrices.end(), {
+                c, s, 0, 0,
+                -s, c, 0, 0,
+                0, 0, scale, 0,
+                x * 2.f, y * 2.f, unit(random), 1,
+            });
+        }
+    }
+    start = chrono::steady_clock::now();
+    scene_bvh scene;
+    build_scene_bvh(
+        span(&mesh, 1), instance_meshes, matrices.data(), 16 * sizeof(float),
+        scene
+    );
+    build_time = milliseconds_since(start);
+    cout <<
+        "scene: " << instance_meshes.size() << " instances built in " <<
+        build_time << " ms" << endl;
+
+    for (auto& ray : rays) {
+        ray.origin[0] = unit(random) * side * 2;
+        ray.origin[1] = unit(random) * side * 2;
+        ray.origin[2] = 4;
+    }
+    hits = 0;
+    start = chrono::steady_clock::now();
+    for (auto& ray : rays) {
+        bvh_hit hit = miss;
+        hits += intersect_scene_bvh(scene, span(&mesh, 1), ray, hit);
+    }
+    trace_time = milliseconds_since(start);
+    cout <<
+        "scene: " << rays.size() / trace_time << " rays/ms, " <<
+        100.f * hits / rays.size() << "% hit" << endl;
+
+    const uint32_t queries = 100000;
+    uint64_t found = 0;
+    vector<uint32_t> instances;
+    start = chrono::steady_clock::now();
+    for (auto i = 0u; i < queries; i++) {
+        float low[3]{unit(random) * side * 2, unit(random) * side * 2, 0};
+        float high[3]{low[0] + 4, low[1] + 4, 2};
+        instances.clear();
+        query_scene_bvh(scene, low, high, instances);
+        found += instances.size();
+    }
+    auto query_time = milliseconds_since(start);
+    cout <<
+        "scene: " << queries / query_time << " box queries/ms, " <<
+        double(found) / queries << " instances each" << endl;
+}
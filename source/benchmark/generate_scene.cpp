@@ -0,0 +1,82 @@
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+
+#include "../scene_file.h"
+
+using namespace std;
+
+// writes a stress scene of the built-in mesh, for example
+//   generate_scene grid 10000 grid.scene
+//   generate_scene hierarchy 4096 chains.scene depth=32 seed=7
+// the scene file is passed to the renderer, which then flies along the
+// camera path once and reports frame time statistics
+
+static void usage() {
+    cerr <<
+        "usage: generate_scene <grid|random|hierarchy> <instances> <output> "
+        "[depth=n] [materials=n] [lights=n] [spacing=x] [duration=s] "
+        "[seed=n]" << endl;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 4) {
+        usage();
+        return 1;
+    }
+
+    stress_parameters parameters;
+    if (strcmp(argv[1], "grid") == 0) {
+        parameters.layout = stress_layout::grid;
+    } else if (strcmp(argv[1], "random") == 0) {
+        parameters.layout = stress_layout::random;
+    } else if (strcmp(argv[1], "hierarchy") == 0) {
+        parameters.layout = stress_layout::hierarchy;
+    } else {
+        usage();
+        return 1;
+    }
+    parameters.instance_count = strtoul(argv[2], nullptr, 10);
+
+    for (auto i = 4; i < argc; i++) {
+        auto value = strchr(argv[i], '=');
+        if (!value) {
+            usage();
+            return 1;
+        }
+        value++;
+        auto is = [&](const char* name) {
+            return strncmp(argv[i], name, strlen(name)) == 0;
+        };
+        if (is("depth=")) {
+            parameters.depth = strtoul(value, nullptr, 10);
+        } else if (is("materials=")) {
+            parameters.material_count = strtoul(value, nullptr, 10);
+        } else if (is("lights=")) {
+            parameters.light_count = strtoul(value, nullptr, 10);
+        } else if (is("spacing=")) {
+            parameters.spacing = strtof(value, nullptr);
+        } else if (is("duration=")) {
+            parameters.duration = strtof(value, nullptr);
+        } else if (is("seed=")) {
+            parameters.seed = strtoul(value, nullptr, 10);
+        } else {
+            usage();
+            return 1;
+        }
+    }
+
+    scene_description scene;
+    generate_stress_scene(parameters, "miku", scene);
+    write_scene(argv[3], scene);
+
+    uint32_t instance_count = 0;
+    for (auto& node : scene.nodes) {
+        instance_count += node.mesh != no_scene_mesh;
+    }
+    cout <<
+        argv[3] << ": " << scene.nodes.size() << " nodes, " <<
+        instance_count << " instances, " << scene.lights.size() <<
+        " lights, " << get_camera_path_duration(scene) << " s camera path" <<
+        endl;
+}
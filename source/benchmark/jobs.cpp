@@ -0,0 +1,133 @@
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <vector>
+#include <atomic>
+
+#include "../job_system.h"
+#include "timing.h"
+
+using namespace std;
+
+// measures the cost of spawning empty jobs and the scaling of parallel_for
+// from 1 thread to all hardware threads, after checking that parallel_for
+// visits every index once for counts beyond the job ring and that jobs
+// spread over all workers
+
+static double spawn_overhead(job_system& system) {
+    const uint32_t rounds = 256, jobs_per_round = 2048;
+    auto start = chrono::steady_clock::now();
+    for (auto round = 0u; round < rounds; round++) {
+        auto root = create_job(system, []() {});
+        for (auto i = 0u; i < jobs_per_round; i++) {
+            run_job(system, *create_job(system, root, []() {}));
+        }
+        run_job(system, *root);
+        wait_job(system, *root);
+    }
+    return milliseconds_since(start) * 1e6 / (rounds * jobs_per_round);
+}
+
+static double workload(job_system& system, vector<float>& values) {
+    auto start = chrono::steady_clock::now();
+    for (auto repeat = 0u; repeat < 8; repeat++) {
+        parallel_for(
+            system, values.size(), 1024, [&](uint32_t begin, uint32_t end) {
+                for (auto i = begin; i < end; i++) {
+                    float x = values[i];
+                    for (auto j = 0u; j < 64; j++) {
+                        x = sqrt(x * x + 1.f) * 0.5f;
+                    }
+                    values[i] = x;
+                }
+            }
+        );
+    }
+    return milliseconds_since(start);
+}
+
+// returns the number of indices that weren't visited exactly once
+static uint32_t check_coverage(job_system& system, uint32_t count) {
+    vector<atomic<uint32_t>> visits(count);
+    parallel_for(system, count, 1, [&](uint32_t begin, uint32_t end) {
+        for (auto i = begin; i < end; i++) {
+            visits[i].fetch_add(1, memory_order_relaxed);
+        }
+    });
+    uint32_t errors = 0;
+    for (auto& v : visits) {
+        errors += v.load(memory_order_relaxed) != 1;
+    }
+    return errors;
+}
+
+// returns the smallest share of 1 ms jobs any of the workers ran, relative
+// to an even split, all jobs are spawned by worker 0 so the others only get
+// them by stealing, sleeping keeps it independent of the cores
+static double check_distribution(uint32_t threads) {
+    const uint32_t count = 400;
+    job_system system;
+    create_job_system(system, threads);
+    vector<atomic<uint32_t>> jobs(threads);
+    auto root = create_job(system, []() {});
+    for (auto i = 0u; i < count; i++) {
+        run_job(system, *create_job(system, root, [&]() {
+            this_thread::sleep_for(chrono::milliseconds(1));
+            jobs[get_worker_index()].fetch_add(1, memory_order_relaxed);
+        }));
+    }
+    run_job(system, *root);
+    wait_job(system, *root);
+    destroy_job_system(system);
+    uint32_t fewest = count;
+    for (auto& j : jobs) {
+        fewest = min(fewest, j.load(memory_order_relaxed));
+    }
+    return double(fewest) * threads / count;
+}
+
+int main() {
+    auto max_threads = max(thread::hardware_concurrency(), 1u);
+
+    job_system check_system;
+    create_job_system(check_system, max_threads);
+    uint32_t errors = 0;
+    for (auto count : {max_jobs_per_worker + 1, 5000u, 1u << 20}) {
+        errors += check_coverage(check_system, count);
+    }
+    destroy_job_system(check_system);
+    if (errors > 0) {
+        cout << errors << " indices not visited exactly once" << endl;
+        return 1;
+    }
+    auto share = check_distribution(4);
+    if (share < 0.25) {
+        cout <<
+            "a worker ran " << 100 * share <<
+            "% of an even share of the jobs" << endl;
+        return 1;
+    }
+    vector<float> values(1 << 20, 1.f);
+
+    double single_thread_time = 0;
+    for (auto threads = 1u; threads <= max_threads; threads *= 2) {
+        job_system system;
+        create_job_system(system, threads);
+        auto overhead = spawn_overhead(system);
+        auto time = workload(system, values);
+        destroy_job_system(system);
+
+        if (threads == 1) {
+            single_thread_time = time;
+        }
+        cout <<
+            threads << " threads: " << overhead << " ns per job, " <<
+            time << " ms parallel_for, " <<
+            100 * single_thread_time / (time * threads) <<
+            "% efficiency" << endl;
+
+        if (threads < max_threads && threads * 2 > max_threads) {
+            threads = max_threads / 2;
+        }
+    }
+}
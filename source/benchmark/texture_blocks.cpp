@@ -0,0 +1,126 @@
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+#include "../texture_blocks.h"
+#include "timing.h"
+
+using namespace std;
+
+// measures decoding a 2048 by 2048 level of random blocks, which covers
+// every mode, in each format that can be decoded. This is the cost of a
+// level the device can't sample, on the loader thread of the texture stream.
+// Blocks with known texels are checked first.
+
+struct known_block {
+    const char* name;
+    VkFormat format;
+    uint8_t bytes[16];
+    // of the first and the last texel, worked out from the specifications
+    uint8_t texels[2][4];
+};
+
+static const known_block known_blocks[]{
+    {
+        "bc5", VK_FORMAT_BC5_UNORM_BLOCK,
+        {200, 100, 0, 0, 0, 0, 0, 0, 10, 20, 255, 255, 255, 255, 255, 255},
+        {{200, 255, 0, 255}, {200, 255, 0, 255}},
+    }, {
+        // mode 6 with p-bits, the last texel has the highest index
+        "bc7 mode 6", VK_FORMAT_BC7_UNORM_BLOCK,
+        {
+            0xc0, 0x3f, 0x00, 0xf0, 0x07, 0x02, 0xff, 0xff,
+            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xf0,
+        },
+        {{255, 1, 129, 255}, {0, 254, 128, 254}},
+    }, {
+        // mode 1 with two subsets and shared p-bits
+        "bc7 mode 1", VK_FORMAT_BC7_UNORM_BLOCK,
+        {
+            0x52, 0xf2, 0x26, 0x65, 0xa6, 0x0c, 0x12, 0xd2,
+            0x89, 0x18, 0x5d, 0x95, 0x0e, 0xe8, 0x81, 0x36,
+        },
+        {{164, 175, 110, 255}, {190, 162, 86, 255}},
+    }, {
+        "etc2 individual", VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK,
+        {0x88, 0x44, 0x22, 0x00, 0x00, 0x00, 0x00, 0x00},
+        {{138, 70, 36, 255}, {138, 70, 36, 255}},
+    }, {
+        "etc2 differential", VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK,
+        {0x80, 0x40, 0x20, 0x02, 0x00, 0x00, 0xff, 0xff},
+        {{140, 74, 41, 255}, {140, 74, 41, 255}},
+    }, {
+        "etc2 t", VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK,
+        {0xf2, 0x53, 0x28, 0xc2, 0x80, 0x00, 0x80, 0x00},
+        {{170, 85, 51, 255}, {31, 133, 201, 255}},
+    }, {
+        "etc2 h", VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK,
+        {0x23, 0x0c, 0xe1, 0x8a, 0x80, 0x00, 0x80, 0x00},
+        {{71, 105, 156, 255}, {201, 48, 14, 255}},
+    }, {
+        "etc2 planar", VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK,
+        {0x41, 0x00, 0x14, 0x62, 0xfe, 0x80, 0x10, 0x3f},
+        {{130, 129, 65, 255}, {81, 224, 208, 255}},
+    }, {
+        "eac", VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK,
+        {
+            0x80, 0x1d, 0x00, 0x00, 0x00, 0x00, 0x00, 0x07,
+            0x88, 0x44, 0x22, 0x00, 0x00, 0x00, 0x00, 0x00,
+        },
+        {{138, 70, 36, 127}, {138, 70, 36, 137}},
+    },
+};
+
+// returns the number of blocks that didn't decode to their texels
+static uint32_t check_known_blocks() {
+    uint32_t errors = 0;
+    for (auto& known : known_blocks) {
+        uint8_t rgba[16 * 4];
+        decode_blocks(known.format, 4, 4, known.bytes, rgba);
+        if (
+            !equal(rgba, rgba + 4, known.texels[0]) ||
+            !equal(rgba + 15 * 4, rgba + 16 * 4, known.texels[1])
+        ) {
+            cout << known.name << " block decoded wrongly" << endl;
+            errors++;
+        }
+    }
+    return errors;
+}
+
+int main() {
+    if (check_known_blocks() > 0) {
+        return 1;
+    }
+    const uint32_t size = 2048, repetitions = 8;
+    mt19937 random(1);
+    vector<uint8_t> rgba(size_t(size) * size * 4);
+    const pair<VkFormat, const char*> formats[]{
+        {VK_FORMAT_BC5_UNORM_BLOCK, "bc5"},
+        {VK_FORMAT_BC7_UNORM_BLOCK, "bc7"},
+        {VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK, "etc2 rgb"},
+        {VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK, "etc2 rgba"},
+    };
+    for (auto [format, name] : formats) {
+        vector<uint8_t> blocks(get_level_size(format, size, size));
+        for (auto& byte : blocks) {
+            byte = uint8_t(random());
+        }
+        auto start = chrono::steady_clock::now();
+        for (auto i = 0u; i < repetitions; i++) {
+            decode_blocks(format, size, size, blocks.data(), rgba.data());
+        }
+        auto time = milliseconds_since(start) / repetitions;
+        // keeps the decoding from being optimized away
+        uint64_t sum = 0;
+        for (auto value : rgba) {
+            sum += value;
+        }
+        cout <<
+            name << ": " << time << " ms per level, " <<
+            double(size) * size / time / 1000 << " Mtexels/s, checksum " <<
+            sum << endl;
+    }
+}
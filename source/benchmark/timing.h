@@ -0,0 +1,11 @@
+#pragma once
+
+#include <chrono>
+
+// wall clock time of the benchmarks
+
+inline double milliseconds_since(std::chrono::steady_clock::time_point start) {
+    std::chrono::duration<double, std::milli> duration =
+        std::chrono::steady_clock::now() - start;
+    return duration.count();
+}
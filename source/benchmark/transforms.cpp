@@ -0,0 +1,97 @@
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <cmath>
+
+#include "../transform_hierarchy.h"
+#include "timing.h"
+
+using namespace std;
+
+// measures world matrix propagation in nodes per millisecond, for all nodes
+// animated and for a few animated subtrees, and the time of applying a
+// moving camera to all instances like the renderer does every frame
+
+struct instance_data {
+    float matrix[16];
+    uint32_t material;
+};
+
+static void run(
+    const char* name, transform_hierarchy& hierarchy,
+    vector<instance_data>& instances, vector<instance_data>& camera_instances,
+    uint32_t animated_count, unsigned iterations
+) {
+    const float root_matrix[16]{
+        1, 0, 0, 0,
+        0, 1, 0, 0,
+        0, 0, 1, 0,
+        0, 0, 0, 1,
+    };
+    auto node_count = static_cast<uint32_t>(hierarchy.slots.size());
+    uint64_t updated = 0;
+    auto start = chrono::steady_clock::now();
+    for (auto i = 0u; i < iterations; i++) {
+        float angle = i * 0.01f;
+        for (auto j = 0u; j < animated_count; j++) {
+            auto node = j * (node_count / animated_count);
+            set_rotation(
+                hierarchy, node, 0, 0, sin(angle * 0.5f), cos(angle * 0.5f)
+            );
+        }
+        updated += update_transforms(
+            hierarchy, root_matrix, instances.data(), sizeof(instance_data)
+        );
+    }
+    auto time = milliseconds_since(start);
+
+    start = chrono::steady_clock::now();
+    for (auto i = 0u; i < iterations; i++) {
+        // translation along x, which changes every iteration
+        float camera[16]{
+            1, 0, 0, 0,
+            0, 1, 0, 0,
+            0, 0, 1, 0,
+            i * 0.01f, 0, 0, 1,
+        };
+        multiply_instances(
+            camera, instances.data(), camera_instances.data(),
+            instances.size(), sizeof(instance_data)
+        );
+    }
+    auto camera_time = milliseconds_since(start);
+    cout <<
+        name << ": " << updated / iterations << " nodes per update, " <<
+        updated / time << " nodes/ms, " << camera_time / iterations <<
+        " ms camera" << endl;
+}
+
+int main() {
+    const uint32_t node_count = 1 << 16;
+    transform_hierarchy hierarchy;
+    vector<instance_data> instances(node_count), camera_instances(node_count);
+
+    // random tree with a bounded fan out, parents are created first
+    mt19937 random(1);
+    for (auto i = 0u; i < node_count; i++) {
+        uint32_t parent = no_node;
+        if (i >= 16) {
+            parent = uniform_int_distribution<uint32_t>(i / 8, i - 1)(random);
+        }
+        auto node = add_node(hierarchy, parent, i);
+        set_translation(hierarchy, node, 1, 0, 0);
+        set_scale(hierarchy, node, 0.99f, 0.99f, 0.99f);
+    }
+
+    run(
+        "all nodes animated", hierarchy, instances, camera_instances,
+        node_count, 100
+    );
+    run(
+        "1/64 of nodes animated", hierarchy, instances, camera_instances,
+        node_count / 64, 100
+    );
+    run(
+        "16 nodes animated", hierarchy, instances, camera_instances, 16, 1000
+    );
+}
@@ -0,0 +1,228 @@
+#include "bindless.h"
+
+#include <stdexcept>
+#include <algorithm>
+
+using namespace std;
+
+void enable_bindless_features(
+    const VkPhysicalDeviceVulkan12Features& supported,
+    VkPhysicalDeviceVulkan12Features& enabled
+) {
+    if (
+        !supported.runtimeDescriptorArray ||
+        !supported.descriptorBindingPartiallyBound ||
+        !supported.descriptorBindingVariableDescriptorCount ||
+        !supported.shaderStorageBufferArrayNonUniformIndexing ||
+        !supported.shaderSampledImageArrayNonUniformIndexing ||
+        !supported.descriptorBindingStorageBufferUpdateAfterBind ||
+        !supported.descriptorBindingSampledImageUpdateAfterBind ||
+        !supported.descriptorBindingUpdateUnusedWhilePending
+    ) {
+        throw runtime_error("descriptor indexing not supported");
+    }
+    enabled.runtimeDescriptorArray = VK_TRUE;
+    enabled.descriptorBindingPartiallyBound = VK_TRUE;
+    enabled.descriptorBindingVariableDescriptorCount = VK_TRUE;
+    enabled.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+    enabled.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    enabled.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+    enabled.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    enabled.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+}
+
+void create_bindless_set(
+    VkDevice device, VkPhysicalDevice physical_device,
+    uint32_t max_buffers, uint32_t max_textures, bindless_set& set
+) {
+    {
+        VkPhysicalDeviceVulkan12Properties vulkan_12_properties{
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES,
+        };
+        VkPhysicalDeviceProperties2 properties{
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+            .pNext = &vulkan_12_properties,
+        };
+        vkGetPhysicalDeviceProperties2(physical_device, &properties);
+        max_buffers = min(
+            max_buffers,
+            vulkan_12_properties.
+                maxPerStageDescriptorUpdateAfterBindStorageBuffers
+        );
+        max_textures = min(
+            max_textures,
+            vulkan_12_properties.
+                maxPerStageDescriptorUpdateAfterBindSampledImages
+        );
+    }
+    set.max_buffers = max_buffers;
+    set.max_textures = max_textures;
+    set.buffer_count = 0;
+    set.texture_count = 0;
+    set.free_buffers.clear();
+    set.free_textures.clear();
+
+    {
+        VkDescriptorSetLayoutBinding bindings[]{
+            {
+                .binding = bindless_buffers,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = max_buffers,
+                .stageFlags = VK_SHADER_STAGE_ALL,
+            }, {
+                .binding = bindless_textures,
+                .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                .descriptorCount = max_textures,
+                .stageFlags = VK_SHADER_STAGE_ALL,
+            },
+        };
+        // slots are written while submitted frames use other slots
+        const VkDescriptorBindingFlags flags =
+            VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+            VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+            VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+        VkDescriptorBindingFlags binding_flags[]{
+            flags,
+            // only the last binding can have a variable count
+            flags | VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT,
+        };
+        VkDescriptorSetLayoutBindingFlagsCreateInfo flags_create_info{
+            .sType =
+                VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+            .bindingCount = size(binding_flags),
+            .pBindingFlags = binding_flags,
+        };
+        VkDescriptorSetLayoutCreateInfo create_info{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .pNext = &flags_create_info,
+            .flags =
+                VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT,
+            .bindingCount = size(bindings),
+            .pBindings = bindings,
+        };
+        if (
+            vkCreateDescriptorSetLayout(
+                device, &create_info, nullptr, &set.layout
+            ) != VK_SUCCESS
+        ) {
+            throw runtime_error("failed to create descriptor set layout");
+        }
+    }
+
+    {
+        VkDescriptorPoolSize sizes[]{
+            {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, max_buffers},
+            {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, max_textures},
+        };
+        VkDescriptorPoolCreateInfo create_info{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+            .flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT,
+            .maxSets = 1,
+            .poolSizeCount = size(sizes),
+            .pPoolSizes = sizes,
+        };
+        if (
+            vkCreateDescriptorPool(device, &create_info, nullptr, &set.pool) !=
+            VK_SUCCESS
+        ) {
+            throw runtime_error("failed to create descriptor pool");
+        }
+    }
+
+    {
+        VkDescriptorSetVariableDescriptorCountAllocateInfo count_info{
+            .sType =
+                VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO,
+            .descriptorSetCount = 1,
+            .pDescriptorCounts = &max_textures,
+        };
+        VkDescriptorSetAllocateInfo allocate_info{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .pNext = &count_info,
+            .descriptorPool = set.pool,
+            .descriptorSetCount = 1,
+            .pSetLayouts = &set.layout,
+        };
+        if (
+            vkAllocateDescriptorSets(device, &allocate_info, &set.set) !=
+            VK_SUCCESS
+        ) {
+            throw runtime_error("failed to allocate descriptor set");
+        }
+    }
+}
+
+void destroy_bindless_set(VkDevice device, const bindless_set& set) {
+    vkDestroyDescriptorPool(device, set.pool, nullptr);
+    vkDestroyDescriptorSetLayout(device, set.layout, nullptr);
+}
+
+static uint32_t allocate_slot(
+    vector<uint32_t>& free_slots, uint32_t& count, uint32_t max
+) {
+    if (!free_slots.empty()) {
+        auto index = free_slots.back();
+        free_slots.pop_back();
+        return index;
+    }
+    if (count == max) {
+        throw runtime_error("bindless descriptor array is full");
+    }
+    return count++;
+}
+
+uint32_t add_buffer(
+    VkDevice device, bindless_set& set,
+    VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range
+) {
+    auto index =
+        allocate_slot(set.free_buffers, set.buffer_count, set.max_buffers);
+    VkDescriptorBufferInfo buffer_info{
+        .buffer = buffer,
+        .offset = offset,
+        .range = range,
+    };
+    VkWriteDescriptorSet write{
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = set.set,
+        .dstBinding = bindless_buffers,
+        .dstArrayElement = index,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .pBufferInfo = &buffer_info,
+    };
+    vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+    return index;
+}
+
+uint32_t add_texture(
+    VkDevice device, bindless_set& set,
+    VkImageView view, VkSampler sampler
+) {
+    auto index =
+        allocate_slot(set.free_textures, set.texture_count, set.max_textures);
+    VkDescriptorImageInfo image_info{
+        .sampler = sampler,
+        .imageView = view,
+        .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+    };
+    VkWriteDescriptorSet write{
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = set.set,
+        .dstBinding = bindless_textures,
+        .dstArrayElement = index,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .pImageInfo = &image_info,
+    };
+    vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+    return index;
+}
+
+void remove_buffer(bindless_set& set, uint32_t index) {
+    set.free_buffers.push_back(index);
+}
+
+void remove_texture(bindless_set& set, uint32_t index) {
+    set.free_textures.push_back(index);
+}
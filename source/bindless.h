@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+// One descriptor set with arrays of all storage buffers and textures. It is
+// bound once per pipeline layout and shaders pick resources by index, so
+// draws with different materials need no descriptor updates or rebinds.
+// Uses descriptor indexing, which is core in Vulkan 1.2.
+
+enum bindless_binding : uint32_t {
+    bindless_buffers, bindless_textures,
+};
+
+// storage buffer slot that holds the material array, the shaders rely on it
+const uint32_t bindless_material_buffer = 0;
+
+const uint32_t no_texture = -1u;
+const uint32_t no_buffer = -1u;
+
+// matches struct material in the shaders, std430 layout
+struct material {
+    float color[4];
+    uint32_t texture;
+    uint32_t padding[3];
+};
+
+struct bindless_set {
+    VkDescriptorSetLayout layout;
+    VkDescriptorPool pool;
+    VkDescriptorSet set;
+    uint32_t max_buffers, max_textures;
+    // slots below these have been handed out at some point
+    uint32_t buffer_count, texture_count;
+    // removed slots, reused before new ones are handed out
+    std::vector<uint32_t> free_buffers, free_textures;
+};
+
+// enables the descriptor indexing features the set needs, throws if they
+// are not supported
+void enable_bindless_features(
+    const VkPhysicalDeviceVulkan12Features& supported,
+    VkPhysicalDeviceVulkan12Features& enabled
+);
+
+// clamps the requested sizes to the limits of the device
+void create_bindless_set(
+    VkDevice device, VkPhysicalDevice physical_device,
+    uint32_t max_buffers, uint32_t max_textures, bindless_set& set
+);
+void destroy_bindless_set(VkDevice device, const bindless_set& set);
+
+// descriptors are written with update-after-bind and update-unused-while-
+// pending, so slots can be added and removed while command buffers using
+// other slots are in flight. A removed slot must not be used by any of
+// them, it is handed out again.
+uint32_t add_buffer(
+    VkDevice device, bindless_set& set,
+    VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range
+);
+uint32_t add_texture(
+    VkDevice device, bindless_set& set,
+    VkImageView view, VkSampler sampler
+);
+// the slot must not be used by any command buffer in flight
+void remove_buffer(bindless_set& set, uint32_t index);
+void remove_texture(bindless_set& set, uint32_t index);
@@ -0,0 +1,45 @@
+#include "buffer.h"
+
+#include <stdexcept>
+
+using namespace std;
+
+void create_mapped_buffer(
+    VkDevice device, memory_tracker& tracker, memory_tag tag,
+    VkDeviceSize size, VkBufferUsageFlags usage, mapped_buffer& buffer,
+    VkMemoryPropertyFlags properties
+) {
+    buffer.size = size;
+    VkBufferCreateInfo create_info{
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = size,
+        .usage = usage,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+    if (
+        vkCreateBuffer(device, &create_info, nullptr, &buffer.buffer) !=
+        VK_SUCCESS
+    ) {
+        throw runtime_error("failed to create buffer");
+    }
+
+    buffer.memory = allocate_tracked_memory(
+        device, tracker, buffer.buffer, properties, tag
+    );
+    vkBindBufferMemory(device, buffer.buffer, buffer.memory, 0);
+
+    if (
+        vkMapMemory(device, buffer.memory, 0, size, 0, &buffer.data) !=
+        VK_SUCCESS
+    ) {
+        throw runtime_error("failed to map buffer memory");
+    }
+}
+
+void destroy_mapped_buffer(
+    VkDevice device, memory_tracker& tracker, const mapped_buffer& buffer
+) {
+    vkUnmapMemory(device, buffer.memory);
+    vkDestroyBuffer(device, buffer.buffer, nullptr);
+    free_tracked_memory(device, tracker, buffer.memory);
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "memory_budget.h"
+
+// buffer in host visible memory that stays mapped for its lifetime, memory
+// must at least be host visible and coherent
+struct mapped_buffer {
+    VkBuffer buffer;
+    VkDeviceMemory memory;
+    void* data;
+    VkDeviceSize size;
+};
+
+void create_mapped_buffer(
+    VkDevice device, memory_tracker& tracker, memory_tag tag,
+    VkDeviceSize size, VkBufferUsageFlags usage, mapped_buffer& buffer,
+    VkMemoryPropertyFlags properties =
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+);
+void destroy_mapped_buffer(
+    VkDevice device, memory_tracker& tracker, const mapped_buffer& buffer
+);
@@ -0,0 +1,658 @@
+#include "bvh.h"
+
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <immintrin.h>
+#define BVH_SSE
+#endif
+
+using namespace std;
+
+// split candidates per axis of the binned surface area heuristic
+const uint32_t bvh_bins = 16;
+// below this depth nodes are split at the median instead, which bounds the
+// depth of the tree, and thereby the traversal stack, for any input
+const uint32_t bvh_sah_depth = 32;
+// enough for 2^32 items below that depth, queries push both children
+const uint32_t bvh_stack_size = 128;
+
+struct bvh_bounds {
+    float min[3], max[3];
+};
+
+// what the nodes are built over, triangles or instances
+struct bvh_item {
+    bvh_bounds bounds;
+    float center[3];
+};
+
+static void reset_bounds(bvh_bounds& bounds) {
+    for (auto i = 0u; i < 3; i++) {
+        bounds.min[i] = INFINITY;
+        bounds.max[i] = -INFINITY;
+    }
+}
+
+static void grow_bounds(bvh_bounds& bounds, const float point[3]) {
+    for (auto i = 0u; i < 3; i++) {
+        bounds.min[i] = min(bounds.min[i], point[i]);
+        bounds.max[i] = max(bounds.max[i], point[i]);
+    }
+}
+
+static void grow_bounds(bvh_bounds& bounds, const bvh_bounds& other) {
+    for (auto i = 0u; i < 3; i++) {
+        bounds.min[i] = min(bounds.min[i], other.min[i]);
+        bounds.max[i] = max(bounds.max[i], other.max[i]);
+    }
+}
+
+// half the surface area, 0 for empty bounds
+static float get_area(const bvh_bounds& bounds) {
+    float x = bounds.max[0] - bounds.min[0];
+    float y = bounds.max[1] - bounds.min[1];
+    float z = bounds.max[2] - bounds.min[2];
+    if (x < 0 || y < 0 || z < 0) {
+        return 0;
+    }
+    return x * y + y * z + z * x;
+}
+
+static uint32_t get_bin(float center, float low, float scale) {
+    return min(uint32_t(max(center - low, 0.f) * scale), bvh_bins - 1);
+}
+
+// appends the subtree over order[begin, end) in depth first order, leaves
+// have up to leaf_size items and point into order
+static void build_nodes(
+    const vector<bvh_item>& items, vector<uint32_t>& order,
+    uint32_t begin, uint32_t end, uint32_t leaf_size, uint32_t depth,
+    vector<bvh_node>& nodes
+) {
+    auto node = uint32_t(nodes.size());
+    nodes.push_back({});
+    bvh_bounds bounds, centers;
+    reset_bounds(bounds);
+    reset_bounds(centers);
+    for (auto i = begin; i < end; i++) {
+        grow_bounds(bounds, items[order[i]].bounds);
+        grow_bounds(centers, items[order[i]].center);
+    }
+    copy(bounds.min, bounds.min + 3, nodes[node].min);
+    copy(bounds.max, bounds.max + 3, nodes[node].max);
+    if (end - begin <= leaf_size) {
+        nodes[node].index = begin;
+        nodes[node].count = end - begin;
+        return;
+    }
+
+    // the cost of a split is the number of items on each side weighted by
+    // the surface area of their bounds, the items are binned along all
+    // axes in one pass and the bins are swept from both sides
+    float scales[3];
+    bool binned = false;
+    for (auto axis = 0u; axis < 3; axis++) {
+        auto extent = centers.max[axis] - centers.min[axis];
+        scales[axis] =
+            extent > 0 && depth < bvh_sah_depth ? bvh_bins / extent : 0;
+        binned |= scales[axis] > 0;
+    }
+    float best_cost = INFINITY;
+    uint32_t best_axis = 3, best_split = 0;
+    if (binned) {
+        bvh_bounds bins[3][bvh_bins];
+        uint32_t counts[3][bvh_bins]{};
+        for (auto& axis_bins : bins) {
+            for (auto& bin : axis_bins) {
+                reset_bounds(bin);
+            }
+        }
+        for (auto i = begin; i < end; i++) {
+            auto& item = items[order[i]];
+            for (auto axis = 0u; axis < 3; axis++) {
+                auto bin = get_bin(
+                    item.center[axis], centers.min[axis], scales[axis]
+                );
+                grow_bounds(bins[axis][bin], item.bounds);
+                counts[axis][bin]++;
+            }
+        }
+        for (auto axis = 0u; axis < 3; axis++) {
+            if (scales[axis] == 0) {
+                continue;
+            }
+            float right_costs[bvh_bins];
+            bvh_bounds side;
+            reset_bounds(side);
+            uint32_t count = 0;
+            for (auto bin = bvh_bins - 1; bin > 0; bin--) {
+                grow_bounds(side, bins[axis][bin]);
+                count += counts[axis][bin];
+                right_costs[bin] = get_area(side) * count;
+            }
+            reset_bounds(side);
+            count = 0;
+            for (auto split = 1u; split < bvh_bins; split++) {
+                grow_bounds(side, bins[axis][split - 1]);
+                count += counts[axis][split - 1];
+                auto cost = get_area(side) * count + right_costs[split];
+                if (cost < best_cost) {
+                    best_cost = cost;
+                    best_axis = axis;
+                    best_split = split;
+                }
+            }
+        }
+    }
+
+    uint32_t middle = begin;
+    if (best_axis < 3) {
+        auto scale = scales[best_axis];
+        middle = uint32_t(
+            partition(
+                order.begin() + begin, order.begin() + end,
+                [&](uint32_t item) {
+                    return get_bin(
+                        items[item].center[best_axis],
+                        centers.min[best_axis], scale
+                    ) < best_split;
+                }
+            ) - order.begin()
+        );
+    }
+    if (middle == begin || middle == end) {
+        // all centers in one bin, or too deep, split at the median of the
+        // longest axis
+        uint32_t axis = 0;
+        for (auto i = 1u; i < 3; i++) {
+            if (
+                centers.max[i] - centers.min[i] >
+                centers.max[axis] - centers.min[axis]
+            ) {
+                axis = i;
+            }
+        }
+        middle = (begin + end) / 2;
+        nth_element(
+            order.begin() + begin, order.begin() + middle,
+            order.begin() + end, [&](uint32_t a, uint32_t b) {
+                return items[a].center[axis] < items[b].center[axis];
+            }
+        );
+    }
+    build_nodes(items, order, begin, middle, leaf_size, depth + 1, nodes);
+    nodes[node].index = uint32_t(nodes.size());
+    nodes[node].count = 0;
+    build_nodes(items, order, middle, end, leaf_size, depth + 1, nodes);
+}
+
+static void build_nodes(
+    const vector<bvh_item>& items, uint32_t leaf_size,
+    vector<bvh_node>& nodes, vector<uint32_t>& order
+) {
+    nodes.clear();
+    order.resize(items.size());
+    iota(order.begin(), order.end(), 0u);
+    if (!items.empty()) {
+        build_nodes(
+            items, order, 0, uint32_t(items.size()), leaf_size, 0, nodes
+        );
+    }
+}
+
+void build_mesh_bvh(
+    span<const float> vertices, uint32_t vertex_stride,
+    span<const uint32_t> indices, mesh_bvh& bvh
+) {
+    auto triangle_count = uint32_t(indices.size() / 3);
+    vector<bvh_item> items(triangle_count);
+    for (auto t = 0u; t < triangle_count; t++) {
+        auto& item = items[t];
+        reset_bounds(item.bounds);
+        for (auto i = 0u; i < 3; i++) {
+            auto vertex = &vertices[size_t(indices[t * 3 + i]) * vertex_stride];
+            grow_bounds(item.bounds, vertex);
+        }
+        for (auto i = 0u; i < 3; i++) {
+            item.center[i] = (item.bounds.min[i] + item.bounds.max[i]) / 2;
+        }
+    }
+    vector<uint32_t> order;
+    build_nodes(items, bvh_leaf_size, bvh.nodes, order);
+
+    // leaves point to their packet instead of order
+    bvh.packets.clear();
+    for (auto& node : bvh.nodes) {
+        if (node.count == 0) {
+            continue;
+        }
+        bvh_triangles packet{};
+        for (auto lane = 0u; lane < node.count; lane++) {
+            auto triangle = order[node.index + lane];
+            const float* corners[3];
+            for (auto i = 0u; i < 3; i++) {
+                corners[i] = &vertices[
+                    size_t(indices[triangle * 3 + i]) * vertex_stride
+                ];
+            }
+            for (auto i = 0u; i < 3; i++) {
+                packet.v0[i][lane] = corners[0][i];
+                packet.e1[i][lane] = corners[1][i] - corners[0][i];
+                packet.e2[i][lane] = corners[2][i] - corners[0][i];
+            }
+            packet.ids[lane] = triangle;
+        }
+        node.index = uint32_t(bvh.packets.size());
+        bvh.packets.push_back(packet);
+    }
+}
+
+// column major affine matrix to the 3 by 4 row major inverse
+static void invert_matrix(const float m[16], float inverse[12]) {
+    // cofactors of the upper 3 by 3 block
+    float c[9]{
+        m[5] * m[10] - m[6] * m[9],
+        m[8] * m[6] - m[4] * m[10],
+        m[4] * m[9] - m[8] * m[5],
+        m[9] * m[2] - m[1] * m[10],
+        m[0] * m[10] - m[8] * m[2],
+        m[8] * m[1] - m[0] * m[9],
+        m[1] * m[6] - m[5] * m[2],
+        m[4] * m[2] - m[0] * m[6],
+        m[0] * m[5] - m[4] * m[1],
+    };
+    auto determinant = m[0] * c[0] + m[4] * c[3] + m[8] * c[6];
+    auto scale = determinant != 0 ? 1 / determinant : 0;
+    for (auto row = 0u; row < 3; row++) {
+        auto r = &inverse[row * 4];
+        for (auto column = 0u; column < 3; column++) {
+            r[column] = c[column * 3 + row] * scale;
+        }
+        r[3] = -(r[0] * m[12] + r[1] * m[13] + r[2] * m[14]);
+    }
+}
+
+void build_scene_bvh(
+    span<const mesh_bvh> meshes, span<const uint32_t> instances,
+    const void* matrices, size_t stride, scene_bvh& bvh
+) {
+    auto count = uint32_t(instances.size());
+    bvh.meshes.assign(instances.begin(), instances.end());
+    bvh.inverse_matrices.resize(size_t(count) * 12);
+    vector<bvh_item> items;
+    // instances of empty meshes can't be hit and are left out
+    vector<uint32_t> ids;
+    for (auto i = 0u; i < count; i++) {
+        float matrix[16];
+        memcpy(matrix, (const char*)matrices + i * stride, sizeof(matrix));
+        invert_matrix(matrix, &bvh.inverse_matrices[size_t(i) * 12]);
+        auto& mesh = meshes[instances[i]];
+        if (mesh.nodes.empty()) {
+            continue;
+        }
+        // the corners of the root bounds in world space
+        auto& root = mesh.nodes[0];
+        bvh_item item;
+        reset_bounds(item.bounds);
+        for (auto corner = 0u; corner < 8; corner++) {
+            float local[3], world[3];
+            for (auto j = 0u; j < 3; j++) {
+                local[j] = corner >> j & 1 ? root.max[j] : root.min[j];
+            }
+            for (auto j = 0u; j < 3; j++) {
+                world[j] =
+                    matrix[j] * local[0] + matrix[4 + j] * local[1] +
+                    matrix[8 + j] * local[2] + matrix[12 + j];
+            }
+            grow_bounds(item.bounds, world);
+        }
+        for (auto j = 0u; j < 3; j++) {
+            item.center[j] = (item.bounds.min[j] + item.bounds.max[j]) / 2;
+        }
+        items.push_back(item);
+        ids.push_back(i);
+    }
+    vector<uint32_t> order;
+    // instances are expensive to test, every one gets its own leaf
+    build_nodes(items, 1, bvh.nodes, order);
+    bvh.instances.resize(order.size());
+    for (auto i = 0u; i < order.size(); i++) {
+        bvh.instances[i] = ids[order[i]];
+    }
+}
+
+// the ray with its reciprocal direction, prepared once for all boxes
+struct bvh_ray_data {
+    float origin[3], direction[3], inverse_direction[3];
+#ifdef BVH_SSE
+    __m128 sse_origin, sse_inverse_direction;
+#endif
+};
+
+static void prepare_ray(const bvh_ray& ray, bvh_ray_data& data) {
+    for (auto i = 0u; i < 3; i++) {
+        data.origin[i] = ray.origin[i];
+        data.direction[i] = ray.direction[i];
+        // axis parallel rays get a huge instead of an infinite reciprocal,
+        // which avoids 0 * infinity in the slab test
+        auto d = ray.direction[i];
+        data.inverse_direction[i] =
+            1 / (fabs(d) < 1e-20f ? copysign(1e-20f, d) : d);
+    }
+#ifdef BVH_SSE
+    data.sse_origin = _mm_setr_ps(
+        data.origin[0], data.origin[1], data.origin[2], 0
+    );
+    data.sse_inverse_direction = _mm_setr_ps(
+        data.inverse_direction[0], data.inverse_direction[1],
+        data.inverse_direction[2], 0
+    );
+#endif
+}
+
+// slab test, near is the distance at which the ray enters the box
+static bool intersect_box(
+    const bvh_ray_data& ray, const bvh_node& node, float max_distance,
+    float& near
+) {
+    float entry, exit;
+#ifdef BVH_SSE
+    // the fourth lane holds index or count, which stay finite as floats and
+    // are multiplied by 0
+    __m128 low = _mm_mul_ps(
+        _mm_sub_ps(_mm_loadu_ps(node.min), ray.sse_origin),
+        ray.sse_inverse_direction
+    );
+    __m128 high = _mm_mul_ps(
+        _mm_sub_ps(_mm_loadu_ps(node.max), ray.sse_origin),
+        ray.sse_inverse_direction
+    );
+    __m128 t_near = _mm_min_ps(low, high);
+    // the fourth lane mustn't limit the exit distance
+    __m128 t_far = _mm_max_ps(
+        _mm_max_ps(low, high),
+        _mm_setr_ps(-INFINITY, -INFINITY, -INFINITY, INFINITY)
+    );
+    t_near = _mm_max_ps(
+        t_near, _mm_shuffle_ps(t_near, t_near, _MM_SHUFFLE(2, 3, 0, 1))
+    );
+    t_near = _mm_max_ps(
+        t_near, _mm_shuffle_ps(t_near, t_near, _MM_SHUFFLE(1, 0, 3, 2))
+    );
+    t_far = _mm_min_ps(
+        t_far, _mm_shuffle_ps(t_far, t_far, _MM_SHUFFLE(2, 3, 0, 1))
+    );
+    t_far = _mm_min_ps(
+        t_far, _mm_shuffle_ps(t_far, t_far, _MM_SHUFFLE(1, 0, 3, 2))
+    );
+    entry = _mm_cvtss_f32(t_near);
+    exit = _mm_cvtss_f32(t_far);
+#else
+    entry = -INFINITY;
+    exit = INFINITY;
+    for (auto i = 0u; i < 3; i++) {
+        auto low = (node.min[i] - ray.origin[i]) * ray.inverse_direction[i];
+        auto high = (node.max[i] - ray.origin[i]) * ray.inverse_direction[i];
+        entry = max(entry, min(low, high));
+        exit = min(exit, max(low, high));
+    }
+#endif
+    near = max(entry, 0.f);
+    return near <= exit && near < max_distance;
+}
+
+// Möller-Trumbore on four triangles at once, updates hit with the closest
+static bool intersect_triangles(
+    const bvh_ray_data& ray, const bvh_triangles& packet, bvh_hit& hit
+) {
+#ifdef BVH_SSE
+    __m128 dx = _mm_set1_ps(ray.direction[0]);
+    __m128 dy = _mm_set1_ps(ray.direction[1]);
+    __m128 dz = _mm_set1_ps(ray.direction[2]);
+    __m128 e1x = _mm_loadu_ps(packet.e1[0]);
+    __m128 e1y = _mm_loadu_ps(packet.e1[1]);
+    __m128 e1z = _mm_loadu_ps(packet.e1[2]);
+    __m128 e2x = _mm_loadu_ps(packet.e2[0]);
+    __m128 e2y = _mm_loadu_ps(packet.e2[1]);
+    __m128 e2z = _mm_loadu_ps(packet.e2[2]);
+    // p = d x e2
+    __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+    __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+    __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+    __m128 determinant = _mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)),
+        _mm_mul_ps(e1z, pz)
+    );
+    __m128 inverse = _mm_div_ps(_mm_set1_ps(1), determinant);
+    __m128 sx = _mm_sub_ps(
+        _mm_set1_ps(ray.origin[0]), _mm_loadu_ps(packet.v0[0])
+    );
+    __m128 sy = _mm_sub_ps(
+        _mm_set1_ps(ray.origin[1]), _mm_loadu_ps(packet.v0[1])
+    );
+    __m128 sz = _mm_sub_ps(
+        _mm_set1_ps(ray.origin[2]), _mm_loadu_ps(packet.v0[2])
+    );
+    __m128 u = _mm_mul_ps(
+        _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)),
+            _mm_mul_ps(sz, pz)
+        ),
+        inverse
+    );
+    // q = s x e1
+    __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+    __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+    __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+    __m128 v = _mm_mul_ps(
+        _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)),
+            _mm_mul_ps(dz, qz)
+        ),
+        inverse
+    );
+    __m128 t = _mm_mul_ps(
+        _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)),
+            _mm_mul_ps(e2z, qz)
+        ),
+        inverse
+    );
+    // degenerate lanes have a determinant of 0, comparisons with the NaNs
+    // they produce are false
+    __m128 zero = _mm_setzero_ps();
+    __m128 mask = _mm_and_ps(
+        _mm_and_ps(
+            _mm_cmpneq_ps(determinant, zero),
+            _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmpge_ps(v, zero))
+        ),
+        _mm_and_ps(
+            _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1)),
+            _mm_and_ps(
+                _mm_cmpgt_ps(t, zero),
+                _mm_cmplt_ps(t, _mm_set1_ps(hit.distance))
+            )
+        )
+    );
+    auto lanes = _mm_movemask_ps(mask);
+    if (lanes == 0) {
+        return false;
+    }
+    float distances[4];
+    _mm_storeu_ps(distances, t);
+    for (auto lane = 0u; lane < 4; lane++) {
+        if (lanes >> lane & 1 && distances[lane] < hit.distance) {
+            hit.distance = distances[lane];
+            hit.triangle = packet.ids[lane];
+        }
+    }
+    return true;
+#else
+    bool found = false;
+    auto& d = ray.direction;
+    for (auto lane = 0u; lane < 4; lane++) {
+        float e1[3], e2[3], s[3];
+        for (auto i = 0u; i < 3; i++) {
+            e1[i] = packet.e1[i][lane];
+            e2[i] = packet.e2[i][lane];
+            s[i] = ray.origin[i] - packet.v0[i][lane];
+        }
+        float p[3]{
+            d[1] * e2[2] - d[2] * e2[1],
+            d[2] * e2[0] - d[0] * e2[2],
+            d[0] * e2[1] - d[1] * e2[0],
+        };
+        auto determinant = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+        if (determinant == 0) {
+            continue;
+        }
+        auto inverse = 1 / determinant;
+        auto u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * inverse;
+        float q[3]{
+            s[1] * e1[2] - s[2] * e1[1],
+            s[2] * e1[0] - s[0] * e1[2],
+            s[0] * e1[1] - s[1] * e1[0],
+        };
+        auto v = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) * inverse;
+        auto t = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * inverse;
+        if (u >= 0 && v >= 0 && u + v <= 1 && t > 0 && t < hit.distance) {
+            hit.distance = t;
+            hit.triangle = packet.ids[lane];
+            found = true;
+        }
+    }
+    return found;
+#endif
+}
+
+// visits the leaves hit by the ray front to back, skipping nodes behind the
+// closest hit so far, intersect_leaf returns whether it updated hit
+template<typename F>
+static bool traverse(
+    const vector<bvh_node>& nodes, const bvh_ray_data& ray, bvh_hit& hit,
+    F&& intersect_leaf
+) {
+    float near;
+    if (nodes.empty() || !intersect_box(ray, nodes[0], hit.distance, near)) {
+        return false;
+    }
+    struct entry {
+        uint32_t node;
+        float near;
+    };
+    entry stack[bvh_stack_size];
+    uint32_t stack_size = 0;
+    uint32_t node = 0;
+    bool found = false;
+    while (true) {
+        auto& current = nodes[node];
+        if (current.count > 0) {
+            found |= intersect_leaf(current);
+        } else {
+            uint32_t first = node + 1, second = current.index;
+            float first_near, second_near;
+            bool first_hit = intersect_box(
+                ray, nodes[first], hit.distance, first_near
+            );
+            bool second_hit = intersect_box(
+                ray, nodes[second], hit.distance, second_near
+            );
+            if (first_hit && second_hit) {
+                if (second_near < first_near) {
+                    swap(first, second);
+                    swap(first_near, second_near);
+                }
+                stack[stack_size++] = {second, second_near};
+                node = first;
+                continue;
+            } else if (first_hit || second_hit) {
+                node = first_hit ? first : second;
+                continue;
+            }
+        }
+        // the next node that may still be in front of the closest hit
+        while (stack_size > 0 && stack[stack_size - 1].near >= hit.distance) {
+            stack_size--;
+        }
+        if (stack_size == 0) {
+            return found;
+        }
+        node = stack[--stack_size].node;
+    }
+}
+
+bool intersect_mesh_bvh(
+    const mesh_bvh& bvh, const bvh_ray& ray, bvh_hit& hit
+) {
+    bvh_ray_data data;
+    prepare_ray(ray, data);
+    return traverse(bvh.nodes, data, hit, [&](const bvh_node& leaf) {
+        return intersect_triangles(data, bvh.packets[leaf.index], hit);
+    });
+}
+
+bool intersect_scene_bvh(
+    const scene_bvh& bvh, span<const mesh_bvh> meshes, const bvh_ray& ray,
+    bvh_hit& hit
+) {
+    bvh_ray_data data;
+    prepare_ray(ray, data);
+    return traverse(bvh.nodes, data, hit, [&](const bvh_node& leaf) {
+        bool found = false;
+        for (auto i = leaf.index; i < leaf.index + leaf.count; i++) {
+            auto instance = bvh.instances[i];
+            auto m = &bvh.inverse_matrices[size_t(instance) * 12];
+            // an affine transform keeps distances along the ray
+            bvh_ray local;
+            for (auto row = 0u; row < 3; row++) {
+                auto r = &m[row * 4];
+                local.origin[row] =
+                    r[0] * ray.origin[0] + r[1] * ray.origin[1] +
+                    r[2] * ray.origin[2] + r[3];
+                local.direction[row] =
+                    r[0] * ray.direction[0] + r[1] * ray.direction[1] +
+                    r[2] * ray.direction[2];
+            }
+            if (intersect_mesh_bvh(meshes[bvh.meshes[instance]], local, hit)) {
+                hit.instance = instance;
+                found = true;
+            }
+        }
+        return found;
+    });
+}
+
+void query_scene_bvh(
+    const scene_bvh& bvh, const float min[3], const float max[3],
+    vector<uint32_t>& instances
+) {
+    if (bvh.nodes.empty()) {
+        return;
+    }
+    uint32_t stack[bvh_stack_size];
+    uint32_t stack_size = 0;
+    stack[stack_size++] = 0;
+    while (stack_size > 0) {
+        auto& node = bvh.nodes[stack[--stack_size]];
+        bool overlaps = true;
+        for (auto i = 0u; i < 3; i++) {
+            overlaps &= node.min[i] <= max[i] && min[i] <= node.max[i];
+        }
+        if (!overlaps) {
+            continue;
+        }
+        if (node.count > 0) {
+            instances.insert(
+                instances.end(), bvh.instances.begin() + node.index,
+                bvh.instances.begin() + node.index + node.count
+            );
+        } else {
+            stack[stack_size++] = node.index;
+            stack[stack_size++] = uint32_t(&node - bvh.nodes.data()) + 1;
+        }
+    }
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <span>
+
+// Bounding volume hierarchies for ray picking and spatial queries on the
+// CPU. A mesh_bvh is built once over the triangles of a mesh, a scene_bvh
+// over instances of such meshes, both with the surface area heuristic.
+// Nodes are flattened in depth first order, so the first child of a node
+// directly follows it in memory, and rays are tested against boxes and
+// against four triangles at once with SSE.
+
+// triangles per leaf of a mesh_bvh, tested together
+const uint32_t bvh_leaf_size = 4;
+
+// 32 bytes, two per cache line
+struct bvh_node {
+    float min[3];
+    // interior nodes: the second child, leaves: the first item
+    uint32_t index;
+    float max[3];
+    // items of a leaf, 0 for interior nodes
+    uint32_t count;
+};
+
+// up to four triangles in structure of arrays layout, each as a vertex and
+// two edges, unused lanes are degenerate and never hit
+struct bvh_triangles {
+    float v0[3][4], e1[3][4], e2[3][4];
+    // triangle of each lane, an index into the index buffer divided by 3
+    uint32_t ids[4];
+};
+
+struct mesh_bvh {
+    std::vector<bvh_node> nodes;
+    // one per leaf, in the order of the leaves
+    std::vector<bvh_triangles> packets;
+};
+
+// the ray is at origin + distance * direction, the direction doesn't need
+// to be normalized
+struct bvh_ray {
+    float origin[3], direction[3];
+};
+
+struct bvh_hit {
+    // hits need to be closer than this, initialize it to the maximum
+    float distance;
+    uint32_t triangle;
+    // only set by intersect_scene_bvh
+    uint32_t instance;
+};
+
+// vertex_stride is in floats, the first three floats of a vertex are the
+// position
+void build_mesh_bvh(
+    std::span<const float> vertices, uint32_t vertex_stride,
+    std::span<const uint32_t> indices, mesh_bvh& bvh
+);
+
+// finds the closest hit before hit.distance and updates hit, returns false
+// if there is none
+bool intersect_mesh_bvh(
+    const mesh_bvh& bvh, const bvh_ray& ray, bvh_hit& hit
+);
+
+struct scene_bvh {
+    std::vector<bvh_node> nodes;
+    // instances in the order of the leaves
+    std::vector<uint32_t> instances;
+    // per instance, its mesh and the inverse of its matrix, 3 by 4 row
+    // major, which moves rays into the space of the mesh
+    std::vector<uint32_t> meshes;
+    std::vector<float> inverse_matrices;
+};
+
+// instance i is of mesh meshes[i], its column major matrix is read from
+// matrices + i * stride, like update_transforms writes them. Instances
+// that don't move can be picked until the next build.
+void build_scene_bvh(
+    std::span<const mesh_bvh> meshes, std::span<const uint32_t> instances,
+    const void* matrices, size_t stride, scene_bvh& bvh
+);
+
+// like intersect_mesh_bvh over all instances, distances are in multiples
+// of the direction of the ray in world space
+bool intersect_scene_bvh(
+    const scene_bvh& bvh, std::span<const mesh_bvh> meshes,
+    const bvh_ray& ray, bvh_hit& hit
+);
+
+// appends the instances whose bounds overlap the box
+void query_scene_bvh(
+    const scene_bvh& bvh, const float min[3], const float max[3],
+    std::vector<uint32_t>& instances
+);
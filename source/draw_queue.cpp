@@ -0,0 +1,128 @@
+#include "draw_queue.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+#include <bit>
+
+using namespace std;
+
+const uint32_t draw_depth_shift = 0;
+const uint32_t draw_mesh_shift = draw_depth_shift + draw_depth_bits;
+const uint32_t draw_material_shift = draw_mesh_shift + draw_mesh_bits;
+const uint32_t draw_pipeline_shift = draw_material_shift + draw_material_bits;
+const uint32_t draw_pass_shift = draw_pipeline_shift + draw_pipeline_bits;
+static_assert(draw_pass_shift + draw_pass_bits == 64);
+
+static uint64_t get_mask(uint32_t bits) {
+    return (uint64_t(1) << bits) - 1;
+}
+
+uint64_t get_draw_key(
+    uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh,
+    float depth
+) {
+    if (
+        pass > get_mask(draw_pass_bits) ||
+        pipeline > get_mask(draw_pipeline_bits) ||
+        mesh > get_mask(draw_mesh_bits)
+    ) {
+        throw runtime_error("draw state doesn't fit into the key");
+    }
+    // also maps NaN to 0
+    auto clamped = depth > 0 ? min(depth, 1.f) : 0.f;
+    auto quantized =
+        uint64_t(lround(clamped * float(get_mask(draw_depth_bits))));
+    return
+        uint64_t(pass) << draw_pass_shift |
+        uint64_t(pipeline) << draw_pipeline_shift |
+        (material & get_mask(draw_material_bits)) << draw_material_shift |
+        uint64_t(mesh) << draw_mesh_shift |
+        quantized << draw_depth_shift;
+}
+
+uint32_t get_draw_pass(uint64_t key) {
+    return (key >> draw_pass_shift) & get_mask(draw_pass_bits);
+}
+
+uint32_t get_draw_pipeline(uint64_t key) {
+    return (key >> draw_pipeline_shift) & get_mask(draw_pipeline_bits);
+}
+
+uint32_t get_draw_mesh(uint64_t key) {
+    return (key >> draw_mesh_shift) & get_mask(draw_mesh_bits);
+}
+
+void sort_draw_queue(draw_queue& queue) {
+    auto& items = queue.items;
+    auto count = items.size();
+    if (count < 2) {
+        return;
+    }
+
+    // histograms of all bytes in one pass
+    uint32_t histograms[8][256]{};
+    for (auto& item : items) {
+        for (auto digit = 0u; digit < 8; digit++) {
+            histograms[digit][(item.key >> (digit * 8)) & 0xff]++;
+        }
+    }
+
+    queue.scratch.resize(count);
+    auto source = items.data(), destination = queue.scratch.data();
+    for (auto digit = 0u; digit < 8; digit++) {
+        auto& histogram = histograms[digit];
+        // all keys have this byte in common, e.g. unused material bits
+        if (histogram[(source[0].key >> (digit * 8)) & 0xff] == count) {
+            continue;
+        }
+        uint32_t offsets[256];
+        uint32_t offset = 0;
+        for (auto i = 0u; i < 256; i++) {
+            offsets[i] = offset;
+            offset += histogram[i];
+        }
+        for (auto i = 0u; i < count; i++) {
+            auto byte = (source[i].key >> (digit * 8)) & 0xff;
+            destination[offsets[byte]++] = source[i];
+        }
+        swap(source, destination);
+    }
+    if (source != items.data()) {
+        items.swap(queue.scratch);
+    }
+}
+
+uint32_t find_draw_pass(const draw_queue& queue, uint32_t pass) {
+    auto found = partition_point(
+        queue.items.begin(), queue.items.end(), [&](const draw_item& item) {
+            return get_draw_pass(item.key) < pass;
+        }
+    );
+    return found - queue.items.begin();
+}
+
+void reset_draw_binds(draw_binds& binds) {
+    binds.key = 0;
+    binds.bound = false;
+}
+
+uint32_t update_draw_binds(draw_binds& binds, uint64_t key) {
+    uint32_t changed = 0;
+    if (
+        !binds.bound ||
+        get_draw_pass(key) != get_draw_pass(binds.key) ||
+        get_draw_pipeline(key) != get_draw_pipeline(binds.key)
+    ) {
+        changed = draw_state_pipeline | draw_state_mesh;
+    } else if (get_draw_mesh(key) != get_draw_mesh(binds.key)) {
+        changed = draw_state_mesh;
+    }
+    binds.key = key;
+    binds.bound = true;
+
+    auto recorded = popcount(changed);
+    binds.recorded += recorded;
+    binds.skipped += 2 - recorded;
+    return changed;
+}
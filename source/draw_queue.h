@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Draws are queued as items with a 64 bit key and sorted by it, so that
+// draws sharing state are recorded together. From the most to the least
+// significant bits the key is
+//
+//   pass 4 | pipeline 8 | material 16 | mesh 16 | depth 20
+//
+// Depth is quantized from 0 at the camera to 1 at the far plane, so opaque
+// draws with the same state are sorted front to back. Pass, pipeline and
+// mesh must fit, materials are only used for ordering and are wrapped.
+
+const uint32_t draw_pass_bits = 4;
+const uint32_t draw_pipeline_bits = 8;
+const uint32_t draw_material_bits = 16;
+const uint32_t draw_mesh_bits = 16;
+const uint32_t draw_depth_bits = 20;
+
+struct draw_item {
+    uint64_t key;
+    // meaning is up to the pipeline, e.g. an instance
+    uint32_t index;
+};
+
+struct draw_queue {
+    std::vector<draw_item> items;
+    // for the sort
+    std::vector<draw_item> scratch;
+};
+
+// throws if pass, pipeline or mesh don't fit, depth is clamped
+uint64_t get_draw_key(
+    uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh,
+    float depth
+);
+uint32_t get_draw_pass(uint64_t key);
+uint32_t get_draw_pipeline(uint64_t key);
+uint32_t get_draw_mesh(uint64_t key);
+
+// stable least significant digit radix sort over bytes, bytes that are the
+// same in every key are skipped
+void sort_draw_queue(draw_queue& queue);
+
+// the first item of the queue with a pass of at least pass, queue must be
+// sorted
+uint32_t find_draw_pass(const draw_queue& queue, uint32_t pass);
+
+enum draw_state : uint32_t {
+    draw_state_pipeline = 1,
+    draw_state_mesh = 2,
+};
+
+// state of the last recorded draw, reset at the start of each pass
+struct draw_binds {
+    uint64_t key;
+    bool bound;
+    // state changes that were recorded and skipped because the state was
+    // already bound, one of each per draw without sorting
+    uint32_t recorded, skipped;
+};
+
+void reset_draw_binds(draw_binds& binds);
+// the draw_state bits that differ from the last draw, a different pass or
+// pipeline changes the mesh too. Counts the changes.
+uint32_t update_draw_binds(draw_binds& binds, uint64_t key);
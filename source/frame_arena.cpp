@@ -0,0 +1,63 @@
+#include "frame_arena.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+void create_frame_arena(size_t block_size, frame_arena& arena) {
+    if (block_size == 0) {
+        throw runtime_error("frame arena blocks can't be empty");
+    }
+    arena.blocks.clear();
+    arena.block_size = block_size;
+    arena.block = 0;
+    arena.offset = 0;
+    arena.used = arena.peak = 0;
+}
+
+static size_t align(size_t offset, size_t alignment) {
+    return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+void* allocate(frame_arena& arena, size_t size, size_t alignment) {
+    // blocks are aligned for any fundamental type, larger alignments may
+    // need padding at the start of a block
+    auto needed = size + max(alignment, alignof(max_align_t)) -
+        alignof(max_align_t);
+    while (arena.block < arena.blocks.size()) {
+        auto& block = arena.blocks[arena.block];
+        auto address = (uintptr_t)block.data.get();
+        auto offset = align(address + arena.offset, alignment) - address;
+        if (offset + size <= block.size) {
+            arena.used += offset + size - arena.offset;
+            arena.peak = max(arena.peak, arena.used);
+            arena.offset = offset + size;
+            return block.data.get() + offset;
+        }
+        // the rest of the block is wasted until the next reset
+        arena.used += block.size - arena.offset;
+        arena.block++;
+        arena.offset = 0;
+    }
+
+    auto block_size = max(arena.block_size, needed);
+    arena.blocks.push_back({make_unique<byte[]>(block_size), block_size});
+    return allocate(arena, size, alignment);
+}
+
+void reset_frame_arena(frame_arena& arena) {
+#ifndef NDEBUG
+    for (auto i = 0u; i <= arena.block && i < arena.blocks.size(); i++) {
+        auto& block = arena.blocks[i];
+        memset(
+            block.data.get(), frame_arena_poison,
+            i == arena.block ? arena.offset : block.size
+        );
+    }
+#endif
+    arena.block = 0;
+    arena.offset = 0;
+    arena.used = 0;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Linear allocator for CPU side data that is only needed while a frame is
+// recorded or in flight, one per frame in flight. Allocations are bumped
+// from blocks that are kept across resets, so once the blocks have grown
+// to the peak of a frame there are no more heap allocations. Deallocation
+// is a no-op, everything is freed at once by resetting the arena after the
+// fence of its frame signaled. Without NDEBUG the used memory is poisoned
+// on reset, so reads of stale data stand out.
+
+// written over memory on reset without NDEBUG
+const uint8_t frame_arena_poison = 0xcd;
+
+struct frame_arena_block {
+    std::unique_ptr<std::byte[]> data;
+    size_t size;
+};
+
+struct frame_arena {
+    std::vector<frame_arena_block> blocks;
+    // size of new blocks, larger allocations get a block of their own
+    size_t block_size;
+    // the block that is allocated from and the offset into it
+    uint32_t block;
+    size_t offset;
+    // bytes since the last reset, including alignment, and the maximum
+    size_t used, peak;
+};
+
+void create_frame_arena(size_t block_size, frame_arena& arena);
+// alignment must be a power of two, never returns null
+void* allocate(frame_arena& arena, size_t size, size_t alignment);
+// invalidates all allocations
+void reset_frame_arena(frame_arena& arena);
+
+// for standard containers, e.g. arena_vector<uint32_t> v(arena)
+template<class T>
+struct arena_allocator {
+    using value_type = T;
+
+    frame_arena* arena;
+
+    arena_allocator(frame_arena& frame) : arena(&frame) {}
+    template<class U>
+    arena_allocator(const arena_allocator<U>& other) : arena(other.arena) {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(
+            ::allocate(*arena, n * sizeof(T), alignof(T))
+        );
+    }
+    void deallocate(T*, size_t) {}
+
+    template<class U>
+    bool operator==(const arena_allocator<U>& other) const {
+        return arena == other.arena;
+    }
+};
+
+template<class T>
+using arena_vector = std::vector<T, arena_allocator<T>>;
@@ -0,0 +1,299 @@
+#include "geometry_arena.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+void reset_ranges(range_allocator& allocator, uint32_t capacity) {
+    allocator.capacity = capacity;
+    allocator.free_ranges.clear();
+    if (capacity > 0) {
+        allocator.free_ranges.push_back({0, capacity});
+    }
+}
+
+uint32_t allocate_range(range_allocator& allocator, uint32_t count) {
+    auto& ranges = allocator.free_ranges;
+    for (auto i = ranges.begin(); i != ranges.end(); i++) {
+        if (i->count < count) {
+            continue;
+        }
+        auto offset = i->offset;
+        i->offset += count;
+        i->count -= count;
+        if (i->count == 0) {
+            ranges.erase(i);
+        }
+        return offset;
+    }
+    return -1u;
+}
+
+void free_range(range_allocator& allocator, uint32_t offset, uint32_t count) {
+    if (count == 0) {
+        return;
+    }
+    auto& ranges = allocator.free_ranges;
+    auto next = lower_bound(
+        ranges.begin(), ranges.end(), offset,
+        [](const range_allocator::range& range, uint32_t offset) {
+            return range.offset < offset;
+        }
+    );
+    // merge with the following range
+    if (next != ranges.end() && offset + count == next->offset) {
+        next->offset = offset;
+        next->count += count;
+    } else {
+        next = ranges.insert(next, {offset, count});
+    }
+    // merge with the preceding range
+    if (next != ranges.begin()) {
+        auto previous = next - 1;
+        if (previous->offset + previous->count == next->offset) {
+            previous->count += next->count;
+            ranges.erase(next);
+        }
+    }
+}
+
+uint32_t largest_free_range(const range_allocator& allocator) {
+    uint32_t largest = 0;
+    for (auto& range : allocator.free_ranges) {
+        largest = max(largest, range.count);
+    }
+    return largest;
+}
+
+void create_geometry_arena(
+    VkDevice device, memory_tracker& tracker,
+    uint32_t vertex_stride, uint32_t vertex_capacity, uint32_t index_capacity,
+    geometry_arena& arena
+) {
+    arena.vertex_stride = vertex_stride;
+    create_mapped_buffer(
+        device, tracker, memory_tag::geometry,
+        uint64_t(vertex_stride) * vertex_capacity,
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        arena.vertex_buffer
+    );
+    create_mapped_buffer(
+        device, tracker, memory_tag::geometry,
+        sizeof(uint32_t) * uint64_t(index_capacity),
+        VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        arena.index_buffer
+    );
+    reset_ranges(arena.vertex_allocator, vertex_capacity);
+    reset_ranges(arena.index_allocator, index_capacity);
+    arena.meshes.clear();
+    arena.free_meshes.clear();
+}
+
+void destroy_geometry_arena(
+    VkDevice device, memory_tracker& tracker, const geometry_arena& arena
+) {
+    destroy_mapped_buffer(device, tracker, arena.vertex_buffer);
+    destroy_mapped_buffer(device, tracker, arena.index_buffer);
+}
+
+static bool allocate_mesh(
+    geometry_arena& arena, uint32_t vertex_count, uint32_t index_count,
+    mesh_allocation& mesh
+) {
+    mesh.vertex_offset = allocate_range(arena.vertex_allocator, vertex_count);
+    if (mesh.vertex_offset == -1u) {
+        return false;
+    }
+    mesh.first_index = allocate_range(arena.index_allocator, index_count);
+    if (mesh.first_index == -1u) {
+        free_range(arena.vertex_allocator, mesh.vertex_offset, vertex_count);
+        return false;
+    }
+    mesh.vertex_count = vertex_count;
+    mesh.index_count = index_count;
+    mesh.live = true;
+    return true;
+}
+
+uint32_t reserve_mesh(
+    geometry_arena& arena, uint32_t vertex_count, uint32_t index_count
+) {
+    mesh_allocation mesh;
+    if (!allocate_mesh(arena, vertex_count, index_count, mesh)) {
+        defragment(arena);
+        if (!allocate_mesh(arena, vertex_count, index_count, mesh)) {
+            throw runtime_error("geometry arena is full");
+        }
+    }
+
+    if (!arena.free_meshes.empty()) {
+        auto id = arena.free_meshes.back();
+        arena.free_meshes.pop_back();
+        arena.meshes[id] = mesh;
+        return id;
+    }
+    arena.meshes.push_back(mesh);
+    return static_cast<uint32_t>(arena.meshes.size() - 1);
+}
+
+uint32_t add_mesh(
+    geometry_arena& arena,
+    span<const char> vertices, span<const uint32_t> indices
+) {
+    auto id = reserve_mesh(
+        arena, static_cast<uint32_t>(vertices.size() / arena.vertex_stride),
+        static_cast<uint32_t>(indices.size())
+    );
+    auto& mesh = arena.meshes[id];
+    copy(
+        vertices.begin(), vertices.end(),
+        (char*)arena.vertex_buffer.data +
+            uint64_t(mesh.vertex_offset) * arena.vertex_stride
+    );
+    copy(
+        indices.begin(), indices.end(),
+        (uint32_t*)arena.index_buffer.data + mesh.first_index
+    );
+    return id;
+}
+
+void remove_mesh(geometry_arena& arena, uint32_t id) {
+    auto& mesh = arena.meshes[id];
+    if (!mesh.live) {
+        throw runtime_error("mesh was already removed");
+    }
+    free_range(arena.vertex_allocator, mesh.vertex_offset, mesh.vertex_count);
+    free_range(arena.index_allocator, mesh.first_index, mesh.index_count);
+    mesh.live = false;
+    arena.free_meshes.push_back(id);
+}
+
+uint64_t defragment(geometry_arena& arena) {
+    vector<uint32_t> live;
+    for (auto i = 0u; i < arena.meshes.size(); i++) {
+        if (arena.meshes[i].live) {
+            live.push_back(i);
+        }
+    }
+    uint64_t moved = 0;
+
+    // moving in order of offset never overwrites a mesh that hasn't been
+    // moved yet
+    sort(live.begin(), live.end(), [&](uint32_t a, uint32_t b) {
+        return arena.meshes[a].vertex_offset < arena.meshes[b].vertex_offset;
+    });
+    uint32_t vertex_end = 0;
+    auto vertices = (char*)arena.vertex_buffer.data;
+    for (auto id : live) {
+        auto& mesh = arena.meshes[id];
+        if (mesh.vertex_offset != vertex_end) {
+            auto size = uint64_t(mesh.vertex_count) * arena.vertex_stride;
+            memmove(
+                vertices + uint64_t(vertex_end) * arena.vertex_stride,
+                vertices + uint64_t(mesh.vertex_offset) * arena.vertex_stride,
+                size
+            );
+            moved += size;
+            mesh.vertex_offset = vertex_end;
+        }
+        vertex_end += mesh.vertex_count;
+    }
+
+    sort(live.begin(), live.end(), [&](uint32_t a, uint32_t b) {
+        return arena.meshes[a].first_index < arena.meshes[b].first_index;
+    });
+    uint32_t index_end = 0;
+    auto indices = (uint32_t*)arena.index_buffer.data;
+    for (auto id : live) {
+        auto& mesh = arena.meshes[id];
+        if (mesh.first_index != index_end) {
+            memmove(
+                indices + index_end, indices + mesh.first_index,
+                sizeof(uint32_t) * mesh.index_count
+            );
+            moved += sizeof(uint32_t) * mesh.index_count;
+            mesh.first_index = index_end;
+        }
+        index_end += mesh.index_count;
+    }
+
+    auto& vertex_allocator = arena.vertex_allocator;
+    reset_ranges(vertex_allocator, vertex_allocator.capacity);
+    allocate_range(vertex_allocator, vertex_end);
+    auto& index_allocator = arena.index_allocator;
+    reset_ranges(index_allocator, index_allocator.capacity);
+    allocate_range(index_allocator, index_end);
+
+    return moved;
+}
+
+void write_draw_commands(
+    const geometry_arena& arena, span<const mesh_draw> draws,
+    VkDrawIndexedIndirectCommand* commands
+) {
+    for (auto& draw : draws) {
+        auto& mesh = arena.meshes[draw.mesh];
+        *commands++ = {
+            .indexCount = mesh.index_count,
+            .instanceCount = draw.instance_count,
+            .firstIndex = mesh.first_index,
+            .vertexOffset = static_cast<int32_t>(mesh.vertex_offset),
+            .firstInstance = draw.first_instance,
+        };
+    }
+}
+
+void create_indirect_buffer(
+    VkDevice device, memory_tracker& tracker, uint32_t capacity,
+    indirect_buffer& buffer
+) {
+    create_mapped_buffer(
+        device, tracker, memory_tag::instances,
+        sizeof(VkDrawIndexedIndirectCommand) * uint64_t(capacity),
+        VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        buffer.buffer
+    );
+    buffer.commands = (VkDrawIndexedIndirectCommand*)buffer.buffer.data;
+    buffer.capacity = capacity;
+}
+
+void destroy_indirect_buffer(
+    VkDevice device, memory_tracker& tracker, const indirect_buffer& buffer
+) {
+    destroy_mapped_buffer(device, tracker, buffer.buffer);
+}
+
+void bind_geometry(VkCommandBuffer command_buffer, const geometry_arena& arena) {
+    VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(
+        command_buffer, 0, 1, &arena.vertex_buffer.buffer, &offset
+    );
+    vkCmdBindIndexBuffer(
+        command_buffer, arena.index_buffer.buffer, 0, VK_INDEX_TYPE_UINT32
+    );
+}
+
+void draw_indirect(
+    VkCommandBuffer command_buffer, const indirect_buffer& buffer,
+    uint32_t draw_count, bool multi_draw_indirect, uint32_t first_draw
+) {
+    const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+    if (multi_draw_indirect) {
+        vkCmdDrawIndexedIndirect(
+            command_buffer, buffer.buffer.buffer,
+            uint64_t(first_draw) * stride, draw_count, stride
+        );
+        return;
+    }
+    for (auto i = first_draw; i < first_draw + draw_count; i++) {
+        vkCmdDrawIndexedIndirect(
+            command_buffer, buffer.buffer.buffer, uint64_t(i) * stride, 1,
+            stride
+        );
+    }
+}
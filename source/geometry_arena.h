@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "buffer.h"
+
+// Meshes are sub-allocated from one vertex buffer and one index buffer, so
+// that all meshes using the same pipeline can be drawn with a single
+// vkCmdDrawIndexedIndirect. The buffers are host visible and stay mapped.
+
+// first-fit allocator of element ranges, free ranges are kept sorted by
+// offset and coalesced
+struct range_allocator {
+    struct range {
+        uint32_t offset, count;
+    };
+    uint32_t capacity;
+    std::vector<range> free_ranges;
+};
+
+void reset_ranges(range_allocator& allocator, uint32_t capacity);
+// returns -1u if there is no free range large enough
+uint32_t allocate_range(range_allocator& allocator, uint32_t count);
+void free_range(range_allocator& allocator, uint32_t offset, uint32_t count);
+uint32_t largest_free_range(const range_allocator& allocator);
+
+struct mesh_allocation {
+    uint32_t vertex_offset, vertex_count;
+    uint32_t first_index, index_count;
+    bool live;
+};
+
+struct geometry_arena {
+    mapped_buffer vertex_buffer, index_buffer;
+    uint32_t vertex_stride;
+    range_allocator vertex_allocator, index_allocator;
+    // indexed by mesh id, ids of removed meshes are reused
+    std::vector<mesh_allocation> meshes;
+    std::vector<uint32_t> free_meshes;
+};
+
+void create_geometry_arena(
+    VkDevice device, memory_tracker& tracker,
+    uint32_t vertex_stride, uint32_t vertex_capacity, uint32_t index_capacity,
+    geometry_arena& arena
+);
+void destroy_geometry_arena(
+    VkDevice device, memory_tracker& tracker, const geometry_arena& arena
+);
+
+// indices are relative to the first vertex of the mesh, returns the mesh id,
+// throws if the arena is full even after defragmentation
+uint32_t add_mesh(
+    geometry_arena& arena,
+    std::span<const char> vertices, std::span<const uint32_t> indices
+);
+// like add_mesh, but leaves the vertices and indices uninitialized
+uint32_t reserve_mesh(
+    geometry_arena& arena, uint32_t vertex_count, uint32_t index_count
+);
+void remove_mesh(geometry_arena& arena, uint32_t mesh);
+
+// moves all meshes to the start of the buffers, so that the free space is
+// one contiguous range, returns the number of bytes moved. The buffers must
+// not be in use by the GPU.
+uint64_t defragment(geometry_arena& arena);
+
+struct mesh_draw {
+    uint32_t mesh;
+    uint32_t instance_count, first_instance;
+};
+
+// writes one indirect command per draw
+void write_draw_commands(
+    const geometry_arena& arena, std::span<const mesh_draw> draws,
+    VkDrawIndexedIndirectCommand* commands
+);
+
+// host visible buffer of indirect commands, one per frame in flight
+struct indirect_buffer {
+    mapped_buffer buffer;
+    VkDrawIndexedIndirectCommand* commands;
+    uint32_t capacity;
+};
+
+void create_indirect_buffer(
+    VkDevice device, memory_tracker& tracker, uint32_t capacity,
+    indirect_buffer& buffer
+);
+void destroy_indirect_buffer(
+    VkDevice device, memory_tracker& tracker, const indirect_buffer& buffer
+);
+
+// binds the arena buffers, the instance buffer is bound by the caller
+void bind_geometry(VkCommandBuffer command_buffer, const geometry_arena& arena);
+
+// draws draw_count commands starting at first_draw, as one multi-draw if
+// the device supports multiDrawIndirect
+void draw_indirect(
+    VkCommandBuffer command_buffer, const indirect_buffer& buffer,
+    uint32_t draw_count, bool multi_draw_indirect, uint32_t first_draw = 0
+);
@@ -0,0 +1,510 @@
+#include "geometry_stream.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <unordered_map>
+#include <cstdio>
+#include <cmath>
+
+using namespace std;
+
+// cells along the longest side of a fallback mesh
+static const uint32_t fallback_resolution = 16;
+
+void create_geometry_stream(
+    geometry_arena& arena, const char* path, uint32_t page_count,
+    uint32_t frames_in_flight, geometry_stream& stream
+) {
+    stream.path = path;
+    stream.file.open(path, ios::binary | ios::trunc);
+    if (!stream.file) {
+        throw runtime_error("failed to create geometry stream file");
+    }
+    stream.file_size = 0;
+    stream.vertex_stride = arena.vertex_stride;
+
+    stream.pool_mesh = reserve_mesh(
+        arena, page_count * stream_page_vertices,
+        page_count * stream_page_indices
+    );
+    stream.page_count = page_count;
+    stream.pages.assign(page_count, -1u);
+
+    stream.meshes.clear();
+    stream.chunks.clear();
+    // 0 is never
+    stream.frame = 1;
+    stream.frames_in_flight = frames_in_flight;
+    stream.detail_distance = 32;
+    stream.max_loads = 16;
+    stream.loading = 0;
+
+    stream.stats = {};
+    stream.stats.page_count = page_count;
+    start_stream_loader(
+        stream.loader,
+        [file = ifstream(path, ios::binary)](stream_load& load) mutable {
+            // the file grows while meshes are added
+            file.clear();
+            file.seekg(load.file_offset);
+            file.read(load.vertices, load.vertex_size);
+            file.read((char*)load.indices, load.index_size);
+            return bool(file);
+        }
+    );
+}
+
+void destroy_geometry_stream(geometry_arena& arena, geometry_stream& stream) {
+    // pending loads only point into the pool
+    stop_stream_loader(stream.loader);
+    stream.loader.queue.clear();
+    stream.loader.finished.clear();
+
+    remove_mesh(arena, stream.pool_mesh);
+    stream.file.close();
+    remove(stream.path.c_str());
+}
+
+void build_fallback_mesh(
+    span<const float> vertices, uint32_t vertex_stride,
+    span<const uint32_t> indices, uint32_t resolution,
+    vector<float>& fallback_vertices, vector<uint32_t>& fallback_indices
+) {
+    fallback_vertices.clear();
+    fallback_indices.clear();
+    auto vertex_count = vertices.size() / vertex_stride;
+    if (vertex_count == 0) {
+        return;
+    }
+
+    float low[3], high[3];
+    for (auto i = 0u; i < 3; i++) {
+        low[i] = high[i] = vertices[i];
+    }
+    for (size_t v = 1; v < vertex_count; v++) {
+        for (auto i = 0u; i < 3; i++) {
+            low[i] = min(low[i], vertices[v * vertex_stride + i]);
+            high[i] = max(high[i], vertices[v * vertex_stride + i]);
+        }
+    }
+    float cell_size = 0;
+    for (auto i = 0u; i < 3; i++) {
+        cell_size = max(cell_size, (high[i] - low[i]) / resolution);
+    }
+    if (cell_size == 0) {
+        cell_size = 1;
+    }
+
+    // fallback vertex of each vertex, the average of its cell
+    unordered_map<uint64_t, uint32_t> cells;
+    vector<uint32_t> remap(vertex_count);
+    vector<uint32_t> cell_counts;
+    for (size_t v = 0; v < vertex_count; v++) {
+        auto vertex = &vertices[v * vertex_stride];
+        uint64_t key = 0;
+        for (auto i = 0u; i < 3; i++) {
+            auto cell = uint64_t(min(
+                (vertex[i] - low[i]) / cell_size, float(resolution - 1)
+            ));
+            key = key * (resolution + 1) + cell;
+        }
+        auto [cell, inserted] = cells.try_emplace(key, cell_counts.size());
+        if (inserted) {
+            // attributes after the normal are taken from the first vertex
+            fallback_vertices.insert(
+                fallback_vertices.end(), vertex, vertex + vertex_stride
+            );
+            fill_n(
+                fallback_vertices.end() - vertex_stride, 6, 0.0f
+            );
+            cell_counts.push_back(0);
+        }
+        auto target = &fallback_vertices[size_t(cell->second) * vertex_stride];
+        for (auto i = 0u; i < 6; i++) {
+            target[i] += vertex[i];
+        }
+        cell_counts[cell->second]++;
+        remap[v] = cell->second;
+    }
+    for (size_t c = 0; c < cell_counts.size(); c++) {
+        auto target = &fallback_vertices[c * vertex_stride];
+        for (auto i = 0u; i < 3; i++) {
+            target[i] /= cell_counts[c];
+        }
+        auto length = sqrt(
+            target[3] * target[3] + target[4] * target[4] +
+            target[5] * target[5]
+        );
+        for (auto i = 3u; i < 6; i++) {
+            target[i] = length > 0 ? target[i] / length : 0;
+        }
+    }
+
+    // triangles with corners in different cells
+    for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+        uint32_t corners[3]{
+            remap[indices[t]], remap[indices[t + 1]], remap[indices[t + 2]],
+        };
+        if (
+            corners[0] != corners[1] && corners[1] != corners[2] &&
+            corners[2] != corners[0]
+        ) {
+            fallback_indices.insert(
+                fallback_indices.end(), corners, corners + 3
+            );
+        }
+    }
+}
+
+// sphere containing the spheres of a range of meshlets
+static void get_chunk_bounds(
+    const meshlet_mesh& meshlets, uint32_t first, uint32_t count,
+    float sphere[4]
+) {
+    float low[3], high[3];
+    for (auto i = 0u; i < 3; i++) {
+        low[i] = INFINITY;
+        high[i] = -INFINITY;
+    }
+    for (auto m = first; m < first + count; m++) {
+        auto& meshlet = meshlets.meshlets[m];
+        for (auto i = 0u; i < 3; i++) {
+            low[i] = min(low[i], meshlet.center[i] - meshlet.radius);
+            high[i] = max(high[i], meshlet.center[i] + meshlet.radius);
+        }
+    }
+    for (auto i = 0u; i < 3; i++) {
+        sphere[i] = (low[i] + high[i]) * 0.5f;
+    }
+    sphere[3] = 0;
+    for (auto m = first; m < first + count; m++) {
+        auto& meshlet = meshlets.meshlets[m];
+        float distance = 0;
+        for (auto i = 0u; i < 3; i++) {
+            auto offset = meshlet.center[i] - sphere[i];
+            distance += offset * offset;
+        }
+        sphere[3] = max(sphere[3], sqrt(distance) + meshlet.radius);
+    }
+}
+
+uint32_t add_stream_mesh(
+    geometry_stream& stream, geometry_arena& arena,
+    span<const float> vertices, span<const uint32_t> indices,
+    const meshlet_mesh& meshlets
+) {
+    auto vertex_stride = stream.vertex_stride / sizeof(float);
+    vector<float> fallback_vertices;
+    vector<uint32_t> fallback_indices;
+    build_fallback_mesh(
+        vertices, vertex_stride, indices, fallback_resolution,
+        fallback_vertices, fallback_indices
+    );
+    auto id = add_mesh(
+        arena,
+        span(
+            (const char*)fallback_vertices.data(),
+            fallback_vertices.size() * sizeof(float)
+        ),
+        fallback_indices
+    );
+    if (stream.meshes.size() <= id) {
+        stream.meshes.resize(id + 1, {});
+    }
+    auto& mesh = stream.meshes[id];
+    mesh.first_chunk = stream.chunks.size();
+    mesh.chunk_count = 0;
+    get_mesh_bounds(meshlets, mesh.sphere);
+
+    // chunk vertex of each mesh vertex, -1u if not in the current chunk
+    vector<uint32_t> local(vertices.size() / vertex_stride, -1u);
+    vector<uint32_t> chunk_vertices, chunk_indices;
+    vector<float> data;
+    auto write_chunk = [&](uint32_t first, uint32_t end) {
+        if (first == end) {
+            return;
+        }
+        stream_chunk chunk{
+            .first_meshlet = first,
+            .meshlet_count = end - first,
+            .vertex_count = uint32_t(chunk_vertices.size()),
+            .index_count = uint32_t(chunk_indices.size()),
+            .sphere = {},
+            .file_offset = stream.file_size,
+            .state = stream_chunk_state::absent,
+            .page = -1u,
+            .last_used = 0,
+            .requested = 0,
+            .priority = 0,
+        };
+        get_chunk_bounds(meshlets, first, end - first, chunk.sphere);
+
+        data.clear();
+        for (auto vertex : chunk_vertices) {
+            auto source = &vertices[size_t(vertex) * vertex_stride];
+            data.insert(data.end(), source, source + vertex_stride);
+            local[vertex] = -1u;
+        }
+        stream.file.write(
+            (const char*)data.data(), data.size() * sizeof(float)
+        );
+        stream.file.write(
+            (const char*)chunk_indices.data(),
+            chunk_indices.size() * sizeof(uint32_t)
+        );
+        stream.file_size +=
+            data.size() * sizeof(float) +
+            chunk_indices.size() * sizeof(uint32_t);
+
+        stream.chunks.push_back(chunk);
+        mesh.chunk_count++;
+        chunk_vertices.clear();
+        chunk_indices.clear();
+    };
+
+    uint32_t first = 0;
+    for (auto m = 0u; m < meshlets.meshlets.size(); m++) {
+        auto& meshlet = meshlets.meshlets[m];
+        if (
+            chunk_vertices.size() + meshlet.vertex_count >
+                stream_page_vertices ||
+            chunk_indices.size() + meshlet.triangle_count * 3 >
+                stream_page_indices
+        ) {
+            write_chunk(first, m);
+            first = m;
+        }
+        auto begin = size_t(meshlet.triangle_offset) * 3;
+        auto end = begin + size_t(meshlet.triangle_count) * 3;
+        for (auto i = begin; i < end; i++) {
+            auto vertex = indices[i];
+            if (local[vertex] == -1u) {
+                local[vertex] = chunk_vertices.size();
+                chunk_vertices.push_back(vertex);
+            }
+            chunk_indices.push_back(local[vertex]);
+        }
+    }
+    write_chunk(first, meshlets.meshlets.size());
+
+    // the loader thread reads from its own handle
+    stream.file.flush();
+    if (!stream.file) {
+        throw runtime_error("failed to write geometry stream file");
+    }
+    return id;
+}
+
+bool is_streamed(const geometry_stream& stream, uint32_t mesh) {
+    return mesh < stream.meshes.size() && stream.meshes[mesh].chunk_count > 0;
+}
+
+void begin_stream_frame(geometry_stream& stream, frame_arena& scratch) {
+    stream.frame++;
+    arena_vector<stream_load> finished(scratch);
+    if (!take_finished_loads(stream.loader, finished)) {
+        throw runtime_error("failed to read geometry stream file");
+    }
+    for (auto& load : finished) {
+        auto& chunk = stream.chunks[load.chunk];
+        chunk.state = stream_chunk_state::resident;
+        stream.loading--;
+        stream.stats.loaded_chunks++;
+        stream.stats.loaded_bytes +=
+            uint64_t(chunk.vertex_count) * stream.vertex_stride +
+            uint64_t(chunk.index_count) * sizeof(uint32_t);
+        stream.stats.resident_pages++;
+    }
+}
+
+// distance from the camera to the surface of the sphere, in object space
+static float get_distance(const meshlet_culler& culler, const float sphere[4]) {
+    if (!culler.cone_culling) {
+        // camera at infinity, everything is equally far
+        return 0;
+    }
+    float distance = 0;
+    for (auto i = 0u; i < 3; i++) {
+        auto offset = culler.camera[i] - sphere[i];
+        distance += offset * offset;
+    }
+    return max(sqrt(distance) - sphere[3], 0.0f);
+}
+
+uint32_t write_stream_commands(
+    geometry_stream& stream, const geometry_arena& arena, uint32_t mesh,
+    const meshlet_mesh& meshlets, const meshlet_culler& culler,
+    uint32_t instance, span<VkDrawIndexedIndirectCommand> commands
+) {
+    auto& streamed = stream.meshes[mesh];
+    auto write_fallback = [&]() {
+        if (commands.empty()) {
+            return -1u;
+        }
+        auto& fallback = arena.meshes[mesh];
+        commands[0] = {
+            .indexCount = fallback.index_count,
+            .instanceCount = 1,
+            .firstIndex = fallback.first_index,
+            .vertexOffset = int32_t(fallback.vertex_offset),
+            .firstInstance = instance,
+        };
+        return 1u;
+    };
+
+    if (
+        get_distance(culler, streamed.sphere) >
+        stream.detail_distance * streamed.sphere[3]
+    ) {
+        return write_fallback();
+    }
+
+    stream.visible.resize(meshlets.meshlets.size());
+    bool missing = false;
+    for (auto c = 0u; c < streamed.chunk_count; c++) {
+        auto index = streamed.first_chunk + c;
+        auto& chunk = stream.chunks[index];
+        bool visible = false;
+        for (auto m = 0u; m < chunk.meshlet_count; m++) {
+            auto meshlet = chunk.first_meshlet + m;
+            stream.visible[meshlet] =
+                is_meshlet_visible(culler, meshlets.meshlets[meshlet]);
+            visible = visible || stream.visible[meshlet];
+        }
+        if (!visible) {
+            continue;
+        }
+        // resident chunks are kept even if the fallback is drawn, they are
+        // needed as soon as the others arrive
+        if (chunk.state == stream_chunk_state::resident) {
+            chunk.last_used = stream.frame;
+            continue;
+        }
+        missing = true;
+        stream.stats.misses++;
+        if (chunk.state == stream_chunk_state::loading) {
+            continue;
+        }
+        auto priority = get_distance(culler, chunk.sphere);
+        if (chunk.requested != stream.frame) {
+            chunk.requested = stream.frame;
+            chunk.priority = priority;
+            stream.requests.push_back(index);
+        } else {
+            chunk.priority = min(chunk.priority, priority);
+        }
+    }
+    if (missing) {
+        return write_fallback();
+    }
+
+    auto& pool = arena.meshes[stream.pool_mesh];
+    uint32_t count = 0;
+    for (auto c = 0u; c < streamed.chunk_count; c++) {
+        auto& chunk = stream.chunks[streamed.first_chunk + c];
+        auto first_triangle =
+            meshlets.meshlets[chunk.first_meshlet].triangle_offset;
+        for (auto m = 0u; m < chunk.meshlet_count; m++) {
+            auto meshlet_index = chunk.first_meshlet + m;
+            if (!stream.visible[meshlet_index]) {
+                continue;
+            }
+            if (count == commands.size()) {
+                return -1u;
+            }
+            auto& meshlet = meshlets.meshlets[meshlet_index];
+            commands[count++] = {
+                .indexCount = meshlet.triangle_count * 3,
+                .instanceCount = 1,
+                .firstIndex =
+                    pool.first_index + chunk.page * stream_page_indices +
+                    (meshlet.triangle_offset - first_triangle) * 3,
+                .vertexOffset = int32_t(
+                    pool.vertex_offset + chunk.page * stream_page_vertices
+                ),
+                .firstInstance = instance,
+            };
+        }
+    }
+    return count;
+}
+
+// page of the chunk that was used longest ago and isn't used by a frame in
+// flight, -1u if there is none
+static uint32_t find_eviction(const geometry_stream& stream) {
+    uint32_t page = -1u;
+    uint64_t oldest = stream.frame;
+    for (auto p = 0u; p < stream.page_count; p++) {
+        auto& chunk = stream.chunks[stream.pages[p]];
+        if (
+            chunk.state == stream_chunk_state::resident &&
+            chunk.last_used + stream.frames_in_flight <= stream.frame &&
+            chunk.last_used < oldest
+        ) {
+            page = p;
+            oldest = chunk.last_used;
+        }
+    }
+    return page;
+}
+
+void dispatch_stream_loads(
+    geometry_stream& stream, const geometry_arena& arena,
+    frame_arena& scratch
+) {
+    sort(
+        stream.requests.begin(), stream.requests.end(),
+        [&](uint32_t a, uint32_t b) {
+            return stream.chunks[a].priority < stream.chunks[b].priority;
+        }
+    );
+
+    auto& pool = arena.meshes[stream.pool_mesh];
+    arena_vector<stream_load> loads(scratch);
+    auto free_page = find(stream.pages.begin(), stream.pages.end(), -1u);
+    for (auto index : stream.requests) {
+        if (stream.loading == stream.max_loads) {
+            break;
+        }
+        uint32_t page;
+        if (free_page != stream.pages.end()) {
+            page = free_page - stream.pages.begin();
+            free_page = find(free_page + 1, stream.pages.end(), -1u);
+        } else {
+            page = find_eviction(stream);
+            if (page == -1u) {
+                break;
+            }
+            auto& evicted = stream.chunks[stream.pages[page]];
+            evicted.state = stream_chunk_state::absent;
+            evicted.page = -1u;
+            stream.stats.evictions++;
+            stream.stats.resident_pages--;
+        }
+
+        auto& chunk = stream.chunks[index];
+        stream.pages[page] = index;
+        chunk.page = page;
+        chunk.state = stream_chunk_state::loading;
+        stream.loading++;
+        auto first_vertex =
+            pool.vertex_offset + uint64_t(page) * stream_page_vertices;
+        auto first_index =
+            pool.first_index + uint64_t(page) * stream_page_indices;
+        loads.push_back({
+            .chunk = index,
+            .file_offset = chunk.file_offset,
+            .vertices =
+                (char*)arena.vertex_buffer.data +
+                first_vertex * arena.vertex_stride,
+            .indices = (uint32_t*)arena.index_buffer.data + first_index,
+            .vertex_size = uint64_t(chunk.vertex_count) * arena.vertex_stride,
+            .index_size = uint64_t(chunk.index_count) * sizeof(uint32_t),
+        });
+    }
+    stream.requests.clear();
+
+    if (!loads.empty()) {
+        queue_loads(stream.loader, loads);
+    }
+}
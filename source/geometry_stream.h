@@ -0,0 +1,165 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <string>
+#include <fstream>
+
+#include <vulkan/vulkan.h>
+
+#include "geometry_arena.h"
+#include "meshlet.h"
+#include "frame_arena.h"
+#include "stream_loader.h"
+
+// Out-of-core geometry. Meshes are split into chunks of consecutive
+// meshlets, each small enough for one page of a fixed pool of pages in the
+// geometry arena. Chunks are written to a file once and are only in memory
+// while resident. Chunks with visible meshlets are requested every frame,
+// nearest first, and a background thread reads them straight into their
+// page. When the pool is full the least recently drawn chunk is evicted.
+// An instance is drawn with a coarse fallback mesh, which is always
+// resident, until all of its visible chunks are.
+
+// size of a page, a chunk has at most this many vertices and indices
+const uint32_t stream_page_vertices = 2048;
+const uint32_t stream_page_indices = 3 * 4096;
+
+enum class stream_chunk_state : uint8_t {
+    absent, loading, resident,
+};
+
+struct stream_chunk {
+    uint32_t first_meshlet, meshlet_count;
+    uint32_t vertex_count, index_count;
+    // object space, center and radius
+    float sphere[4];
+    // the vertices followed by the chunk relative indices
+    uint64_t file_offset;
+
+    stream_chunk_state state;
+    // -1u unless loading or resident
+    uint32_t page;
+    // frame in which the chunk was last needed
+    uint64_t last_used;
+    // frame of the last request and the smallest distance it was requested
+    // at in that frame, nearer chunks are loaded first
+    uint64_t requested;
+    float priority;
+};
+
+// chunks of one mesh of the arena, whose allocation is the fallback
+struct stream_mesh {
+    uint32_t first_chunk, chunk_count;
+    float sphere[4];
+};
+
+struct stream_load {
+    uint32_t chunk;
+    uint64_t file_offset;
+    // in the mapped arena buffers
+    char* vertices;
+    uint32_t* indices;
+    uint64_t vertex_size, index_size;
+};
+
+struct stream_stats {
+    uint64_t loaded_bytes, loaded_chunks;
+    // visible chunks that weren't resident when they were drawn
+    uint64_t misses;
+    uint64_t evictions;
+    uint32_t resident_pages, page_count;
+};
+
+struct geometry_stream {
+    std::string path;
+    std::ofstream file;
+    uint64_t file_size;
+    uint32_t vertex_stride;
+
+    // arena mesh of the pool, page i starts at its vertex
+    // i * stream_page_vertices and index i * stream_page_indices
+    uint32_t pool_mesh, page_count;
+    // chunk in each page, -1u if free
+    std::vector<uint32_t> pages;
+
+    // indexed by arena mesh id, chunk_count is 0 for meshes that aren't
+    // streamed
+    std::vector<stream_mesh> meshes;
+    std::vector<stream_chunk> chunks;
+
+    uint64_t frame;
+    // frames that may still be in use by the GPU, their chunks can't be
+    // evicted
+    uint32_t frames_in_flight;
+    // instances farther than this many mesh radii are always drawn with the
+    // fallback
+    float detail_distance;
+    uint32_t max_loads;
+    uint32_t loading;
+    // chunks requested in this frame
+    std::vector<uint32_t> requests;
+    // per meshlet of the mesh being written
+    std::vector<uint8_t> visible;
+
+    // reads chunks from its own handle of the file
+    stream_loader<stream_load> loader;
+
+    stream_stats stats;
+};
+
+// allocates page_count pages from the arena and starts the loader thread,
+// chunks are written to a new file at path. frames_in_flight is the number
+// of frames that are recorded before waiting for the oldest one.
+void create_geometry_stream(
+    geometry_arena& arena, const char* path, uint32_t page_count,
+    uint32_t frames_in_flight, geometry_stream& stream
+);
+// the arena must not be in use by the GPU, deletes the file
+void destroy_geometry_stream(geometry_arena& arena, geometry_stream& stream);
+
+// writes the chunks of a mesh to the file and adds its fallback to the
+// arena, returns the mesh id of the fallback. Indices must be in meshlet
+// order, see get_meshlet_indices. Throws if the file can't be written.
+// Adding the fallback may defragment the arena, so no loads may be in
+// flight.
+uint32_t add_stream_mesh(
+    geometry_stream& stream, geometry_arena& arena,
+    std::span<const float> vertices, std::span<const uint32_t> indices,
+    const meshlet_mesh& meshlets
+);
+
+// coarse version of a mesh by merging the vertices in each cell of a grid
+// with resolution cells along the longest side of the bounding box, the
+// first six floats of a vertex are the position and the normal
+void build_fallback_mesh(
+    std::span<const float> vertices, uint32_t vertex_stride,
+    std::span<const uint32_t> indices, uint32_t resolution,
+    std::vector<float>& fallback_vertices,
+    std::vector<uint32_t>& fallback_indices
+);
+
+// makes finished loads resident, call once per frame after the fence of
+// the oldest frame in flight was waited for. Throws if a chunk couldn't be
+// read.
+void begin_stream_frame(geometry_stream& stream, frame_arena& scratch);
+
+// like write_meshlet_commands, for a streamed mesh. Draws the visible
+// meshlets from the pages of their chunks if all of them are resident,
+// the fallback otherwise, and requests the missing chunks.
+uint32_t write_stream_commands(
+    geometry_stream& stream, const geometry_arena& arena, uint32_t mesh,
+    const meshlet_mesh& meshlets, const meshlet_culler& culler,
+    uint32_t instance, std::span<VkDrawIndexedIndirectCommand> commands
+);
+
+// hands the nearest requested chunks to the loader thread, evicting chunks
+// that weren't used in the last frames in flight if the pool is full. Call
+// after all commands of the frame were written.
+void dispatch_stream_loads(
+    geometry_stream& stream, const geometry_arena& arena,
+    frame_arena& scratch
+);
+
+bool is_streamed(const geometry_stream& stream, uint32_t mesh);
@@ -0,0 +1,486 @@
+#include "hud.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <memory>
+#include <cstdio>
+#include <cstddef>
+
+#include "ge1/shader_module.h"
+
+#include "shaders/hud_vertex.glsl.h"
+
+using namespace std;
+
+extern char _binary_shaders_hud_vertex_glsl_spv_start;
+extern char _binary_shaders_hud_vertex_glsl_spv_end;
+extern char _binary_shaders_hud_fragment_glsl_spv_start;
+extern char _binary_shaders_hud_fragment_glsl_spv_end;
+
+// one binding, the color is stored as normalized bytes
+static constexpr uint32_t hud_first_locations[]{0};
+static constexpr auto hud_attributes = get_vertex_attributes(
+    with_format(hud_vertex_inputs, 2, VK_FORMAT_R8G8B8A8_UNORM, 4),
+    hud_first_locations
+);
+
+static_assert(get_attribute_offset(hud_attributes, 0) == offsetof(hud_quad, x));
+static_assert(
+    get_attribute_offset(hud_attributes, 1) == offsetof(hud_quad, glyph)
+);
+static_assert(
+    get_attribute_offset(hud_attributes, 2) == offsetof(hud_quad, color)
+);
+static_assert(hud_vertex_push_constant_size == sizeof(float) * 2);
+
+void create_hud_buffer(
+    VkDevice device, memory_tracker& tracker, uint32_t capacity,
+    hud_buffer& buffer
+) {
+    create_mapped_buffer(
+        device, tracker, memory_tag::other,
+        sizeof(hud_quad) * uint64_t(capacity),
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, buffer.buffer
+    );
+    buffer.quads = (hud_quad*)buffer.buffer.data;
+    buffer.capacity = capacity;
+    buffer.count = 0;
+}
+
+void destroy_hud_buffer(
+    VkDevice device, memory_tracker& tracker, const hud_buffer& buffer
+) {
+    destroy_mapped_buffer(device, tracker, buffer.buffer);
+}
+
+void add_hud_rectangle(
+    hud_buffer& buffer, float x, float y, float width, float height,
+    uint32_t color
+) {
+    if (buffer.count == buffer.capacity) {
+        return;
+    }
+    buffer.quads[buffer.count++] = {x, y, width, height, hud_solid, color};
+}
+
+float add_hud_text(
+    hud_buffer& buffer, float x, float y, float scale, string_view text,
+    uint32_t color
+) {
+    for (char c : text) {
+        // the font has no lower case letters
+        if (c >= 'a' && c <= 'z') {
+            c += 'A' - 'a';
+        }
+        if (c < ' ' || c > '_') {
+            c = '?';
+        }
+        if (c != ' ' && buffer.count < buffer.capacity) {
+            buffer.quads[buffer.count++] = {
+                x, y, 6 * scale, 8 * scale, uint32_t(c - ' '), color
+            };
+        }
+        x += 6 * scale;
+    }
+    return x;
+}
+
+void create_hud_pipeline(
+    VkDevice device, render_target target, uint32_t subpass,
+    VkSampleCountFlagBits samples, hud_pipeline& pipeline
+) {
+    pipeline.vertex_module = ge1::create_shader_module(device, {
+        &_binary_shaders_hud_vertex_glsl_spv_start,
+        &_binary_shaders_hud_vertex_glsl_spv_end
+    });
+    pipeline.fragment_module = ge1::create_shader_module(device, {
+        &_binary_shaders_hud_fragment_glsl_spv_start,
+        &_binary_shaders_hud_fragment_glsl_spv_end
+    });
+
+    VkPushConstantRange push_constant_range{
+        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+        .offset = 0,
+        .size = hud_vertex_push_constant_size,
+    };
+    VkPipelineLayoutCreateInfo layout_create_info{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &push_constant_range,
+    };
+    if (
+        vkCreatePipelineLayout(
+            device, &layout_create_info, nullptr, &pipeline.layout
+        ) != VK_SUCCESS
+    ) {
+        throw runtime_error("failed to create pipeline layout");
+    }
+
+    VkPipelineShaderStageCreateInfo stage_create_infos[]{
+        {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_VERTEX_BIT,
+            .module = pipeline.vertex_module,
+            .pName = "main",
+        }, {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .module = pipeline.fragment_module,
+            .pName = "main",
+        }
+    };
+    VkVertexInputBindingDescription binding_description{
+        .binding = 0,
+        .stride = sizeof(hud_quad),
+        .inputRate = VK_VERTEX_INPUT_RATE_INSTANCE,
+    };
+    VkPipelineVertexInputStateCreateInfo input_state_create_info{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+        .vertexBindingDescriptionCount = 1,
+        .pVertexBindingDescriptions = &binding_description,
+        .vertexAttributeDescriptionCount = size(hud_attributes),
+        .pVertexAttributeDescriptions = hud_attributes.data(),
+    };
+    VkPipelineInputAssemblyStateCreateInfo assembly_state_create_info{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+        .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+        .primitiveRestartEnable = VK_FALSE,
+    };
+    VkPipelineViewportStateCreateInfo viewport_state_create_info{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+        .viewportCount = 1,
+        .scissorCount = 1,
+    };
+    VkPipelineRasterizationStateCreateInfo rasterization_state_create_info{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+        .depthClampEnable = VK_FALSE,
+        .rasterizerDiscardEnable = VK_FALSE,
+        .polygonMode = VK_POLYGON_MODE_FILL,
+        .cullMode = VK_CULL_MODE_NONE,
+        .frontFace = VK_FRONT_FACE_CLOCKWISE,
+        .depthBiasEnable = VK_FALSE,
+        .lineWidth = 1.0f,
+    };
+    VkPipelineMultisampleStateCreateInfo multisample_state_create_info{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+        .rasterizationSamples = samples,
+        .sampleShadingEnable = VK_FALSE,
+    };
+    // drawn on top of everything
+    VkPipelineDepthStencilStateCreateInfo depth_stencil_info{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+        .depthTestEnable = VK_FALSE,
+        .depthWriteEnable = VK_FALSE,
+        .depthBoundsTestEnable = VK_FALSE,
+        .stencilTestEnable = VK_FALSE,
+    };
+    VkPipelineColorBlendAttachmentState color_blend_attachment_state{
+        .blendEnable = VK_TRUE,
+        .srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA,
+        .dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+        .colorBlendOp = VK_BLEND_OP_ADD,
+        .srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
+        .dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+        .alphaBlendOp = VK_BLEND_OP_ADD,
+        .colorWriteMask =
+            VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+            VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
+    };
+    VkPipelineColorBlendStateCreateInfo color_blend_state_create_info{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+        .logicOpEnable = VK_FALSE,
+        .attachmentCount = 1,
+        .pAttachments = &color_blend_attachment_state,
+    };
+    VkDynamicState dynamic_state[]{
+        VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_SCISSOR,
+    };
+    VkPipelineDynamicStateCreateInfo dynamic_state_create_info{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+        .dynamicStateCount = size(dynamic_state),
+        .pDynamicStates = dynamic_state,
+    };
+    VkGraphicsPipelineCreateInfo pipeline_create_info{
+        .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+        .pNext = target.rendering,
+        .stageCount = size(stage_create_infos),
+        .pStages = stage_create_infos,
+        .pVertexInputState = &input_state_create_info,
+        .pInputAssemblyState = &assembly_state_create_info,
+        .pViewportState = &viewport_state_create_info,
+        .pRasterizationState = &rasterization_state_create_info,
+        .pMultisampleState = &multisample_state_create_info,
+        .pDepthStencilState = &depth_stencil_info,
+        .pColorBlendState = &color_blend_state_create_info,
+        .pDynamicState = &dynamic_state_create_info,
+        .layout = pipeline.layout,
+        .renderPass = target.render_pass,
+        .subpass = subpass,
+    };
+    if (
+        vkCreateGraphicsPipelines(
+            device, VK_NULL_HANDLE, 1, &pipeline_create_info, nullptr,
+            &pipeline.pipeline
+        ) != VK_SUCCESS
+    ) {
+        throw runtime_error("failed to create pipeline");
+    }
+}
+
+void destroy_hud_pipeline(VkDevice device, const hud_pipeline& pipeline) {
+    vkDestroyPipeline(device, pipeline.pipeline, nullptr);
+    vkDestroyPipelineLayout(device, pipeline.layout, nullptr);
+    vkDestroyShaderModule(device, pipeline.vertex_module, nullptr);
+    vkDestroyShaderModule(device, pipeline.fragment_module, nullptr);
+}
+
+void record_hud(
+    VkCommandBuffer command_buffer, const hud_pipeline& pipeline,
+    const hud_buffer& buffer, VkExtent2D extent
+) {
+    if (buffer.count == 0) {
+        return;
+    }
+    vkCmdBindPipeline(
+        command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipeline
+    );
+    float screen_size[]{float(extent.width), float(extent.height)};
+    vkCmdPushConstants(
+        command_buffer, pipeline.layout, VK_SHADER_STAGE_VERTEX_BIT,
+        0, sizeof(screen_size), screen_size
+    );
+    VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(
+        command_buffer, 0, 1, &buffer.buffer.buffer, &offset
+    );
+    vkCmdDraw(command_buffer, 6, buffer.count, 0, 0);
+}
+
+void create_gpu_timer(
+    VkDevice device, VkPhysicalDevice physical_device, uint32_t queue_family,
+    gpu_timer& timer
+) {
+    uint32_t family_count;
+    vkGetPhysicalDeviceQueueFamilyProperties(
+        physical_device, &family_count, nullptr
+    );
+    auto families = make_unique<VkQueueFamilyProperties[]>(family_count);
+    vkGetPhysicalDeviceQueueFamilyProperties(
+        physical_device, &family_count, families.get()
+    );
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physical_device, &properties);
+    timer.period =
+        families[queue_family].timestampValidBits > 0 ?
+        properties.limits.timestampPeriod : 0;
+    timer.recorded = false;
+
+    VkQueryPoolCreateInfo create_info{
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .queryType = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount = 2,
+    };
+    if (
+        vkCreateQueryPool(device, &create_info, nullptr, &timer.pool) !=
+        VK_SUCCESS
+    ) {
+        throw runtime_error("failed to create query pool");
+    }
+}
+
+void destroy_gpu_timer(VkDevice device, const gpu_timer& timer) {
+    vkDestroyQueryPool(device, timer.pool, nullptr);
+}
+
+void begin_gpu_timer(VkCommandBuffer command_buffer, gpu_timer& timer) {
+    if (timer.period == 0) {
+        return;
+    }
+    timer.recorded = true;
+    vkCmdResetQueryPool(command_buffer, timer.pool, 0, 2);
+    vkCmdWriteTimestamp(
+        command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timer.pool, 0
+    );
+}
+
+void end_gpu_timer(VkCommandBuffer command_buffer, const gpu_timer& timer) {
+    if (timer.period == 0) {
+        return;
+    }
+    vkCmdWriteTimestamp(
+        command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timer.pool, 1
+    );
+}
+
+double read_gpu_timer(VkDevice device, const gpu_timer& timer) {
+    if (!timer.recorded) {
+        return -1;
+    }
+    uint64_t timestamps[2];
+    if (
+        vkGetQueryPoolResults(
+            device, timer.pool, 0, 2, sizeof(timestamps), timestamps,
+            sizeof(uint64_t), VK_QUERY_RESULT_64_BIT
+        ) != VK_SUCCESS
+    ) {
+        return -1;
+    }
+    return (timestamps[1] - timestamps[0]) * timer.period * 1e-6;
+}
+
+void add_frame_time(hud_stats& stats, float frame_time) {
+    stats.frame_times[stats.history_index] = frame_time;
+    stats.history_index = (stats.history_index + 1) % hud_history_size;
+}
+
+const char* get_present_mode_name(VkPresentModeKHR mode) {
+    switch (mode) {
+    case VK_PRESENT_MODE_IMMEDIATE_KHR: return "immediate";
+    case VK_PRESENT_MODE_MAILBOX_KHR: return "mailbox";
+    case VK_PRESENT_MODE_FIFO_KHR: return "fifo";
+    case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "fifo relaxed";
+    default: return "other";
+    }
+}
+
+void add_hud_stats(hud_buffer& buffer, const hud_stats& stats) {
+    const float scale = 2, line_height = 10 * scale, margin = 8;
+    const float graph_height = 60, bar_width = 2;
+    const uint32_t text_color = 0xffffffff, background = 0xb0000000;
+    const uint32_t graph_color = 0xff40ff40, slow_color = 0xff4040ff;
+    const uint32_t line_count =
+        10 + stats.impostors + stats.streaming + stats.skinning +
+        stats.textures;
+
+    float width = max(bar_width * hud_history_size, 6 * scale * 28);
+    add_hud_rectangle(
+        buffer, 0, 0, width + margin * 2,
+        graph_height + line_count * line_height + margin * 3, background
+    );
+
+    // frame time graph, bars above 1/60 s are highlighted, the scale tops
+    // out at 1/30 s
+    const float budget = 1000.f / 60;
+    for (auto i = 0u; i < hud_history_size; i++) {
+        auto time = stats.frame_times[(stats.history_index + i) %
+            hud_history_size];
+        auto height = min(time / (2 * budget), 1.f) * graph_height;
+        add_hud_rectangle(
+            buffer, margin + i * bar_width, margin + graph_height - height,
+            bar_width, height, time > budget ? slow_color : graph_color
+        );
+    }
+    add_hud_rectangle(
+        buffer, margin, margin + graph_height / 2, bar_width *
+        hud_history_size, 1, text_color
+    );
+
+    char line[64];
+    float y = margin * 2 + graph_height;
+    auto frame_time =
+        stats.frame_times[(stats.history_index + hud_history_size - 1) %
+        hud_history_size];
+    snprintf(line, sizeof(line), "frame %.2f ms", frame_time);
+    add_hud_text(buffer, margin, y, scale, line, text_color);
+    y += line_height;
+    if (stats.gpu_time >= 0) {
+        snprintf(
+            line, sizeof(line), "cpu %.2f ms gpu %.2f ms",
+            stats.cpu_time, stats.gpu_time
+        );
+    } else {
+        snprintf(line, sizeof(line), "cpu %.2f ms", stats.cpu_time);
+    }
+    add_hud_text(buffer, margin, y, scale, line, text_color);
+    y += line_height;
+    snprintf(
+        line, sizeof(line), "%s %ux msaa",
+        get_present_mode_name(stats.present_mode), unsigned(stats.samples)
+    );
+    add_hud_text(buffer, margin, y, scale, line, text_color);
+    y += line_height;
+    snprintf(
+        line, sizeof(line), "%llu instances",
+        (unsigned long long)stats.instance_count
+    );
+    add_hud_text(buffer, margin, y, scale, line, text_color);
+    y += line_height;
+    snprintf(
+        line, sizeof(line), "%llu triangles",
+        (unsigned long long)stats.triangle_count
+    );
+    add_hud_text(buffer, margin, y, scale, line, text_color);
+    y += line_height;
+    snprintf(
+        line, sizeof(line), "%llu/%llu meshlets %s",
+        (unsigned long long)stats.visible_meshlets,
+        (unsigned long long)stats.meshlet_count, stats.vertex_path
+    );
+    add_hud_text(buffer, margin, y, scale, line, text_color);
+    y += line_height;
+    if (stats.occlusion_culling) {
+        snprintf(
+            line, sizeof(line), "%llu instances rejected",
+            (unsigned long long)stats.rejected_instances
+        );
+    } else {
+        snprintf(line, sizeof(line), "occlusion culling off");
+    }
+    add_hud_text(buffer, margin, y, scale, line, text_color);
+    y += line_height;
+    snprintf(
+        line, sizeof(line), "memory %llu/%llu mib",
+        (unsigned long long)(stats.memory_usage >> 20),
+        (unsigned long long)(stats.memory_budget >> 20)
+    );
+    add_hud_text(buffer, margin, y, scale, line, text_color);
+    y += line_height;
+    snprintf(
+        line, sizeof(line), "%u binds %u skipped",
+        stats.recorded_binds, stats.skipped_binds
+    );
+    add_hud_text(buffer, margin, y, scale, line, text_color);
+    y += line_height;
+    snprintf(
+        line, sizeof(line), "stall sim %.2f render %.2f ms",
+        stats.simulation_stall, stats.render_stall
+    );
+    add_hud_text(buffer, margin, y, scale, line, text_color);
+    if (stats.impostors) {
+        y += line_height;
+        snprintf(
+            line, sizeof(line), "%llu meshes %llu impostors",
+            (unsigned long long)stats.mesh_instances,
+            (unsigned long long)stats.impostor_instances
+        );
+        add_hud_text(buffer, margin, y, scale, line, text_color);
+    }
+    if (stats.streaming) {
+        y += line_height;
+        snprintf(
+            line, sizeof(line), "stream %u/%u pages %.1f mib/s %llu misses",
+            stats.resident_pages, stats.page_count, stats.stream_bandwidth,
+            (unsigned long long)stats.stream_misses
+        );
+        add_hud_text(buffer, margin, y, scale, line, text_color);
+    }
+    if (stats.skinning) {
+        y += line_height;
+        snprintf(
+            line, sizeof(line), "skin %u poses %.0f verts/ms",
+            stats.skinned_poses, stats.skinning_rate
+        );
+        add_hud_text(buffer, margin, y, scale, line, text_color);
+    }
+    if (stats.textures) {
+        y += line_height;
+        snprintf(
+            line, sizeof(line), "textures %llu/%llu mib %u levels missing",
+            (unsigned long long)(stats.texture_usage >> 20),
+            (unsigned long long)(stats.texture_budget >> 20),
+            stats.missing_texture_levels
+        );
+        add_hud_text(buffer, margin, y, scale, line, text_color);
+    }
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+#include <vulkan/vulkan.h>
+
+#include "buffer.h"
+#include "render_graph.h"
+
+// Performance overlay drawn as instanced quads, each either a solid
+// rectangle or a glyph of the 5 by 7 pixel font built into the fragment
+// shader. It is recorded into an existing render pass with one draw call.
+
+const uint32_t hud_solid = -1u;
+
+// matches the vertex attributes of hud_vertex.glsl
+struct hud_quad {
+    float x, y, width, height;
+    uint32_t glyph;
+    // R8G8B8A8, 0xaabbggrr when written as an integer
+    uint32_t color;
+};
+
+// written every frame, one per frame in flight
+struct hud_buffer {
+    mapped_buffer buffer;
+    hud_quad* quads;
+    uint32_t capacity, count;
+};
+
+void create_hud_buffer(
+    VkDevice device, memory_tracker& tracker, uint32_t capacity,
+    hud_buffer& buffer
+);
+void destroy_hud_buffer(
+    VkDevice device, memory_tracker& tracker, const hud_buffer& buffer
+);
+
+// quads past the capacity are dropped
+void add_hud_rectangle(
+    hud_buffer& buffer, float x, float y, float width, float height,
+    uint32_t color
+);
+// scale is the size of a font pixel, returns the x after the last glyph
+float add_hud_text(
+    hud_buffer& buffer, float x, float y, float scale, std::string_view text,
+    uint32_t color
+);
+
+struct hud_pipeline {
+    VkShaderModule vertex_module, fragment_module;
+    VkPipelineLayout layout;
+    VkPipeline pipeline;
+};
+
+// viewport and scissor are dynamic and not set by record_hud
+void create_hud_pipeline(
+    VkDevice device, render_target target, uint32_t subpass,
+    VkSampleCountFlagBits samples, hud_pipeline& pipeline
+);
+void destroy_hud_pipeline(VkDevice device, const hud_pipeline& pipeline);
+
+void record_hud(
+    VkCommandBuffer command_buffer, const hud_pipeline& pipeline,
+    const hud_buffer& buffer, VkExtent2D extent
+);
+
+// time between two timestamps written into a command buffer, read back
+// once the command buffer completed, without waiting
+struct gpu_timer {
+    VkQueryPool pool;
+    // nanoseconds per tick, 0 if the queue doesn't support timestamps
+    float period;
+    // set once timestamps were recorded, queries can't be read before that
+    bool recorded;
+};
+
+void create_gpu_timer(
+    VkDevice device, VkPhysicalDevice physical_device, uint32_t queue_family,
+    gpu_timer& timer
+);
+void destroy_gpu_timer(VkDevice device, const gpu_timer& timer);
+
+// must be recorded outside of a render pass
+void begin_gpu_timer(VkCommandBuffer command_buffer, gpu_timer& timer);
+void end_gpu_timer(VkCommandBuffer command_buffer, const gpu_timer& timer);
+// returns the time in milliseconds or a negative value if not available
+double read_gpu_timer(VkDevice device, const gpu_timer& timer);
+
+const uint32_t hud_history_size = 120;
+
+struct hud_stats {
+    // frame times in milliseconds, oldest first from history_index
+    float frame_times[hud_history_size];
+    uint32_t history_index;
+    double cpu_time, gpu_time;
+
+    VkPresentModeKHR present_mode;
+    VkSampleCountFlagBits samples;
+    // how the solid pass reads vertices, meshlets are culled by a task
+    // shader with mesh shaders and on the CPU otherwise
+    const char* vertex_path;
+    uint64_t instance_count, triangle_count;
+    uint64_t meshlet_count, visible_meshlets;
+    bool occlusion_culling;
+    // instances outside of the frustum or occluded, of the last completed
+    // frame
+    uint64_t rejected_instances;
+    // of device local heaps
+    VkDeviceSize memory_usage, memory_budget;
+    // state changes of the draw queue of the last completed frame, and
+    // those that were skipped because the state was already bound
+    uint32_t recorded_binds, skipped_binds;
+    // instances drawn as meshes and as impostors, those in the cross fade
+    // band count as both
+    bool impostors;
+    uint64_t mesh_instances, impostor_instances;
+    // geometry streaming, bandwidth in MiB/s and misses per second
+    bool streaming;
+    double stream_bandwidth;
+    uint64_t stream_misses;
+    uint32_t resident_pages, page_count;
+    // skeletal animation, poses skinned every frame and skinned vertices per
+    // millisecond of GPU time
+    bool skinning;
+    uint32_t skinned_poses;
+    double skinning_rate;
+    // texture streaming, resident and budget in bytes, levels still
+    // missing of the requested ones over all textures
+    bool textures;
+    VkDeviceSize texture_usage, texture_budget;
+    uint32_t missing_texture_levels;
+    // milliseconds the simulation waited for the render thread to take its
+    // last snapshot, and the render thread waited for a new one
+    double simulation_stall, render_stall;
+};
+
+void add_frame_time(hud_stats& stats, float frame_time);
+
+const char* get_present_mode_name(VkPresentModeKHR mode);
+
+// lays out the overlay in the top left corner
+void add_hud_stats(hud_buffer& buffer, const hud_stats& stats);
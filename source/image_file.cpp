@@ -0,0 +1,128 @@
+#include "image_file.h"
+
+#include <stdexcept>
+#include <fstream>
+#include <vector>
+#include <array>
+
+using namespace std;
+
+void write_ppm(
+    const char* path, uint32_t width, uint32_t height, const uint8_t* rgb
+) {
+    ofstream file(path, ios::binary);
+    if (!file) {
+        throw runtime_error("failed to open image file");
+    }
+    file << "P6\n" << width << " " << height << "\n255\n";
+    file.write((const char*)rgb, uint64_t(width) * height * 3);
+}
+
+static const array<uint32_t, 256> crc_table = []() {
+    array<uint32_t, 256> table;
+    for (auto i = 0u; i < 256; i++) {
+        uint32_t c = i;
+        for (auto k = 0u; k < 8; k++) {
+            c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+        }
+        table[i] = c;
+    }
+    return table;
+}();
+
+static uint32_t update_crc(uint32_t crc, const uint8_t* data, size_t size) {
+    for (auto i = 0u; i < size; i++) {
+        crc = crc_table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+static void append_u32(vector<uint8_t>& data, uint32_t value) {
+    data.push_back(value >> 24);
+    data.push_back(value >> 16);
+    data.push_back(value >> 8);
+    data.push_back(value);
+}
+
+static void write_chunk(
+    ofstream& file, const char* type, const vector<uint8_t>& data
+) {
+    vector<uint8_t> header;
+    append_u32(header, static_cast<uint32_t>(data.size()));
+    header.insert(header.end(), type, type + 4);
+    file.write((const char*)header.data(), header.size());
+    file.write((const char*)data.data(), data.size());
+
+    // the crc covers type and data
+    auto crc = update_crc(0xffffffffu, header.data() + 4, 4);
+    crc = update_crc(crc, data.data(), data.size()) ^ 0xffffffffu;
+    vector<uint8_t> footer;
+    append_u32(footer, crc);
+    file.write((const char*)footer.data(), footer.size());
+}
+
+void write_png(
+    const char* path, uint32_t width, uint32_t height, const uint8_t* rgb
+) {
+    ofstream file(path, ios::binary);
+    if (!file) {
+        throw runtime_error("failed to open image file");
+    }
+    const uint8_t signature[]{137, 80, 78, 71, 13, 10, 26, 10};
+    file.write((const char*)signature, sizeof(signature));
+
+    vector<uint8_t> header;
+    append_u32(header, width);
+    append_u32(header, height);
+    // 8 bits per channel, RGB, deflate, adaptive filtering, no interlacing
+    header.insert(header.end(), {8, 2, 0, 0, 0});
+    write_chunk(file, "IHDR", header);
+
+    // every row starts with filter type 0
+    auto row_size = uint64_t(width) * 3 + 1;
+    auto raw_size = row_size * height;
+    const uint64_t block_size = 65535;
+    vector<uint8_t> data;
+    data.reserve(2 + raw_size + (raw_size / block_size + 1) * 5 + 4);
+    // zlib header, deflate with 32K window, no compression
+    data.push_back(0x78);
+    data.push_back(0x01);
+    uint32_t a = 1, b = 0;
+    vector<uint8_t> raw;
+    raw.reserve(raw_size);
+    for (auto y = 0u; y < height; y++) {
+        raw.push_back(0);
+        auto row = rgb + uint64_t(y) * width * 3;
+        raw.insert(raw.end(), row, row + uint64_t(width) * 3);
+    }
+    // stored blocks, an empty image still needs one final block
+    uint64_t offset = 0;
+    do {
+        auto size = min(block_size, raw_size - offset);
+        bool last = offset + size == raw_size;
+        data.push_back(last);
+        data.push_back(size & 0xff);
+        data.push_back(size >> 8);
+        data.push_back(~size & 0xff);
+        data.push_back((~size >> 8) & 0xff);
+        data.insert(
+            data.end(), raw.begin() + offset, raw.begin() + offset + size
+        );
+        offset += size;
+    } while (offset < raw_size);
+    // adler32 of the uncompressed data, with the modulo deferred as long as
+    // the sums can't overflow
+    for (offset = 0; offset < raw_size; offset += 5552) {
+        auto end = min(raw_size, offset + 5552);
+        for (auto i = offset; i < end; i++) {
+            a += raw[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    append_u32(data, (b << 16) | a);
+    write_chunk(file, "IDAT", data);
+
+    write_chunk(file, "IEND", {});
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstdint>
+
+// Writers for 8 bit RGB images, rows are stored top to bottom without
+// padding. PNG files are written with uncompressed deflate blocks, which is
+// fast enough to keep up with capturing every frame.
+
+void write_ppm(
+    const char* path, uint32_t width, uint32_t height, const uint8_t* rgb
+);
+void write_png(
+    const char* path, uint32_t width, uint32_t height, const uint8_t* rgb
+);
@@ -0,0 +1,664 @@
+#include "impostor.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+
+#include "ge1/shader_module.h"
+
+#include "shader_reflection.h"
+#include "shaders/impostor_bake_vertex.glsl.h"
+#include "shaders/impostor_vertex.glsl.h"
+
+using namespace std;
+
+extern char _binary_shaders_impostor_bake_vertex_glsl_spv_start;
+extern char _binary_shaders_impostor_bake_vertex_glsl_spv_end;
+extern char _binary_shaders_impostor_bake_fragment_glsl_spv_start;
+extern char _binary_shaders_impostor_bake_fragment_glsl_spv_end;
+extern char _binary_shaders_impostor_vertex_glsl_spv_start;
+extern char _binary_shaders_impostor_vertex_glsl_spv_end;
+extern char _binary_shaders_impostor_fragment_glsl_spv_start;
+extern char _binary_shaders_impostor_fragment_glsl_spv_end;
+
+static_assert(
+    impostor_bake_vertex_push_constant_size ==
+    sizeof(impostor_bake_constants)
+);
+static_assert(impostor_vertex_push_constant_size == sizeof(impostor_constants));
+static_assert(impostor_tile_size >> (impostor_mip_levels - 1) > 0);
+
+const VkFormat impostor_format = VK_FORMAT_R8G8B8A8_UNORM;
+const VkFormat impostor_depth_format = VK_FORMAT_D32_SFLOAT;
+
+static VkPipelineLayout create_layout(
+    VkDevice device, const bindless_set& bindless, uint32_t push_size
+) {
+    VkPushConstantRange push_constant_range{
+        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+        .offset = 0,
+        .size = push_size,
+    };
+    VkPipelineLayoutCreateInfo create_info{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &bindless.layout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &push_constant_range,
+    };
+    VkPipelineLayout layout;
+    if (
+        vkCreatePipelineLayout(device, &create_info, nullptr, &layout) !=
+        VK_SUCCESS
+    ) {
+        throw runtime_error("failed to create pipeline layout");
+    }
+    return layout;
+}
+
+// no vertex input, depth tested, one opaque color attachment
+static VkPipeline create_graphics_pipeline(
+    VkDevice device, VkPipelineLayout layout, render_target target,
+    VkSampleCountFlagBits samples,
+    VkShaderModule vertex_module, VkShaderModule fragment_module
+) {
+    VkPipelineShaderStageCreateInfo stage_create_infos[]{
+        {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_VERTEX_BIT,
+            .module = vertex_module,
+            .pName = "main",
+        }, {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .module = fragment_module,
+            .pName = "main",
+        }
+    };
+    VkPipelineVertexInputStateCreateInfo input_state_create_info{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+    };
+    VkPipelineInputAssemblyStateCreateInfo assembly_state_create_info{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+        .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+        .primitiveRestartEnable = VK_FALSE,
+    };
+    VkPipelineViewportStateCreateInfo viewport_state_create_info{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+        .viewportCount = 1,
+        .scissorCount = 1,
+    };
+    // the bake sees every side of the mesh, the winding of the quads
+    // depends on the view direction
+    VkPipelineRasterizationStateCreateInfo rasterization_state_create_info{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+        .depthClampEnable = VK_FALSE,
+        .rasterizerDiscardEnable = VK_FALSE,
+        .polygonMode = VK_POLYGON_MODE_FILL,
+        .cullMode = VK_CULL_MODE_NONE,
+        .frontFace = VK_FRONT_FACE_CLOCKWISE,
+        .depthBiasEnable = VK_FALSE,
+        .lineWidth = 1.0f,
+    };
+    VkPipelineMultisampleStateCreateInfo multisample_state_create_info{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+        .rasterizationSamples = samples,
+        .sampleShadingEnable = VK_FALSE,
+    };
+    VkPipelineDepthStencilStateCreateInfo depth_stencil_info{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+        .depthTestEnable = VK_TRUE,
+        .depthWriteEnable = VK_TRUE,
+        .depthCompareOp = VK_COMPARE_OP_LESS,
+        .depthBoundsTestEnable = VK_FALSE,
+        .stencilTestEnable = VK_FALSE,
+    };
+    VkPipelineColorBlendAttachmentState color_blend_attachment_state{
+        .blendEnable = VK_FALSE,
+        .colorWriteMask =
+            VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+            VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
+    };
+    VkPipelineColorBlendStateCreateInfo color_blend_state_create_info{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+        .logicOpEnable = VK_FALSE,
+        .attachmentCount = 1,
+        .pAttachments = &color_blend_attachment_state,
+    };
+    VkDynamicState dynamic_state[]{
+        VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_SCISSOR,
+    };
+    VkPipelineDynamicStateCreateInfo dynamic_state_create_info{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+        .dynamicStateCount = size(dynamic_state),
+        .pDynamicStates = dynamic_state,
+    };
+    VkGraphicsPipelineCreateInfo pipeline_create_info{
+        .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+        .pNext = target.rendering,
+        .stageCount = size(stage_create_infos),
+        .pStages = stage_create_infos,
+        .pVertexInputState = &input_state_create_info,
+        .pInputAssemblyState = &assembly_state_create_info,
+        .pViewportState = &viewport_state_create_info,
+        .pRasterizationState = &rasterization_state_create_info,
+        .pMultisampleState = &multisample_state_create_info,
+        .pDepthStencilState = &depth_stencil_info,
+        .pColorBlendState = &color_blend_state_create_info,
+        .pDynamicState = &dynamic_state_create_info,
+        .layout = layout,
+        .renderPass = target.render_pass,
+        .subpass = 0,
+    };
+    VkPipeline pipeline;
+    if (
+        vkCreateGraphicsPipelines(
+            device, VK_NULL_HANDLE, 1, &pipeline_create_info, nullptr,
+            &pipeline
+        ) != VK_SUCCESS
+    ) {
+        throw runtime_error("failed to create pipeline");
+    }
+    return pipeline;
+}
+
+void create_impostor_pipeline(
+    VkDevice device, const bindless_set& bindless,
+    render_target early_target, render_target target,
+    VkSampleCountFlagBits samples, impostor_pipeline& pipeline
+) {
+    pipeline.bake_vertex_module = ge1::create_shader_module(device, {
+        &_binary_shaders_impostor_bake_vertex_glsl_spv_start,
+        &_binary_shaders_impostor_bake_vertex_glsl_spv_end
+    });
+    pipeline.bake_fragment_module = ge1::create_shader_module(device, {
+        &_binary_shaders_impostor_bake_fragment_glsl_spv_start,
+        &_binary_shaders_impostor_bake_fragment_glsl_spv_end
+    });
+    pipeline.vertex_module = ge1::create_shader_module(device, {
+        &_binary_shaders_impostor_vertex_glsl_spv_start,
+        &_binary_shaders_impostor_vertex_glsl_spv_end
+    });
+    pipeline.fragment_module = ge1::create_shader_module(device, {
+        &_binary_shaders_impostor_fragment_glsl_spv_start,
+        &_binary_shaders_impostor_fragment_glsl_spv_end
+    });
+
+    // the atlas ends up as the source of the mip chain blits
+    {
+        VkAttachmentDescription attachments[]{
+            {
+                .format = impostor_format,
+                .samples = VK_SAMPLE_COUNT_1_BIT,
+                .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+                .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+                .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+                .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+                .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+                .finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            }, {
+                .format = impostor_depth_format,
+                .samples = VK_SAMPLE_COUNT_1_BIT,
+                .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+                .storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+                .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+                .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+                .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+                .finalLayout =
+                    VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+            },
+        };
+        VkAttachmentReference color_reference{
+            .attachment = 0,
+            .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        };
+        VkAttachmentReference depth_reference{
+            .attachment = 1,
+            .layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+        };
+        VkSubpassDescription subpass{
+            .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+            .colorAttachmentCount = 1,
+            .pColorAttachments = &color_reference,
+            .pDepthStencilAttachment = &depth_reference,
+        };
+        VkSubpassDependency dependency{
+            .srcSubpass = 0,
+            .dstSubpass = VK_SUBPASS_EXTERNAL,
+            .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            .dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT,
+            .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+        };
+        VkRenderPassCreateInfo create_info{
+            .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+            .attachmentCount = size(attachments),
+            .pAttachments = attachments,
+            .subpassCount = 1,
+            .pSubpasses = &subpass,
+            .dependencyCount = 1,
+            .pDependencies = &dependency,
+        };
+        if (
+            vkCreateRenderPass(
+                device, &create_info, nullptr, &pipeline.bake_render_pass
+            ) != VK_SUCCESS
+        ) {
+            throw runtime_error("failed to create render pass");
+        }
+    }
+
+    pipeline.bake_layout = create_layout(
+        device, bindless, impostor_bake_vertex_push_constant_size
+    );
+    pipeline.layout =
+        create_layout(device, bindless, impostor_vertex_push_constant_size);
+    pipeline.bake_pipeline = create_graphics_pipeline(
+        device, pipeline.bake_layout, {pipeline.bake_render_pass, nullptr},
+        VK_SAMPLE_COUNT_1_BIT,
+        pipeline.bake_vertex_module, pipeline.bake_fragment_module
+    );
+    pipeline.pipeline = create_graphics_pipeline(
+        device, pipeline.layout, target, samples,
+        pipeline.vertex_module, pipeline.fragment_module
+    );
+    pipeline.early_pipeline = create_graphics_pipeline(
+        device, pipeline.layout, early_target, samples,
+        pipeline.vertex_module, pipeline.fragment_module
+    );
+
+    VkSamplerCreateInfo create_info{
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .magFilter = VK_FILTER_LINEAR,
+        .minFilter = VK_FILTER_LINEAR,
+        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR,
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .maxLod = VK_LOD_CLAMP_NONE,
+    };
+    if (
+        vkCreateSampler(device, &create_info, nullptr, &pipeline.sampler) !=
+        VK_SUCCESS
+    ) {
+        throw runtime_error("failed to create sampler");
+    }
+}
+
+void destroy_impostor_pipeline(
+    VkDevice device, const impostor_pipeline& pipeline
+) {
+    vkDestroySampler(device, pipeline.sampler, nullptr);
+    vkDestroyPipeline(device, pipeline.bake_pipeline, nullptr);
+    vkDestroyPipeline(device, pipeline.pipeline, nullptr);
+    vkDestroyPipeline(device, pipeline.early_pipeline, nullptr);
+    vkDestroyPipelineLayout(device, pipeline.bake_layout, nullptr);
+    vkDestroyPipelineLayout(device, pipeline.layout, nullptr);
+    vkDestroyRenderPass(device, pipeline.bake_render_pass, nullptr);
+    vkDestroyShaderModule(device, pipeline.bake_vertex_module, nullptr);
+    vkDestroyShaderModule(device, pipeline.bake_fragment_module, nullptr);
+    vkDestroyShaderModule(device, pipeline.vertex_module, nullptr);
+    vkDestroyShaderModule(device, pipeline.fragment_module, nullptr);
+}
+
+static void create_image(
+    VkDevice device, memory_tracker& tracker, VkFormat format,
+    VkImageAspectFlags aspect, uint32_t size, uint32_t mip_levels,
+    VkImageUsageFlags usage, VkImage& image, VkDeviceMemory& memory,
+    VkImageView& view
+) {
+    VkImageCreateInfo image_info{
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = format,
+        .extent = {size, size, 1},
+        .mipLevels = mip_levels,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = usage,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+    };
+    if (vkCreateImage(device, &image_info, nullptr, &image) != VK_SUCCESS) {
+        throw runtime_error("failed to create image");
+    }
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(device, image, &requirements);
+    memory = allocate_tracked_memory(
+        device, tracker, requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        memory_tag::other
+    );
+    vkBindImageMemory(device, image, memory, 0);
+
+    VkImageViewCreateInfo view_info{
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .image = image,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format = format,
+        .subresourceRange = {
+            .aspectMask = aspect,
+            .baseMipLevel = 0,
+            .levelCount = mip_levels,
+            .baseArrayLayer = 0,
+            .layerCount = 1,
+        },
+    };
+    if (vkCreateImageView(device, &view_info, nullptr, &view) != VK_SUCCESS) {
+        throw runtime_error("failed to create image view");
+    }
+}
+
+static void record_level_barrier(
+    VkCommandBuffer command_buffer, VkImage image, uint32_t level,
+    uint32_t level_count,
+    VkImageLayout old_layout, VkImageLayout new_layout,
+    VkPipelineStageFlags source_stage, VkPipelineStageFlags destination_stage,
+    VkAccessFlags source_access, VkAccessFlags destination_access
+) {
+    VkImageMemoryBarrier barrier{
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = source_access,
+        .dstAccessMask = destination_access,
+        .oldLayout = old_layout,
+        .newLayout = new_layout,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = image,
+        .subresourceRange = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .baseMipLevel = level,
+            .levelCount = level_count,
+            .baseArrayLayer = 0,
+            .layerCount = 1,
+        },
+    };
+    vkCmdPipelineBarrier(
+        command_buffer, source_stage, destination_stage, 0,
+        0, nullptr, 0, nullptr, 1, &barrier
+    );
+}
+
+void bake_impostor_atlas(
+    VkDevice device, memory_tracker& tracker, bindless_set& bindless,
+    const impostor_pipeline& pipeline, queue& queue,
+    VkCommandPool command_pool, const geometry_arena& arena,
+    uint32_t vertices, uint32_t mesh, const float sphere[4],
+    impostor_atlas& atlas
+) {
+    auto size = impostor_tiles * impostor_tile_size;
+    copy(sphere, sphere + 4, atlas.sphere);
+    create_image(
+        device, tracker, impostor_format, VK_IMAGE_ASPECT_COLOR_BIT, size,
+        impostor_mip_levels,
+        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+        VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+        VK_IMAGE_USAGE_SAMPLED_BIT,
+        atlas.image, atlas.memory, atlas.view
+    );
+
+    // only needed while baking
+    VkImage depth_image;
+    VkDeviceMemory depth_memory;
+    VkImageView depth_view;
+    create_image(
+        device, tracker, impostor_depth_format, VK_IMAGE_ASPECT_DEPTH_BIT,
+        size, 1, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+        depth_image, depth_memory, depth_view
+    );
+    // the framebuffer can only have the first level
+    VkImageView level_view;
+    {
+        VkImageViewCreateInfo view_info{
+            .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+            .image = atlas.image,
+            .viewType = VK_IMAGE_VIEW_TYPE_2D,
+            .format = impostor_format,
+            .subresourceRange = {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .baseMipLevel = 0,
+                .levelCount = 1,
+                .baseArrayLayer = 0,
+                .layerCount = 1,
+            },
+        };
+        if (
+            vkCreateImageView(device, &view_info, nullptr, &level_view) !=
+            VK_SUCCESS
+        ) {
+            throw runtime_error("failed to create image view");
+        }
+    }
+    VkFramebuffer framebuffer;
+    {
+        VkImageView attachments[]{level_view, depth_view};
+        VkFramebufferCreateInfo create_info{
+            .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+            .renderPass = pipeline.bake_render_pass,
+            .attachmentCount = std::size(attachments),
+            .pAttachments = attachments,
+            .width = size,
+            .height = size,
+            .layers = 1,
+        };
+        if (
+            vkCreateFramebuffer(device, &create_info, nullptr, &framebuffer) !=
+            VK_SUCCESS
+        ) {
+            throw runtime_error("failed to create framebuffer");
+        }
+    }
+
+    VkCommandBuffer command_buffer;
+    {
+        VkCommandBufferAllocateInfo allocate_info{
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = command_pool,
+            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            .commandBufferCount = 1,
+        };
+        if (
+            vkAllocateCommandBuffers(
+                device, &allocate_info, &command_buffer
+            ) != VK_SUCCESS
+        ) {
+            throw runtime_error("failed to allocate command buffers");
+        }
+    }
+    VkCommandBufferBeginInfo begin_info{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    vkBeginCommandBuffer(command_buffer, &begin_info);
+
+    // transparent background, so the atlas is premultiplied
+    VkClearValue clear_values[2]{};
+    clear_values[1].depthStencil = {1.0f, 0};
+    VkRenderPassBeginInfo render_pass_info{
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+        .renderPass = pipeline.bake_render_pass,
+        .framebuffer = framebuffer,
+        .renderArea = {{0, 0}, {size, size}},
+        .clearValueCount = std::size(clear_values),
+        .pClearValues = clear_values,
+    };
+    vkCmdBeginRenderPass(
+        command_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE
+    );
+    VkViewport viewport{
+        .x = 0.0f,
+        .y = 0.0f,
+        .width = float(size),
+        .height = float(size),
+        .minDepth = 0.0f,
+        .maxDepth = 1.0f,
+    };
+    VkRect2D scissors{{0, 0}, {size, size}};
+    vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+    vkCmdSetScissor(command_buffer, 0, 1, &scissors);
+    vkCmdBindPipeline(
+        command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+        pipeline.bake_pipeline
+    );
+    vkCmdBindDescriptorSets(
+        command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.bake_layout,
+        0, 1, &bindless.set, 0, nullptr
+    );
+    impostor_bake_constants constants{
+        .sphere = {sphere[0], sphere[1], sphere[2], sphere[3]},
+        .vertices = vertices,
+        .vertex_stride = uint32_t(arena.vertex_stride / sizeof(float)),
+        .tiles = impostor_tiles,
+    };
+    vkCmdPushConstants(
+        command_buffer, pipeline.bake_layout, VK_SHADER_STAGE_VERTEX_BIT,
+        0, sizeof(constants), &constants
+    );
+    // only the index buffer is used, one instance per tile
+    bind_geometry(command_buffer, arena);
+    auto& allocation = arena.meshes[mesh];
+    vkCmdDrawIndexed(
+        command_buffer, allocation.index_count,
+        impostor_tiles * impostor_tiles, allocation.first_index,
+        int32_t(allocation.vertex_offset), 0
+    );
+    vkCmdEndRenderPass(command_buffer);
+
+    // each level is blitted from the previous one
+    for (auto level = 1u; level < impostor_mip_levels; level++) {
+        record_level_barrier(
+            command_buffer, atlas.image, level, 1,
+            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0, VK_ACCESS_TRANSFER_WRITE_BIT
+        );
+        int32_t source_size = size >> (level - 1);
+        VkImageBlit blit{
+            .srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1},
+            .srcOffsets = {{0, 0, 0}, {source_size, source_size, 1}},
+            .dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1},
+            .dstOffsets = {
+                {0, 0, 0}, {source_size / 2, source_size / 2, 1}
+            },
+        };
+        vkCmdBlitImage(
+            command_buffer,
+            atlas.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            atlas.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            1, &blit, VK_FILTER_LINEAR
+        );
+        record_level_barrier(
+            command_buffer, atlas.image, level, 1,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT
+        );
+    }
+    // covers all later submissions to the queue
+    record_level_barrier(
+        command_buffer, atlas.image, 0, impostor_mip_levels,
+        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+        VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT
+    );
+    if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
+        throw runtime_error("failed to record command buffer");
+    }
+
+    auto value = submit(queue, {.command_buffers = {&command_buffer, 1}});
+    wait(device, queue, value);
+
+    vkFreeCommandBuffers(device, command_pool, 1, &command_buffer);
+    vkDestroyFramebuffer(device, framebuffer, nullptr);
+    vkDestroyImageView(device, level_view, nullptr);
+    vkDestroyImageView(device, depth_view, nullptr);
+    vkDestroyImage(device, depth_image, nullptr);
+    free_tracked_memory(device, tracker, depth_memory);
+
+    atlas.texture = add_texture(device, bindless, atlas.view, pipeline.sampler);
+}
+
+void destroy_impostor_atlas(
+    VkDevice device, memory_tracker& tracker, bindless_set& bindless,
+    const impostor_atlas& atlas
+) {
+    remove_texture(bindless, atlas.texture);
+    vkDestroyImageView(device, atlas.view, nullptr);
+    vkDestroyImage(device, atlas.image, nullptr);
+    free_tracked_memory(device, tracker, atlas.memory);
+}
+
+void create_impostor_buffer(
+    VkDevice device, memory_tracker& tracker, bindless_set& bindless,
+    uint32_t capacity, impostor_buffer& buffer
+) {
+    // never empty, so that it can be added to the bindless set
+    create_mapped_buffer(
+        device, tracker, memory_tag::instances,
+        sizeof(impostor_entry) * uint64_t(max(capacity, 1u)),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, buffer.buffer
+    );
+    buffer.entries = (impostor_entry*)buffer.buffer.data;
+    buffer.capacity = capacity;
+    buffer.slot = add_buffer(
+        device, bindless, buffer.buffer.buffer, 0, buffer.buffer.size
+    );
+}
+
+void destroy_impostor_buffer(
+    VkDevice device, memory_tracker& tracker, bindless_set& bindless,
+    const impostor_buffer& buffer
+) {
+    remove_buffer(bindless, buffer.slot);
+    destroy_mapped_buffer(device, tracker, buffer.buffer);
+}
+
+float get_impostor_fade(
+    const meshlet_culler& culler, const float sphere[4], float distance,
+    float band
+) {
+    if (!culler.cone_culling) {
+        return 0;
+    }
+    float squared = 0;
+    for (auto i = 0u; i < 3; i++) {
+        auto offset = culler.camera[i] - sphere[i];
+        squared += offset * offset;
+    }
+    auto radii = sqrt(squared) / sphere[3];
+    if (band <= 0) {
+        return radii > distance ? 1 : 0;
+    }
+    return clamp((radii - distance) / band, 0.0f, 1.0f);
+}
+
+void bind_impostor_pipeline(
+    VkCommandBuffer command_buffer, const impostor_pipeline& pipeline,
+    const bindless_set& bindless, bool early
+) {
+    vkCmdBindPipeline(
+        command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+        early ? pipeline.early_pipeline : pipeline.pipeline
+    );
+    vkCmdBindDescriptorSets(
+        command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.layout,
+        0, 1, &bindless.set, 0, nullptr
+    );
+}
+
+void draw_impostors(
+    VkCommandBuffer command_buffer, const impostor_pipeline& pipeline,
+    const impostor_constants& constants, uint32_t count
+) {
+    if (count == 0) {
+        return;
+    }
+    vkCmdPushConstants(
+        command_buffer, pipeline.layout, VK_SHADER_STAGE_VERTEX_BIT,
+        0, sizeof(constants), &constants
+    );
+    vkCmdDraw(command_buffer, 6, count, 0, 0);
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstdint>
+
+#include <vulkan/vulkan.h>
+
+#include "buffer.h"
+#include "bindless.h"
+#include "geometry_arena.h"
+#include "meshlet.h"
+#include "queues.h"
+#include "render_graph.h"
+
+// Distant instances are drawn as camera facing quads instead of meshes. The
+// mesh is rendered once from impostor_tiles by impostor_tiles directions,
+// the centers of the cells of an octahedral map of the sphere, into an
+// atlas of object space normals, which the quads are shaded with like the
+// solid passes. Over a band of distances the impostor is dithered in on top
+// of the mesh, the mesh is dropped once the impostor is fully opaque.
+
+const uint32_t impostor_tiles = 8;
+const uint32_t impostor_tile_size = 128;
+// down to tiles of 8 by 8 texels
+const uint32_t impostor_mip_levels = 5;
+
+// must match the push constants in impostor_bake_vertex.glsl, buffers are
+// bindless slots
+struct impostor_bake_constants {
+    float sphere[4];
+    uint32_t vertices, vertex_stride, tiles;
+};
+
+// must match the push constants in impostor_vertex.glsl, buffers and the
+// atlas are bindless slots
+struct impostor_constants {
+    float sphere[4];
+    uint32_t instances, impostors;
+    // no_buffer to draw all impostors
+    uint32_t visibility;
+    uint32_t first_impostor;
+    uint32_t atlas, tiles;
+};
+
+// early pipelines are for the pass before the occlusion test, like the
+// solid pipelines
+struct impostor_pipeline {
+    VkShaderModule bake_vertex_module, bake_fragment_module;
+    VkShaderModule vertex_module, fragment_module;
+    VkRenderPass bake_render_pass;
+    VkPipelineLayout bake_layout, layout;
+    VkPipeline bake_pipeline, pipeline, early_pipeline;
+    VkSampler sampler;
+};
+
+// the targets are the solid passes, viewport and scissor are dynamic
+void create_impostor_pipeline(
+    VkDevice device, const bindless_set& bindless,
+    render_target early_target, render_target target,
+    VkSampleCountFlagBits samples, impostor_pipeline& pipeline
+);
+void destroy_impostor_pipeline(
+    VkDevice device, const impostor_pipeline& pipeline
+);
+
+struct impostor_atlas {
+    VkImage image;
+    VkDeviceMemory memory;
+    VkImageView view;
+    // bindless texture slot
+    uint32_t texture;
+    // object space bounding sphere of the mesh, center and radius
+    float sphere[4];
+};
+
+// renders a mesh of the arena into a new atlas and blocks until it is done.
+// vertices is the bindless slot of the arena's vertex buffer.
+void bake_impostor_atlas(
+    VkDevice device, memory_tracker& tracker, bindless_set& bindless,
+    const impostor_pipeline& pipeline, queue& queue,
+    VkCommandPool command_pool, const geometry_arena& arena,
+    uint32_t vertices, uint32_t mesh, const float sphere[4],
+    impostor_atlas& atlas
+);
+// the atlas must not be used by any command buffer in flight
+void destroy_impostor_atlas(
+    VkDevice device, memory_tracker& tracker, bindless_set& bindless,
+    const impostor_atlas& atlas
+);
+
+// matches the impostor list in impostor_vertex.glsl
+struct impostor_entry {
+    uint32_t instance;
+    float fade;
+};
+
+// list of impostors written every frame, one per frame in flight
+struct impostor_buffer {
+    mapped_buffer buffer;
+    impostor_entry* entries;
+    uint32_t capacity;
+    uint32_t slot;
+};
+
+void create_impostor_buffer(
+    VkDevice device, memory_tracker& tracker, bindless_set& bindless,
+    uint32_t capacity, impostor_buffer& buffer
+);
+void destroy_impostor_buffer(
+    VkDevice device, memory_tracker& tracker, bindless_set& bindless,
+    const impostor_buffer& buffer
+);
+
+// 0 if the instance is nearer than distance bounding sphere radii, 1 if it
+// is farther than distance + band, in between in the band. Instances seen
+// from infinitely far, like with orthographic projections, are never faded.
+float get_impostor_fade(
+    const meshlet_culler& culler, const float sphere[4], float distance,
+    float band
+);
+
+// inside of a solid pass, before draw_impostors
+void bind_impostor_pipeline(
+    VkCommandBuffer command_buffer, const impostor_pipeline& pipeline,
+    const bindless_set& bindless, bool early
+);
+// draws count impostors of the list starting at constants.first_impostor
+void draw_impostors(
+    VkCommandBuffer command_buffer, const impostor_pipeline& pipeline,
+    const impostor_constants& constants, uint32_t count
+);
@@ -0,0 +1,183 @@
+#include "job_system.h"
+
+#include <stdexcept>
+
+using namespace std;
+
+static thread_local uint32_t worker_index = -1u;
+
+static void push(job_deque& deque, job* j) {
+    auto bottom = deque.bottom.load(memory_order_relaxed);
+    auto top = deque.top.load(memory_order_acquire);
+    if (bottom - top >= max_jobs_per_worker) {
+        throw runtime_error("job deque is full");
+    }
+    deque.jobs[bottom & (max_jobs_per_worker - 1)].store(
+        j, memory_order_relaxed
+    );
+    atomic_thread_fence(memory_order_release);
+    deque.bottom.store(bottom + 1, memory_order_relaxed);
+}
+
+static job* pop(job_deque& deque) {
+    auto bottom = deque.bottom.load(memory_order_relaxed) - 1;
+    deque.bottom.store(bottom, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    auto top = deque.top.load(memory_order_relaxed);
+    if (top > bottom) {
+        // empty
+        deque.bottom.store(bottom + 1, memory_order_relaxed);
+        return nullptr;
+    }
+    auto j = deque.jobs[bottom & (max_jobs_per_worker - 1)].load(
+        memory_order_relaxed
+    );
+    if (top == bottom) {
+        // last job, race against thieves for it
+        if (!deque.top.compare_exchange_strong(
+            top, top + 1, memory_order_seq_cst, memory_order_relaxed
+        )) {
+            j = nullptr;
+        }
+        deque.bottom.store(bottom + 1, memory_order_relaxed);
+    }
+    return j;
+}
+
+static job* steal(job_deque& deque) {
+    auto top = deque.top.load(memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    auto bottom = deque.bottom.load(memory_order_acquire);
+    if (top >= bottom) {
+        return nullptr;
+    }
+    auto j = deque.jobs[top & (max_jobs_per_worker - 1)].load(
+        memory_order_relaxed
+    );
+    if (!deque.top.compare_exchange_strong(
+        top, top + 1, memory_order_seq_cst, memory_order_relaxed
+    )) {
+        return nullptr;
+    }
+    return j;
+}
+
+static void finish(job& j) {
+    if (j.unfinished.fetch_sub(1, memory_order_acq_rel) == 1) {
+        if (j.parent) {
+            finish(*j.parent);
+        }
+    }
+}
+
+static void execute(job& j) {
+    j.function(j);
+    if (j.destructor) {
+        j.destructor(j);
+    }
+    finish(j);
+}
+
+static job* find_job(job_system& system) {
+    auto& worker = system.workers[worker_index];
+    if (auto j = pop(worker.deque)) {
+        return j;
+    }
+    for (auto i = 0u; i < system.worker_count; i++) {
+        auto victim = (worker.steal_index + i) % system.worker_count;
+        if (victim == worker_index) {
+            continue;
+        }
+        if (auto j = steal(system.workers[victim].deque)) {
+            // keep stealing from the same worker while it has jobs
+            worker.steal_index = victim;
+            return j;
+        }
+    }
+    return nullptr;
+}
+
+static void work(job_system& system, uint32_t index) {
+    worker_index = index;
+    while (system.running.load(memory_order_acquire)) {
+        auto generation = system.generation.load(memory_order_acquire);
+        if (auto j = find_job(system)) {
+            execute(*j);
+            continue;
+        }
+        // sleep until a job is pushed
+        system.generation.wait(generation, memory_order_acquire);
+    }
+}
+
+void create_job_system(job_system& system, uint32_t thread_count) {
+    if (thread_count == 0) {
+        thread_count = max(thread::hardware_concurrency(), 1u);
+    }
+    system.worker_count = thread_count;
+    system.workers = make_unique<job_worker[]>(thread_count);
+    for (auto i = 0u; i < thread_count; i++) {
+        auto& worker = system.workers[i];
+        worker.deque.top = 0;
+        worker.deque.bottom = 0;
+        worker.deque.jobs =
+            make_unique<atomic<job*>[]>(max_jobs_per_worker);
+        worker.jobs = make_unique<job[]>(max_jobs_per_worker);
+        worker.allocated = 0;
+        worker.steal_index = i;
+    }
+    system.running = true;
+    system.generation = 0;
+
+    worker_index = 0;
+    for (auto i = 1u; i < thread_count; i++) {
+        system.threads.emplace_back(work, ref(system), i);
+    }
+}
+
+void destroy_job_system(job_system& system) {
+    system.running.store(false, memory_order_release);
+    system.generation.fetch_add(1, memory_order_release);
+    system.generation.notify_all();
+    for (auto& thread : system.threads) {
+        thread.join();
+    }
+    system.threads.clear();
+    system.workers.reset();
+}
+
+job* allocate_job(job_system& system, job* parent) {
+    auto& worker = system.workers[worker_index];
+    auto& j = worker.jobs[worker.allocated++ & (max_jobs_per_worker - 1)];
+    if (j.unfinished.load(memory_order_acquire) > 0) {
+        throw runtime_error("job ring is full");
+    }
+    j.function = nullptr;
+    j.destructor = nullptr;
+    j.parent = parent;
+    j.unfinished.store(1, memory_order_relaxed);
+    if (parent) {
+        parent->unfinished.fetch_add(1, memory_order_relaxed);
+    }
+    return &j;
+}
+
+void run_job(job_system& system, job& j) {
+    push(system.workers[worker_index].deque, &j);
+    system.generation.fetch_add(1, memory_order_release);
+    system.generation.notify_one();
+}
+
+void wait_job(job_system& system, job& j) {
+    while (j.unfinished.load(memory_order_acquire) > 0) {
+        if (auto other = find_job(system)) {
+            execute(*other);
+        } else {
+            this_thread::yield();
+        }
+    }
+}
+
+uint32_t get_worker_index() {
+    return worker_index;
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <new>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+
+// Work-stealing scheduler. Every worker owns a Chase-Lev deque, pushes and
+// pops jobs at the bottom and steals from the top of the other deques when
+// its own is empty. The thread that creates the job system is worker 0 and
+// only executes jobs while waiting for one. Jobs are allocated from a ring
+// per worker, so a job must finish before its worker allocated
+// max_jobs_per_worker more.
+
+const uint32_t max_jobs_per_worker = 4096;
+// parallel_for raises the batch size for large counts, halving the range
+// then creates at most twice as many jobs and leaves most of the ring to
+// the jobs around it
+const uint32_t max_parallel_for_batches = max_jobs_per_worker / 8;
+
+struct job {
+    void (*function)(job&);
+    void (*destructor)(job&);
+    // finishing a job decrements the counter of its parent
+    job* parent;
+    // 1 for the job itself plus 1 per unfinished child
+    std::atomic<int32_t> unfinished;
+    alignas(std::max_align_t) unsigned char data[64];
+};
+
+// single owner pushes and pops at the bottom, any thread steals at the top
+struct job_deque {
+    std::atomic<int64_t> top, bottom;
+    std::unique_ptr<std::atomic<job*>[]> jobs;
+};
+
+// aligned to avoid false sharing between the deques of different workers
+struct alignas(64) job_worker {
+    job_deque deque;
+    std::unique_ptr<job[]> jobs;
+    uint32_t allocated;
+    // worker to try stealing from next
+    uint32_t steal_index;
+};
+
+struct job_system {
+    std::unique_ptr<job_worker[]> workers;
+    uint32_t worker_count;
+    std::vector<std::thread> threads;
+    std::atomic<bool> running;
+    // incremented for every job pushed, idle workers wait for it to change
+    std::atomic<uint32_t> generation;
+};
+
+// thread_count includes the calling thread, 0 uses all hardware threads
+void create_job_system(job_system& system, uint32_t thread_count = 0);
+void destroy_job_system(job_system& system);
+
+// allocates a job from the ring of the calling worker, the caller sets its
+// function, create_job does that for callables that fit in job.data
+job* allocate_job(job_system& system, job* parent = nullptr);
+
+// makes the job available to all workers
+void run_job(job_system& system, job& job);
+
+// executes other jobs until the job and its children finished
+void wait_job(job_system& system, job& job);
+
+// returns the worker index of the calling thread
+uint32_t get_worker_index();
+
+template<class F>
+job* create_job(job_system& system, job* parent, F&& function) {
+    using function_type = std::decay_t<F>;
+    static_assert(sizeof(function_type) <= sizeof(job::data));
+    static_assert(alignof(function_type) <= alignof(std::max_align_t));
+    auto j = allocate_job(system, parent);
+    new (j->data) function_type(std::forward<F>(function));
+    j->function = [](job& j) {
+        (*std::launder((function_type*)j.data))();
+    };
+    if constexpr (!std::is_trivially_destructible_v<function_type>) {
+        j->destructor = [](job& j) {
+            std::launder((function_type*)j.data)->~function_type();
+        };
+    }
+    return j;
+}
+
+template<class F>
+job* create_job(job_system& system, F&& function) {
+    return create_job(system, nullptr, std::forward<F>(function));
+}
+
+namespace detail {
+    template<class F>
+    void split_range(
+        job_system& system, job* parent, uint32_t begin, uint32_t end,
+        uint32_t batch_size, const F& function
+    ) {
+        // hand half of the range to other workers until it is small enough
+        while (end - begin > batch_size) {
+            auto middle = begin + (end - begin) / 2;
+            auto half = create_job(
+                system, parent,
+                [&system, parent, middle, end, batch_size, &function]() {
+                    split_range(
+                        system, parent, middle, end, batch_size, function
+                    );
+                }
+            );
+            run_job(system, *half);
+            end = middle;
+        }
+        function(begin, end);
+    }
+}
+
+// calls function(begin, end) for batches of at most batch_size indices,
+// or count / max_parallel_for_batches if that is more, returns once all
+// batches finished
+template<class F>
+void parallel_for(
+    job_system& system, uint32_t count, uint32_t batch_size, const F& function
+) {
+    if (count == 0) {
+        return;
+    }
+    batch_size = std::max({
+        batch_size, 1u,
+        (count + max_parallel_for_batches - 1) / max_parallel_for_batches,
+    });
+    // empty job that finishes once all batches did
+    auto root = create_job(system, []() {});
+    auto split = create_job(
+        system, root, [&system, root, count, batch_size, &function]() {
+            detail::split_range(system, root, 0, count, batch_size, function);
+        }
+    );
+    run_job(system, *split);
+    run_job(system, *root);
+    wait_job(system, *root);
+}
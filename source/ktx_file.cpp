@@ -0,0 +1,103 @@
+#include "ktx_file.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <fstream>
+
+#include "texture_blocks.h"
+
+using namespace std;
+
+static const uint8_t ktx2_identifier[12]{
+    0xab, 'K', 'T', 'X', ' ', '2', '0', 0xbb, '\r', '\n', 0x1a, '\n',
+};
+
+// bytes up to the level index, which has an offset, a size and an
+// uncompressed size of 8 bytes each per level, all little endian
+static const uint32_t ktx2_header_size = 80;
+static const uint32_t ktx2_level_index_size = 24;
+
+static uint32_t read_u32(const uint8_t* bytes) {
+    return
+        uint32_t(bytes[0]) | uint32_t(bytes[1]) << 8 |
+        uint32_t(bytes[2]) << 16 | uint32_t(bytes[3]) << 24;
+}
+
+static uint64_t read_u64(const uint8_t* bytes) {
+    return uint64_t(read_u32(bytes)) | uint64_t(read_u32(bytes + 4)) << 32;
+}
+
+void read_ktx2_header(const char* path, ktx2_file& file) {
+    ifstream stream(path, ios::binary);
+    if (!stream) {
+        throw runtime_error("failed to open texture file");
+    }
+    uint8_t bytes[ktx2_header_size];
+    if (!stream.read((char*)bytes, sizeof(bytes))) {
+        throw runtime_error("texture file is too short");
+    }
+    if (!equal(begin(ktx2_identifier), end(ktx2_identifier), bytes)) {
+        throw runtime_error("texture file is not KTX2");
+    }
+    auto format = VkFormat(read_u32(bytes + 12));
+    auto width = read_u32(bytes + 20), height = read_u32(bytes + 24);
+    auto depth = read_u32(bytes + 28);
+    auto layer_count = read_u32(bytes + 32);
+    auto face_count = read_u32(bytes + 36);
+    auto level_count = read_u32(bytes + 40);
+    auto supercompression = read_u32(bytes + 44);
+    if (get_block_size(format) == 0) {
+        throw runtime_error("texture file format is not supported");
+    }
+    if (supercompression != 0) {
+        throw runtime_error("supercompressed texture files aren't supported");
+    }
+    if (
+        width == 0 || height == 0 || depth > 1 ||
+        layer_count > 1 || face_count != 1
+    ) {
+        throw runtime_error("texture file is not a single 2D image");
+    }
+    // 0 asks the loader to generate levels, which isn't supported either
+    if (level_count == 0 || level_count > max_ktx2_levels) {
+        throw runtime_error("texture file has an unsupported level count");
+    }
+
+    file.path = path;
+    file.format = format;
+    file.width = width;
+    file.height = height;
+    file.levels.resize(level_count);
+    stream.seekg(0, ios::end);
+    uint64_t file_size = stream.tellg();
+    stream.seekg(ktx2_header_size);
+    for (auto i = 0u; i < level_count; i++) {
+        uint8_t entry[ktx2_level_index_size];
+        if (!stream.read((char*)entry, sizeof(entry))) {
+            throw runtime_error("texture file is too short");
+        }
+        auto& level = file.levels[i];
+        level.offset = read_u64(entry);
+        level.size = read_u64(entry + 8);
+        level.width = max(width >> i, 1u);
+        level.height = max(height >> i, 1u);
+        if (
+            level.size != get_level_size(format, level.width, level.height) ||
+            level.offset > file_size || level.size > file_size - level.offset
+        ) {
+            throw runtime_error("texture file has a malformed level index");
+        }
+    }
+}
+
+void read_ktx2_level(
+    const ktx2_file& file, uint32_t level, span<uint8_t> data
+) {
+    ifstream stream(file.path, ios::binary);
+    auto& entry = file.levels[level];
+    stream.seekg(entry.offset);
+    stream.read((char*)data.data(), min<uint64_t>(data.size(), entry.size));
+    if (!stream) {
+        throw runtime_error("failed to read texture file");
+    }
+}
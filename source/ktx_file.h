@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <span>
+
+#include <vulkan/vulkan.h>
+
+// Reader for the subset of KTX2 that the texture stream uses: single 2D
+// images with mip levels in a block compressed format, see
+// texture_blocks.h, and without supercompression. The level index is read
+// up front, so that single levels can be loaded later on.
+
+// enough for 32768 by 32768 texels
+const uint32_t max_ktx2_levels = 16;
+
+struct ktx2_level {
+    // in the file
+    uint64_t offset, size;
+    uint32_t width, height;
+};
+
+struct ktx2_file {
+    std::string path;
+    VkFormat format;
+    uint32_t width, height;
+    // level 0 is the largest
+    std::vector<ktx2_level> levels;
+};
+
+// throws if the file can't be read, is malformed or uses features that
+// aren't supported
+void read_ktx2_header(const char* path, ktx2_file& file);
+
+// reads the blocks of one level, data must have the size of the level.
+// Throws if the file can't be read.
+void read_ktx2_level(
+    const ktx2_file& file, uint32_t level, std::span<uint8_t> data
+);
@@ -6,6 +6,14 @@
 #include <fstream>
 #include <cassert>
 #include <array>
+#include <cstddef>
+#include <cmath>
+#include <vector>
+#include <cstdio>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <exception>
 
 #define GLFW_INCLUDE_VULKAN
 #define GLFW_VULKAN_STATIC
@@ -17,14 +25,49 @@
 
 #include "ge1/shader_module.h"
 #include "ge1/span.h"
-#include "ge1/memory.h"
+
+#include "queues.h"
+#include "render_graph.h"
+#include "bindless.h"
+#include "geometry_arena.h"
+#include "geometry_stream.h"
+#include "texture_stream.h"
+#include "transform_hierarchy.h"
+#include "job_system.h"
+#include "readback.h"
+#include "memory_budget.h"
+#include "hud.h"
+#include "meshlet.h"
+#include "occlusion.h"
+#include "impostor.h"
+#include "scene_file.h"
+#include "shader_reflection.h"
+#include "tuning.h"
+#include "pipeline_manager.h"
+#include "draw_queue.h"
+#include "frame_arena.h"
+#include "animation.h"
+#include "skinning.h"
+#include "triple_buffer.h"
+#include "bvh.h"
+
+#include "shaders/solid_vertex.glsl.h"
+#include "shaders/solid_pulled_vertex.glsl.h"
+#include "shaders/solid_task.glsl.h"
+#include "shaders/solid_mesh.glsl.h"
 
 using namespace std;
 
 extern char _binary_shaders_solid_vertex_glsl_spv_start;
 extern char _binary_shaders_solid_vertex_glsl_spv_end;
+extern char _binary_shaders_solid_pulled_vertex_glsl_spv_start;
+extern char _binary_shaders_solid_pulled_vertex_glsl_spv_end;
 extern char _binary_shaders_solid_fragment_glsl_spv_start;
 extern char _binary_shaders_solid_fragment_glsl_spv_end;
+extern char _binary_shaders_solid_task_glsl_spv_start;
+extern char _binary_shaders_solid_task_glsl_spv_end;
+extern char _binary_shaders_solid_mesh_glsl_spv_start;
+extern char _binary_shaders_solid_mesh_glsl_spv_end;
 
 extern float _binary_models_miku_vertices_vbo_start;
 extern float _binary_models_miku_vertices_vbo_end;
@@ -32,13 +75,54 @@ extern unsigned _binary_models_miku_faces_vbo_start;
 extern unsigned _binary_models_miku_faces_vbo_end;
 
 
-static float matrices[]{
-    1, 0, 0, 0,
-    0, 1, 0, 0,
-    0, 0, 1, 0,
-    0, 0, 0, 1,
+struct instance_data {
+    float matrix[16];
+    // index into the bindless material array
+    uint32_t material;
+};
+
+// must match the push constants in solid_pulled_vertex.glsl, buffers are
+// bindless slots
+struct pulled_vertex_constants {
+    uint32_t vertices;
+    // in floats
+    uint32_t vertex_stride;
+    uint32_t instances;
+};
+
+static_assert(
+    solid_pulled_vertex_push_constant_size == sizeof(pulled_vertex_constants)
+);
+
+// how the solid passes get their vertices, F3 switches between the
+// supported paths and benchmarks run the camera path once with each
+enum class vertex_path : uint32_t {
+    // fixed function vertex input, one indirect draw per visible meshlet
+    vertex_input,
+    // the same draws, the vertex shader reads vertices and instances from
+    // storage buffers
+    vertex_pulling,
+    // task and mesh shaders, culling meshlets on the GPU
+    mesh_shader,
 };
 
+static const char* get_vertex_path_name(vertex_path path) {
+    switch (path) {
+    case vertex_path::vertex_input: return "vertex input";
+    case vertex_path::vertex_pulling: return "vertex pulling";
+    default: return "mesh shader";
+    }
+}
+
+// number of generated materials, all are in the bindless set at once
+static const uint32_t material_count = 4096;
+
+// capacity of the indirect command buffers
+static const uint32_t max_draws = 4096;
+
+// capacity of the HUD vertex buffers, enough for the stats overlay
+static const uint32_t max_hud_quads = 1024;
+
 enum binding : uint32_t {
     vertices, instances
 };
@@ -52,51 +136,51 @@ static VkVertexInputBindingDescription vertex_binding_descriptions[] {
     }, {
         // instances
         .binding = instances,
-        .stride = sizeof(float) * 16,
+        .stride = sizeof(instance_data),
         .inputRate = VK_VERTEX_INPUT_RATE_INSTANCE,
     },
 };
 
-enum attribute : uint32_t {
-    position, normal,
-    model_0, model_1, model_2, model_3
-};
-
-static VkVertexInputAttributeDescription vertex_attribute_descriptions[]{
-    {
-        .location = position,
-        .binding = vertices,
-        .format = VK_FORMAT_R32G32B32_SFLOAT,
-        .offset = 0,
-    }, {
-        .location = normal,
-        .binding = vertices,
-        .format = VK_FORMAT_R32G32B32_SFLOAT,
-        .offset = sizeof(float) * 3,
-    }, {
-        .location = model_0,
-        .binding = instances,
-        .format = VK_FORMAT_R32G32B32A32_SFLOAT,
-        .offset = 0,
-    }, {
-        .location = model_1,
-        .binding = instances,
-        .format = VK_FORMAT_R32G32B32A32_SFLOAT,
-        .offset = sizeof(float) * 4,
-    }, {
-        .location = model_2,
-        .binding = instances,
-        .format = VK_FORMAT_R32G32B32A32_SFLOAT,
-        .offset = sizeof(float) * 8,
-    }, {
-        .location = model_3,
-        .binding = instances,
-        .format = VK_FORMAT_R32G32B32A32_SFLOAT,
-        .offset = sizeof(float) * 12,
-    },
-};
+// first location of each binding, the inputs of solid_vertex.glsl are
+// packed in the order of their locations
+static constexpr uint32_t binding_first_locations[]{0, 2};
+
+static constexpr auto vertex_attribute_descriptions =
+    get_vertex_attributes(solid_vertex_inputs, binding_first_locations);
+
+// position and normal, followed by unused texture coordinates
+static_assert(
+    get_binding_size(solid_vertex_inputs, binding_first_locations, vertices)
+    <= sizeof(float) * 8
+);
+static_assert(
+    get_binding_size(solid_vertex_inputs, binding_first_locations, instances)
+    == sizeof(instance_data)
+);
+static_assert(
+    get_attribute_offset(vertex_attribute_descriptions, 6) ==
+    offsetof(instance_data, material)
+);
+static_assert(solid_task_push_constant_size == sizeof(meshlet_constants));
+static_assert(solid_mesh_push_constant_size == sizeof(meshlet_constants));
+
+// spreads hues evenly, material 0 is white
+static material generate_material(uint32_t index) {
+    if (index == 0) {
+        return {.color = {1, 1, 1, 1}, .texture = no_texture};
+    }
+    auto hue = fmod(index * 0.618034f, 1.0f) * 6;
+    auto channel = [hue](float offset) {
+        return clamp(abs(fmod(hue + offset, 6.0f) - 3) - 1, 0.0f, 1.0f);
+    };
+    return {
+        .color = {channel(0), channel(4), channel(2), 1},
+        .texture = no_texture,
+    };
+}
 
-VkSampleCountFlagBits max_sample_count;
+// of the solid passes
+VkSampleCountFlagBits sample_count;
 
 static VKAPI_ATTR VkBool32 VKAPI_CALL debug_callback(
     VkDebugUtilsMessageSeverityFlagBitsEXT severity,
@@ -115,69 +199,540 @@ static VKAPI_ATTR VkBool32 VKAPI_CALL debug_callback(
     return VK_FALSE;
 }
 
+static image_ownership_transfer present_ownership_transfer(
+    const queue_families& queue_families, VkImage image
+) {
+    return {
+        .image = image,
+        .aspect = VK_IMAGE_ASPECT_COLOR_BIT,
+        .source_family = queue_families.graphics,
+        .destination_family = queue_families.present,
+        .old_layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+        .new_layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+        .source_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        .source_access = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        .destination_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+        .destination_access = 0,
+    };
+}
+
 struct swapchain_frame {
     // can't have image_available_semaphore here because calls to
     // vkAcquireNextImageKHR require a semaphore, but at that point it's not
     // known which image will be used
+    VkImage image;
     VkImageView view;
-    // TODO: for number of in-flight frames to be independent of number of
-    // swapchain images, there would have to be one framebuffer and command
-    // buffer per combination of swapchain_frame and render frame
-    VkFramebuffer framebuffer;
-    VkCommandBuffer command_buffer;
-    VkImage color_image;
-    VkImageView color_image_view;
-    VkDeviceMemory color_memory;
-    VkImage depth_image;
-    VkImageView depth_image_view;
-    VkDeviceMemory depth_memory;
+    // transient attachments and framebuffers of the render graph
+    render_graph_instance graph_instance;
+    // views and descriptor sets of the depth pyramid in graph_instance
+    hiz_pyramid pyramid;
+    // acquires ownership of the image on the present queue, only used if it
+    // is in a different family than the graphics queue
+    VkCommandBuffer present_command_buffer;
 };
 
+// a range of the impostor list of a frame, all of one mesh and one phase of
+// the occlusion test
+struct impostor_draw {
+    uint32_t mesh;
+    uint32_t first, count;
+    bool early;
+};
+
+// pipeline of impostor draws in draw keys, the others use their vertex path
+const uint32_t impostor_draw_pipeline = 3;
+
 struct frame_semaphores {
     // number of swapchain_frames is determined by GPU,
     // number of in-flight frames is not
     // there can't be more in-flight frames than swapchain_frames
     VkSemaphore image_available_semaphore, render_finished_semaphore;
+    // signaled after the present queue acquired ownership of the image
+    VkSemaphore present_ready_semaphore;
     VkFence ready_fence;
+    // recorded every frame, once the fence signaled
+    VkCommandBuffer command_buffer;
+    // copy of scene.instances, written every frame once the fence signaled
+    mapped_buffer instances;
+    uint32_t instance_slot;
+    // written every frame, once the fence signaled, draws of instances
+    // that passed the last occlusion test come first
+    indirect_buffer draw_commands;
+    uint32_t draw_count, early_draw_count;
+    // bindless slot of draw_commands, for the occlusion test
+    uint32_t draw_command_slot;
+    // results are read once the fence signaled
+    occlusion_buffer occlusion;
+    // read and reset once the fence signaled, only with mesh shaders
+    meshlet_counter meshlet_counter;
+    hud_buffer hud;
+    gpu_timer timer;
+    // written every frame, once the fence signaled, early impostors first
+    impostor_buffer impostors;
+    vector<impostor_draw> impostor_draws;
+    // written every frame, once the fence signaled, pass 0 is before the
+    // occlusion test. Items of impostors index impostor_draws, the others
+    // are instances.
+    draw_queue draws;
+    // counts are read and reset once the fence signaled
+    draw_binds binds;
+    // temporary CPU side data of the frame, reset once the fence signaled
+    frame_arena arena;
+    // only with skin=<poses>, written every frame once the fence signaled
+    palette_buffer palettes;
+    gpu_timer skin_timer;
+};
+
+// rig of a skinned mesh, its poses blend the two clips
+struct mesh_animation {
+    skeleton skeleton;
+    animation_clip clips[2];
 };
 
 struct scene {
-    VkBuffer static_buffer;
+    geometry_arena geometry;
+    // only used with stream=<pages> on the command line
+    geometry_stream stream;
+
+    // grouped by mesh, written by the transform hierarchy and copied to the
+    // instance buffer of the frame
+    vector<instance_data> instances;
+    // one per mesh, all drawn with the same pipeline
+    vector<mesh_draw> draws;
+
+    // indexed by mesh id, the index buffer of the mesh is in meshlet order
+    vector<meshlet_mesh> meshlets;
+    // only with mesh shaders
+    vector<meshlet_buffer> meshlet_buffers;
+
+    // indexed by mesh id, empty if impostors are disabled
+    vector<impostor_atlas> impostor_atlases;
+    // per instance, written every frame, instances with a fade of 1 are
+    // only drawn as impostors
+    vector<float> fades;
+
+    // only with skin=<poses>, the pose meshes are drawn instead of their
+    // sources
+    vector<skinned_mesh> skinned_meshes;
+    vector<mesh_animation> animations;
+
+    // only if the scene file has textures
+    texture_stream textures;
+
+    // indexed by mesh id of the scene file's meshes, in their rest pose
+    vector<mesh_bvh> mesh_bvhs;
+    // over the instances in world space, built once since nodes don't move
+    scene_bvh picking;
+};
+
+// skin=<poses> rigs every mesh as a chain of joints that waves along two
+// clips, bending around both axes perpendicular to the chain
+const uint32_t skin_joints = 8;
+// radians per joint
+const float skin_amplitude = 0.15f;
+const float skin_duration = 2;
+const uint32_t skin_keys = 32;
+
+// each pose is ahead in the clips by its share of their duration and blends
+// them with its own weight, the result is in a
+static void sample_pose(
+    const mesh_animation& animation, uint32_t pose, uint32_t pose_count,
+    float time, joint_pose& a, joint_pose& b
+) {
+    auto& clips = animation.clips;
+    auto offset = get_clip_duration(clips[0]) * pose / pose_count;
+    sample_clip(clips[0], time + offset, a);
+    sample_clip(clips[1], time + offset, b);
+    blend_poses(a, b, (pose + 0.5f) / pose_count, a);
+}
+
+// largest distance a vertex moves away from the bind pose, sampled at the
+// keys of every pose, by which the meshlet bounds of the poses are grown
+static float get_skinning_margin(
+    job_system& jobs, const mesh_animation& animation, uint32_t pose_count,
+    span<const float> vertices, uint32_t vertex_stride,
+    span<const uint32_t> weights
+) {
+    auto& clip = animation.clips[0];
+    auto key_count = uint32_t(clip.keys.size());
+    vector<float> margins(pose_count * key_count, 0);
+    parallel_for(
+        jobs, uint32_t(margins.size()), 1, [&](uint32_t begin, uint32_t end) {
+            joint_pose a, b;
+            float palette[max_joints * palette_matrix_size];
+            for (auto i = begin; i < end; i++) {
+                sample_pose(
+                    animation, i / key_count, pose_count,
+                    i % key_count / clip.key_rate, a, b
+                );
+                get_joint_palette(animation.skeleton, a, palette);
+                for (auto v = 0u; v < weights.size() / 2; v++) {
+                    auto position = &vertices[size_t(v) * vertex_stride];
+                    float skinned[3];
+                    skin_position(
+                        palette, weights[v * 2], weights[v * 2 + 1],
+                        position, skinned
+                    );
+                    margins[i] = max(margins[i], hypot(
+                        skinned[0] - position[0], skinned[1] - position[1],
+                        skinned[2] - position[2]
+                    ));
+                }
+            }
+        }
+    );
+    return *max_element(margins.begin(), margins.end());
+}
+
+// samples the poses of all skinned meshes at time in seconds, in parallel
+// over the poses of each mesh, palettes has get_palette_size matrices
+static void write_palettes(
+    job_system& jobs, const scene& scene, float time, float* palettes
+) {
+    uint32_t first_matrix = 0;
+    for (auto m = 0u; m < scene.skinned_meshes.size(); m++) {
+        auto& mesh = scene.skinned_meshes[m];
+        auto& animation = scene.animations[m];
+        auto pose_count = uint32_t(mesh.poses.size());
+        parallel_for(jobs, pose_count, 4, [&](uint32_t begin, uint32_t end) {
+            joint_pose a, b;
+            for (auto p = begin; p < end; p++) {
+                sample_pose(animation, p, pose_count, time, a, b);
+                get_joint_palette(
+                    animation.skeleton, a, palettes +
+                        size_t(first_matrix + p * mesh.joint_count) *
+                        palette_matrix_size
+                );
+            }
+        });
+        first_matrix += mesh.joint_count * pose_count;
+    }
+}
+
+// requests the texture level of each instance from the size of its
+// bounding sphere on screen, which the texture projected onto the normals
+// covers. Instances behind the camera request nothing.
+static void request_instance_textures(scene& scene, float height) {
+    uint32_t texture_count = scene.textures.textures.size();
+    for (auto& draw : scene.draws) {
+        float sphere[4];
+        get_mesh_bounds(scene.meshlets[draw.mesh], sphere);
+        for (auto i = 0u; i < draw.instance_count; i++) {
+            auto& instance = scene.instances[draw.first_instance + i];
+            auto m = instance.matrix;
+            auto w =
+                m[3] * sphere[0] + m[7] * sphere[1] + m[11] * sphere[2] +
+                m[15];
+            // of the sphere in clip space
+            auto depth_radius =
+                sphere[3] * sqrt(m[3] * m[3] + m[7] * m[7] + m[11] * m[11]);
+            auto radius =
+                sphere[3] * sqrt(m[1] * m[1] + m[5] * m[5] + m[9] * m[9]);
+            if (w < -depth_radius) {
+                continue;
+            }
+            // the largest level for instances around the camera
+            auto pixels = w > depth_radius ? radius / w * height : INFINITY;
+            request_texture(
+                scene.textures, instance.material % texture_count, pixels
+            );
+        }
+    }
+}
+
+// key state of the simulation thread, F1 toggles the HUD, F2 occlusion
+// culling, F3 switches the vertex path, F11 toggles capturing every frame
+// and F12 saves a screenshot
+struct frame_input {
+    bool show_hud, occlusion_culling, capturing_video;
+    // pressed since the last snapshot
+    bool screenshot, next_vertex_path;
+};
 
-    uint64_t vertex_offset, face_offset, instance_offset;
-    uint32_t index_count;
+// what the simulation thread hands to the render thread every frame
+struct frame_snapshot {
+    // scene.instances with the camera and the transform hierarchy applied
+    vector<instance_data> instances;
+    // of all poses, see write_palettes
+    vector<float> palettes;
+    frame_input input;
+    // in milliseconds, the CPU time of the animation and the time the
+    // simulation waited for the render thread to take the previous snapshot
+    double animation_time, stall_time;
 };
 
+// whether the instance is drawn before the occlusion test, visibility is
+// null if there is no test
+static bool is_early(const uint32_t* visibility, uint32_t instance) {
+    return !visibility || visibility[instance] != 0;
+}
+
+// updates the fades of the instances and writes the list of impostors, the
+// early ones first, with one draw per mesh and phase. Returns the number of
+// instances that are drawn as meshes.
+static uint32_t write_impostors(
+    scene& scene, impostor_buffer& buffer, vector<impostor_draw>& draws,
+    const uint32_t* visibility, float distance, float band
+) {
+    draws.clear();
+    uint32_t count = 0, mesh_count = 0;
+    for (auto early : {true, false}) {
+        for (auto& draw : scene.draws) {
+            auto& atlas = scene.impostor_atlases[draw.mesh];
+            impostor_draw impostor_draw{
+                .mesh = draw.mesh,
+                .first = count,
+                .count = 0,
+                .early = early,
+            };
+            for (auto i = 0u; i < draw.instance_count; i++) {
+                auto instance = draw.first_instance + i;
+                if (is_early(visibility, instance) != early) {
+                    continue;
+                }
+                meshlet_culler culler;
+                create_meshlet_culler(
+                    scene.instances[instance].matrix, culler
+                );
+                auto fade =
+                    get_impostor_fade(culler, atlas.sphere, distance, band);
+                scene.fades[instance] = fade;
+                if (fade < 1) {
+                    mesh_count++;
+                }
+                // the buffer has room for every instance
+                if (fade > 0) {
+                    buffer.entries[count] = {instance, fade};
+                    count++;
+                    impostor_draw.count++;
+                }
+            }
+            if (impostor_draw.count > 0) {
+                draws.push_back(impostor_draw);
+            }
+        }
+    }
+    return mesh_count;
+}
+
+// far plane of get_camera_matrix
+const float camera_far = 1000;
+
+// queues a draw for each instance that is drawn as a mesh and for each
+// list of impostors, and sorts them
+static void write_draw_queue(
+    const scene& scene, const vector<impostor_draw>& impostor_draws,
+    const uint32_t* visibility, vertex_path path, draw_queue& queue
+) {
+    queue.items.clear();
+    for (auto& draw : scene.draws) {
+        for (auto i = 0u; i < draw.instance_count; i++) {
+            auto instance = draw.first_instance + i;
+            if (scene.fades[instance] >= 1) {
+                continue;
+            }
+            // instance matrices include the camera, so this is w of the
+            // origin in clip space, the distance along the view direction
+            auto& data = scene.instances[instance];
+            auto depth = data.matrix[15] / camera_far;
+            queue.items.push_back({
+                get_draw_key(
+                    is_early(visibility, instance) ? 0 : 1, uint32_t(path),
+                    data.material, draw.mesh, depth
+                ),
+                instance,
+            });
+        }
+    }
+    for (auto i = 0u; i < impostor_draws.size(); i++) {
+        auto& draw = impostor_draws[i];
+        queue.items.push_back({
+            get_draw_key(
+                draw.early ? 0 : 1, impostor_draw_pipeline, 0, draw.mesh, 0
+            ),
+            i,
+        });
+    }
+    sort_draw_queue(queue);
+}
+
+// culls the meshlets of every instance in the queue and writes an indirect
+// draw for each visible one, in the order of the queue, draws whole meshes
+// if they don't fit into the buffer. Draws of early instances come first,
+// early_count is their number.
+static uint32_t write_meshlet_draws(
+    scene& scene, const draw_queue& queue, const indirect_buffer& buffer,
+    uint32_t& early_count, uint64_t& meshlet_count,
+    uint64_t& visible_meshlets
+) {
+    span commands(buffer.commands, buffer.capacity);
+    uint32_t count = 0;
+    meshlet_count = 0;
+    for (auto& draw : scene.draws) {
+        auto& mesh = scene.meshlets[draw.mesh];
+        meshlet_count += uint64_t(mesh.meshlets.size()) * draw.instance_count;
+    }
+    early_count = 0;
+    for (auto& item : queue.items) {
+        if (get_draw_pipeline(item.key) == impostor_draw_pipeline) {
+            continue;
+        }
+        auto instance = item.index;
+        auto mesh_id = get_draw_mesh(item.key);
+        auto& mesh = scene.meshlets[mesh_id];
+        meshlet_culler culler;
+        create_meshlet_culler(scene.instances[instance].matrix, culler);
+        auto written = is_streamed(scene.stream, mesh_id) ?
+            write_stream_commands(
+                scene.stream, scene.geometry, mesh_id, mesh, culler,
+                instance, commands.subspan(count)
+            ) :
+            write_meshlet_commands(
+                mesh, scene.geometry.meshes[mesh_id], culler, instance,
+                commands.subspan(count)
+            );
+        if (written == -1u) {
+            write_draw_commands(scene.geometry, scene.draws, commands.data());
+            early_count = scene.draws.size();
+            visible_meshlets = meshlet_count;
+            return scene.draws.size();
+        }
+        count += written;
+        if (get_draw_pass(item.key) == 0) {
+            early_count = count;
+        }
+    }
+    visible_meshlets = count;
+    return count;
+}
+
+// view and projection at time on the camera path of the scene, or a fixed
+// view if it has none
+static glm::mat4 get_camera_matrix(
+    const scene_description& description, float time, VkExtent2D extent
+) {
+    glm::vec3 eye{0, -1, 1}, target{0, 0, 1};
+    if (!description.camera_path.empty()) {
+        sample_camera_path(
+            description, time, glm::value_ptr(eye), glm::value_ptr(target)
+        );
+    }
+    auto matrix = glm::perspectiveFov<float>(
+        30.f, extent.width, extent.height, 0.1, camera_far
+    );
+    return matrix * glm::lookAt(eye, target, {0, 0, 1});
+}
+
+// logs the instance and triangle under the cursor, skinned meshes are
+// picked in their rest pose
+static void pick_instance(
+    GLFWwindow* window, const scene& scene, const glm::mat4& camera
+) {
+    double x, y;
+    glfwGetCursorPos(window, &x, &y);
+    int width, height;
+    glfwGetWindowSize(window, &width, &height);
+    if (width <= 0 || height <= 0) {
+        return;
+    }
+    // the viewport isn't flipped, so y points down like in window
+    // coordinates, the ray goes from depth 0 to the far plane
+    glm::vec2 cursor{float(2 * x / width - 1), float(2 * y / height - 1)};
+    auto inverse = glm::inverse(camera);
+    auto near_point = inverse * glm::vec4(cursor, 0, 1);
+    auto far_point = inverse * glm::vec4(cursor, 1, 1);
+    glm::vec3 origin = glm::vec3(near_point) / near_point.w;
+    glm::vec3 direction = glm::vec3(far_point) / far_point.w - origin;
+    bvh_ray ray{
+        .origin = {origin.x, origin.y, origin.z},
+        .direction = {direction.x, direction.y, direction.z},
+    };
+    bvh_hit hit{.distance = 1, .triangle = 0, .instance = 0};
+    auto start = chrono::steady_clock::now();
+    bool found = intersect_scene_bvh(
+        scene.picking, scene.mesh_bvhs, ray, hit
+    );
+    auto time = chrono::duration<double, micro>(
+        chrono::steady_clock::now() - start
+    ).count();
+    if (found) {
+        cout <<
+            "Picked instance " << hit.instance << ", triangle " <<
+            hit.triangle << " at distance " <<
+            hit.distance * glm::length(direction) << " in " << time <<
+            " us" << endl;
+    } else {
+        cout << "Picked nothing in " << time << " us" << endl;
+    }
+}
+
+// frames of one run along the camera path, the camera advances by 1/60 s
+// per frame so that benchmarks render the same frames on every machine
+static uint32_t get_camera_path_frames(const scene_description& description) {
+    auto duration = get_camera_path_duration(description);
+    uint32_t frames = 0;
+    while (frames / 60.f <= duration) {
+        frames++;
+    }
+    return frames;
+}
+
+// mean, median, 99th percentile and maximum of times in milliseconds
+static void log_frame_times(const char* name, vector<float> times) {
+    if (times.empty()) {
+        return;
+    }
+    sort(times.begin(), times.end());
+    double sum = 0;
+    for (auto time : times) {
+        sum += time;
+    }
+    cout <<
+        name << ": mean " << sum / times.size() << " ms, median " <<
+        times[times.size() / 2] << " ms, 99th percentile " <<
+        times[times.size() * 99 / 100] << " ms, max " << times.back() <<
+        " ms over " << times.size() << " frames" << endl;
+}
+
 struct display_size {
     // TODO: find better name
     VkSurfaceCapabilitiesKHR capabilities;
     ge1::unique_span<swapchain_frame> swapchain_frames;
     VkExtent2D extent;
+    VkPresentModeKHR present_mode;
     VkSwapchainKHR swapchain;
-    VkViewport viewport;
-    VkRect2D scissors;
 };
 
 void create_display_size(
     int framebuffer_width, int framebuffer_height,
     VkDevice device,
-    VkPhysicalDevice physical_device,
-    uint32_t graphics_queue_family, uint32_t present_queue_family,
+    VkPhysicalDevice physical_device, memory_tracker& tracker,
+    const queue_families& queue_families,
     VkSurfaceKHR surface, VkSurfaceFormatKHR surface_format,
-    VkCommandPool command_pool, scene scene,
-    VkRenderPass render_pass, VkPipeline pipeline,
-    display_size& display_size
+    VkCommandPool present_command_pool,
+    const render_graph& graph, uint32_t swapchain_image,
+    const occlusion_pipeline& occlusion,
+    uint32_t depth_image, uint32_t pyramid_image,
+    const render_settings& settings, display_size& display_size
 ) {
     // NOTE: capabilities change with window size
     vkGetPhysicalDeviceSurfaceCapabilitiesKHR(
         physical_device, surface, &display_size.capabilities
     );
 
-    display_size.swapchain_frames = ge1::unique_span<swapchain_frame>(
-        display_size.capabilities.minImageCount
+    // at least one image per frame in flight, so that there is always an
+    // image for the frame being recorded
+    auto requested_count = max(
+        display_size.capabilities.minImageCount, settings.frames_in_flight
     );
+    if (display_size.capabilities.maxImageCount != 0) {
+        requested_count =
+            min(requested_count, display_size.capabilities.maxImageCount);
+    }
+    display_size.swapchain_frames =
+        ge1::unique_span<swapchain_frame>(requested_count);
 
-    auto present_mode = VK_PRESENT_MODE_FIFO_KHR;
+    display_size.present_mode = settings.present_mode;
     display_size.extent = {
         max(
             min<uint32_t>(
@@ -195,10 +750,12 @@ void create_display_size(
         )
     };
 
+    // images are owned by one queue family at a time, if graphics and present
+    // families differ, ownership is transferred explicitly after rendering
+    bool transfer_ownership =
+        queue_families.graphics != queue_families.present;
+
     {
-        uint32_t queue_family_indices[]{
-            graphics_queue_family, present_queue_family
-        };
         VkSwapchainCreateInfoKHR create_info{
             .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
             .surface = surface,
@@ -207,13 +764,20 @@ void create_display_size(
             .imageColorSpace = surface_format.colorSpace,
             .imageExtent = display_size.extent,
             .imageArrayLayers = 1,
-            .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-            .imageSharingMode = VK_SHARING_MODE_CONCURRENT,
-            .queueFamilyIndexCount = size(queue_family_indices),
-            .pQueueFamilyIndices = queue_family_indices,
+            // transfer source for frame captures and destination of the
+            // scaled scene, if supported
+            .imageUsage =
+                VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                (
+                    display_size.capabilities.supportedUsageFlags & (
+                        VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+                        VK_IMAGE_USAGE_TRANSFER_DST_BIT
+                    )
+                ),
+            .imageSharingMode = VK_SHARING_MODE_EXCLUSIVE,
             .preTransform = display_size.capabilities.currentTransform,
             .compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
-            .presentMode = present_mode,
+            .presentMode = display_size.present_mode,
             .clipped = VK_TRUE,
             .oldSwapchain = VK_NULL_HANDLE,
         };
@@ -222,20 +786,6 @@ void create_display_size(
         );
     }
 
-    // viewport
-    display_size.viewport = {
-        .x = 0.0f,
-        .y = 0.0f,
-        .width = static_cast<float>(display_size.extent.width),
-        .height = static_cast<float>(display_size.extent.height),
-        .minDepth = 0.0f,
-        .maxDepth = 1.0f,
-    };
-    display_size.scissors = {
-        .offset = {0, 0},
-        .extent = display_size.extent,
-    };
-
     // create swapchain frame data
     {
         uint32_t image_count;
@@ -246,19 +796,19 @@ void create_display_size(
         assert(image_count == display_size.swapchain_frames.size());
 
         // command buffers
-        auto commandBuffers = make_unique<VkCommandBuffer[]>(
+        auto present_command_buffers = make_unique<VkCommandBuffer[]>(
             display_size.swapchain_frames.size()
         );
-        {
+        if (transfer_ownership) {
             VkCommandBufferAllocateInfo allocate_info{
                 .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-                .commandPool = command_pool,
+                .commandPool = present_command_pool,
                 .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
                 .commandBufferCount = display_size.swapchain_frames.size(),
             };
             if (
                 vkAllocateCommandBuffers(
-                    device, &allocate_info, commandBuffers.get()
+                    device, &allocate_info, present_command_buffers.get()
                 ) != VK_SUCCESS
             ) {
                 throw runtime_error("failed to allocate command buffers");
@@ -272,96 +822,10 @@ void create_display_size(
         for (auto i = 0u; i < display_size.swapchain_frames.size(); i++) {
             auto& swapchain_frame = display_size.swapchain_frames[i];
             auto image = images[i];
-            swapchain_frame.command_buffer = commandBuffers[i];
-
-            // color image
-            {
-                VkImageCreateInfo image_info{
-                    .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
-                    .imageType = VK_IMAGE_TYPE_2D,
-                    .format = surface_format.format,
-                    .extent = {
-                        display_size.extent.width, display_size.extent.height, 1
-                    },
-                    .mipLevels = 1,
-                    .arrayLayers = 1,
-                    .samples = max_sample_count,
-                    .tiling = VK_IMAGE_TILING_OPTIMAL,
-                    .usage =
-                        VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT |
-                        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-                    .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
-                    .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-                };
-
-                if (
-                    vkCreateImage(
-                        device, &image_info, nullptr,
-                        &swapchain_frame.color_image
-                    ) != VK_SUCCESS
-                ) {
-                    throw std::runtime_error("failed to create image");
-                }
-
-                VkMemoryRequirements memory_requirements;
-                vkGetImageMemoryRequirements(
-                    device, swapchain_frame.color_image, &memory_requirements
-                );
-
-                swapchain_frame.color_memory = ge1::allocate_memory(
-                    device, physical_device, memory_requirements,
-                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
-                );
-
-                vkBindImageMemory(
-                    device, swapchain_frame.color_image,
-                    swapchain_frame.color_memory, 0
-                );
-            }
-
-            // depth image
-            {
-                VkImageCreateInfo image_info{
-                    .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
-                    .imageType = VK_IMAGE_TYPE_2D,
-                    .format = VK_FORMAT_D24_UNORM_S8_UINT,
-                    .extent = {
-                        display_size.extent.width, display_size.extent.height, 1
-                    },
-                    .mipLevels = 1,
-                    .arrayLayers = 1,
-                    .samples = max_sample_count,
-                    .tiling = VK_IMAGE_TILING_OPTIMAL,
-                    .usage =
-                        VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
-                    .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
-                    .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-                };
-
-                if (
-                    vkCreateImage(
-                        device, &image_info, nullptr,
-                        &swapchain_frame.depth_image
-                    ) != VK_SUCCESS
-                ) {
-                    throw std::runtime_error("failed to create image");
-                }
-
-                VkMemoryRequirements memory_requirements;
-                vkGetImageMemoryRequirements(
-                    device, swapchain_frame.depth_image, &memory_requirements
-                );
-
-                swapchain_frame.depth_memory = ge1::allocate_memory(
-                    device, physical_device, memory_requirements,
-                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
-                );
-
-                vkBindImageMemory(
-                    device, swapchain_frame.depth_image,
-                    swapchain_frame.depth_memory, 0
-                );
-            }
+            swapchain_frame.image = image;
+            swapchain_frame.present_command_buffer =
+                transfer_ownership ?
+                    present_command_buffers[i] : VK_NULL_HANDLE;
 
             // views
             {
@@ -383,165 +847,137 @@ void create_display_size(
                 );
             }
 
-            {
-                VkImageViewCreateInfo create_info{
-                    .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
-                    .image = swapchain_frame.color_image,
-                    .viewType = VK_IMAGE_VIEW_TYPE_2D,
-                    .format = surface_format.format,
-                    .subresourceRange{
-                        .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-                        .baseMipLevel = 0,
-                        .levelCount = 1,
-                        .baseArrayLayer = 0,
-                        .layerCount = 1,
-                    }
-                };
-                vkCreateImageView(
-                    device, &create_info, nullptr,
-                    &swapchain_frame.color_image_view
-                );
-            }
-
-            {
-                VkImageViewCreateInfo create_info{
-                    .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
-                    .image = swapchain_frame.depth_image,
-                    .viewType = VK_IMAGE_VIEW_TYPE_2D,
-                    .format = VK_FORMAT_D24_UNORM_S8_UINT,
-                    .subresourceRange{
-                        .aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT,
-                        .baseMipLevel = 0,
-                        .levelCount = 1,
-                        .baseArrayLayer = 0,
-                        .layerCount = 1,
-                    }
-                };
-                vkCreateImageView(
-                    device, &create_info, nullptr,
-                    &swapchain_frame.depth_image_view
-                );
-            }
-
-            // framebuffers
-            VkImageView attachments[] = {
-                swapchain_frame.color_image_view,
-                swapchain_frame.depth_image_view,
-                swapchain_frame.view
+            // transient images and framebuffers
+            render_graph_imported_image imported_images[]{
+                {swapchain_image, image, swapchain_frame.view},
             };
-            {
-                VkFramebufferCreateInfo create_info{
-                    .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
-                    .renderPass = render_pass,
-                    .attachmentCount = std::size(attachments),
-                    .pAttachments = attachments,
-                    .width = display_size.extent.width,
-                    .height = display_size.extent.height,
-                    .layers = 1,
-                };
+            create_render_graph_instance(
+                device, tracker, graph, display_size.extent,
+                imported_images, swapchain_frame.graph_instance
+            );
+            create_hiz_pyramid(
+                device, occlusion, swapchain_frame.graph_instance,
+                depth_image, pyramid_image, swapchain_frame.pyramid
+            );
 
+            if (transfer_ownership) {
+                auto present_command_buffer =
+                    swapchain_frame.present_command_buffer;
+                VkCommandBufferBeginInfo buffer_begin_info{
+                    .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+                };
                 if (
-                    vkCreateFramebuffer(
-                        device, &create_info, nullptr,
-                        &swapchain_frame.framebuffer
+                    vkBeginCommandBuffer(
+                        present_command_buffer, &buffer_begin_info
                     ) != VK_SUCCESS
                 ) {
-                    throw runtime_error("failed to create framebuffer");
+                    throw runtime_error(
+                        "failed to begin recording command buffer"
+                    );
+                }
+                acquire_ownership(
+                    present_command_buffer,
+                    present_ownership_transfer(queue_families, image)
+                );
+                if (
+                    vkEndCommandBuffer(present_command_buffer) != VK_SUCCESS
+                ) {
+                    throw runtime_error("failed to record command buffer");
                 }
-            }
-
-            // write commands
-            auto& command_buffer = swapchain_frame.command_buffer;
-            VkCommandBufferBeginInfo buffer_begin_info{
-                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-            };
-            if (
-                vkBeginCommandBuffer(
-                    command_buffer, &buffer_begin_info
-                ) != VK_SUCCESS
-            ) {
-                throw runtime_error("failed to begin recording command buffer");
-            }
-            VkClearValue clearValue[]{
-                {{{1.0f, 1.0f, 1.0f, 1.0f}}}, // color
-                {{{1.0f, 1.0f, 1.0f, 1.0f}}}, // depth
-            };
-            VkRenderPassBeginInfo render_pass_begin_info{
-                .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-                .renderPass = render_pass,
-                .framebuffer = swapchain_frame.framebuffer,
-                .renderArea{
-                    .offset = {0, 0},
-                    .extent = display_size.extent,
-                },
-                .clearValueCount = std::size(clearValue),
-                .pClearValues = clearValue,
-            };
-            vkCmdBeginRenderPass(
-                command_buffer, &render_pass_begin_info,
-                VK_SUBPASS_CONTENTS_INLINE
-            );
-
-            vkCmdBindPipeline(
-                command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                pipeline
-            );
-
-            vkCmdSetViewport(command_buffer, 0, 1, &display_size.viewport);
-            vkCmdSetScissor(command_buffer, 0, 1, &display_size.scissors);
-            VkBuffer vertex_buffers[] = {
-                scene.static_buffer, scene.static_buffer,
-            };
-            VkDeviceSize offsets[] = {
-                scene.vertex_offset, scene.instance_offset
-            };
-            vkCmdBindVertexBuffers(
-                command_buffer, 0,
-                size(vertex_buffers), vertex_buffers, offsets
-            );
-            vkCmdBindIndexBuffer(
-                command_buffer, scene.static_buffer, scene.face_offset,
-                VK_INDEX_TYPE_UINT32
-            );
-
-            vkCmdDrawIndexed(
-                command_buffer, scene.index_count, 1, 0, 0, 0
-            );
-            vkCmdEndRenderPass(command_buffer);
-
-            if (
-                vkEndCommandBuffer(command_buffer) != VK_SUCCESS
-            ) {
-                throw runtime_error("failed to record command buffer");
             }
         }
     }
+
+    auto& instance = display_size.swapchain_frames[0].graph_instance;
+    cout <<
+        "transient memory per frame: " << (instance.memory_size >> 10) <<
+        " KiB, peak alive " << (instance.peak_memory_size >> 10) <<
+        " KiB, without aliasing " << (instance.unaliased_memory_size >> 10) <<
+        " KiB" << endl;
 }
 
 void destroy_display_size(
-    VkDevice device,
-    const display_size& display_size
+    VkDevice device, memory_tracker& tracker,
+    VkCommandPool present_command_pool,
+    const render_graph& graph, const display_size& display_size
 ) {
     for (auto& swapchain_frame : display_size.swapchain_frames) {
-        vkDestroyFramebuffer(device, swapchain_frame.framebuffer, nullptr);
-    }
-
-    for (auto& swapchain_frame : display_size.swapchain_frames) {
+        destroy_hiz_pyramid(device, swapchain_frame.pyramid);
+        destroy_render_graph_instance(
+            device, tracker, graph, swapchain_frame.graph_instance
+        );
         vkDestroyImageView(device, swapchain_frame.view, nullptr);
-        vkDestroyImageView(device, swapchain_frame.color_image_view, nullptr);
-        vkDestroyImageView(device, swapchain_frame.depth_image_view, nullptr);
-        vkDestroyImage(device, swapchain_frame.color_image, nullptr);
-        vkDestroyImage(device, swapchain_frame.depth_image, nullptr);
-        vkFreeMemory(device, swapchain_frame.color_memory, nullptr);
-        vkFreeMemory(device, swapchain_frame.depth_memory, nullptr);
+        if (swapchain_frame.present_command_buffer != VK_NULL_HANDLE) {
+            vkFreeCommandBuffers(
+                device, present_command_pool, 1,
+                &swapchain_frame.present_command_buffer
+            );
+        }
     }
 
     vkDestroySwapchainKHR(device, display_size.swapchain, nullptr);
 }
 
-int main() {
+// from the command line, see main
+struct launch_options {
+    const char* scene_path;
+    uint32_t stream_pages;
+    float impostor_distance;
+    // number of poses each mesh is skinned into every frame, 0 for static
+    // meshes
+    uint32_t skin_poses;
+    // of the resident levels of streamed textures, in MiB
+    uint32_t texture_budget;
+    // uses render passes even if dynamic rendering is supported
+    bool render_pass;
+    // null for the settings stored for the device in tuning_path, or the
+    // defaults if there are none
+    const render_settings* settings;
+    bool stored_settings;
+    // closes the window after this many frames after the warm up, 0 to run
+    // until it is closed
+    uint32_t tuning_frames;
+};
+
+// what the device supports and how the run went
+struct launch_report {
+    uint8_t device_uuid[VK_UUID_SIZE];
+    VkSampleCountFlags sample_counts;
+    vector<VkPresentModeKHR> present_modes;
+    // whether the scene can be rendered at a lower resolution
+    bool scaling;
+    render_settings settings;
+    // means of the tuning frames, in milliseconds, gpu_time is negative if
+    // the queue has no timestamps
+    float frame_time;
+    float gpu_time;
+};
+
+static const char* tuning_path = "tuning.txt";
+static const char* pipeline_cache_path = "pipeline_cache.bin";
+
+static void log_settings(const render_settings& settings) {
+    cout <<
+        settings.samples << "x msaa, " << settings.frames_in_flight <<
+        " frames in flight, " <<
+        get_present_mode_name(settings.present_mode) << ", " <<
+        settings.resolution_scale * 100 << "% scale";
+}
+
+// opens the window, renders until it is closed and cleans up again
+static void run(const launch_options& options, launch_report& report) {
+    auto scene_path = options.scene_path;
+    auto stream_pages = options.stream_pages;
+    auto impostor_distance = options.impostor_distance;
+    // streamed meshes are not always resident, so they can't be skinned
+    auto skin_poses = stream_pages > 0 ? 0 : options.skin_poses;
+
     glfwInit();
 
+    // the main thread is worker 0
+    job_system jobs;
+    create_job_system(jobs);
+
     unsigned windowWidth = 1280, windowHeight = 720;
 
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
@@ -570,7 +1006,7 @@ int main() {
         .applicationVersion = VK_MAKE_VERSION(1, 0, 0),
         .pEngineName = "No Engine",
         .engineVersion = VK_MAKE_VERSION(1, 0, 0),
-        .apiVersion = VK_API_VERSION_1_0
+        .apiVersion = VK_API_VERSION_1_2
     };
 
     // look up extensions needed by GLFW
@@ -698,92 +1134,170 @@ int main() {
         physical_device = devices[0]; // just pick the first one for now
     }
 
-    // get properties of physical device
-    max_sample_count = VK_SAMPLE_COUNT_1_BIT;
+    // get properties of physical device, by default the solid passes use
+    // the highest sample count
+    sample_count = VK_SAMPLE_COUNT_1_BIT;
     {
-        VkPhysicalDeviceProperties physical_device_properties;
-        vkGetPhysicalDeviceProperties(
+        VkPhysicalDeviceIDProperties id_properties{
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES,
+        };
+        VkPhysicalDeviceProperties2 physical_device_properties{
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+            .pNext = &id_properties,
+        };
+        vkGetPhysicalDeviceProperties2(
             physical_device, &physical_device_properties
         );
+        copy(
+            id_properties.deviceUUID, id_properties.deviceUUID + VK_UUID_SIZE,
+            report.device_uuid
+        );
 
-        VkSampleCountFlags sample_count_falgs =
-            physical_device_properties.limits.framebufferColorSampleCounts &
-            physical_device_properties.limits.framebufferDepthSampleCounts &
-            physical_device_properties.limits.framebufferStencilSampleCounts;
+        auto& limits = physical_device_properties.properties.limits;
+        report.sample_counts =
+            limits.framebufferColorSampleCounts &
+            limits.framebufferDepthSampleCounts &
+            limits.framebufferStencilSampleCounts &
+            // the Hi-Z pyramid samples the multisampled depth image
+            limits.sampledImageDepthSampleCounts;
 
         for (auto bit : {
             VK_SAMPLE_COUNT_64_BIT, VK_SAMPLE_COUNT_32_BIT,
             VK_SAMPLE_COUNT_16_BIT, VK_SAMPLE_COUNT_8_BIT,
             VK_SAMPLE_COUNT_4_BIT, VK_SAMPLE_COUNT_2_BIT,
         }) {
-            if (sample_count_falgs & bit) {
-                max_sample_count = bit;
+            if (report.sample_counts & bit) {
+                sample_count = bit;
                 break;
             }
         }
     }
-    assert(max_sample_count != VK_SAMPLE_COUNT_1_BIT);
-    std::cout << max_sample_count << std::endl;
+    assert(sample_count != VK_SAMPLE_COUNT_1_BIT);
 
     // look for available queue families
-    uint32_t queueFamilyCount = 0;
-    vkGetPhysicalDeviceQueueFamilyProperties(
-        physical_device, &queueFamilyCount, nullptr
-    );
-    auto queueFamilies =
-        make_unique<VkQueueFamilyProperties[]>(queueFamilyCount);
-    vkGetPhysicalDeviceQueueFamilyProperties(
-        physical_device, &queueFamilyCount, queueFamilies.get()
-    );
+    auto queue_families = find_queue_families(physical_device, surface);
 
-    uint32_t graphicsQueueFamily = -1u, presentQueueFamily = -1u;
-    for (auto i = 0u; i < queueFamilyCount; i++) {
-        const auto& queueFamily = queueFamilies[i];
-        if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
-            graphicsQueueFamily = i;
-        }
-
-        VkBool32 presentSupport = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(
-            physical_device, i, surface, &presentSupport
-        );
-        if (presentSupport) {
-            presentQueueFamily = i;
-        }
-    }
-    if (graphicsQueueFamily == -1u) {
-        throw runtime_error("no suitable queue found");
-    }
+    // check for required features
+    VkPhysicalDeviceVulkan12Features supported_vulkan_12_features{
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+    };
+    VkPhysicalDeviceFeatures2 supported_features{
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &supported_vulkan_12_features,
+    };
+    vkGetPhysicalDeviceFeatures2(physical_device, &supported_features);
+    if (!supported_vulkan_12_features.timelineSemaphore) {
+        throw runtime_error("timeline semaphores not supported");
+    }
+    // without it every indirect draw is a separate call
+    bool multi_draw_indirect =
+        supported_features.features.multiDrawIndirect;
+    // without it the budget is the heap size
+    bool memory_budget = supports_memory_budget(physical_device);
+    // without it meshlets are culled on the CPU and drawn indirectly.
+    // Meshlet buffers index the vertices of the whole mesh, which aren't
+    // resident when streaming.
+    bool mesh_shader =
+        supports_mesh_shader(physical_device) && stream_pages == 0;
+    // without it every pipeline is compiled on a background thread, even if
+    // it is in the pipeline cache
+    bool pipeline_cache_control =
+        supports_pipeline_cache_control(physical_device);
+    // without it the render graph creates render passes and framebuffers
+    bool dynamic_rendering =
+        supports_dynamic_rendering(physical_device) && !options.render_pass;
 
     // create queues and logical device
     VkDevice device;
     {
-        float priority = 1.0f;
-        VkDeviceQueueCreateInfo queueCreateInfos[]{
-            {
-                .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-                .queueFamilyIndex = graphicsQueueFamily,
-                .queueCount = 1,
-                .pQueuePriorities = &priority,
-            }, {
-                .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-                .queueFamilyIndex = presentQueueFamily,
-                .queueCount = 1,
-                .pQueuePriorities = &priority,
-            }
-        };
+        VkDeviceQueueCreateInfo queueCreateInfos[4];
+        auto queueCreateInfoCount =
+            get_queue_create_infos(queue_families, queueCreateInfos);
 
-        const char* enabledExtensionNames[] = {
+        vector<const char*> enabledExtensionNames{
             VK_KHR_SWAPCHAIN_EXTENSION_NAME,
         };
+        if (memory_budget) {
+            enabledExtensionNames.push_back(
+                VK_EXT_MEMORY_BUDGET_EXTENSION_NAME
+            );
+        }
+        if (mesh_shader) {
+            enabledExtensionNames.push_back(
+                VK_EXT_MESH_SHADER_EXTENSION_NAME
+            );
+        }
+        if (pipeline_cache_control) {
+            enabledExtensionNames.push_back(
+                VK_EXT_PIPELINE_CREATION_CACHE_CONTROL_EXTENSION_NAME
+            );
+        }
+        if (dynamic_rendering) {
+            enabledExtensionNames.push_back(
+                VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME
+            );
+            enabledExtensionNames.push_back(
+                VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME
+            );
+        }
 
-        VkPhysicalDeviceFeatures deviceFeatures{};
+        VkPhysicalDevicePipelineCreationCacheControlFeaturesEXT
+            cache_control_features{
+                .sType =
+                    VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PIPELINE_CREATION_CACHE_CONTROL_FEATURES_EXT,
+                .pipelineCreationCacheControl = VK_TRUE,
+            };
+        void* optional_features =
+            pipeline_cache_control ? &cache_control_features : nullptr;
+        VkPhysicalDeviceSynchronization2FeaturesKHR synchronization2_features{
+            .sType =
+                VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR,
+            .pNext = optional_features,
+            .synchronization2 = VK_TRUE,
+        };
+        VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamic_rendering_features{
+            .sType =
+                VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR,
+            .pNext = &synchronization2_features,
+            .dynamicRendering = VK_TRUE,
+        };
+        if (dynamic_rendering) {
+            optional_features = &dynamic_rendering_features;
+        }
+        VkPhysicalDeviceMeshShaderFeaturesEXT mesh_shader_features{
+            .sType =
+                VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT,
+            .pNext = optional_features,
+            .taskShader = VK_TRUE,
+            .meshShader = VK_TRUE,
+        };
+        if (mesh_shader) {
+            optional_features = &mesh_shader_features;
+        }
+        VkPhysicalDeviceVulkan12Features vulkan_12_features{
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+            .pNext = optional_features,
+            .timelineSemaphore = VK_TRUE,
+        };
+        enable_bindless_features(
+            supported_vulkan_12_features, vulkan_12_features
+        );
+        // without them the texture stream decodes blocks on the CPU
+        VkPhysicalDeviceFeatures deviceFeatures{
+            .multiDrawIndirect = multi_draw_indirect,
+            .textureCompressionETC2 =
+                supported_features.features.textureCompressionETC2,
+            .textureCompressionBC =
+                supported_features.features.textureCompressionBC,
+        };
         VkDeviceCreateInfo createInfo{
             .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-            .queueCreateInfoCount = size(queueCreateInfos),
+            .pNext = &vulkan_12_features,
+            .queueCreateInfoCount = queueCreateInfoCount,
             .pQueueCreateInfos = queueCreateInfos,
-            .enabledExtensionCount = size(enabledExtensionNames),
-            .ppEnabledExtensionNames = enabledExtensionNames,
+            .enabledExtensionCount =
+                static_cast<uint32_t>(enabledExtensionNames.size()),
+            .ppEnabledExtensionNames = enabledExtensionNames.data(),
             .pEnabledFeatures = &deviceFeatures
         };
 
@@ -796,9 +1310,12 @@ int main() {
     }
 
     // retreive queues
-    VkQueue graphicsQueue, presentQueue;
-    vkGetDeviceQueue(device, graphicsQueueFamily, 0, &graphicsQueue);
-    vkGetDeviceQueue(device, presentQueueFamily, 0, &presentQueue);
+    auto queues = create_queues(device, queue_families);
+
+    // all device memory is allocated through the tracker
+    memory_tracker tracker;
+    create_memory_tracker(physical_device, memory_budget, tracker);
+    auto memory_log_time = chrono::steady_clock::now();
 
     // create swap chains
     uint32_t formatCount = 0, presentModeCount = 0;
@@ -835,23 +1352,101 @@ int main() {
         }
     }
 
+    // a lower resolution scene is blitted to the swapchain image
+    {
+        VkSurfaceCapabilitiesKHR capabilities;
+        vkGetPhysicalDeviceSurfaceCapabilitiesKHR(
+            physical_device, surface, &capabilities
+        );
+        VkFormatProperties format_properties;
+        vkGetPhysicalDeviceFormatProperties(
+            physical_device, surfaceFormat.format, &format_properties
+        );
+        VkFormatFeatureFlags blit_features =
+            VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+            VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+        report.scaling =
+            (
+                capabilities.supportedUsageFlags &
+                VK_IMAGE_USAGE_TRANSFER_DST_BIT
+            ) && (
+                format_properties.optimalTilingFeatures & blit_features
+            ) == blit_features;
+    }
+    report.present_modes.assign(
+        presentModes.get(), presentModes.get() + presentModeCount
+    );
+
+    // settings from the command line, stored by the tuner or defaults,
+    // stored settings may be from an older driver
+    report.settings = {
+        .samples = sample_count,
+        .frames_in_flight = 2,
+        .present_mode = VK_PRESENT_MODE_FIFO_KHR,
+        .resolution_scale = 1,
+    };
+    if (options.settings) {
+        report.settings = *options.settings;
+    } else if (
+        options.stored_settings &&
+        read_tuning(tuning_path, report.device_uuid, report.settings)
+    ) {
+        cout << "Tuned settings: ";
+        log_settings(report.settings);
+        cout << endl;
+    }
+    auto& settings = report.settings;
+    if (!(report.sample_counts & settings.samples)) {
+        settings.samples = sample_count;
+    }
+    if (
+        find(
+            report.present_modes.begin(), report.present_modes.end(),
+            settings.present_mode
+        ) == report.present_modes.end()
+    ) {
+        settings.present_mode = VK_PRESENT_MODE_FIFO_KHR;
+    }
+    if (!report.scaling) {
+        settings.resolution_scale = 1;
+    }
+    sample_count = settings.samples;
+
     // load shaders
     VkShaderModule
         vertex_shader_module = ge1::create_shader_module(device, {
             &_binary_shaders_solid_vertex_glsl_spv_start,
             &_binary_shaders_solid_vertex_glsl_spv_end
         }),
+        pulled_vertex_shader_module = ge1::create_shader_module(device, {
+            &_binary_shaders_solid_pulled_vertex_glsl_spv_start,
+            &_binary_shaders_solid_pulled_vertex_glsl_spv_end
+        }),
         fragment_shader_module = ge1::create_shader_module(device, {
             &_binary_shaders_solid_fragment_glsl_spv_start,
             &_binary_shaders_solid_fragment_glsl_spv_end
         });
+    VkShaderModule
+        task_shader_module = VK_NULL_HANDLE,
+        mesh_shader_module = VK_NULL_HANDLE;
+    if (mesh_shader) {
+        task_shader_module = ge1::create_shader_module(device, {
+            &_binary_shaders_solid_task_glsl_spv_start,
+            &_binary_shaders_solid_task_glsl_spv_end
+        });
+        mesh_shader_module = ge1::create_shader_module(device, {
+            &_binary_shaders_solid_mesh_glsl_spv_start,
+            &_binary_shaders_solid_mesh_glsl_spv_end
+        });
+    }
 
-    // create command pool
-    VkCommandPool commandPool;
+    // create command pools
+    VkCommandPool commandPool, presentCommandPool;
     {
         VkCommandPoolCreateInfo createInfo{
             .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
-            .queueFamilyIndex = graphicsQueueFamily,
+            .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+            .queueFamilyIndex = queue_families.graphics,
         };
         if (
             vkCreateCommandPool(device, &createInfo, nullptr, &commandPool) !=
@@ -859,87 +1454,907 @@ int main() {
         ) {
             throw runtime_error("failed to create command pool");
         }
+        createInfo.queueFamilyIndex = queue_families.present;
+        if (
+            vkCreateCommandPool(
+                device, &createInfo, nullptr, &presentCommandPool
+            ) != VK_SUCCESS
+        ) {
+            throw runtime_error("failed to create command pool");
+        }
     }
 
-    // camera
-    {
-        auto matrix = glm::perspectiveFov<float>(
-            30.f, windowWidth, windowHeight, 0.1, 100
-        );
-        matrix = matrix * glm::lookAt(
-            glm::vec3{0, -1, 1}, {0, 0, 1}, {0, 0, 1}
-        );
-        copy(
-            glm::value_ptr(matrix), glm::value_ptr(matrix) + 16,
-            matrices
-        );
+    // scene file from the command line, or one instance of the built-in
+    // mesh
+    scene_description description;
+    if (scene_path) {
+        read_scene(scene_path, description);
+    } else {
+        description.meshes.push_back("miku");
+        description.nodes.push_back({
+            .parent = no_scene_node,
+            .mesh = 0,
+            .material = 0,
+            .translation = {0, 0, 0},
+            .rotation = {0, 0, 0, 1},
+            .scale = {1, 1, 1},
+        });
     }
+    cout <<
+        "Scene: " << description.nodes.size() << " nodes, " <<
+        description.lights.size() << " lights, " <<
+        get_camera_path_duration(description) << " s camera path" << endl;
 
-    // create buffers for geometry
+    unsigned frames_in_flight = settings.frames_in_flight;
+
+    // create buffers for geometry, with room for the stream pages and the
+    // skinned copies of the built in mesh
     scene scene;
-    auto vertex_buffer_size =
-        sizeof(float) * (
+    uint64_t pose_count = uint64_t(skin_poses) * description.meshes.size();
+    create_geometry_arena(
+        device, tracker, vertex_binding_descriptions[vertices].stride,
+        (1 << 20) + stream_pages * stream_page_vertices + pose_count * (
             &_binary_models_miku_vertices_vbo_end -
             &_binary_models_miku_vertices_vbo_start
-        ) + sizeof(unsigned) * (
+        ) * sizeof(float) / vertex_binding_descriptions[vertices].stride,
+        (1 << 22) + stream_pages * stream_page_indices + pose_count * (
             &_binary_models_miku_faces_vbo_end -
             &_binary_models_miku_faces_vbo_start
-        ) + sizeof(matrices);
-    VkBuffer vertex_buffer;
+        ),
+        scene.geometry
+    );
+    if (stream_pages > 0) {
+        create_geometry_stream(
+            scene.geometry, "geometry_stream.tmp", stream_pages,
+            frames_in_flight, scene.stream
+        );
+    }
+    // mesh id of each mesh of the description
+    vector<uint32_t> mesh_ids;
+    for (auto& name : description.meshes) {
+        // the only mesh that is built in
+        if (name != "miku") {
+            throw runtime_error("unknown mesh in scene file");
+        }
+        auto vertices = span(
+            (const char*)&_binary_models_miku_vertices_vbo_start,
+            (const char*)&_binary_models_miku_vertices_vbo_end
+        );
+        auto faces = span(
+            &_binary_models_miku_faces_vbo_start,
+            &_binary_models_miku_faces_vbo_end
+        );
+        // the arena gets the triangles in meshlet order, so that each
+        // meshlet can also be drawn as a range of the index buffer
+        meshlet_mesh meshlets;
+        build_meshlets(
+            span(
+                &_binary_models_miku_vertices_vbo_start,
+                &_binary_models_miku_vertices_vbo_end
+            ),
+            scene.geometry.vertex_stride / sizeof(float), faces, meshlets
+        );
+        auto mesh = stream_pages > 0 ?
+            add_stream_mesh(
+                scene.stream, scene.geometry,
+                span(
+                    &_binary_models_miku_vertices_vbo_start,
+                    &_binary_models_miku_vertices_vbo_end
+                ),
+                get_meshlet_indices(meshlets), meshlets
+            ) :
+            add_mesh(
+                scene.geometry, vertices, get_meshlet_indices(meshlets)
+            );
+        cout <<
+            "Mesh " << mesh << ": " << faces.size() / 3 << " triangles in " <<
+            meshlets.meshlets.size() << " meshlets" << endl;
+        scene.meshlets.resize(mesh + 1);
+        scene.meshlets[mesh] = std::move(meshlets);
+        scene.mesh_bvhs.resize(mesh + 1);
+        build_mesh_bvh(
+            span(
+                &_binary_models_miku_vertices_vbo_start,
+                &_binary_models_miku_vertices_vbo_end
+            ),
+            scene.geometry.vertex_stride / sizeof(float), faces,
+            scene.mesh_bvhs[mesh]
+        );
+        mesh_ids.push_back(mesh);
+    }
+
+    // instances are grouped by mesh, so that each mesh is one draw
+    vector<uint32_t> node_instances(description.nodes.size(), no_instance);
+    for (auto m = 0u; m < mesh_ids.size(); m++) {
+        mesh_draw draw{
+            .mesh = mesh_ids[m],
+            .instance_count = 0,
+            .first_instance = uint32_t(scene.instances.size()),
+        };
+        for (auto n = 0u; n < description.nodes.size(); n++) {
+            auto& node = description.nodes[n];
+            if (node.mesh != m) {
+                continue;
+            }
+            if (node.material >= material_count) {
+                throw runtime_error("material out of range in scene file");
+            }
+            node_instances[n] = scene.instances.size();
+            scene.instances.push_back({.material = node.material});
+            draw.instance_count++;
+        }
+        if (draw.instance_count > 0) {
+            scene.draws.push_back(draw);
+        }
+    }
+    scene.fades.resize(scene.instances.size(), 0);
+
+    // node ids are the indices in the description, the world matrices don't
+    // depend on the camera, so only animated subtrees are recomputed
+    transform_hierarchy transforms;
+    for (auto n = 0u; n < description.nodes.size(); n++) {
+        auto& node = description.nodes[n];
+        add_node(transforms, node.parent, node_instances[n]);
+        auto& t = node.translation;
+        auto& r = node.rotation;
+        auto& s = node.scale;
+        set_translation(transforms, n, t[0], t[1], t[2]);
+        set_rotation(transforms, n, r[0], r[1], r[2], r[3]);
+        set_scale(transforms, n, s[0], s[1], s[2]);
+    }
+    auto instance_buffer_size = sizeof(instance_data) * scene.instances.size();
+
+    // world matrices without the camera, later updates only write the
+    // nodes that changed. The draws still have the meshes of the scene file
+    // before skinning.
+    {
+        glm::mat4 identity(1);
+        update_transforms(
+            transforms, glm::value_ptr(identity), scene.instances.data(),
+            sizeof(instance_data)
+        );
+        vector<uint32_t> instance_meshes(scene.instances.size());
+        for (auto& draw : scene.draws) {
+            fill_n(
+                instance_meshes.begin() + draw.first_instance,
+                draw.instance_count, draw.mesh
+            );
+        }
+        build_scene_bvh(
+            scene.mesh_bvhs, instance_meshes, scene.instances.data(),
+            sizeof(instance_data), scene.picking
+        );
+    }
+
+    auto material_buffer_size = sizeof(material) * material_count;
+    VkBuffer material_buffer;
     {
         VkBufferCreateInfo create_info{
             .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-            .size = vertex_buffer_size,
-            .usage =
-                VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
-                VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+            .size = material_buffer_size,
+            .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
             .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
         };
         if (
-            vkCreateBuffer(device, &create_info, nullptr, &vertex_buffer) !=
-            VK_SUCCESS
+            vkCreateBuffer(
+                device, &create_info, nullptr, &material_buffer
+            ) != VK_SUCCESS
         ) {
-            throw runtime_error("failed to create vertex buffer");
+            throw runtime_error("failed to create material buffer");
         }
     }
 
-    VkDeviceMemory vertex_memory = ge1::allocate_memory(
-        device, physical_device, vertex_buffer,
+    VkDeviceMemory material_memory = allocate_tracked_memory(
+        device, tracker, material_buffer,
         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        memory_tag::instances
     );
-    vkBindBufferMemory(device, vertex_buffer, vertex_memory, 0);
+    vkBindBufferMemory(device, material_buffer, material_memory, 0);
 
+    // stays mapped, the texture slots of textured materials change while
+    // their levels are streamed in
+    material* materials;
     {
         void* data;
-        vkMapMemory(device, vertex_memory, 0, vertex_buffer_size, 0, &data);
-        void* iterator = data;
-        scene.vertex_offset = 0;
-        iterator = std::copy(
-            &_binary_models_miku_vertices_vbo_start,
-            &_binary_models_miku_vertices_vbo_end, (float*)iterator
+        vkMapMemory(
+            device, material_memory, 0, material_buffer_size, 0, &data
         );
-        scene.face_offset = (char*)iterator - (char*)data;
-        iterator = std::copy(
-            &_binary_models_miku_faces_vbo_start,
-            &_binary_models_miku_faces_vbo_end, (unsigned*)iterator
+        materials = (material*)data;
+        parallel_for(
+            jobs, material_count, 256, [&](uint32_t begin, uint32_t end) {
+                for (auto i = begin; i < end; i++) {
+                    materials[i] = generate_material(i);
+                }
+            }
+        );
+    }
+    // material i uses texture i modulo the texture count, untextured until
+    // its tail is resident
+    bool textured = !description.textures.empty();
+    if (textured) {
+        create_texture_stream(
+            device, physical_device, queues.graphics, queues.transfer,
+            description.textures, VkDeviceSize(options.texture_budget) << 20,
+            frames_in_flight, scene.textures
         );
-        scene.instance_offset = (char*)iterator - (char*)data;
-        memcpy(
-            (char*)iterator,
-            matrices, sizeof(matrices)
+        // the other allocations are made up front or are small
+        tracker.evictors.push_back(
+            [&textures = scene.textures](uint32_t heap, VkDeviceSize size) {
+                return shrink_texture_budget(textures, heap, size);
+            }
         );
-        vkUnmapMemory(device, vertex_memory);
+        cout <<
+            "Textures: " << description.textures.size() << " streamed, " <<
+            scene.textures.stats.decoded_textures << " decoded on the CPU" <<
+            endl;
     }
-    scene.static_buffer = vertex_buffer;
-    scene.index_count =
-        &_binary_models_miku_faces_vbo_end -
-        &_binary_models_miku_faces_vbo_start;
 
-    // create pipeline
-    VkRenderPass render_pass;
+    // create frame data
+    ge1::unique_span<frame_semaphores> frames(frames_in_flight);
+    for (auto i = 0u; i < frames.size(); i++) {
+        auto& frame = frames[i];
+        frame.binds = {};
+        create_frame_arena(64 << 10, frame.arena);
+
+        // create semaphores
+        VkSemaphoreCreateInfo semaphore_create_info{
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        };
+        VkFenceCreateInfo fence_create_info{
+            .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+            .flags = VK_FENCE_CREATE_SIGNALED_BIT,
+        };
+        if (
+            vkCreateSemaphore(
+                device, &semaphore_create_info, nullptr,
+                &frame.image_available_semaphore
+            ) != VK_SUCCESS ||
+            vkCreateSemaphore(
+                device, &semaphore_create_info, nullptr,
+                &frame.render_finished_semaphore
+            ) != VK_SUCCESS ||
+            vkCreateSemaphore(
+                device, &semaphore_create_info, nullptr,
+                &frame.present_ready_semaphore
+            ) != VK_SUCCESS ||
+            vkCreateFence(
+                device, &fence_create_info, nullptr, &frame.ready_fence
+            )
+        ) {
+            throw runtime_error("failed to create synchronisation objects");
+        }
+
+        VkCommandBufferAllocateInfo allocate_info{
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = commandPool,
+            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            .commandBufferCount = 1,
+        };
+        if (
+            vkAllocateCommandBuffers(
+                device, &allocate_info, &frame.command_buffer
+            ) != VK_SUCCESS
+        ) {
+            throw runtime_error("failed to allocate command buffers");
+        }
+
+        create_mapped_buffer(
+            device, tracker, memory_tag::instances, instance_buffer_size,
+            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            frame.instances
+        );
+        create_indirect_buffer(
+            device, tracker, max_draws, frame.draw_commands
+        );
+        create_hud_buffer(device, tracker, max_hud_quads, frame.hud);
+        create_gpu_timer(
+            device, physical_device, queue_families.graphics, frame.timer
+        );
+    }
+
+    unsigned frame_index = 0;
+
+    // create bindless descriptor set
+    bindless_set bindless;
+    create_bindless_set(device, physical_device, 1024, 4096, bindless);
+    if (
+        add_buffer(
+            device, bindless, material_buffer, 0, material_buffer_size
+        ) != bindless_material_buffer
+    ) {
+        throw runtime_error("material buffer not in expected slot");
+    }
+
+    // with skin=<poses> the meshes are rigged and skinned into up to that
+    // many poses every frame, the instances of each mesh are split evenly
+    // between its poses. The poses are meshes in the arena, so every vertex
+    // path draws them like static meshes.
+    skin_pipeline skin;
+    uint32_t skinned_poses = 0;
+    uint64_t skinned_vertices = 0;
+    if (skin_poses > 0) {
+        create_skin_pipeline(device, bindless, skin);
+        vector<mesh_draw> draws;
+        for (auto& draw : scene.draws) {
+            // a copy, reserving the poses adds meshes
+            auto source = scene.geometry.meshes[draw.mesh];
+            auto stride =
+                uint32_t(scene.geometry.vertex_stride / sizeof(float));
+            auto vertices = span(
+                (const float*)scene.geometry.vertex_buffer.data +
+                    uint64_t(source.vertex_offset) * stride,
+                uint64_t(source.vertex_count) * stride
+            );
+            mesh_animation animation;
+            vector<uint32_t> weights;
+            auto axis = create_chain_skeleton(
+                vertices, stride, skin_joints, animation.skeleton, weights
+            );
+            for (auto i = 0u; i < 2; i++) {
+                float bend_axis[3]{};
+                bend_axis[(axis + 1 + i) % 3] = 1;
+                create_wave_clip(
+                    animation.skeleton, bend_axis, skin_amplitude,
+                    skin_duration, skin_keys, animation.clips[i]
+                );
+            }
+            // no pose without instances
+            auto pose_count = min(skin_poses, draw.instance_count);
+            auto margin = get_skinning_margin(
+                jobs, animation, pose_count, vertices, stride, weights
+            );
+
+            // reserving the poses may move the source vertices
+            skinned_mesh mesh;
+            create_skinned_mesh(
+                device, tracker, bindless, scene.geometry, draw.mesh, weights,
+                skin_joints, pose_count, mesh
+            );
+            auto meshlets = scene.meshlets[draw.mesh];
+            loosen_meshlets(meshlets, margin);
+            for (auto p = 0u; p < pose_count; p++) {
+                auto pose = mesh.poses[p];
+                scene.meshlets.resize(max(
+                    scene.meshlets.size(), size_t(pose) + 1
+                ));
+                scene.meshlets[pose] = meshlets;
+                auto begin = draw.instance_count * p / pose_count;
+                auto end = draw.instance_count * (p + 1) / pose_count;
+                draws.push_back({
+                    .mesh = pose,
+                    .instance_count = end - begin,
+                    .first_instance = draw.first_instance + begin,
+                });
+            }
+            cout <<
+                "Mesh " << draw.mesh << ": skinned into " << pose_count <<
+                " poses, bounds grown by " << margin << endl;
+            skinned_poses += pose_count;
+            skinned_vertices += uint64_t(source.vertex_count) * pose_count;
+            scene.skinned_meshes.push_back(std::move(mesh));
+            scene.animations.push_back(std::move(animation));
+        }
+        scene.draws = std::move(draws);
+        for (auto& frame : frames) {
+            create_palette_buffer(
+                device, tracker, bindless,
+                get_palette_size(scene.skinned_meshes), frame.palettes
+            );
+            create_gpu_timer(
+                device, physical_device, queue_families.graphics,
+                frame.skin_timer
+            );
+        }
+    }
+
+    // instances are tested against the depth of the instances that passed
+    // the last test, F2 toggles the test
+    occlusion_pipeline occlusion;
+    create_occlusion_pipeline(device, bindless, occlusion);
+    bool occlusion_culling = true;
+    for (auto& frame : frames) {
+        // the occlusion test and the mesh shaders read instances from the
+        // bindless set
+        frame.instance_slot = add_buffer(
+            device, bindless, frame.instances.buffer, 0, instance_buffer_size
+        );
+        frame.draw_command_slot = add_buffer(
+            device, bindless, frame.draw_commands.buffer.buffer, 0,
+            frame.draw_commands.buffer.size
+        );
+        create_occlusion_buffer(
+            device, tracker, bindless, scene.instances.size(),
+            frame.occlusion
+        );
+        if (impostor_distance > 0) {
+            create_impostor_buffer(
+                device, tracker, bindless, scene.instances.size(),
+                frame.impostors
+            );
+        }
+        for (auto& draw : scene.draws) {
+            float sphere[4];
+            get_mesh_bounds(scene.meshlets[draw.mesh], sphere);
+            for (auto i = 0u; i < draw.instance_count; i++) {
+                copy(
+                    sphere, sphere + 4,
+                    frame.occlusion.bounds + (draw.first_instance + i) * 4
+                );
+            }
+        }
+    }
+    // set for the frame being recorded
+    const hiz_pyramid* current_pyramid = nullptr;
+
+    // the fastest path is the default, mesh shaders are the last path and
+    // only counted if supported
+    auto current_vertex_path =
+        mesh_shader ? vertex_path::mesh_shader : vertex_path::vertex_input;
+    uint32_t vertex_path_count = mesh_shader ? 3 : 2;
+    // the path that is drawn, vertex input until the pipelines of the
+    // current path are compiled
+    auto active_vertex_path = vertex_path::vertex_input;
+
+    // mesh shaders and the pulling vertex shader read vertices from storage
+    // buffers in the bindless set, mesh shaders also read meshlets
+    pulled_vertex_constants pulled_constants{
+        .vertices = add_buffer(
+            device, bindless, scene.geometry.vertex_buffer.buffer, 0,
+            scene.geometry.vertex_buffer.size
+        ),
+        .vertex_stride = uint32_t(
+            scene.geometry.vertex_stride / sizeof(float)
+        ),
+    };
+    meshlet_constants mesh_constants{};
+    if (mesh_shader) {
+        for (auto& meshlets : scene.meshlets) {
+            scene.meshlet_buffers.emplace_back();
+            create_meshlet_buffer(
+                device, tracker, bindless, meshlets,
+                scene.meshlet_buffers.back()
+            );
+        }
+        for (auto& frame : frames) {
+            create_meshlet_counter(
+                device, tracker, bindless, frame.meshlet_counter
+            );
+        }
+        mesh_constants.vertices = pulled_constants.vertices;
+        mesh_constants.vertex_stride = pulled_constants.vertex_stride;
+    }
+    auto draw_mesh_tasks =
+        (PFN_vkCmdDrawMeshTasksEXT)vkGetDeviceProcAddr(
+            device, "vkCmdDrawMeshTasksEXT"
+        );
+
+    // create render graph
+    // the solid pipelines are ids in the pipeline manager
+    pipeline_manager pipelines;
+    create_pipeline_manager(
+        device, pipeline_cache_control, 2, pipeline_cache_path, pipelines
+    );
     VkPipelineLayout pipeline_layout;
-    VkPipeline pipeline;
+    // early pipelines are for the pass before the occlusion test, its render
+    // pass has no resolve attachment
+    uint32_t pipeline, early_pipeline;
+    // without vertex input, with push constants for the buffers
+    VkPipelineLayout pulled_pipeline_layout;
+    uint32_t pulled_pipeline, early_pulled_pipeline;
+    // only with mesh shaders
+    VkPipelineLayout mesh_pipeline_layout = VK_NULL_HANDLE;
+    uint32_t mesh_pipeline = no_pipeline;
+    uint32_t early_mesh_pipeline = no_pipeline;
+    hud_pipeline hud;
+    bool show_hud = true;
+    // only if impostor_distance isn't 0
+    impostor_pipeline impostor;
+    render_graph graph;
+    auto color_image = add_image(graph, {
+        .format = surfaceFormat.format,
+        .samples = sample_count,
+        .scale = settings.resolution_scale,
+    });
+    // sampled by the depth reduction, which needs a depth only format
+    auto depth_image = add_image(graph, {
+        .format = VK_FORMAT_D32_SFLOAT,
+        .aspect = VK_IMAGE_ASPECT_DEPTH_BIT,
+        .samples = sample_count,
+        .scale = settings.resolution_scale,
+    });
+    // farthest depth of each texel, at every mip level
+    auto pyramid_image = add_image(graph, {
+        .format = VK_FORMAT_R32_SFLOAT,
+        .mip_levels = 0,
+        .scale = settings.resolution_scale,
+    });
+    auto swapchain_image = add_image(graph, {
+        .format = surfaceFormat.format,
+        .imported = true,
+        // matches the wait for image_available_semaphore
+        .initial_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        .final_layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+    });
+    // the solid passes resolve into the swapchain image, unless they are
+    // scaled, then they resolve into an image that is scaled up to it
+    auto scene_image = swapchain_image;
+    if (settings.resolution_scale != 1) {
+        scene_image = add_image(graph, {
+            .format = surfaceFormat.format,
+            .scale = settings.resolution_scale,
+        });
+    }
+
+    // draws the instances of one phase of the occlusion test
+    auto record_solid = [&](
+        VkCommandBuffer command_buffer, const render_pass_context& context,
+        bool early
+    ) {
+        VkViewport viewport{
+            .x = 0.0f,
+            .y = 0.0f,
+            .width = static_cast<float>(context.extent.width),
+            .height = static_cast<float>(context.extent.height),
+            .minDepth = 0.0f,
+            .maxDepth = 1.0f,
+        };
+        VkRect2D scissors{
+            .offset = {0, 0},
+            .extent = context.extent,
+        };
+        vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+        vkCmdSetScissor(command_buffer, 0, 1, &scissors);
+
+        auto& frame = frames[frame_index];
+        bool mesh_path = active_vertex_path == vertex_path::mesh_shader;
+        if (active_vertex_path == vertex_path::vertex_pulling) {
+            vkCmdBindPipeline(
+                command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                get_pipeline(
+                    pipelines, early ? early_pulled_pipeline : pulled_pipeline
+                )
+            );
+            vkCmdBindDescriptorSets(
+                command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                pulled_pipeline_layout, 0, 1, &bindless.set, 0, nullptr
+            );
+            auto constants = pulled_constants;
+            constants.instances = frame.instance_slot;
+            vkCmdPushConstants(
+                command_buffer, pulled_pipeline_layout,
+                VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(constants), &constants
+            );
+            // only the index buffer is used
+            bind_geometry(command_buffer, scene.geometry);
+        } else if (!mesh_path) {
+            vkCmdBindPipeline(
+                command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                get_pipeline(pipelines, early ? early_pipeline : pipeline)
+            );
+            // bound once, draws select their material by index
+            vkCmdBindDescriptorSets(
+                command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                pipeline_layout, 0, 1, &bindless.set, 0, nullptr
+            );
+            bind_geometry(command_buffer, scene.geometry);
+            VkDeviceSize offset = 0;
+            vkCmdBindVertexBuffers(
+                command_buffer, instances, 1, &frame.instances.buffer, &offset
+            );
+        }
+        if (!mesh_path) {
+            // all visible meshlets of the phase in one call, in the order of
+            // the draw queue, late draws of occluded instances have an
+            // instance count of 0
+            if (early) {
+                draw_indirect(
+                    command_buffer, frame.draw_commands,
+                    frame.early_draw_count, multi_draw_indirect
+                );
+            } else {
+                draw_indirect(
+                    command_buffer, frame.draw_commands,
+                    frame.draw_count - frame.early_draw_count,
+                    multi_draw_indirect, frame.early_draw_count
+                );
+            }
+        }
+
+        // the task shader culls the meshlets of one instance, late
+        // instances are skipped if they failed the occlusion test
+        auto constants = mesh_constants;
+        constants.instances = frame.instance_slot;
+        constants.counter = frame.meshlet_counter.slot;
+        constants.visibility =
+            early ? no_buffer : frame.occlusion.visibility_slot;
+
+        // the queue is sorted by pass, then pipeline, then mesh, so state
+        // is only bound when it changes
+        uint32_t pass = early ? 0 : 1;
+        auto& queue = frame.draws;
+        auto end = find_draw_pass(queue, pass + 1);
+        reset_draw_binds(frame.binds);
+        for (auto i = find_draw_pass(queue, pass); i < end; i++) {
+            auto& item = queue.items[i];
+            bool impostor_item =
+                get_draw_pipeline(item.key) == impostor_draw_pipeline;
+            if (!impostor_item && !mesh_path) {
+                continue;
+            }
+            auto changed = update_draw_binds(frame.binds, item.key);
+            if (impostor_item) {
+                // late impostors are skipped in the vertex shader if they
+                // failed the occlusion test
+                if (changed & draw_state_pipeline) {
+                    bind_impostor_pipeline(
+                        command_buffer, impostor, bindless, early
+                    );
+                }
+                auto& draw = frame.impostor_draws[item.index];
+                auto& atlas = scene.impostor_atlases[draw.mesh];
+                impostor_constants atlas_constants{
+                    .sphere = {
+                        atlas.sphere[0], atlas.sphere[1], atlas.sphere[2],
+                        atlas.sphere[3],
+                    },
+                    .instances = frame.instance_slot,
+                    .impostors = frame.impostors.slot,
+                    .visibility = early || !occlusion_culling ?
+                        no_buffer : frame.occlusion.visibility_slot,
+                    .first_impostor = draw.first,
+                    .atlas = atlas.texture,
+                    .tiles = impostor_tiles,
+                };
+                draw_impostors(
+                    command_buffer, impostor, atlas_constants, draw.count
+                );
+                continue;
+            }
+
+            if (changed & draw_state_pipeline) {
+                vkCmdBindPipeline(
+                    command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    get_pipeline(
+                        pipelines, early ? early_mesh_pipeline : mesh_pipeline
+                    )
+                );
+                vkCmdBindDescriptorSets(
+                    command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    mesh_pipeline_layout, 0, 1, &bindless.set, 0, nullptr
+                );
+            }
+            auto mesh = get_draw_mesh(item.key);
+            if (changed & draw_state_mesh) {
+                auto& buffer = scene.meshlet_buffers[mesh];
+                constants.meshlets = buffer.meshlets;
+                constants.meshlet_vertices = buffer.vertices;
+                constants.meshlet_triangles = buffer.triangles;
+                constants.meshlet_count = buffer.meshlet_count;
+                constants.vertex_offset =
+                    scene.geometry.meshes[mesh].vertex_offset;
+                constants.instance = item.index;
+                push_meshlet_constants(
+                    command_buffer, mesh_pipeline_layout, constants
+                );
+            }
+            draw_meshlets(
+                command_buffer, draw_mesh_tasks, mesh_pipeline_layout,
+                constants.meshlet_count, item.index
+            );
+        }
+    };
+    // skins the poses of the frame into the geometry arena, which the graph
+    // doesn't track
+    if (skin_poses > 0) {
+        add_pass(graph, {
+            .name = "skinning",
+            .graphics = false,
+            .side_effects = true,
+            .record = [&](
+                VkCommandBuffer command_buffer, const render_pass_context&
+            ) {
+                auto& frame = frames[frame_index];
+                begin_gpu_timer(command_buffer, frame.skin_timer);
+                record_skinning(
+                    command_buffer, skin, bindless, scene.geometry,
+                    pulled_constants.vertices, scene.skinned_meshes,
+                    frame.palettes,
+                    VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+                    VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | (
+                        mesh_shader ?
+                            VK_PIPELINE_STAGE_MESH_SHADER_BIT_EXT : 0
+                    )
+                );
+                end_gpu_timer(command_buffer, frame.skin_timer);
+            },
+        });
+    }
+    auto early_solid_pass = add_pass(graph, {
+        .name = "solid early",
+        .uses = {
+            {
+                color_image, render_access::color_attachment,
+                true, {.color = {{1.0f, 1.0f, 1.0f, 1.0f}}},
+            }, {
+                depth_image, render_access::depth_attachment,
+                true, {.depthStencil = {1.0f, 0}},
+            },
+        },
+        .record = [&](
+            VkCommandBuffer command_buffer, const render_pass_context& context
+        ) {
+            record_solid(command_buffer, context, true);
+        },
+    });
+    add_pass(graph, {
+        .name = "depth pyramid",
+        .graphics = false,
+        .uses = {
+            {depth_image, render_access::sampled},
+            {pyramid_image, render_access::storage_write},
+        },
+        .record = [&](
+            VkCommandBuffer command_buffer, const render_pass_context&
+        ) {
+            if (occlusion_culling) {
+                record_hiz_pyramid(
+                    command_buffer, occlusion, *current_pyramid,
+                    sample_count
+                );
+            }
+        },
+    });
+    // writes the visibility of instances and filters the late draws, which
+    // the graph doesn't track
+    add_pass(graph, {
+        .name = "occlusion",
+        .graphics = false,
+        .side_effects = true,
+        .uses = {{pyramid_image, render_access::sampled}},
+        .record = [&](
+            VkCommandBuffer command_buffer, const render_pass_context&
+        ) {
+            if (!occlusion_culling) {
+                return;
+            }
+            auto& frame = frames[frame_index];
+            occlusion_constants constants{
+                .instances = frame.instance_slot,
+                .bounds = frame.occlusion.bounds_slot,
+                .visibility = frame.occlusion.visibility_slot,
+                .counter = frame.occlusion.rejected_slot,
+                .commands = frame.draw_command_slot,
+                .instance_count = uint32_t(scene.instances.size()),
+                .command_offset = frame.early_draw_count,
+                .command_count =
+                    active_vertex_path == vertex_path::mesh_shader ? 0 :
+                    frame.draw_count - frame.early_draw_count,
+            };
+            record_occlusion_cull(
+                command_buffer, occlusion, bindless, *current_pyramid,
+                constants,
+                // impostors read the visibility in the vertex shader
+                VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | (
+                    active_vertex_path == vertex_path::mesh_shader ?
+                        VK_PIPELINE_STAGE_TASK_SHADER_BIT_EXT :
+                        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT
+                )
+            );
+        },
+    });
+    auto solid_pass = add_pass(graph, {
+        .name = "solid late",
+        .uses = {
+            {color_image, render_access::color_attachment},
+            {depth_image, render_access::depth_attachment},
+            {scene_image, render_access::resolve_attachment},
+        },
+        .record = [&](
+            VkCommandBuffer command_buffer, const render_pass_context& context
+        ) {
+            record_solid(command_buffer, context, false);
+
+            // on top of the scene, in the same render pass
+            if (show_hud) {
+                record_hud(
+                    command_buffer, hud, frames[frame_index].hud,
+                    context.extent
+                );
+            }
+        },
+    });
+
+    if (scene_image != swapchain_image) {
+        add_pass(graph, {
+            .name = "upscale",
+            .graphics = false,
+            .uses = {
+                {scene_image, render_access::transfer_read},
+                {swapchain_image, render_access::transfer_write},
+            },
+            .record = [&](
+                VkCommandBuffer command_buffer,
+                const render_pass_context& context
+            ) {
+                auto& source = context.instance.images[scene_image];
+                auto& destination = context.instance.images[swapchain_image];
+                VkImageBlit region{
+                    .srcSubresource = {
+                        .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                        .mipLevel = 0,
+                        .baseArrayLayer = 0,
+                        .layerCount = 1,
+                    },
+                    .srcOffsets = {
+                        {0, 0, 0},
+                        {
+                            int32_t(source.extent.width),
+                            int32_t(source.extent.height), 1
+                        },
+                    },
+                    .dstSubresource = {
+                        .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                        .mipLevel = 0,
+                        .baseArrayLayer = 0,
+                        .layerCount = 1,
+                    },
+                    .dstOffsets = {
+                        {0, 0, 0},
+                        {
+                            int32_t(destination.extent.width),
+                            int32_t(destination.extent.height), 1
+                        },
+                    },
+                };
+                vkCmdBlitImage(
+                    command_buffer,
+                    source.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                    destination.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                    1, &region, VK_FILTER_LINEAR
+                );
+            },
+        });
+    }
+
+    // copies the swapchain image into the readback ring, when requested
+    readback_slot* capture = nullptr;
+    bool capture_supported = is_readback_format(surfaceFormat.format);
+    {
+        VkSurfaceCapabilitiesKHR capabilities;
+        vkGetPhysicalDeviceSurfaceCapabilitiesKHR(
+            physical_device, surface, &capabilities
+        );
+        capture_supported = capture_supported && (
+            capabilities.supportedUsageFlags &
+            VK_IMAGE_USAGE_TRANSFER_SRC_BIT
+        );
+    }
+    if (capture_supported) {
+        add_pass(graph, {
+            .name = "capture",
+            .graphics = false,
+            .side_effects = true,
+            .uses = {{swapchain_image, render_access::transfer_read}},
+            .record = [&](
+                VkCommandBuffer command_buffer,
+                const render_pass_context& context
+            ) {
+                if (capture) {
+                    record_readback(
+                        command_buffer,
+                        context.instance.images[swapchain_image].image,
+                        *capture
+                    );
+                }
+            },
+        });
+    }
+    graph.dynamic_rendering = dynamic_rendering;
+    compile_render_graph(device, graph);
+
+    // create pipeline
     {
         VkPipelineShaderStageCreateInfo stage_create_infos[]{
             {
@@ -961,7 +2376,8 @@ int main() {
             .pVertexBindingDescriptions = vertex_binding_descriptions,
             .vertexAttributeDescriptionCount =
                 size(vertex_attribute_descriptions),
-            .pVertexAttributeDescriptions = vertex_attribute_descriptions,
+            .pVertexAttributeDescriptions =
+                vertex_attribute_descriptions.data(),
         };
         VkPipelineInputAssemblyStateCreateInfo assembly_state_create_info{
             .sType =
@@ -989,7 +2405,7 @@ int main() {
         };
         VkPipelineMultisampleStateCreateInfo multisample_state_create_info{
             .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
-            .rasterizationSamples = max_sample_count,
+            .rasterizationSamples = sample_count,
             .sampleShadingEnable = VK_FALSE,
         };
         VkPipelineColorBlendAttachmentState color_blend_attachment_state{
@@ -1015,6 +2431,8 @@ int main() {
         };
         VkPipelineLayoutCreateInfo layout_create_info{
             .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .setLayoutCount = 1,
+            .pSetLayouts = &bindless.layout,
         };
         if (
             vkCreatePipelineLayout(
@@ -1024,91 +2442,6 @@ int main() {
         ) {
             throw runtime_error("failed to create pipeline layout");
         }
-        VkAttachmentDescription color_attachment{
-            .format = surfaceFormat.format,
-            .samples = max_sample_count,
-            .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-            .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-            .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-            .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-            .finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-        };
-        VkAttachmentReference color_attachment_reference{
-            .attachment = 0, // index into attachments list
-            .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-        };
-        VkAttachmentDescription depth_attachment{
-            .format = VK_FORMAT_D24_UNORM_S8_UINT,
-            .samples = max_sample_count,
-            .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-            .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-            .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-            .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-            .finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
-        };
-        VkAttachmentReference depth_attachment_reference{
-            .attachment = 1,
-            .layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
-        };
-        VkAttachmentDescription resolve_attachment{
-            .format = surfaceFormat.format,
-            .samples = VK_SAMPLE_COUNT_1_BIT,
-            .loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-            .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-            .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-            .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-            .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-        };
-        VkAttachmentReference resolve_attachment_reference{
-            .attachment = 2,
-            .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
-        };
-
-        VkSubpassDescription subpass{
-            .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
-            .colorAttachmentCount = 1,
-            .pColorAttachments = &color_attachment_reference,
-            .pResolveAttachments = &resolve_attachment_reference,
-            .pDepthStencilAttachment = &depth_attachment_reference,
-        };
-        VkSubpassDependency dependency{
-            .srcSubpass = VK_SUBPASS_EXTERNAL,
-            .dstSubpass = 0,
-            .srcStageMask =
-                VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
-                VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
-            .dstStageMask =
-                VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
-                VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
-            .srcAccessMask = 0,
-            .dstAccessMask =
-                VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
-                VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
-        };
-        VkAttachmentDescription attachments[] = {
-            color_attachment, depth_attachment, resolve_attachment
-        };
-        VkRenderPassCreateInfo render_pass_create_info{
-            .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
-            .attachmentCount = std::size(attachments),
-            .pAttachments = attachments,
-            .subpassCount = 1,
-            .pSubpasses = &subpass,
-            .dependencyCount = 1,
-            .pDependencies = &dependency,
-        };
-        if (
-            vkCreateRenderPass(
-                device, &render_pass_create_info, nullptr,
-                &render_pass
-            ) != VK_SUCCESS
-        ) {
-            throw runtime_error("failed to create render pass");
-        }
-
         VkPipelineDepthStencilStateCreateInfo depth_stencil_info{
             .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
             .depthTestEnable = VK_TRUE,
@@ -1118,8 +2451,11 @@ int main() {
             .stencilTestEnable = VK_FALSE,
         };
 
+        auto target = get_render_target(graph, solid_pass);
+        auto early_target = get_render_target(graph, early_solid_pass);
         VkGraphicsPipelineCreateInfo pipeline_create_info{
             .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+            .pNext = target.rendering,
             .stageCount = size(stage_create_infos),
             .pStages = stage_create_infos,
             .pVertexInputState = &input_state_create_info,
@@ -1131,16 +2467,133 @@ int main() {
             .pColorBlendState = &color_blend_state_create_info,
             .pDynamicState = &dynamic_state_create_info,
             .layout = pipeline_layout,
-            .renderPass = render_pass,
+            .renderPass = target.render_pass,
             .subpass = 0,
         };
-        if (
-            vkCreateGraphicsPipelines(
-                device, VK_NULL_HANDLE, 1, &pipeline_create_info, nullptr,
-                &pipeline
-            ) != VK_SUCCESS
-        ) {
-            throw runtime_error("failed to create pipeline");
+        // the vertex input pipelines are the fallback of the others, so
+        // they are waited for
+        pipeline = request_pipeline(pipelines, pipeline_create_info);
+        pipeline_create_info.pNext = early_target.rendering;
+        pipeline_create_info.renderPass = early_target.render_pass;
+        early_pipeline = request_pipeline(pipelines, pipeline_create_info);
+        pipeline_create_info.pNext = target.rendering;
+        pipeline_create_info.renderPass = target.render_pass;
+        wait_for_pipeline(pipelines, pipeline);
+        wait_for_pipeline(pipelines, early_pipeline);
+
+        {
+            VkPushConstantRange push_constant_range{
+                .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+                .offset = 0,
+                .size = sizeof(pulled_vertex_constants),
+            };
+            layout_create_info.pushConstantRangeCount = 1;
+            layout_create_info.pPushConstantRanges = &push_constant_range;
+            if (
+                vkCreatePipelineLayout(
+                    device, &layout_create_info, nullptr,
+                    &pulled_pipeline_layout
+                ) != VK_SUCCESS
+            ) {
+                throw runtime_error("failed to create pipeline layout");
+            }
+
+            // same state, with an empty vertex input state
+            VkPipelineShaderStageCreateInfo pulled_stage_create_infos[]{
+                stage_create_infos[0], stage_create_infos[1],
+            };
+            pulled_stage_create_infos[0].module = pulled_vertex_shader_module;
+            VkPipelineVertexInputStateCreateInfo empty_input_state_create_info{
+                .sType =
+                    VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+            };
+            auto pulled_create_info = pipeline_create_info;
+            pulled_create_info.pStages = pulled_stage_create_infos;
+            pulled_create_info.pVertexInputState =
+                &empty_input_state_create_info;
+            pulled_create_info.layout = pulled_pipeline_layout;
+            pulled_pipeline = request_pipeline(
+                pipelines, pulled_create_info, pipeline
+            );
+            pulled_create_info.pNext = early_target.rendering;
+            pulled_create_info.renderPass = early_target.render_pass;
+            early_pulled_pipeline = request_pipeline(
+                pipelines, pulled_create_info, early_pipeline
+            );
+        }
+
+        if (mesh_shader) {
+            VkPushConstantRange push_constant_range{
+                .stageFlags =
+                    VK_SHADER_STAGE_TASK_BIT_EXT |
+                    VK_SHADER_STAGE_MESH_BIT_EXT,
+                .offset = 0,
+                .size = sizeof(meshlet_constants),
+            };
+            layout_create_info.pushConstantRangeCount = 1;
+            layout_create_info.pPushConstantRanges = &push_constant_range;
+            if (
+                vkCreatePipelineLayout(
+                    device, &layout_create_info, nullptr,
+                    &mesh_pipeline_layout
+                ) != VK_SUCCESS
+            ) {
+                throw runtime_error("failed to create pipeline layout");
+            }
+
+            // same state, without vertex input
+            VkPipelineShaderStageCreateInfo mesh_stage_create_infos[]{
+                {
+                    .sType =
+                        VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                    .stage = VK_SHADER_STAGE_TASK_BIT_EXT,
+                    .module = task_shader_module,
+                    .pName = "main",
+                }, {
+                    .sType =
+                        VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                    .stage = VK_SHADER_STAGE_MESH_BIT_EXT,
+                    .module = mesh_shader_module,
+                    .pName = "main",
+                },
+                stage_create_infos[1],
+            };
+            pipeline_create_info.stageCount = size(mesh_stage_create_infos);
+            pipeline_create_info.pStages = mesh_stage_create_infos;
+            pipeline_create_info.pVertexInputState = nullptr;
+            pipeline_create_info.pInputAssemblyState = nullptr;
+            pipeline_create_info.layout = mesh_pipeline_layout;
+            mesh_pipeline = request_pipeline(
+                pipelines, pipeline_create_info, pipeline
+            );
+            pipeline_create_info.pNext = early_target.rendering;
+            pipeline_create_info.renderPass = early_target.render_pass;
+            early_mesh_pipeline = request_pipeline(
+                pipelines, pipeline_create_info, early_pipeline
+            );
+        }
+    }
+    create_hud_pipeline(
+        device, get_render_target(graph, solid_pass), 0, sample_count, hud
+    );
+
+    // every mesh is baked into an atlas up front, streamed meshes from their
+    // fallback, instances cross fade to impostors over impostor_band radii
+    const float impostor_band = 10;
+    if (impostor_distance > 0) {
+        create_impostor_pipeline(
+            device, bindless, get_render_target(graph, early_solid_pass),
+            get_render_target(graph, solid_pass), sample_count, impostor
+        );
+        scene.impostor_atlases.resize(scene.meshlets.size());
+        for (auto& draw : scene.draws) {
+            float sphere[4];
+            get_mesh_bounds(scene.meshlets[draw.mesh], sphere);
+            bake_impostor_atlas(
+                device, tracker, bindless, impostor, queues.graphics,
+                commandPool, scene.geometry, pulled_constants.vertices,
+                draw.mesh, sphere, scene.impostor_atlases[draw.mesh]
+            );
         }
     }
 
@@ -1150,161 +2603,901 @@ int main() {
     int framebuffer_width, framebuffer_height;
     glfwGetFramebufferSize(window, &framebuffer_width, &framebuffer_height);
     create_display_size(
-        framebuffer_width, framebuffer_width, device, physical_device,
-        graphicsQueueFamily, presentQueueFamily, surface, surfaceFormat,
-        commandPool, scene, render_pass, pipeline,
-        display_size
+        framebuffer_width, framebuffer_height, device, physical_device, tracker,
+        queue_families, surface, surfaceFormat, presentCommandPool,
+        graph, swapchain_image, occlusion, depth_image, pyramid_image,
+        settings, display_size
     );
 
-    // create frame data
-    unsigned frames_in_flight = 2;
-    ge1::unique_span<frame_semaphores> frames(frames_in_flight);
-    for (auto i = 0u; i < frames.size(); i++) {
-        auto& frame = frames[i];
-
-        // create semaphores
-        VkSemaphoreCreateInfo semaphore_create_info{
-            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
-        };
-        VkFenceCreateInfo fence_create_info{
-            .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-            .flags = VK_FENCE_CREATE_SIGNALED_BIT,
-        };
-        if (
-            vkCreateSemaphore(
-                device, &semaphore_create_info, nullptr,
-                &frame.image_available_semaphore
-            ) != VK_SUCCESS ||
-            vkCreateSemaphore(
-                device, &semaphore_create_info, nullptr,
-                &frame.render_finished_semaphore
-            ) != VK_SUCCESS ||
-            vkCreateFence(
-                device, &fence_create_info, nullptr, &frame.ready_fence
-            )
+    // F12 saves a screenshot, F11 toggles capturing every frame
+    readback_ring readback;
+    create_readback_ring(tracker, frames_in_flight + 2, readback);
+    bool screenshot = false, capturing_video = false;
+    unsigned capture_index = 0;
+
+    hud_stats stats{
+        .cpu_time = 0,
+        .gpu_time = -1,
+        .samples = sample_count,
+        .impostors = false,
+        .mesh_instances = 0,
+        .impostor_instances = 0,
+        .streaming = stream_pages > 0,
+        .stream_bandwidth = 0,
+        .stream_misses = 0,
+        .page_count = stream_pages,
+        .skinning = skin_poses > 0,
+        .skinned_poses = skinned_poses,
+        .skinning_rate = 0,
+        .textures = textured,
+        .texture_usage = 0,
+        .texture_budget = VkDeviceSize(options.texture_budget) << 20,
+        .missing_texture_levels = 0,
+        .simulation_stall = 0,
+        .render_stall = 0,
+    };
+    // streaming totals at the start of the current second
+    auto stream_window_time = chrono::steady_clock::now();
+    stream_stats stream_window{};
+    // CPU time of sampling the poses of the last frame, in milliseconds
+    double animation_time = 0;
+
+    // with a camera path the scene is flown through once per vertex path,
+    // then frame time statistics are printed and the window is closed.
+    // Tuning runs measure the default vertex path instead.
+    bool benchmark =
+        !description.camera_path.empty() && options.tuning_frames == 0;
+    report.frame_time = INFINITY;
+    report.gpu_time = -1;
+    if (benchmark) {
+        current_vertex_path = vertex_path::vertex_input;
+        // every path is measured with its own pipelines
+        for (
+            auto id : {
+                pulled_pipeline, early_pulled_pipeline,
+                mesh_pipeline, early_mesh_pipeline,
+            }
         ) {
-            throw runtime_error("failed to create synchronisation objects");
+            if (id != no_pipeline) {
+                wait_for_pipeline(pipelines, id);
+            }
         }
     }
-
-    unsigned frame_index = 0;
-
-    while (!glfwWindowShouldClose(window)) {
-        glfwPollEvents();
-
-        vkWaitForFences(
-            device, 1, &frames[frame_index].ready_fence, VK_TRUE, -1ul
-        );
-
-        // get next image from swapchain
-        uint32_t image_index;
-        auto result = vkAcquireNextImageKHR(
-            device, display_size.swapchain, -1ul,
-            frames[frame_index].image_available_semaphore,
-            VK_NULL_HANDLE,
-            &image_index
+    // frames before the measurement starts, e.g. for pipeline compilation
+    const uint32_t benchmark_warm_up = 10;
+    // frames since the start of the camera path
+    uint32_t camera_frame = 0;
+    vector<float> benchmark_frame_times, benchmark_gpu_times;
+    auto last_frame = chrono::steady_clock::now();
+
+    // the main thread handles events and simulates the next frame while
+    // the render thread waits for fences and the swapchain, they exchange
+    // snapshots through a triple buffer. No snapshot is dropped and the
+    // camera advances by one step per snapshot, like it did per frame.
+    triple_buffer handoff;
+    create_triple_buffer(handoff);
+    frame_snapshot snapshots[3];
+    for (auto& snapshot : snapshots) {
+        snapshot.instances = scene.instances;
+        snapshot.palettes.resize(
+            get_palette_size(scene.skinned_meshes) * palette_matrix_size
         );
-        if (result == VK_SUCCESS) {
-            vkResetFences(device, 1, &frames[frame_index].ready_fence);
-            auto& swapchain_frame = display_size.swapchain_frames[image_index];
+    }
+    auto camera_path_frames = description.camera_path.empty() ?
+        0 : get_camera_path_frames(description);
+    // width and height, written by the simulation for resizing the swapchain
+    atomic<uint64_t> framebuffer_size{
+        uint64_t(framebuffer_width) << 32 | uint32_t(framebuffer_height)
+    };
+    // stall times in milliseconds since the last log, summed up by the
+    // render thread
+    double simulation_stall_sum = 0, render_stall_sum = 0;
+    uint32_t stall_frames = 0;
+
+    auto render_frames = [&]() {
+        // a snapshot is kept until it was rendered, so that none are skipped
+        // while the swapchain is recreated
+        bool rendered = true;
+        while (true) {
+            bool taken = false;
+            if (rendered) {
+                auto stall_start = chrono::steady_clock::now();
+                if (!take_triple_buffer(handoff)) {
+                    break;
+                }
+                stats.render_stall = chrono::duration<double, milli>(
+                    chrono::steady_clock::now() - stall_start
+                ).count();
+                taken = true;
+            } else if (is_triple_buffer_closed(handoff)) {
+                break;
+            }
+            rendered = false;
+            auto& snapshot = snapshots[handoff.front];
+            if (taken) {
+                // wakes the simulation if it waits to publish the next one
+                glfwPostEmptyEvent();
+                swap(scene.instances, snapshot.instances);
+                auto& input = snapshot.input;
+                show_hud = input.show_hud;
+                occlusion_culling = input.occlusion_culling;
+                capturing_video = input.capturing_video;
+                screenshot = input.screenshot;
+                if (input.next_vertex_path && !benchmark) {
+                    current_vertex_path = vertex_path(
+                        (uint32_t(current_vertex_path) + 1) % vertex_path_count
+                    );
+                }
+                stats.simulation_stall = snapshot.stall_time;
+                simulation_stall_sum += snapshot.stall_time;
+                render_stall_sum += stats.render_stall;
+                stall_frames++;
+            }
 
-            // submit command buffer
-            VkSemaphore waitSemaphores[]{
-                frames[frame_index].image_available_semaphore
-            };
-            VkPipelineStageFlags waitStages[]{
-                VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
-            };
-            VkSemaphore signalSemaphores[]{
-                frames[frame_index].render_finished_semaphore
-            };
-            VkSubmitInfo submitInfo{
-                .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-                .waitSemaphoreCount = 1,
-                .pWaitSemaphores = waitSemaphores,
-                .pWaitDstStageMask = waitStages,
-                .commandBufferCount = 1,
-                .pCommandBuffers = &swapchain_frame.command_buffer,
-                .signalSemaphoreCount = 1,
-                .pSignalSemaphores = signalSemaphores,
-            };
+            // the pulled and mesh pipelines are compiled in the background
+            {
+                active_vertex_path = current_vertex_path;
+                auto late = pipeline, early = early_pipeline;
+                if (current_vertex_path == vertex_path::vertex_pulling) {
+                    late = pulled_pipeline;
+                    early = early_pulled_pipeline;
+                } else if (current_vertex_path == vertex_path::mesh_shader) {
+                    late = mesh_pipeline;
+                    early = early_mesh_pipeline;
+                }
+                if (
+                    get_ready_pipeline(pipelines, late) != late ||
+                    get_ready_pipeline(pipelines, early) != early
+                ) {
+                    active_vertex_path = vertex_path::vertex_input;
+                }
+            }
+            poll_readbacks(device, readback, queues.graphics.timeline);
+
+            update_memory_budget(tracker);
+            if (chrono::steady_clock::now() - memory_log_time > 10s) {
+                log_memory_usage(tracker);
+                if (stats.meshlet_count > 0) {
+                    cout <<
+                        "meshlets: " << stats.visible_meshlets << " of " <<
+                        stats.meshlet_count << " visible, " <<
+                        100 -
+                        100 * stats.visible_meshlets / stats.meshlet_count <<
+                        "% culled (" <<
+                        get_vertex_path_name(active_vertex_path) << ")" <<
+                        endl;
+                }
+                if (stats.occlusion_culling) {
+                    cout <<
+                        "occlusion: " << stats.rejected_instances << " of " <<
+                        scene.instances.size() << " instances rejected" << endl;
+                }
+                cout <<
+                    "binds: " << stats.recorded_binds << " recorded, " <<
+                    stats.skipped_binds << " skipped per frame" << endl;
+                if (stall_frames > 0) {
+                    cout <<
+                        "threads: simulation stalled " <<
+                        simulation_stall_sum / stall_frames <<
+                        " ms, render stalled " <<
+                        render_stall_sum / stall_frames << " ms per frame" <<
+                        endl;
+                }
+                simulation_stall_sum = render_stall_sum = 0;
+                stall_frames = 0;
+                if (stats.impostors) {
+                    cout <<
+                        "impostors: " << stats.mesh_instances << " meshes, " <<
+                        stats.impostor_instances << " impostors" << endl;
+                }
+                if (stats.skinning) {
+                    cout <<
+                        "skinning: " << stats.skinned_poses << " poses, " <<
+                        skinned_vertices << " vertices per frame, " <<
+                        stats.skinning_rate << " vertices/ms on the GPU, " <<
+                        animation_time << " ms animation on the CPU" << endl;
+                }
+                if (textured) {
+                    auto& totals = scene.textures.stats;
+                    cout <<
+                        "textures: " << (totals.resident_bytes >> 20) <<
+                        " of " << options.texture_budget <<
+                        " MiB resident, " << totals.uploads << " uploads (" <<
+                        (totals.uploaded_bytes >> 20) << " MiB), " <<
+                        totals.evictions << " evictions, " <<
+                        totals.missing_levels << " levels missing" << endl;
+                }
+                if (stats.streaming) {
+                    auto& totals = scene.stream.stats;
+                    cout <<
+                        "stream: " << totals.resident_pages << " of " <<
+                        totals.page_count << " pages resident, " <<
+                        totals.loaded_chunks << " chunks (" <<
+                        (totals.loaded_bytes >> 20) << " MiB) loaded, " <<
+                        totals.misses << " misses, " << totals.evictions <<
+                        " evictions" << endl;
+                }
+                memory_log_time = chrono::steady_clock::now();
+            }
             if (
-                vkQueueSubmit(
-                    graphicsQueue, 1, &submitInfo,
-                    frames[frame_index].ready_fence
-                ) != VK_SUCCESS
+                stats.streaming &&
+                chrono::steady_clock::now() - stream_window_time > 1s
             ) {
-                throw runtime_error("failed to submit draw command buffer");
+                auto now = chrono::steady_clock::now();
+                auto seconds =
+                    chrono::duration<double>(now - stream_window_time).count();
+                auto& totals = scene.stream.stats;
+                stats.stream_bandwidth =
+                    (totals.loaded_bytes - stream_window.loaded_bytes) /
+                    seconds / (1 << 20);
+                stats.stream_misses =
+                    (totals.misses - stream_window.misses) / seconds;
+                stream_window = totals;
+                stream_window_time = now;
             }
 
-            // present image
-            VkPresentInfoKHR presentInfo{
-                .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
-                .waitSemaphoreCount = 1,
-                .pWaitSemaphores = signalSemaphores,
-                .swapchainCount = 1,
-                .pSwapchains = &display_size.swapchain,
-                .pImageIndices = &image_index,
-            };
-            vkQueuePresentKHR(presentQueue, &presentInfo);
-
-            frame_index = (frame_index + 1) % frames.size();
-
-        } else if (
-            result == VK_SUBOPTIMAL_KHR || result == VK_ERROR_OUT_OF_DATE_KHR
-        ) {
-            for (auto frame : frames) {
-                vkWaitForFences(device, 1, &frame.ready_fence, VK_TRUE, -1ul);
+            vkWaitForFences(
+                device, 1, &frames[frame_index].ready_fence, VK_TRUE, -1ul
+            );
+            // the previous use of this frame's timer completed with the fence
+            stats.gpu_time = read_gpu_timer(device, frames[frame_index].timer);
+            if (stats.skinning) {
+                auto time = read_gpu_timer(
+                    device, frames[frame_index].skin_timer
+                );
+                if (time > 0) {
+                    stats.skinning_rate = skinned_vertices / time;
+                }
+            }
+            reset_frame_arena(frames[frame_index].arena);
+            {
+                auto& binds = frames[frame_index].binds;
+                stats.recorded_binds = binds.recorded;
+                stats.skipped_binds = binds.skipped;
+                binds.recorded = binds.skipped = 0;
+            }
+            if (mesh_shader) {
+                auto& counter = frames[frame_index].meshlet_counter;
+                stats.visible_meshlets = *counter.count;
+                *counter.count = 0;
+            }
+            {
+                auto& occlusion = frames[frame_index].occlusion;
+                stats.occlusion_culling = occlusion_culling;
+                stats.vertex_path = get_vertex_path_name(active_vertex_path);
+                stats.rejected_instances = *occlusion.rejected;
+                *occlusion.rejected = 0;
             }
 
-            int framebuffer_width, framebuffer_height;
-            glfwGetFramebufferSize(
-                window, &framebuffer_width, &framebuffer_height
+            // get next image from swapchain
+            uint32_t image_index;
+            auto result = vkAcquireNextImageKHR(
+                device, display_size.swapchain, -1ul,
+                frames[frame_index].image_available_semaphore,
+                VK_NULL_HANDLE,
+                &image_index
             );
-            if (framebuffer_height > 0 && framebuffer_width > 0) {
-                destroy_display_size(device, display_size);
-
-                create_display_size(
-                    framebuffer_width, framebuffer_width,
-                    device, physical_device,
-                    graphicsQueueFamily, presentQueueFamily,
-                    surface, surfaceFormat,
-                    commandPool, scene, render_pass, pipeline,
-                    display_size
+            if (result == VK_SUCCESS) {
+                vkResetFences(device, 1, &frames[frame_index].ready_fence);
+                auto& swapchain_frame =
+                    display_size.swapchain_frames[image_index];
+                // only counts recorded frames, chunks are kept for as long as
+                // a frame that draws them may be in flight
+                if (stats.streaming) {
+                    begin_stream_frame(scene.stream, frames[frame_index].arena);
+                }
+                // replaced images are kept until no frame in flight uses
+                // them, so materials can switch to the new slots right away
+                if (textured) {
+                    auto& textures = scene.textures;
+                    begin_texture_frame(
+                        device, tracker, bindless, queues.transfer, textures,
+                        frames[frame_index].arena
+                    );
+                    // frames in flight read the materials while they are
+                    // written, but each reads either the old slot or the new
+                    // one. The new descriptor was written before, and the
+                    // old one stays valid until its image is destroyed
+                    // frames_in_flight frames later. The slots are aligned
+                    // 32 bit values, which the device never sees torn.
+                    uint32_t texture_count = textures.textures.size();
+                    for (auto texture : textures.changed) {
+                        auto slot = textures.textures[texture].slot;
+                        for (
+                            auto i = texture; i < material_count;
+                            i += texture_count
+                        ) {
+                            materials[i].texture = slot;
+                        }
+                    }
+                }
+                auto cpu_start = chrono::steady_clock::now();
+
+                // frame time includes waiting for the fence and the swapchain
+                add_frame_time(
+                    stats, chrono::duration<float, milli>(
+                        cpu_start - last_frame
+                    ).count()
+                );
+                last_frame = cpu_start;
+
+                // the camera path advances by a fixed step per frame, so that
+                // benchmark runs render the same frames on every machine
+                if (benchmark) {
+                    if (camera_frame >= benchmark_warm_up) {
+                        benchmark_frame_times.push_back(
+                            stats.frame_times[(stats.history_index +
+                                hud_history_size - 1) % hud_history_size]
+                        );
+                        if (stats.gpu_time >= 0) {
+                            benchmark_gpu_times.push_back(stats.gpu_time);
+                        }
+                    }
+                    if (camera_frame >= camera_path_frames) {
+                        string name = get_vertex_path_name(current_vertex_path);
+                        log_frame_times(
+                            (name + " frame time").c_str(),
+                            benchmark_frame_times
+                        );
+                        log_frame_times(
+                            (name + " gpu time").c_str(), benchmark_gpu_times
+                        );
+                        benchmark_frame_times.clear();
+                        benchmark_gpu_times.clear();
+                        camera_frame = 0;
+                        auto next = uint32_t(current_vertex_path) + 1;
+                        if (next < vertex_path_count) {
+                            current_vertex_path = vertex_path(next);
+                        } else {
+                            glfwSetWindowShouldClose(window, GLFW_TRUE);
+                        }
+                    }
+                }
+                if (
+                    options.tuning_frames > 0 &&
+                    camera_frame >= benchmark_warm_up
+                ) {
+                    benchmark_frame_times.push_back(
+                        stats.frame_times[(stats.history_index +
+                            hud_history_size - 1) % hud_history_size]
+                    );
+                    if (stats.gpu_time >= 0) {
+                        benchmark_gpu_times.push_back(stats.gpu_time);
+                    }
+                    if (benchmark_frame_times.size() == options.tuning_frames) {
+                        double sum = 0;
+                        for (auto time : benchmark_frame_times) {
+                            sum += time;
+                        }
+                        report.frame_time = sum / benchmark_frame_times.size();
+                        if (!benchmark_gpu_times.empty()) {
+                            sum = 0;
+                            for (auto time : benchmark_gpu_times) {
+                                sum += time;
+                            }
+                            report.gpu_time =
+                                sum / benchmark_gpu_times.size();
+                        }
+                        glfwSetWindowShouldClose(window, GLFW_TRUE);
+                    }
+                }
+                // the snapshot was simulated for this frame
+                camera_frame++;
+                memcpy(
+                    frames[frame_index].instances.data, scene.instances.data(),
+                    instance_buffer_size
+                );
+                if (textured) {
+                    request_instance_textures(
+                        scene, float(display_size.extent.height)
+                    );
+                    dispatch_texture_loads(
+                        device, tracker, scene.textures,
+                        frames[frame_index].arena
+                    );
+                    stats.texture_usage =
+                        scene.textures.stats.resident_bytes;
+                    stats.missing_texture_levels =
+                        scene.textures.stats.missing_levels;
+                }
+                if (stats.skinning) {
+                    copy(
+                        snapshot.palettes.begin(), snapshot.palettes.end(),
+                        frames[frame_index].palettes.palettes
+                    );
+                    animation_time = snapshot.animation_time;
+                }
+
+                {
+                    auto& frame = frames[frame_index];
+                    auto visibility = occlusion_culling ?
+                        frame.occlusion.visibility : nullptr;
+                    stats.impostors = impostor_distance > 0;
+                    if (stats.impostors) {
+                        stats.mesh_instances = write_impostors(
+                            scene, frame.impostors, frame.impostor_draws,
+                            visibility, impostor_distance, impostor_band
+                        );
+                        stats.impostor_instances = 0;
+                        for (auto& draw : frame.impostor_draws) {
+                            stats.impostor_instances += draw.count;
+                        }
+                    }
+                    write_draw_queue(
+                        scene, frame.impostor_draws, visibility,
+                        active_vertex_path, frame.draws
+                    );
+                }
+                if (active_vertex_path == vertex_path::mesh_shader) {
+                    stats.meshlet_count = 0;
+                    for (auto& draw : scene.draws) {
+                        auto& buffer = scene.meshlet_buffers[draw.mesh];
+                        stats.meshlet_count +=
+                            uint64_t(buffer.meshlet_count) *
+                            draw.instance_count;
+                    }
+                } else {
+                    auto& frame = frames[frame_index];
+                    frame.draw_count = write_meshlet_draws(
+                        scene, frame.draws, frame.draw_commands,
+                        frame.early_draw_count,
+                        stats.meshlet_count, stats.visible_meshlets
+                    );
+                    if (stats.streaming) {
+                        dispatch_stream_loads(
+                            scene.stream, scene.geometry, frame.arena
+                        );
+                        stats.resident_pages =
+                            scene.stream.stats.resident_pages;
+                    }
+                }
+
+                capture = nullptr;
+                if (capture_supported && (screenshot || capturing_video)) {
+                    // video frames are PPM, which needs no encoding
+                    char path[32];
+                    snprintf(
+                        path, sizeof(path), "capture_%05u.%s", capture_index,
+                        capturing_video ? "ppm" : "png"
+                    );
+                    capture = acquire_readback(
+                        device, tracker, readback,
+                        display_size.extent, surfaceFormat.format, path
+                    );
+                    if (capture) {
+                        capture_index++;
+                    }
+                }
+
+                auto& overlay = frames[frame_index].hud;
+                overlay.count = 0;
+                if (show_hud) {
+                    stats.present_mode = display_size.present_mode;
+                    stats.instance_count = 0;
+                    stats.triangle_count = 0;
+                    // the arena only has the fallback of streamed meshes
+                    for (auto& draw : scene.draws) {
+                        auto& mesh = scene.meshlets[draw.mesh];
+                        stats.instance_count += draw.instance_count;
+                        stats.triangle_count +=
+                            uint64_t(mesh.triangles.size()) *
+                            draw.instance_count;
+                    }
+                    stats.memory_usage = 0;
+                    stats.memory_budget = 0;
+                    for (auto& heap : tracker.heaps) {
+                        if (heap.device_local) {
+                            stats.memory_usage += heap.usage;
+                            stats.memory_budget += heap.budget;
+                        }
+                    }
+                    add_hud_stats(overlay, stats);
+                }
+
+                // record command buffer
+                auto command_buffer = frames[frame_index].command_buffer;
+                vkResetCommandBuffer(command_buffer, 0);
+                VkCommandBufferBeginInfo buffer_begin_info{
+                    .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+                    .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+                };
+                if (
+                    vkBeginCommandBuffer(
+                        command_buffer, &buffer_begin_info
+                    ) != VK_SUCCESS
+                ) {
+                    throw runtime_error(
+                        "failed to begin recording command buffer"
+                    );
+                }
+                begin_gpu_timer(command_buffer, frames[frame_index].timer);
+                current_pyramid = &swapchain_frame.pyramid;
+                record_render_graph(
+                    command_buffer, graph, swapchain_frame.graph_instance,
+                    frames[frame_index].arena
                 );
+                end_gpu_timer(command_buffer, frames[frame_index].timer);
+                if (mesh_shader) {
+                    record_meshlet_counter_barrier(
+                        command_buffer, frames[frame_index].meshlet_counter
+                    );
+                }
+                if (swapchain_frame.present_command_buffer != VK_NULL_HANDLE) {
+                    release_ownership(
+                        command_buffer, present_ownership_transfer(
+                            queue_families, swapchain_frame.image
+                        )
+                    );
+                }
+                if (
+                    vkEndCommandBuffer(command_buffer) != VK_SUCCESS
+                ) {
+                    throw runtime_error("failed to record command buffer");
+                }
+
+                // submit command buffer
+                semaphore_wait waits[]{
+                    {
+                        .semaphore =
+                            frames[frame_index].image_available_semaphore,
+                        .stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                    },
+                    // the copies of adopted textures completed already,
+                    // the wait makes them visible to the graphics queue
+                    wait_for(
+                        queues.transfer,
+                        textured ? scene.textures.wait_value : 0,
+                        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT
+                    ),
+                };
+                VkSemaphore signalSemaphores[]{
+                    frames[frame_index].render_finished_semaphore
+                };
+                auto value = submit(queues.graphics, {
+                    .command_buffers = {&command_buffer, 1},
+                    .waits = span(waits).first(textured ? 2 : 1),
+                    .signal_semaphores = signalSemaphores,
+                    .fence = frames[frame_index].ready_fence,
+                });
+                if (capture) {
+                    submit_readback(*capture, value);
+                }
+
+                // hand the image over to the present queue
+                if (swapchain_frame.present_command_buffer != VK_NULL_HANDLE) {
+                    semaphore_wait waits[]{
+                        {
+                            .semaphore = signalSemaphores[0],
+                            .stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                        },
+                    };
+                    signalSemaphores[0] =
+                        frames[frame_index].present_ready_semaphore;
+                    submit(queues.present, {
+                        .command_buffers = {
+                            &swapchain_frame.present_command_buffer, 1
+                        },
+                        .waits = waits,
+                        .signal_semaphores = signalSemaphores,
+                    });
+                }
+
+                // present image
+                VkPresentInfoKHR presentInfo{
+                    .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+                    .waitSemaphoreCount = 1,
+                    .pWaitSemaphores = signalSemaphores,
+                    .swapchainCount = 1,
+                    .pSwapchains = &display_size.swapchain,
+                    .pImageIndices = &image_index,
+                };
+                vkQueuePresentKHR(queues.present.handle, &presentInfo);
+
+                // shown with the next frame
+                stats.cpu_time = chrono::duration<double, milli>(
+                    chrono::steady_clock::now() - cpu_start
+                ).count();
+
+                frame_index = (frame_index + 1) % frames.size();
+                rendered = true;
+
+            } else if (
+                result == VK_SUBOPTIMAL_KHR ||
+                result == VK_ERROR_OUT_OF_DATE_KHR
+            ) {
+                for (auto& frame : frames) {
+                    vkWaitForFences(
+                        device, 1, &frame.ready_fence, VK_TRUE, -1ul
+                    );
+                }
+                wait(device, queues.present, queues.present.value);
+
+                // the simulation thread handles the window events. A
+                // minimized window has no size and acquiring fails until
+                // it is restored, polls for that instead of spinning.
+                auto size = framebuffer_size.load(memory_order_relaxed);
+                while (
+                    (size >> 32 == 0 || uint32_t(size) == 0) &&
+                    !is_triple_buffer_closed(handoff)
+                ) {
+                    this_thread::sleep_for(chrono::milliseconds(10));
+                    size = framebuffer_size.load(memory_order_relaxed);
+                }
+                int framebuffer_width = size >> 32;
+                int framebuffer_height = uint32_t(size);
+                if (framebuffer_height > 0 && framebuffer_width > 0) {
+                    destroy_display_size(
+                        device, tracker, presentCommandPool, graph, display_size
+                    );
+
+                    create_display_size(
+                        framebuffer_width, framebuffer_height,
+                        device, physical_device, tracker, queue_families,
+                        surface, surfaceFormat, presentCommandPool,
+                        graph, swapchain_image, occlusion, depth_image,
+                        pyramid_image, settings, display_size
+                    );
+                }
+
+            } else {
+                throw runtime_error("failed to acquire sawp chain image");
             }
 
-        } else {
-            throw runtime_error("failed to acquire sawp chain image");
+            // TODO: swapchain doesn't necessarily sync with current monitor
+            // use VK_KHR_display to wait for vsync of current display
         }
+    };
+
+    // state of the simulation thread, set up before rendering starts
+    auto simulated_instances = scene.instances;
+    frame_input input{
+        .show_hud = show_hud,
+        .occlusion_culling = occlusion_culling,
+        .capturing_video = false,
+        .screenshot = false,
+        .next_vertex_path = false,
+    };
+    bool screenshot_key = false, video_key = false, hud_key = false;
+    bool occlusion_key = false, vertex_path_key = false;
+    // the left mouse button picks what is under the cursor
+    bool pick_button = false;
+    auto camera_extent = display_size.extent;
+    // of the last simulated step
+    glm::mat4 camera(1);
+    // steps since the start, simulated is set while the back slot holds a
+    // step that wasn't published yet
+    uint32_t step = 0;
+    bool simulated = false;
+    // time spent waiting for the render thread since the last publish
+    double stall_time = 0;
+
+    exception_ptr render_error;
+    thread render_thread([&]() {
+        try {
+            render_frames();
+        } catch (...) {
+            render_error = current_exception();
+        }
+        // ends the simulation if rendering ended first
+        close_triple_buffer(handoff);
+        glfwPostEmptyEvent();
+    });
+
+    try {
+        while (!glfwWindowShouldClose(window)) {
+            glfwPollEvents();
+            {
+                auto pressed = [&](int key) {
+                    return glfwGetKey(window, key) == GLFW_PRESS;
+                };
+                bool down = pressed(GLFW_KEY_F12);
+                input.screenshot |= down && !screenshot_key;
+                screenshot_key = down;
+                down = pressed(GLFW_KEY_F11);
+                if (down && !video_key) {
+                    input.capturing_video = !input.capturing_video;
+                }
+                video_key = down;
+                down = pressed(GLFW_KEY_F1);
+                if (down && !hud_key) {
+                    input.show_hud = !input.show_hud;
+                }
+                hud_key = down;
+                down = pressed(GLFW_KEY_F2);
+                if (down && !occlusion_key) {
+                    input.occlusion_culling = !input.occlusion_culling;
+                }
+                occlusion_key = down;
+                down = pressed(GLFW_KEY_F3);
+                input.next_vertex_path |= down && !vertex_path_key;
+                vertex_path_key = down;
+            }
+            int width, height;
+            glfwGetFramebufferSize(window, &width, &height);
+            framebuffer_size.store(
+                uint64_t(width) << 32 | uint32_t(height),
+                memory_order_relaxed
+            );
+            if (width > 0 && height > 0) {
+                camera_extent = {uint32_t(width), uint32_t(height)};
+            }
 
-        // TODO: swapchain doesn't necessarily sync with current monitor
-        // use VK_KHR_display to wait for vsync of current display
+            auto& snapshot = snapshots[handoff.back];
+            if (!simulated) {
+                // the camera path restarts with every benchmark run
+                auto frame = benchmark ? step % camera_path_frames : step;
+                step++;
+                auto time = frame / 60.f;
+                camera = get_camera_matrix(
+                    description, time, camera_extent
+                );
+                glm::mat4 identity(1);
+                update_transforms(
+                    transforms, glm::value_ptr(identity),
+                    simulated_instances.data(), sizeof(instance_data)
+                );
+                copy(
+                    simulated_instances.begin(), simulated_instances.end(),
+                    snapshot.instances.begin()
+                );
+                multiply_instances(
+                    glm::value_ptr(camera), simulated_instances.data(),
+                    snapshot.instances.data(), snapshot.instances.size(),
+                    sizeof(instance_data)
+                );
+                if (skin_poses > 0) {
+                    auto start = chrono::steady_clock::now();
+                    write_palettes(
+                        jobs, scene, time, snapshot.palettes.data()
+                    );
+                    snapshot.animation_time = chrono::duration<double, milli>(
+                        chrono::steady_clock::now() - start
+                    ).count();
+                }
+                simulated = true;
+            }
+            bool down = glfwGetMouseButton(
+                window, GLFW_MOUSE_BUTTON_LEFT
+            ) == GLFW_PRESS;
+            if (down && !pick_button) {
+                pick_instance(window, scene, camera);
+            }
+            pick_button = down;
+            snapshot.input = input;
+            snapshot.stall_time = stall_time;
+            if (publish_triple_buffer(handoff)) {
+                simulated = false;
+                stall_time = 0;
+                input.screenshot = input.next_vertex_path = false;
+                continue;
+            }
+            if (is_triple_buffer_closed(handoff)) {
+                break;
+            }
+            // the render thread posts an empty event when it takes the last
+            // snapshot
+            auto stall_start = chrono::steady_clock::now();
+            glfwWaitEvents();
+            stall_time += chrono::duration<double, milli>(
+                chrono::steady_clock::now() - stall_start
+            ).count();
+        }
+    } catch (...) {
+        close_triple_buffer(handoff);
+        render_thread.join();
+        throw;
+    }
+    close_triple_buffer(handoff);
+    render_thread.join();
+    if (render_error) {
+        rethrow_exception(render_error);
     }
 
 
+    wait(device, queues.present, queues.present.value);
     for (auto& frame : frames) {
         vkWaitForFences(device, 1, &frame.ready_fence, VK_TRUE, -1ul);
         vkDestroySemaphore(device, frame.image_available_semaphore, nullptr);
         vkDestroySemaphore(device, frame.render_finished_semaphore, nullptr);
+        vkDestroySemaphore(device, frame.present_ready_semaphore, nullptr);
         vkDestroyFence(device, frame.ready_fence, nullptr);
+        vkFreeCommandBuffers(device, commandPool, 1, &frame.command_buffer);
+        destroy_indirect_buffer(device, tracker, frame.draw_commands);
+        remove_buffer(bindless, frame.instance_slot);
+        destroy_mapped_buffer(device, tracker, frame.instances);
+        destroy_hud_buffer(device, tracker, frame.hud);
+        remove_buffer(bindless, frame.draw_command_slot);
+        destroy_occlusion_buffer(device, tracker, bindless, frame.occlusion);
+        if (impostor_distance > 0) {
+            destroy_impostor_buffer(
+                device, tracker, bindless, frame.impostors
+            );
+        }
+        if (mesh_shader) {
+            destroy_meshlet_counter(
+                device, tracker, bindless, frame.meshlet_counter
+            );
+        }
+        destroy_gpu_timer(device, frame.timer);
+        if (skin_poses > 0) {
+            destroy_palette_buffer(device, tracker, bindless, frame.palettes);
+            destroy_gpu_timer(device, frame.skin_timer);
+        }
     }
 
-    destroy_display_size(device, display_size);
+    destroy_display_size(
+        device, tracker, presentCommandPool, graph, display_size
+    );
+
+    wait(device, queues.graphics, queues.graphics.value);
+    destroy_readback_ring(device, tracker, readback);
+    if (readback.captured > 0 || readback.dropped > 0) {
+        cout <<
+            "Captured " << readback.captured << " frames, dropped " <<
+            readback.dropped << endl;
+    }
 
-    vkDestroyPipeline(device, pipeline, nullptr);
+    destroy_pipeline_manager(pipelines);
+    cout <<
+        "Pipelines: " << pipelines.stats.requests << " requested, " <<
+        pipelines.stats.deduplicated << " deduplicated, " <<
+        pipelines.stats.cache_hits << " from cache, " <<
+        pipelines.stats.compiled << " compiled, " <<
+        pipelines.stats.failed << " failed" << endl;
     vkDestroyPipelineLayout(device, pipeline_layout, nullptr);
-    vkDestroyRenderPass(device, render_pass, nullptr);
+    vkDestroyPipelineLayout(device, pulled_pipeline_layout, nullptr);
+    destroy_hud_pipeline(device, hud);
+    destroy_occlusion_pipeline(device, occlusion);
+    if (impostor_distance > 0) {
+        for (auto& draw : scene.draws) {
+            destroy_impostor_atlas(
+                device, tracker, bindless,
+                scene.impostor_atlases[draw.mesh]
+            );
+        }
+        destroy_impostor_pipeline(device, impostor);
+    }
+    vkDestroyPipelineLayout(device, mesh_pipeline_layout, nullptr);
+    for (auto& buffer : scene.meshlet_buffers) {
+        destroy_meshlet_buffer(device, tracker, bindless, buffer);
+    }
+    for (auto& mesh : scene.skinned_meshes) {
+        destroy_skinned_mesh(device, tracker, bindless, scene.geometry, mesh);
+    }
+    if (skin_poses > 0) {
+        destroy_skin_pipeline(device, skin);
+    }
+    if (textured) {
+        wait(device, queues.transfer, queues.transfer.value);
+        tracker.evictors.clear();
+        destroy_texture_stream(device, tracker, bindless, scene.textures);
+    }
+    destroy_render_graph(device, graph);
+    destroy_bindless_set(device, bindless);
 
-    vkDestroyBuffer(device, vertex_buffer, nullptr);
-    vkFreeMemory(device, vertex_memory, nullptr);
+    vkDestroyBuffer(device, material_buffer, nullptr);
+    free_tracked_memory(device, tracker, material_memory);
+    if (stream_pages > 0) {
+        destroy_geometry_stream(scene.geometry, scene.stream);
+    }
+    destroy_geometry_arena(device, tracker, scene.geometry);
+    if (!tracker.allocations.empty()) {
+        cout <<
+            "leaked " << tracker.allocations.size() << " allocations" <<
+            endl;
+    }
 
     vkDestroyCommandPool(device, commandPool, nullptr);
+    vkDestroyCommandPool(device, presentCommandPool, nullptr);
 
     vkDestroyShaderModule(device, vertex_shader_module, nullptr);
+    vkDestroyShaderModule(device, pulled_vertex_shader_module, nullptr);
     vkDestroyShaderModule(device, fragment_shader_module, nullptr);
+    vkDestroyShaderModule(device, task_shader_module, nullptr);
+    vkDestroyShaderModule(device, mesh_shader_module, nullptr);
 
     vkDestroySurfaceKHR(instance, surface, nullptr);
+    destroy_queues(device, queues);
     vkDestroyDevice(device, nullptr);
     vkDestroyDebugUtilsMessengerEXT(instance, debugUtilsMessenger, nullptr);
     vkDestroyInstance(instance, nullptr);
@@ -1313,5 +3506,95 @@ int main() {
 
     glfwTerminate();
 
+    destroy_job_system(jobs);
+}
+
+int main(int argc, char** argv) {
+    // optional scene file, stream=<pages> streams the meshes through a pool
+    // of that many pages, impostor=<radii> sets the distance in bounding
+    // sphere radii beyond which instances become impostors, 0 disables them.
+    // tune[=<ms>] benchmarks candidate settings against a target GPU time,
+    // 60 Hz by default, stores the best one for the device and continues
+    // with it. render_pass uses render passes instead of dynamic rendering.
+    // skin=<poses> animates the meshes, skinned into up to that many poses
+    // that their instances share. texture_budget=<MiB> limits the resident
+    // levels of the textures of the scene file, 256 MiB by default.
+    launch_options options{
+        .scene_path = nullptr,
+        .stream_pages = 0,
+        .impostor_distance = 50,
+        .skin_poses = 0,
+        .texture_budget = 256,
+        .render_pass = false,
+        .settings = nullptr,
+        .stored_settings = true,
+        .tuning_frames = 0,
+    };
+    bool tune = false;
+    float tuning_target = 1000.f / 60;
+    for (auto i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "stream=", 7) == 0) {
+            options.stream_pages = strtoul(argv[i] + 7, nullptr, 10);
+        } else if (strncmp(argv[i], "impostor=", 9) == 0) {
+            options.impostor_distance = strtof(argv[i] + 9, nullptr);
+        } else if (strncmp(argv[i], "skin=", 5) == 0) {
+            options.skin_poses = strtoul(argv[i] + 5, nullptr, 10);
+        } else if (strncmp(argv[i], "texture_budget=", 15) == 0) {
+            options.texture_budget = strtoul(argv[i] + 15, nullptr, 10);
+        } else if (strcmp(argv[i], "render_pass") == 0) {
+            options.render_pass = true;
+        } else if (strcmp(argv[i], "tune") == 0) {
+            tune = true;
+        } else if (strncmp(argv[i], "tune=", 5) == 0) {
+            tune = true;
+            tuning_target = strtof(argv[i] + 5, nullptr);
+        } else {
+            options.scene_path = argv[i];
+        }
+    }
+
+    launch_report report;
+    if (tune) {
+        // the defaults are the first candidate, the first run also finds
+        // out what the device supports. Candidates are run in order of
+        // preference until one is fast enough.
+        options.stored_settings = false;
+        options.tuning_frames = 120;
+        vector<tuning_result> results;
+        vector<render_settings> candidates;
+        for (auto i = 0u; i == 0 || i < candidates.size(); i++) {
+            options.settings = i == 0 ? nullptr : &candidates[i];
+            run(options, report);
+            if (i == 0) {
+                get_tuning_candidates(
+                    report.sample_counts, report.present_modes,
+                    report.scaling, candidates
+                );
+            }
+            results.push_back({
+                report.settings, report.frame_time, report.gpu_time,
+            });
+            cout << "Tuning: ";
+            log_settings(report.settings);
+            cout << ": " << report.frame_time << " ms";
+            if (report.gpu_time >= 0) {
+                cout << ", " << report.gpu_time << " ms gpu";
+            }
+            cout << endl;
+            if (meets_tuning_target(results.back(), tuning_target)) {
+                break;
+            }
+        }
+        auto settings = pick_tuning(results, tuning_target);
+        write_tuning(tuning_path, report.device_uuid, settings);
+        cout << "Tuned for " << tuning_target << " ms: ";
+        log_settings(settings);
+        cout << endl;
+        options.settings = &settings;
+        options.tuning_frames = 0;
+        run(options, report);
+    } else {
+        run(options, report);
+    }
     return 0;
 }
@@ -0,0 +1,223 @@
+#include "memory_budget.h"
+
+#include <stdexcept>
+#include <iostream>
+#include <cstring>
+#include <memory>
+
+using namespace std;
+
+const char* get_memory_tag_name(memory_tag tag) {
+    switch (tag) {
+    case memory_tag::render_target: return "render targets";
+    case memory_tag::geometry: return "geometry";
+    case memory_tag::instances: return "instances";
+    case memory_tag::textures: return "textures";
+    case memory_tag::staging: return "staging";
+    case memory_tag::readback: return "readback";
+    case memory_tag::other: return "other";
+    case memory_tag::count: break;
+    }
+    throw runtime_error("unknown memory tag");
+}
+
+bool supports_memory_budget(VkPhysicalDevice physical_device) {
+    uint32_t count;
+    vkEnumerateDeviceExtensionProperties(
+        physical_device, nullptr, &count, nullptr
+    );
+    auto extensions = make_unique<VkExtensionProperties[]>(count);
+    vkEnumerateDeviceExtensionProperties(
+        physical_device, nullptr, &count, extensions.get()
+    );
+    for (auto i = 0u; i < count; i++) {
+        if (
+            strcmp(
+                extensions[i].extensionName,
+                VK_EXT_MEMORY_BUDGET_EXTENSION_NAME
+            ) == 0
+        ) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void create_memory_tracker(
+    VkPhysicalDevice physical_device, bool budget_extension,
+    memory_tracker& tracker
+) {
+    tracker.physical_device = physical_device;
+    tracker.budget_extension = budget_extension;
+    vkGetPhysicalDeviceMemoryProperties(
+        physical_device, &tracker.properties
+    );
+    tracker.heaps.resize(tracker.properties.memoryHeapCount);
+    for (auto i = 0u; i < tracker.heaps.size(); i++) {
+        auto& heap = tracker.properties.memoryHeaps[i];
+        tracker.heaps[i] = {
+            .size = heap.size,
+            .budget = heap.size,
+            .usage = 0,
+            .allocated = 0,
+            .device_local =
+                (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0,
+        };
+    }
+    for (auto& size : tracker.tag_sizes) {
+        size = 0;
+    }
+    tracker.allocations.clear();
+    tracker.eviction_threshold = 0.9f;
+    tracker.evictors.clear();
+    update_memory_budget(tracker);
+}
+
+void update_memory_budget(memory_tracker& tracker) {
+    if (!tracker.budget_extension) {
+        for (auto& heap : tracker.heaps) {
+            heap.usage = heap.allocated;
+        }
+        return;
+    }
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budget{
+        .sType =
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT,
+    };
+    VkPhysicalDeviceMemoryProperties2 properties{
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2,
+        .pNext = &budget,
+    };
+    vkGetPhysicalDeviceMemoryProperties2(
+        tracker.physical_device, &properties
+    );
+    for (auto i = 0u; i < tracker.heaps.size(); i++) {
+        tracker.heaps[i].budget = budget.heapBudget[i];
+        tracker.heaps[i].usage = budget.heapUsage[i];
+    }
+}
+
+static uint32_t find_memory_type(
+    const memory_tracker& tracker, uint32_t type_bits,
+    VkMemoryPropertyFlags properties
+) {
+    for (auto i = 0u; i < tracker.properties.memoryTypeCount; i++) {
+        auto flags = tracker.properties.memoryTypes[i].propertyFlags;
+        if ((type_bits & (1u << i)) && (flags & properties) == properties) {
+            return i;
+        }
+    }
+    throw runtime_error("failed to find suitable memory type");
+}
+
+static void evict(
+    memory_tracker& tracker, uint32_t heap_index, VkDeviceSize size,
+    memory_tag tag
+) {
+    auto& heap = tracker.heaps[heap_index];
+    auto limit = VkDeviceSize(heap.budget * tracker.eviction_threshold);
+    if (heap.usage + size <= limit) {
+        return;
+    }
+    // usage only drops once the memory is freed, which the evictors mostly
+    // do after the frames in flight finished
+    VkDeviceSize releasing = 0;
+    for (auto& evictor : tracker.evictors) {
+        releasing += evictor(
+            heap_index, heap.usage + size - limit - releasing
+        );
+        if (heap.usage + size <= limit + releasing) {
+            return;
+        }
+    }
+    cout <<
+        "memory warning: allocating " << (size >> 20) << " MiB of " <<
+        get_memory_tag_name(tag) << " puts heap " <<
+        heap_index << " at " << ((heap.usage + size) >> 20) << " of " <<
+        (heap.budget >> 20) << " MiB budget" << endl;
+}
+
+VkDeviceMemory allocate_tracked_memory(
+    VkDevice device, memory_tracker& tracker,
+    VkMemoryRequirements requirements, VkMemoryPropertyFlags properties,
+    memory_tag tag
+) {
+    auto type = find_memory_type(
+        tracker, requirements.memoryTypeBits, properties
+    );
+    auto heap = tracker.properties.memoryTypes[type].heapIndex;
+    evict(tracker, heap, requirements.size, tag);
+
+    VkMemoryAllocateInfo allocate_info{
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = requirements.size,
+        .memoryTypeIndex = type,
+    };
+    VkDeviceMemory memory;
+    if (
+        vkAllocateMemory(device, &allocate_info, nullptr, &memory) !=
+        VK_SUCCESS
+    ) {
+        throw runtime_error("failed to allocate memory");
+    }
+
+    tracker.allocations[memory] = {requirements.size, heap, tag};
+    tracker.heaps[heap].allocated += requirements.size;
+    tracker.heaps[heap].usage += requirements.size;
+    tracker.tag_sizes[size_t(tag)] += requirements.size;
+    return memory;
+}
+
+VkDeviceMemory allocate_tracked_memory(
+    VkDevice device, memory_tracker& tracker,
+    VkBuffer buffer, VkMemoryPropertyFlags properties, memory_tag tag
+) {
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(device, buffer, &requirements);
+    return allocate_tracked_memory(
+        device, tracker, requirements, properties, tag
+    );
+}
+
+void free_tracked_memory(
+    VkDevice device, memory_tracker& tracker, VkDeviceMemory memory
+) {
+    if (memory == VK_NULL_HANDLE) {
+        return;
+    }
+    auto allocation = tracker.allocations.find(memory);
+    if (allocation == tracker.allocations.end()) {
+        throw runtime_error("memory was not allocated by the tracker");
+    }
+    auto& [size, heap, tag] = allocation->second;
+    tracker.heaps[heap].allocated -= size;
+    auto& usage = tracker.heaps[heap].usage;
+    usage -= min(usage, size);
+    tracker.tag_sizes[size_t(tag)] -= size;
+    tracker.allocations.erase(allocation);
+    vkFreeMemory(device, memory, nullptr);
+}
+
+VkDeviceSize get_memory_usage(const memory_tracker& tracker, memory_tag tag) {
+    return tracker.tag_sizes[size_t(tag)];
+}
+
+void log_memory_usage(const memory_tracker& tracker) {
+    cout << "memory:";
+    for (auto i = 0u; i < tracker.heaps.size(); i++) {
+        auto& heap = tracker.heaps[i];
+        cout <<
+            " heap " << i << (heap.device_local ? " (device)" : "") <<
+            " " << (heap.usage >> 20) << "/" << (heap.budget >> 20) <<
+            " MiB,";
+    }
+    for (auto i = 0u; i < size_t(memory_tag::count); i++) {
+        if (tracker.tag_sizes[i] == 0) {
+            continue;
+        }
+        cout <<
+            " " << get_memory_tag_name(memory_tag(i)) << " " <<
+            (tracker.tag_sizes[i] >> 10) << " KiB,";
+    }
+    cout << " " << tracker.allocations.size() << " allocations" << endl;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+
+#include <vulkan/vulkan.h>
+
+// Accounting of device memory allocations by purpose and heap, and the
+// budget of every heap as reported by VK_EXT_memory_budget. Without the
+// extension the budget is the heap size and the usage is what was
+// allocated through the tracker.
+
+enum class memory_tag : uint32_t {
+    render_target, geometry, instances, textures, staging, readback, other,
+    count
+};
+
+const char* get_memory_tag_name(memory_tag tag);
+
+struct memory_allocation {
+    VkDeviceSize size;
+    uint32_t heap;
+    memory_tag tag;
+};
+
+struct memory_heap {
+    VkDeviceSize size, budget;
+    // usage of this process, including memory not allocated by the tracker
+    VkDeviceSize usage;
+    // allocated through the tracker
+    VkDeviceSize allocated;
+    bool device_local;
+};
+
+// called when allocating would exceed the eviction threshold of a heap,
+// should free memory on that heap, or release it once the GPU no longer
+// uses it, and return the number of bytes it will release later. Usage
+// only drops once the memory is freed through free_tracked_memory. Memory
+// allocated up front, like the pages of the geometry stream, has no
+// evictor.
+using memory_evictor =
+    std::function<VkDeviceSize(uint32_t heap, VkDeviceSize size)>;
+
+struct memory_tracker {
+    VkPhysicalDevice physical_device;
+    VkPhysicalDeviceMemoryProperties properties;
+    bool budget_extension;
+    std::vector<memory_heap> heaps;
+    VkDeviceSize tag_sizes[size_t(memory_tag::count)];
+    std::unordered_map<VkDeviceMemory, memory_allocation> allocations;
+
+    // fraction of the budget above which evictors are called before
+    // allocating, and a warning is printed if that didn't help
+    float eviction_threshold;
+    std::vector<memory_evictor> evictors;
+};
+
+bool supports_memory_budget(VkPhysicalDevice physical_device);
+
+// budget_extension must only be set if VK_EXT_memory_budget was enabled on
+// the device
+void create_memory_tracker(
+    VkPhysicalDevice physical_device, bool budget_extension,
+    memory_tracker& tracker
+);
+
+// queries the budgets, call once per frame
+void update_memory_budget(memory_tracker& tracker);
+
+// throws if no memory type matches or the allocation fails, evicting makes
+// room for later allocations, as evictors release memory asynchronously
+VkDeviceMemory allocate_tracked_memory(
+    VkDevice device, memory_tracker& tracker,
+    VkMemoryRequirements requirements, VkMemoryPropertyFlags properties,
+    memory_tag tag
+);
+VkDeviceMemory allocate_tracked_memory(
+    VkDevice device, memory_tracker& tracker,
+    VkBuffer buffer, VkMemoryPropertyFlags properties, memory_tag tag
+);
+void free_tracked_memory(
+    VkDevice device, memory_tracker& tracker, VkDeviceMemory memory
+);
+
+VkDeviceSize get_memory_usage(const memory_tracker& tracker, memory_tag tag);
+
+// prints the usage and budget of each heap and the size of each tag
+void log_memory_usage(const memory_tracker& tracker);
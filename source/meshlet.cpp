@@ -0,0 +1,481 @@
+#include "meshlet.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <memory>
+#include <cstring>
+#include <cmath>
+#include <array>
+#include <cstddef>
+
+using namespace std;
+
+static float dot(const float a[3], const float b[3]) {
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static void compute_bounds(
+    span<const float> vertices, uint32_t vertex_stride,
+    const meshlet_mesh& mesh, meshlet& meshlet
+) {
+    auto position = [&](uint32_t local) {
+        return &vertices[
+            size_t(mesh.vertices[meshlet.vertex_offset + local]) *
+            vertex_stride
+        ];
+    };
+
+    // sphere around the center of the bounding box
+    float low[3], high[3];
+    for (auto i = 0u; i < 3; i++) {
+        low[i] = high[i] = position(0)[i];
+    }
+    for (auto v = 1u; v < meshlet.vertex_count; v++) {
+        for (auto i = 0u; i < 3; i++) {
+            low[i] = min(low[i], position(v)[i]);
+            high[i] = max(high[i], position(v)[i]);
+        }
+    }
+    for (auto i = 0u; i < 3; i++) {
+        meshlet.center[i] = (low[i] + high[i]) * 0.5f;
+    }
+    float radius = 0;
+    for (auto v = 0u; v < meshlet.vertex_count; v++) {
+        float offset[3];
+        for (auto i = 0u; i < 3; i++) {
+            offset[i] = position(v)[i] - meshlet.center[i];
+        }
+        radius = max(radius, dot(offset, offset));
+    }
+    meshlet.radius = sqrt(radius);
+
+    // face normals, oriented like the vertex normals so that the result
+    // doesn't depend on the winding order
+    vector<array<float, 3>> normals;
+    normals.reserve(meshlet.triangle_count);
+    float axis[3]{0, 0, 0};
+    for (auto t = 0u; t < meshlet.triangle_count; t++) {
+        auto triangle = mesh.triangles[meshlet.triangle_offset + t];
+        const float* corners[3];
+        float vertex_normal[3]{0, 0, 0};
+        for (auto c = 0u; c < 3; c++) {
+            corners[c] = position((triangle >> (c * 8)) & 0xff);
+            for (auto i = 0u; i < 3; i++) {
+                vertex_normal[i] += corners[c][3 + i];
+            }
+        }
+        float a[3], b[3];
+        for (auto i = 0u; i < 3; i++) {
+            a[i] = corners[1][i] - corners[0][i];
+            b[i] = corners[2][i] - corners[0][i];
+        }
+        array<float, 3> normal{
+            a[1] * b[2] - a[2] * b[1],
+            a[2] * b[0] - a[0] * b[2],
+            a[0] * b[1] - a[1] * b[0],
+        };
+        float length = sqrt(dot(normal.data(), normal.data()));
+        if (length == 0) {
+            continue;
+        }
+        if (dot(normal.data(), vertex_normal) < 0) {
+            length = -length;
+        }
+        for (auto i = 0u; i < 3; i++) {
+            normal[i] /= length;
+            axis[i] += normal[i];
+        }
+        normals.push_back(normal);
+    }
+
+    // culling only pays off for narrow cones, wide ones are rarely
+    // entirely back facing
+    meshlet.cone_cutoff = 1;
+    float length = sqrt(dot(axis, axis));
+    for (auto i = 0u; i < 3; i++) {
+        meshlet.cone_axis[i] = length > 0 ? axis[i] / length : 0;
+    }
+    if (length == 0 || normals.empty()) {
+        return;
+    }
+    float min_dot = 1;
+    for (auto& normal : normals) {
+        min_dot = min(min_dot, dot(normal.data(), meshlet.cone_axis));
+    }
+    if (min_dot > 0.1f) {
+        meshlet.cone_cutoff = sqrt(1 - min_dot * min_dot);
+    }
+}
+
+void build_meshlets(
+    span<const float> vertices, uint32_t vertex_stride,
+    span<const uint32_t> indices, meshlet_mesh& mesh
+) {
+    mesh.meshlets.clear();
+    mesh.vertices.clear();
+    mesh.triangles.clear();
+
+    // meshlet vertex of each mesh vertex in the current meshlet
+    vector<uint32_t> local(vertices.size() / vertex_stride, -1u);
+    meshlet current{};
+    auto finish = [&]() {
+        for (auto i = 0u; i < current.vertex_count; i++) {
+            local[mesh.vertices[current.vertex_offset + i]] = -1u;
+        }
+        mesh.meshlets.push_back(current);
+        current = {};
+        current.vertex_offset = mesh.vertices.size();
+        current.triangle_offset = mesh.triangles.size();
+    };
+
+    for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+        const uint32_t* corners = &indices[t];
+        auto new_vertices = 0u;
+        for (auto c = 0u; c < 3; c++) {
+            new_vertices +=
+                local[corners[c]] == -1u &&
+                (c == 0 || corners[c] != corners[0]) &&
+                (c < 2 || corners[c] != corners[1]);
+        }
+        if (
+            current.vertex_count + new_vertices > max_meshlet_vertices ||
+            current.triangle_count == max_meshlet_triangles
+        ) {
+            finish();
+        }
+
+        uint32_t triangle = 0;
+        for (auto c = 0u; c < 3; c++) {
+            auto& index = local[corners[c]];
+            if (index == -1u) {
+                index = current.vertex_count++;
+                mesh.vertices.push_back(corners[c]);
+            }
+            triangle |= index << (c * 8);
+        }
+        mesh.triangles.push_back(triangle);
+        current.triangle_count++;
+    }
+    if (current.triangle_count > 0) {
+        finish();
+    }
+
+    for (auto& meshlet : mesh.meshlets) {
+        compute_bounds(vertices, vertex_stride, mesh, meshlet);
+    }
+}
+
+vector<uint32_t> get_meshlet_indices(const meshlet_mesh& mesh) {
+    vector<uint32_t> indices;
+    indices.reserve(mesh.triangles.size() * 3);
+    for (auto& meshlet : mesh.meshlets) {
+        for (auto t = 0u; t < meshlet.triangle_count; t++) {
+            auto triangle = mesh.triangles[meshlet.triangle_offset + t];
+            for (auto c = 0u; c < 3; c++) {
+                indices.push_back(mesh.vertices[
+                    meshlet.vertex_offset + ((triangle >> (c * 8)) & 0xff)
+                ]);
+            }
+        }
+    }
+    return indices;
+}
+
+void get_mesh_bounds(const meshlet_mesh& mesh, float sphere[4]) {
+    // around the center of the box containing the meshlet spheres
+    float low[3]{INFINITY, INFINITY, INFINITY};
+    float high[3]{-INFINITY, -INFINITY, -INFINITY};
+    for (auto& meshlet : mesh.meshlets) {
+        for (auto i = 0u; i < 3; i++) {
+            low[i] = min(low[i], meshlet.center[i] - meshlet.radius);
+            high[i] = max(high[i], meshlet.center[i] + meshlet.radius);
+        }
+    }
+    for (auto i = 0u; i < 3; i++) {
+        sphere[i] = mesh.meshlets.empty() ? 0 : (low[i] + high[i]) / 2;
+    }
+    sphere[3] = 0;
+    for (auto& meshlet : mesh.meshlets) {
+        float offset[3];
+        for (auto i = 0u; i < 3; i++) {
+            offset[i] = meshlet.center[i] - sphere[i];
+        }
+        sphere[3] = max(sphere[3], sqrt(dot(offset, offset)) + meshlet.radius);
+    }
+}
+
+void loosen_meshlets(meshlet_mesh& mesh, float margin) {
+    for (auto& meshlet : mesh.meshlets) {
+        meshlet.radius += margin;
+        meshlet.cone_cutoff = 1;
+    }
+}
+
+// solves matrix * x = b with partial pivoting, returns false if singular
+static bool solve(const float matrix[16], const float b[4], float x[4]) {
+    double m[4][5];
+    for (auto r = 0u; r < 4; r++) {
+        for (auto c = 0u; c < 4; c++) {
+            m[r][c] = matrix[c * 4 + r];
+        }
+        m[r][4] = b[r];
+    }
+    for (auto c = 0u; c < 4; c++) {
+        auto pivot = c;
+        for (auto r = c + 1; r < 4; r++) {
+            if (abs(m[r][c]) > abs(m[pivot][c])) {
+                pivot = r;
+            }
+        }
+        if (abs(m[pivot][c]) < 1e-12) {
+            return false;
+        }
+        swap(m[c], m[pivot]);
+        for (auto r = 0u; r < 4; r++) {
+            if (r == c) {
+                continue;
+            }
+            auto factor = m[r][c] / m[c][c];
+            for (auto k = c; k < 5; k++) {
+                m[r][k] -= factor * m[c][k];
+            }
+        }
+    }
+    for (auto r = 0u; r < 4; r++) {
+        x[r] = m[r][4] / m[r][r];
+    }
+    return true;
+}
+
+void create_meshlet_culler(const float matrix[16], meshlet_culler& culler) {
+    // planes from the rows of the matrix, the near plane is z > -w, which
+    // is conservative for both 0 to 1 and -1 to 1 depth ranges
+    auto row = [&](uint32_t r, uint32_t c) {
+        return matrix[c * 4 + r];
+    };
+    const int signs[6][2]{
+        {0, 1}, {0, -1}, {1, 1}, {1, -1}, {2, 1}, {2, -1},
+    };
+    for (auto p = 0u; p < 6; p++) {
+        auto r = signs[p][0];
+        float length = 0;
+        for (auto c = 0u; c < 4; c++) {
+            culler.planes[p][c] = row(3, c) + signs[p][1] * row(r, c);
+            if (c < 3) {
+                length += culler.planes[p][c] * culler.planes[p][c];
+            }
+        }
+        length = sqrt(length);
+        for (auto c = 0u; c < 4; c++) {
+            culler.planes[p][c] /= length > 0 ? length : 1;
+        }
+    }
+
+    // the camera is the point that is projected to infinity in front of
+    // the near plane, (0, 0, 1, 0) in clip space
+    const float infinity[4]{0, 0, 1, 0};
+    float camera[4]{};
+    culler.cone_culling =
+        solve(matrix, infinity, camera) && abs(camera[3]) > 1e-6f;
+    for (auto i = 0u; i < 3; i++) {
+        culler.camera[i] = culler.cone_culling ? camera[i] / camera[3] : 0;
+    }
+}
+
+bool is_meshlet_visible(const meshlet_culler& culler, const meshlet& meshlet) {
+    for (auto& plane : culler.planes) {
+        if (dot(plane, meshlet.center) + plane[3] < -meshlet.radius) {
+            return false;
+        }
+    }
+    if (culler.cone_culling) {
+        // every point of the sphere sees every triangle from behind
+        float view[3];
+        for (auto i = 0u; i < 3; i++) {
+            view[i] = meshlet.center[i] - culler.camera[i];
+        }
+        auto distance = sqrt(dot(view, view));
+        if (
+            dot(view, meshlet.cone_axis) >
+            meshlet.cone_cutoff * distance +
+            meshlet.radius * (1 + meshlet.cone_cutoff)
+        ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint32_t write_meshlet_commands(
+    const meshlet_mesh& mesh, const mesh_allocation& allocation,
+    const meshlet_culler& culler, uint32_t instance,
+    span<VkDrawIndexedIndirectCommand> commands
+) {
+    uint32_t count = 0;
+    for (auto& meshlet : mesh.meshlets) {
+        if (!is_meshlet_visible(culler, meshlet)) {
+            continue;
+        }
+        if (count == commands.size()) {
+            return -1u;
+        }
+        commands[count++] = {
+            .indexCount = meshlet.triangle_count * 3,
+            .instanceCount = 1,
+            .firstIndex =
+                allocation.first_index + meshlet.triangle_offset * 3,
+            .vertexOffset = int32_t(allocation.vertex_offset),
+            .firstInstance = instance,
+        };
+    }
+    return count;
+}
+
+bool supports_mesh_shader(VkPhysicalDevice physical_device) {
+    uint32_t count;
+    vkEnumerateDeviceExtensionProperties(
+        physical_device, nullptr, &count, nullptr
+    );
+    auto extensions = make_unique<VkExtensionProperties[]>(count);
+    vkEnumerateDeviceExtensionProperties(
+        physical_device, nullptr, &count, extensions.get()
+    );
+    bool found = false;
+    for (auto i = 0u; i < count; i++) {
+        found = found || strcmp(
+            extensions[i].extensionName, VK_EXT_MESH_SHADER_EXTENSION_NAME
+        ) == 0;
+    }
+    if (!found) {
+        return false;
+    }
+
+    VkPhysicalDeviceMeshShaderFeaturesEXT mesh_shader_features{
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT,
+    };
+    VkPhysicalDeviceFeatures2 features{
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &mesh_shader_features,
+    };
+    vkGetPhysicalDeviceFeatures2(physical_device, &features);
+    return mesh_shader_features.taskShader && mesh_shader_features.meshShader;
+}
+
+// offsets of storage buffers need to be aligned, 256 is the largest
+// minStorageBufferOffsetAlignment allowed
+static VkDeviceSize align(VkDeviceSize offset) {
+    return (offset + 255) / 256 * 256;
+}
+
+void create_meshlet_buffer(
+    VkDevice device, memory_tracker& tracker, bindless_set& bindless,
+    const meshlet_mesh& mesh, meshlet_buffer& buffer
+) {
+    auto meshlets_size = sizeof(meshlet) * mesh.meshlets.size();
+    auto vertices_size = sizeof(uint32_t) * mesh.vertices.size();
+    auto triangles_size = sizeof(uint32_t) * mesh.triangles.size();
+    auto vertices_offset = align(meshlets_size);
+    auto triangles_offset = align(vertices_offset + vertices_size);
+
+    create_mapped_buffer(
+        device, tracker, memory_tag::geometry,
+        triangles_offset + triangles_size,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, buffer.buffer
+    );
+    auto data = (char*)buffer.buffer.data;
+    memcpy(data, mesh.meshlets.data(), meshlets_size);
+    memcpy(data + vertices_offset, mesh.vertices.data(), vertices_size);
+    memcpy(data + triangles_offset, mesh.triangles.data(), triangles_size);
+
+    buffer.meshlet_count = mesh.meshlets.size();
+    buffer.meshlets = add_buffer(
+        device, bindless, buffer.buffer.buffer, 0, meshlets_size
+    );
+    buffer.vertices = add_buffer(
+        device, bindless, buffer.buffer.buffer, vertices_offset,
+        vertices_size
+    );
+    buffer.triangles = add_buffer(
+        device, bindless, buffer.buffer.buffer, triangles_offset,
+        triangles_size
+    );
+}
+
+void destroy_meshlet_buffer(
+    VkDevice device, memory_tracker& tracker, bindless_set& bindless,
+    const meshlet_buffer& buffer
+) {
+    remove_buffer(bindless, buffer.meshlets);
+    remove_buffer(bindless, buffer.vertices);
+    remove_buffer(bindless, buffer.triangles);
+    destroy_mapped_buffer(device, tracker, buffer.buffer);
+}
+
+void create_meshlet_counter(
+    VkDevice device, memory_tracker& tracker, bindless_set& bindless,
+    meshlet_counter& counter
+) {
+    create_mapped_buffer(
+        device, tracker, memory_tag::other, sizeof(uint32_t),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, counter.buffer
+    );
+    counter.count = (uint32_t*)counter.buffer.data;
+    *counter.count = 0;
+    counter.slot = add_buffer(
+        device, bindless, counter.buffer.buffer, 0, sizeof(uint32_t)
+    );
+}
+
+void destroy_meshlet_counter(
+    VkDevice device, memory_tracker& tracker, bindless_set& bindless,
+    const meshlet_counter& counter
+) {
+    remove_buffer(bindless, counter.slot);
+    destroy_mapped_buffer(device, tracker, counter.buffer);
+}
+
+void record_meshlet_counter_barrier(
+    VkCommandBuffer command_buffer, const meshlet_counter& counter
+) {
+    VkBufferMemoryBarrier barrier{
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer = counter.buffer.buffer,
+        .offset = 0,
+        .size = VK_WHOLE_SIZE,
+    };
+    vkCmdPipelineBarrier(
+        command_buffer,
+        VK_PIPELINE_STAGE_TASK_SHADER_BIT_EXT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+        0, nullptr, 1, &barrier, 0, nullptr
+    );
+}
+
+void push_meshlet_constants(
+    VkCommandBuffer command_buffer, VkPipelineLayout layout,
+    const meshlet_constants& constants
+) {
+    vkCmdPushConstants(
+        command_buffer, layout,
+        VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT,
+        0, sizeof(constants), &constants
+    );
+}
+
+void draw_meshlets(
+    VkCommandBuffer command_buffer,
+    PFN_vkCmdDrawMeshTasksEXT draw_mesh_tasks, VkPipelineLayout layout,
+    uint32_t meshlet_count, uint32_t instance
+) {
+    vkCmdPushConstants(
+        command_buffer, layout,
+        VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT,
+        offsetof(meshlet_constants, instance), sizeof(instance), &instance
+    );
+    auto group_count =
+        (meshlet_count + meshlet_task_size - 1) / meshlet_task_size;
+    draw_mesh_tasks(command_buffer, group_count, 1, 1);
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <span>
+
+#include <vulkan/vulkan.h>
+
+#include "buffer.h"
+#include "bindless.h"
+#include "geometry_arena.h"
+
+// Meshes split into small clusters of triangles, each with a bounding
+// sphere and a cone containing its triangle normals. Clusters outside the
+// view frustum or facing away from the camera are culled before
+// rasterization, by a task shader with VK_EXT_mesh_shader or on the CPU
+// by writing indirect draws for visible meshlets only otherwise.
+
+const uint32_t max_meshlet_vertices = 64;
+const uint32_t max_meshlet_triangles = 124;
+// meshlets tested by one task shader workgroup, matches meshlet.glsl
+const uint32_t meshlet_task_size = 32;
+
+// matches struct meshlet in meshlet.glsl, std430 layout
+struct meshlet {
+    float center[3];
+    float radius;
+    // normalized, the cutoff is the sine of the cone's half angle, or 1 if
+    // the cone is too wide for culling
+    float cone_axis[3];
+    float cone_cutoff;
+    // into meshlet_mesh::vertices and meshlet_mesh::triangles
+    uint32_t vertex_offset, triangle_offset;
+    uint32_t vertex_count, triangle_count;
+};
+
+struct meshlet_mesh {
+    std::vector<meshlet> meshlets;
+    // mesh vertex of each meshlet vertex
+    std::vector<uint32_t> vertices;
+    // three 8 bit meshlet vertex indices per triangle
+    std::vector<uint32_t> triangles;
+};
+
+// vertex_stride is in floats, the first six floats of a vertex are the
+// position and normal. Triangles are taken in index order, so the index
+// buffer should already be ordered for locality.
+void build_meshlets(
+    std::span<const float> vertices, uint32_t vertex_stride,
+    std::span<const uint32_t> indices, meshlet_mesh& mesh
+);
+
+// index buffer with the triangles in meshlet order, meshlet i covers the
+// indices from 3 * triangle_offset to 3 * (triangle_offset + triangle_count)
+std::vector<uint32_t> get_meshlet_indices(const meshlet_mesh& mesh);
+
+// sphere containing all meshlets, center and radius
+void get_mesh_bounds(const meshlet_mesh& mesh, float sphere[4]);
+
+// grows the spheres of all meshlets by margin and disables their cones, for
+// meshes whose vertices move by up to margin, like skinned poses
+void loosen_meshlets(meshlet_mesh& mesh, float margin);
+
+// view frustum and camera position in the object space of an instance
+struct meshlet_culler {
+    float planes[6][4];
+    float camera[3];
+    // false if the camera is at infinity, like for orthographic projections
+    bool cone_culling;
+};
+
+// matrix is column major and transforms to clip space
+void create_meshlet_culler(const float matrix[16], meshlet_culler& culler);
+bool is_meshlet_visible(const meshlet_culler& culler, const meshlet& meshlet);
+
+// writes one indirect draw for each visible meshlet of one instance,
+// returns the number of draws written, or -1u if they didn't fit
+uint32_t write_meshlet_commands(
+    const meshlet_mesh& mesh, const mesh_allocation& allocation,
+    const meshlet_culler& culler, uint32_t instance,
+    std::span<VkDrawIndexedIndirectCommand> commands
+);
+
+// checks for the extension and for task and mesh shader support
+bool supports_mesh_shader(VkPhysicalDevice physical_device);
+
+// meshlets, vertices and triangles of a meshlet_mesh on the GPU, each
+// registered as a bindless storage buffer
+struct meshlet_buffer {
+    mapped_buffer buffer;
+    uint32_t meshlet_count;
+    uint32_t meshlets, vertices, triangles;
+};
+
+void create_meshlet_buffer(
+    VkDevice device, memory_tracker& tracker, bindless_set& bindless,
+    const meshlet_mesh& mesh, meshlet_buffer& buffer
+);
+void destroy_meshlet_buffer(
+    VkDevice device, memory_tracker& tracker, bindless_set& bindless,
+    const meshlet_buffer& buffer
+);
+
+// number of meshlets that passed the task shader, one per frame in flight
+struct meshlet_counter {
+    mapped_buffer buffer;
+    uint32_t* count;
+    uint32_t slot;
+};
+
+void create_meshlet_counter(
+    VkDevice device, memory_tracker& tracker, bindless_set& bindless,
+    meshlet_counter& counter
+);
+void destroy_meshlet_counter(
+    VkDevice device, memory_tracker& tracker, bindless_set& bindless,
+    const meshlet_counter& counter
+);
+// makes the count visible to the host, must be recorded after all draws
+// and outside of a render pass
+void record_meshlet_counter_barrier(
+    VkCommandBuffer command_buffer, const meshlet_counter& counter
+);
+
+// matches the push constants in meshlet.glsl, buffers are bindless slots
+struct meshlet_constants {
+    uint32_t meshlets, meshlet_vertices, meshlet_triangles;
+    uint32_t vertices, instances, counter;
+    uint32_t meshlet_count, vertex_offset, vertex_stride;
+    uint32_t instance;
+    // per instance flags from the occlusion test, or no_buffer to draw all
+    uint32_t visibility;
+};
+
+// the pipeline layout needs a push constant range for task and mesh stages
+void push_meshlet_constants(
+    VkCommandBuffer command_buffer, VkPipelineLayout layout,
+    const meshlet_constants& constants
+);
+// draws one instance of the mesh whose constants were pushed last, only the
+// instance is pushed
+void draw_meshlets(
+    VkCommandBuffer command_buffer,
+    PFN_vkCmdDrawMeshTasksEXT draw_mesh_tasks, VkPipelineLayout layout,
+    uint32_t meshlet_count, uint32_t instance
+);
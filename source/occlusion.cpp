@@ -0,0 +1,474 @@
+#include "occlusion.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+#include "ge1/shader_module.h"
+
+#include "shaders/hiz_reduce.glsl.h"
+#include "shaders/occlusion_cull.glsl.h"
+
+using namespace std;
+
+extern char _binary_shaders_hiz_reduce_glsl_spv_start;
+extern char _binary_shaders_hiz_reduce_glsl_spv_end;
+extern char _binary_shaders_occlusion_cull_glsl_spv_start;
+extern char _binary_shaders_occlusion_cull_glsl_spv_end;
+
+// bindings of set 1, matches occlusion.glsl
+enum occlusion_binding : uint32_t {
+    depth_binding, source_binding, destination_binding, pyramid_binding,
+};
+
+static constexpr shader_binding occlusion_set_bindings[]{
+    {1, depth_binding, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1},
+    {1, source_binding, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1},
+    {1, destination_binding, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1},
+    {1, pyramid_binding, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1},
+};
+
+static_assert(fits_layout(hiz_reduce_bindings, 1, occlusion_set_bindings));
+static_assert(
+    fits_layout(occlusion_cull_bindings, 1, occlusion_set_bindings)
+);
+static_assert(hiz_reduce_push_constant_size == sizeof(hiz_constants));
+static_assert(
+    occlusion_cull_push_constant_size == sizeof(occlusion_constants)
+);
+
+static VkPipeline create_compute_pipeline(
+    VkDevice device, VkPipelineLayout layout, VkShaderModule module
+) {
+    VkComputePipelineCreateInfo create_info{
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .stage = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+            .module = module,
+            .pName = "main",
+        },
+        .layout = layout,
+    };
+    VkPipeline pipeline;
+    if (
+        vkCreateComputePipelines(
+            device, VK_NULL_HANDLE, 1, &create_info, nullptr, &pipeline
+        ) != VK_SUCCESS
+    ) {
+        throw runtime_error("failed to create compute pipeline");
+    }
+    return pipeline;
+}
+
+void create_occlusion_pipeline(
+    VkDevice device, const bindless_set& bindless,
+    occlusion_pipeline& pipeline
+) {
+    pipeline.reduce_module = ge1::create_shader_module(device, {
+        &_binary_shaders_hiz_reduce_glsl_spv_start,
+        &_binary_shaders_hiz_reduce_glsl_spv_end
+    });
+    pipeline.cull_module = ge1::create_shader_module(device, {
+        &_binary_shaders_occlusion_cull_glsl_spv_start,
+        &_binary_shaders_occlusion_cull_glsl_spv_end
+    });
+
+    // only texelFetch is used, the sampler just has to be valid
+    {
+        VkSamplerCreateInfo create_info{
+            .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+            .magFilter = VK_FILTER_NEAREST,
+            .minFilter = VK_FILTER_NEAREST,
+            .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+            .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+            .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+            .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+            .maxLod = VK_LOD_CLAMP_NONE,
+        };
+        if (
+            vkCreateSampler(
+                device, &create_info, nullptr, &pipeline.sampler
+            ) != VK_SUCCESS
+        ) {
+            throw runtime_error("failed to create sampler");
+        }
+    }
+
+    {
+        VkDescriptorSetLayoutBinding bindings[size(occlusion_set_bindings)];
+        for (auto i = 0u; i < size(bindings); i++) {
+            bindings[i] = {
+                .binding = occlusion_set_bindings[i].binding,
+                .descriptorType = occlusion_set_bindings[i].type,
+                .descriptorCount = occlusion_set_bindings[i].count,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            };
+        }
+        VkDescriptorSetLayoutCreateInfo create_info{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .bindingCount = size(bindings),
+            .pBindings = bindings,
+        };
+        if (
+            vkCreateDescriptorSetLayout(
+                device, &create_info, nullptr, &pipeline.set_layout
+            ) != VK_SUCCESS
+        ) {
+            throw runtime_error("failed to create descriptor set layout");
+        }
+    }
+
+    {
+        VkDescriptorSetLayout set_layouts[]{
+            bindless.layout, pipeline.set_layout,
+        };
+        VkPushConstantRange push_constant_range{
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .offset = 0,
+            .size = max(
+                hiz_reduce_push_constant_size,
+                occlusion_cull_push_constant_size
+            ),
+        };
+        VkPipelineLayoutCreateInfo create_info{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .setLayoutCount = size(set_layouts),
+            .pSetLayouts = set_layouts,
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &push_constant_range,
+        };
+        if (
+            vkCreatePipelineLayout(
+                device, &create_info, nullptr, &pipeline.layout
+            ) != VK_SUCCESS
+        ) {
+            throw runtime_error("failed to create pipeline layout");
+        }
+    }
+
+    pipeline.reduce_pipeline = create_compute_pipeline(
+        device, pipeline.layout, pipeline.reduce_module
+    );
+    pipeline.cull_pipeline = create_compute_pipeline(
+        device, pipeline.layout, pipeline.cull_module
+    );
+}
+
+void destroy_occlusion_pipeline(
+    VkDevice device, const occlusion_pipeline& pipeline
+) {
+    vkDestroyPipeline(device, pipeline.reduce_pipeline, nullptr);
+    vkDestroyPipeline(device, pipeline.cull_pipeline, nullptr);
+    vkDestroyPipelineLayout(device, pipeline.layout, nullptr);
+    vkDestroyDescriptorSetLayout(device, pipeline.set_layout, nullptr);
+    vkDestroySampler(device, pipeline.sampler, nullptr);
+    vkDestroyShaderModule(device, pipeline.reduce_module, nullptr);
+    vkDestroyShaderModule(device, pipeline.cull_module, nullptr);
+}
+
+void create_hiz_pyramid(
+    VkDevice device, const occlusion_pipeline& pipeline,
+    const render_graph_instance& instance,
+    uint32_t depth_image, uint32_t pyramid_image, hiz_pyramid& pyramid
+) {
+    auto& image = instance.images[pyramid_image];
+    pyramid.image = image.image;
+    pyramid.extent = image.extent;
+    pyramid.levels = image.mip_levels;
+
+    // storage images can only have one level per view
+    pyramid.views.resize(pyramid.levels);
+    for (auto level = 0u; level < pyramid.levels; level++) {
+        VkImageViewCreateInfo create_info{
+            .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+            .image = image.image,
+            .viewType = VK_IMAGE_VIEW_TYPE_2D,
+            .format = VK_FORMAT_R32_SFLOAT,
+            .subresourceRange = {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .baseMipLevel = level,
+                .levelCount = 1,
+                .baseArrayLayer = 0,
+                .layerCount = 1,
+            },
+        };
+        if (
+            vkCreateImageView(
+                device, &create_info, nullptr, &pyramid.views[level]
+            ) != VK_SUCCESS
+        ) {
+            throw runtime_error("failed to create image view");
+        }
+    }
+
+    {
+        VkDescriptorPoolSize sizes[]{
+            {
+                VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                2 * pyramid.levels,
+            }, {
+                VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                2 * pyramid.levels,
+            },
+        };
+        VkDescriptorPoolCreateInfo create_info{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+            .maxSets = pyramid.levels,
+            .poolSizeCount = size(sizes),
+            .pPoolSizes = sizes,
+        };
+        if (
+            vkCreateDescriptorPool(
+                device, &create_info, nullptr, &pyramid.pool
+            ) != VK_SUCCESS
+        ) {
+            throw runtime_error("failed to create descriptor pool");
+        }
+    }
+
+    {
+        vector<VkDescriptorSetLayout> layouts(
+            pyramid.levels, pipeline.set_layout
+        );
+        VkDescriptorSetAllocateInfo allocate_info{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .descriptorPool = pyramid.pool,
+            .descriptorSetCount = pyramid.levels,
+            .pSetLayouts = layouts.data(),
+        };
+        pyramid.sets.resize(pyramid.levels);
+        if (
+            vkAllocateDescriptorSets(
+                device, &allocate_info, pyramid.sets.data()
+            ) != VK_SUCCESS
+        ) {
+            throw runtime_error("failed to allocate descriptor sets");
+        }
+    }
+
+    // level 0 reads the depth buffer, but its set still needs a valid
+    // source, other levels read the previous level
+    for (auto level = 0u; level < pyramid.levels; level++) {
+        VkDescriptorImageInfo depth_info{
+            .sampler = pipeline.sampler,
+            .imageView = instance.images[depth_image].view,
+            .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        };
+        VkDescriptorImageInfo source_info{
+            .imageView = pyramid.views[level > 0 ? level - 1 : 0],
+            .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+        };
+        VkDescriptorImageInfo destination_info{
+            .imageView = pyramid.views[level],
+            .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+        };
+        VkDescriptorImageInfo pyramid_info{
+            .sampler = pipeline.sampler,
+            .imageView = image.view,
+            .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        };
+        auto write = [&](
+            uint32_t binding, VkDescriptorType type,
+            const VkDescriptorImageInfo* info
+        ) {
+            return VkWriteDescriptorSet{
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = pyramid.sets[level],
+                .dstBinding = binding,
+                .descriptorCount = 1,
+                .descriptorType = type,
+                .pImageInfo = info,
+            };
+        };
+        VkWriteDescriptorSet writes[]{
+            write(
+                depth_binding, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                &depth_info
+            ),
+            write(
+                source_binding, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                &source_info
+            ),
+            write(
+                destination_binding, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                &destination_info
+            ),
+            write(
+                pyramid_binding, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                &pyramid_info
+            ),
+        };
+        vkUpdateDescriptorSets(device, size(writes), writes, 0, nullptr);
+    }
+}
+
+void destroy_hiz_pyramid(VkDevice device, const hiz_pyramid& pyramid) {
+    vkDestroyDescriptorPool(device, pyramid.pool, nullptr);
+    for (auto view : pyramid.views) {
+        vkDestroyImageView(device, view, nullptr);
+    }
+}
+
+void record_hiz_pyramid(
+    VkCommandBuffer command_buffer, const occlusion_pipeline& pipeline,
+    const hiz_pyramid& pyramid, VkSampleCountFlagBits samples
+) {
+    vkCmdBindPipeline(
+        command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+        pipeline.reduce_pipeline
+    );
+    for (auto level = 0u; level < pyramid.levels; level++) {
+        if (level > 0) {
+            // the previous level is complete before it is reduced
+            VkImageMemoryBarrier barrier{
+                .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+                .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+                .oldLayout = VK_IMAGE_LAYOUT_GENERAL,
+                .newLayout = VK_IMAGE_LAYOUT_GENERAL,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .image = pyramid.image,
+                .subresourceRange = {
+                    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                    .baseMipLevel = level - 1,
+                    .levelCount = 1,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1,
+                },
+            };
+            vkCmdPipelineBarrier(
+                command_buffer,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                0, nullptr, 0, nullptr, 1, &barrier
+            );
+        }
+
+        vkCmdBindDescriptorSets(
+            command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.layout,
+            1, 1, &pyramid.sets[level], 0, nullptr
+        );
+        hiz_constants constants{
+            .level = level,
+            .samples = uint32_t(samples),
+        };
+        vkCmdPushConstants(
+            command_buffer, pipeline.layout, VK_SHADER_STAGE_COMPUTE_BIT,
+            0, sizeof(constants), &constants
+        );
+        auto width = max(pyramid.extent.width >> level, 1u);
+        auto height = max(pyramid.extent.height >> level, 1u);
+        vkCmdDispatch(command_buffer, (width + 7) / 8, (height + 7) / 8, 1);
+    }
+}
+
+// offsets of storage buffers need to be aligned, 256 is the largest
+// minStorageBufferOffsetAlignment allowed
+static VkDeviceSize align(VkDeviceSize offset) {
+    return (offset + 255) / 256 * 256;
+}
+
+void create_occlusion_buffer(
+    VkDevice device, memory_tracker& tracker, bindless_set& bindless,
+    uint32_t capacity, occlusion_buffer& buffer
+) {
+    auto bounds_size = sizeof(float) * 4 * uint64_t(capacity);
+    auto visibility_size = sizeof(uint32_t) * uint64_t(capacity);
+    auto visibility_offset = align(bounds_size);
+    auto rejected_offset = align(visibility_offset + visibility_size);
+
+    create_mapped_buffer(
+        device, tracker, memory_tag::other,
+        rejected_offset + sizeof(uint32_t),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, buffer.buffer
+    );
+    auto data = (char*)buffer.buffer.data;
+    buffer.capacity = capacity;
+    buffer.bounds = (float*)data;
+    buffer.visibility = (uint32_t*)(data + visibility_offset);
+    buffer.rejected = (uint32_t*)(data + rejected_offset);
+    memset(buffer.bounds, 0, bounds_size);
+    fill(buffer.visibility, buffer.visibility + capacity, 1u);
+    *buffer.rejected = 0;
+
+    buffer.bounds_slot = add_buffer(
+        device, bindless, buffer.buffer.buffer, 0, bounds_size
+    );
+    buffer.visibility_slot = add_buffer(
+        device, bindless, buffer.buffer.buffer, visibility_offset,
+        visibility_size
+    );
+    buffer.rejected_slot = add_buffer(
+        device, bindless, buffer.buffer.buffer, rejected_offset,
+        sizeof(uint32_t)
+    );
+}
+
+void destroy_occlusion_buffer(
+    VkDevice device, memory_tracker& tracker, bindless_set& bindless,
+    const occlusion_buffer& buffer
+) {
+    remove_buffer(bindless, buffer.bounds_slot);
+    remove_buffer(bindless, buffer.visibility_slot);
+    remove_buffer(bindless, buffer.rejected_slot);
+    destroy_mapped_buffer(device, tracker, buffer.buffer);
+}
+
+void record_occlusion_cull(
+    VkCommandBuffer command_buffer, const occlusion_pipeline& pipeline,
+    const bindless_set& bindless, const hiz_pyramid& pyramid,
+    occlusion_constants constants, VkPipelineStageFlags draw_stage
+) {
+    vkCmdBindPipeline(
+        command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+        pipeline.cull_pipeline
+    );
+    // any level's set has the whole pyramid
+    VkDescriptorSet sets[]{bindless.set, pyramid.sets[0]};
+    vkCmdBindDescriptorSets(
+        command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.layout,
+        0, size(sets), sets, 0, nullptr
+    );
+
+    constants.stage = 0;
+    vkCmdPushConstants(
+        command_buffer, pipeline.layout, VK_SHADER_STAGE_COMPUTE_BIT,
+        0, sizeof(constants), &constants
+    );
+    vkCmdDispatch(command_buffer, (constants.instance_count + 63) / 64, 1, 1);
+
+    VkMemoryBarrier barrier{
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+    };
+    if (constants.command_count > 0) {
+        // the command filter reads the visibility of all instances
+        vkCmdPipelineBarrier(
+            command_buffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+            1, &barrier, 0, nullptr, 0, nullptr
+        );
+        constants.stage = 1;
+        vkCmdPushConstants(
+            command_buffer, pipeline.layout, VK_SHADER_STAGE_COMPUTE_BIT,
+            0, sizeof(constants), &constants
+        );
+        vkCmdDispatch(
+            command_buffer, (constants.command_count + 63) / 64, 1, 1
+        );
+    }
+
+    barrier.dstAccessMask =
+        VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT |
+        VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(
+        command_buffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        draw_stage | VK_PIPELINE_STAGE_HOST_BIT, 0,
+        1, &barrier, 0, nullptr, 0, nullptr
+    );
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "buffer.h"
+#include "bindless.h"
+#include "render_graph.h"
+
+// Two phase occlusion culling against a hierarchical depth buffer. Instances
+// that passed the previous test are drawn first, their depth is reduced into
+// a pyramid of farthest depths and every instance is tested against it.
+// Instances that were not drawn in the first phase but passed the test are
+// drawn in a second phase, on top of the same depth buffer.
+
+// must match the push constants in hiz_reduce.glsl
+struct hiz_constants {
+    uint32_t level, samples;
+};
+
+// must match the push constants in occlusion_cull.glsl, buffers are
+// bindless slots
+struct occlusion_constants {
+    uint32_t instances, bounds, visibility, counter;
+    uint32_t commands;
+    uint32_t instance_count, command_offset, command_count;
+    uint32_t stage;
+};
+
+// descriptor set 0 is the bindless set, set 1 has the images of one level
+// of a hiz_pyramid, see occlusion.glsl
+struct occlusion_pipeline {
+    VkDescriptorSetLayout set_layout;
+    VkPipelineLayout layout;
+    VkShaderModule reduce_module, cull_module;
+    VkPipeline reduce_pipeline, cull_pipeline;
+    VkSampler sampler;
+};
+
+void create_occlusion_pipeline(
+    VkDevice device, const bindless_set& bindless,
+    occlusion_pipeline& pipeline
+);
+void destroy_occlusion_pipeline(
+    VkDevice device, const occlusion_pipeline& pipeline
+);
+
+// views and descriptor sets for the pyramid image of one render graph
+// instance, which must have a full mip chain and an R32_SFLOAT format
+struct hiz_pyramid {
+    VkImage image;
+    VkExtent2D extent;
+    uint32_t levels;
+    // one per level
+    std::vector<VkImageView> views;
+    VkDescriptorPool pool;
+    std::vector<VkDescriptorSet> sets;
+};
+
+void create_hiz_pyramid(
+    VkDevice device, const occlusion_pipeline& pipeline,
+    const render_graph_instance& instance,
+    uint32_t depth_image, uint32_t pyramid_image, hiz_pyramid& pyramid
+);
+void destroy_hiz_pyramid(VkDevice device, const hiz_pyramid& pyramid);
+
+// reduces the multisampled depth buffer into the pyramid, the depth buffer
+// must be in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL and the pyramid in
+// VK_IMAGE_LAYOUT_GENERAL
+void record_hiz_pyramid(
+    VkCommandBuffer command_buffer, const occlusion_pipeline& pipeline,
+    const hiz_pyramid& pyramid, VkSampleCountFlagBits samples
+);
+
+// per instance bounds and test results, one per frame in flight
+struct occlusion_buffer {
+    mapped_buffer buffer;
+    uint32_t capacity;
+    // object space sphere of each instance, center and radius
+    float* bounds;
+    // non-zero for instances that passed the last test, all start visible
+    uint32_t* visibility;
+    // number of instances that failed the last test, reset by the caller
+    uint32_t* rejected;
+    uint32_t bounds_slot, visibility_slot, rejected_slot;
+};
+
+void create_occlusion_buffer(
+    VkDevice device, memory_tracker& tracker, bindless_set& bindless,
+    uint32_t capacity, occlusion_buffer& buffer
+);
+void destroy_occlusion_buffer(
+    VkDevice device, memory_tracker& tracker, bindless_set& bindless,
+    const occlusion_buffer& buffer
+);
+
+// tests all instances against the pyramid, which must be in
+// VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, then sets instanceCount to 0 for
+// indirect commands of instances that failed, if there are any. Results are
+// made available to draw_stage and to the host.
+void record_occlusion_cull(
+    VkCommandBuffer command_buffer, const occlusion_pipeline& pipeline,
+    const bindless_set& bindless, const hiz_pyramid& pyramid,
+    occlusion_constants constants, VkPipelineStageFlags draw_stage
+);
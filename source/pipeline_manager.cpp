@@ -0,0 +1,630 @@
+#include "pipeline_manager.h"
+
+#include <stdexcept>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <fstream>
+#include <iterator>
+
+using namespace std;
+
+bool supports_pipeline_cache_control(VkPhysicalDevice physical_device) {
+    uint32_t count;
+    vkEnumerateDeviceExtensionProperties(
+        physical_device, nullptr, &count, nullptr
+    );
+    auto extensions = make_unique<VkExtensionProperties[]>(count);
+    vkEnumerateDeviceExtensionProperties(
+        physical_device, nullptr, &count, extensions.get()
+    );
+    bool found = false;
+    for (auto i = 0u; i < count; i++) {
+        found = found || strcmp(
+            extensions[i].extensionName,
+            VK_EXT_PIPELINE_CREATION_CACHE_CONTROL_EXTENSION_NAME
+        ) == 0;
+    }
+    if (!found) {
+        return false;
+    }
+
+    VkPhysicalDevicePipelineCreationCacheControlFeaturesEXT
+        cache_control_features{
+            .sType =
+                VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PIPELINE_CREATION_CACHE_CONTROL_FEATURES_EXT,
+        };
+    VkPhysicalDeviceFeatures2 features{
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &cache_control_features,
+    };
+    vkGetPhysicalDeviceFeatures2(physical_device, &features);
+    return cache_control_features.pipelineCreationCacheControl;
+}
+
+// the state of a create info as bytes, field by field, since the structs
+// have padding
+struct state_writer {
+    string bytes;
+
+    template<class T>
+    void add(T value) {
+        static_assert(is_scalar_v<T>);
+        bytes.append((const char*)&value, sizeof(value));
+    }
+    void add(const void* data, size_t size) {
+        add(size);
+        bytes.append((const char*)data, size);
+    }
+};
+
+static void check_chain(const void* next) {
+    if (next) {
+        throw runtime_error("pipeline state with pNext is not supported");
+    }
+}
+
+static void write_stencil(state_writer& writer, const VkStencilOpState& op) {
+    writer.add(op.failOp);
+    writer.add(op.passOp);
+    writer.add(op.depthFailOp);
+    writer.add(op.compareOp);
+    writer.add(op.compareMask);
+    writer.add(op.writeMask);
+    writer.add(op.reference);
+}
+
+// for dynamic rendering, the only structure allowed in the chain
+static const VkPipelineRenderingCreateInfoKHR* get_rendering(
+    const VkGraphicsPipelineCreateInfo& info
+) {
+    auto rendering = (const VkPipelineRenderingCreateInfoKHR*)info.pNext;
+    if (!rendering) {
+        return nullptr;
+    }
+    if (
+        rendering->sType !=
+            VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR
+    ) {
+        throw runtime_error("pipeline state with pNext is not supported");
+    }
+    check_chain(rendering->pNext);
+    return rendering;
+}
+
+// everything except for the base pipeline, which is set by the manager
+static void write_state(
+    state_writer& writer, const VkGraphicsPipelineCreateInfo& info
+) {
+    auto rendering = get_rendering(info);
+    writer.add(rendering != nullptr);
+    if (rendering) {
+        writer.add(rendering->viewMask);
+        writer.add(
+            rendering->pColorAttachmentFormats,
+            sizeof(VkFormat) * rendering->colorAttachmentCount
+        );
+        writer.add(rendering->depthAttachmentFormat);
+        writer.add(rendering->stencilAttachmentFormat);
+    }
+    writer.add(info.flags);
+    writer.add(info.stageCount);
+    for (auto i = 0u; i < info.stageCount; i++) {
+        auto& stage = info.pStages[i];
+        check_chain(stage.pNext);
+        writer.add(stage.flags);
+        writer.add(stage.stage);
+        writer.add(stage.module);
+        writer.add(stage.pName, strlen(stage.pName));
+        auto specialization = stage.pSpecializationInfo;
+        writer.add(specialization != nullptr);
+        if (specialization) {
+            writer.add(specialization->mapEntryCount);
+            for (auto j = 0u; j < specialization->mapEntryCount; j++) {
+                auto& entry = specialization->pMapEntries[j];
+                writer.add(entry.constantID);
+                writer.add(entry.offset);
+                writer.add(entry.size);
+            }
+            writer.add(specialization->pData, specialization->dataSize);
+        }
+    }
+
+    auto vertex_input = info.pVertexInputState;
+    writer.add(vertex_input != nullptr);
+    if (vertex_input) {
+        check_chain(vertex_input->pNext);
+        writer.add(vertex_input->flags);
+        writer.add(vertex_input->vertexBindingDescriptionCount);
+        for (
+            auto i = 0u; i < vertex_input->vertexBindingDescriptionCount; i++
+        ) {
+            auto& binding = vertex_input->pVertexBindingDescriptions[i];
+            writer.add(binding.binding);
+            writer.add(binding.stride);
+            writer.add(binding.inputRate);
+        }
+        writer.add(vertex_input->vertexAttributeDescriptionCount);
+        for (
+            auto i = 0u; i < vertex_input->vertexAttributeDescriptionCount;
+            i++
+        ) {
+            auto& attribute = vertex_input->pVertexAttributeDescriptions[i];
+            writer.add(attribute.location);
+            writer.add(attribute.binding);
+            writer.add(attribute.format);
+            writer.add(attribute.offset);
+        }
+    }
+
+    auto input_assembly = info.pInputAssemblyState;
+    writer.add(input_assembly != nullptr);
+    if (input_assembly) {
+        check_chain(input_assembly->pNext);
+        writer.add(input_assembly->flags);
+        writer.add(input_assembly->topology);
+        writer.add(input_assembly->primitiveRestartEnable);
+    }
+
+    auto tessellation = info.pTessellationState;
+    writer.add(tessellation != nullptr);
+    if (tessellation) {
+        check_chain(tessellation->pNext);
+        writer.add(tessellation->flags);
+        writer.add(tessellation->patchControlPoints);
+    }
+
+    auto viewport = info.pViewportState;
+    writer.add(viewport != nullptr);
+    if (viewport) {
+        check_chain(viewport->pNext);
+        writer.add(viewport->flags);
+        writer.add(viewport->viewportCount);
+        writer.add(viewport->pViewports != nullptr);
+        auto viewports =
+            viewport->pViewports ? viewport->viewportCount : 0;
+        for (auto i = 0u; i < viewports; i++) {
+            auto& v = viewport->pViewports[i];
+            for (auto value : {v.x, v.y, v.width, v.height}) {
+                writer.add(value);
+            }
+            writer.add(v.minDepth);
+            writer.add(v.maxDepth);
+        }
+        writer.add(viewport->scissorCount);
+        writer.add(viewport->pScissors != nullptr);
+        auto scissors = viewport->pScissors ? viewport->scissorCount : 0;
+        for (auto i = 0u; i < scissors; i++) {
+            auto& scissor = viewport->pScissors[i];
+            writer.add(scissor.offset.x);
+            writer.add(scissor.offset.y);
+            writer.add(scissor.extent.width);
+            writer.add(scissor.extent.height);
+        }
+    }
+
+    auto rasterization = info.pRasterizationState;
+    writer.add(rasterization != nullptr);
+    if (rasterization) {
+        check_chain(rasterization->pNext);
+        writer.add(rasterization->flags);
+        writer.add(rasterization->depthClampEnable);
+        writer.add(rasterization->rasterizerDiscardEnable);
+        writer.add(rasterization->polygonMode);
+        writer.add(rasterization->cullMode);
+        writer.add(rasterization->frontFace);
+        writer.add(rasterization->depthBiasEnable);
+        writer.add(rasterization->depthBiasConstantFactor);
+        writer.add(rasterization->depthBiasClamp);
+        writer.add(rasterization->depthBiasSlopeFactor);
+        writer.add(rasterization->lineWidth);
+    }
+
+    auto multisample = info.pMultisampleState;
+    writer.add(multisample != nullptr);
+    if (multisample) {
+        check_chain(multisample->pNext);
+        writer.add(multisample->flags);
+        writer.add(multisample->rasterizationSamples);
+        writer.add(multisample->sampleShadingEnable);
+        writer.add(multisample->minSampleShading);
+        writer.add(multisample->pSampleMask != nullptr);
+        if (multisample->pSampleMask) {
+            writer.add(
+                multisample->pSampleMask, sizeof(VkSampleMask) *
+                ((multisample->rasterizationSamples + 31) / 32)
+            );
+        }
+        writer.add(multisample->alphaToCoverageEnable);
+        writer.add(multisample->alphaToOneEnable);
+    }
+
+    auto depth_stencil = info.pDepthStencilState;
+    writer.add(depth_stencil != nullptr);
+    if (depth_stencil) {
+        check_chain(depth_stencil->pNext);
+        writer.add(depth_stencil->flags);
+        writer.add(depth_stencil->depthTestEnable);
+        writer.add(depth_stencil->depthWriteEnable);
+        writer.add(depth_stencil->depthCompareOp);
+        writer.add(depth_stencil->depthBoundsTestEnable);
+        writer.add(depth_stencil->stencilTestEnable);
+        write_stencil(writer, depth_stencil->front);
+        write_stencil(writer, depth_stencil->back);
+        writer.add(depth_stencil->minDepthBounds);
+        writer.add(depth_stencil->maxDepthBounds);
+    }
+
+    auto color_blend = info.pColorBlendState;
+    writer.add(color_blend != nullptr);
+    if (color_blend) {
+        check_chain(color_blend->pNext);
+        writer.add(color_blend->flags);
+        writer.add(color_blend->logicOpEnable);
+        writer.add(color_blend->logicOp);
+        writer.add(color_blend->attachmentCount);
+        for (auto i = 0u; i < color_blend->attachmentCount; i++) {
+            auto& attachment = color_blend->pAttachments[i];
+            writer.add(attachment.blendEnable);
+            writer.add(attachment.srcColorBlendFactor);
+            writer.add(attachment.dstColorBlendFactor);
+            writer.add(attachment.colorBlendOp);
+            writer.add(attachment.srcAlphaBlendFactor);
+            writer.add(attachment.dstAlphaBlendFactor);
+            writer.add(attachment.alphaBlendOp);
+            writer.add(attachment.colorWriteMask);
+        }
+        for (auto constant : color_blend->blendConstants) {
+            writer.add(constant);
+        }
+    }
+
+    auto dynamic = info.pDynamicState;
+    writer.add(dynamic != nullptr);
+    if (dynamic) {
+        check_chain(dynamic->pNext);
+        writer.add(dynamic->flags);
+        writer.add(
+            dynamic->pDynamicStates,
+            sizeof(VkDynamicState) * dynamic->dynamicStateCount
+        );
+    }
+
+    writer.add(info.layout);
+    writer.add(info.renderPass);
+    writer.add(info.subpass);
+}
+
+// copies what the pointers of info point to and points them at the copies
+static void copy_state(
+    const VkGraphicsPipelineCreateInfo& info, pipeline_state& state
+) {
+    state.info = info;
+    state.info.basePipelineHandle = VK_NULL_HANDLE;
+    state.info.basePipelineIndex = -1;
+
+    if (auto rendering = get_rendering(info)) {
+        state.rendering = *rendering;
+        state.color_formats.assign(
+            rendering->pColorAttachmentFormats,
+            rendering->pColorAttachmentFormats +
+                rendering->colorAttachmentCount
+        );
+        state.rendering.pColorAttachmentFormats = state.color_formats.data();
+        state.info.pNext = &state.rendering;
+    }
+
+    state.stages.assign(info.pStages, info.pStages + info.stageCount);
+    state.entry_points.resize(info.stageCount);
+    state.specializations.resize(info.stageCount);
+    state.map_entries.resize(info.stageCount);
+    state.specialization_data.resize(info.stageCount);
+    for (auto i = 0u; i < info.stageCount; i++) {
+        auto& stage = state.stages[i];
+        state.entry_points[i] = stage.pName;
+        stage.pName = state.entry_points[i].c_str();
+        if (stage.pSpecializationInfo) {
+            auto& specialization = state.specializations[i];
+            specialization = *stage.pSpecializationInfo;
+            state.map_entries[i].assign(
+                specialization.pMapEntries,
+                specialization.pMapEntries + specialization.mapEntryCount
+            );
+            specialization.pMapEntries = state.map_entries[i].data();
+            auto data = (const char*)specialization.pData;
+            state.specialization_data[i].assign(
+                data, data + specialization.dataSize
+            );
+            specialization.pData = state.specialization_data[i].data();
+            stage.pSpecializationInfo = &specialization;
+        }
+    }
+    state.info.pStages = state.stages.data();
+
+    if (info.pVertexInputState) {
+        auto& vertex_input = state.vertex_input;
+        vertex_input = *info.pVertexInputState;
+        state.bindings.assign(
+            vertex_input.pVertexBindingDescriptions,
+            vertex_input.pVertexBindingDescriptions +
+                vertex_input.vertexBindingDescriptionCount
+        );
+        state.attributes.assign(
+            vertex_input.pVertexAttributeDescriptions,
+            vertex_input.pVertexAttributeDescriptions +
+                vertex_input.vertexAttributeDescriptionCount
+        );
+        vertex_input.pVertexBindingDescriptions = state.bindings.data();
+        vertex_input.pVertexAttributeDescriptions = state.attributes.data();
+        state.info.pVertexInputState = &vertex_input;
+    }
+    if (info.pInputAssemblyState) {
+        state.input_assembly = *info.pInputAssemblyState;
+        state.info.pInputAssemblyState = &state.input_assembly;
+    }
+    if (info.pTessellationState) {
+        state.tessellation = *info.pTessellationState;
+        state.info.pTessellationState = &state.tessellation;
+    }
+    if (info.pViewportState) {
+        auto& viewport = state.viewport;
+        viewport = *info.pViewportState;
+        if (viewport.pViewports) {
+            state.viewports.assign(
+                viewport.pViewports,
+                viewport.pViewports + viewport.viewportCount
+            );
+            viewport.pViewports = state.viewports.data();
+        }
+        if (viewport.pScissors) {
+            state.scissors.assign(
+                viewport.pScissors, viewport.pScissors + viewport.scissorCount
+            );
+            viewport.pScissors = state.scissors.data();
+        }
+        state.info.pViewportState = &viewport;
+    }
+    if (info.pRasterizationState) {
+        state.rasterization = *info.pRasterizationState;
+        state.info.pRasterizationState = &state.rasterization;
+    }
+    if (info.pMultisampleState) {
+        auto& multisample = state.multisample;
+        multisample = *info.pMultisampleState;
+        if (multisample.pSampleMask) {
+            state.sample_mask.assign(
+                multisample.pSampleMask, multisample.pSampleMask +
+                    (multisample.rasterizationSamples + 31) / 32
+            );
+            multisample.pSampleMask = state.sample_mask.data();
+        }
+        state.info.pMultisampleState = &multisample;
+    }
+    if (info.pDepthStencilState) {
+        state.depth_stencil = *info.pDepthStencilState;
+        state.info.pDepthStencilState = &state.depth_stencil;
+    }
+    if (info.pColorBlendState) {
+        auto& color_blend = state.color_blend;
+        color_blend = *info.pColorBlendState;
+        state.blend_attachments.assign(
+            color_blend.pAttachments,
+            color_blend.pAttachments + color_blend.attachmentCount
+        );
+        color_blend.pAttachments = state.blend_attachments.data();
+        state.info.pColorBlendState = &color_blend;
+    }
+    if (info.pDynamicState) {
+        auto& dynamic = state.dynamic;
+        dynamic = *info.pDynamicState;
+        state.dynamic_states.assign(
+            dynamic.pDynamicStates,
+            dynamic.pDynamicStates + dynamic.dynamicStateCount
+        );
+        dynamic.pDynamicStates = state.dynamic_states.data();
+        state.info.pDynamicState = &dynamic;
+    }
+}
+
+// derives from the fallback if it is ready, sets the pipeline on success
+static VkResult compile_pipeline(
+    pipeline_manager& manager, pipeline_entry& entry,
+    VkPipelineCreateFlags flags
+) {
+    auto info = entry.state.info;
+    info.flags |= VK_PIPELINE_CREATE_ALLOW_DERIVATIVES_BIT | flags;
+    if (entry.fallback_entry) {
+        auto base = entry.fallback_entry->pipeline.load();
+        if (base != VK_NULL_HANDLE) {
+            info.flags |= VK_PIPELINE_CREATE_DERIVATIVE_BIT;
+            info.basePipelineHandle = base;
+        }
+    }
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    auto result = vkCreateGraphicsPipelines(
+        manager.device, manager.cache, 1, &info, nullptr, &pipeline
+    );
+    if (result == VK_SUCCESS) {
+        entry.pipeline = pipeline;
+    }
+    return result;
+}
+
+static void run_compiler(pipeline_manager& manager) {
+    while (true) {
+        pipeline_entry* entry;
+        {
+            unique_lock lock(manager.mutex);
+            manager.condition.wait(lock, [&]() {
+                return manager.stopping || !manager.queue.empty();
+            });
+            // queued pipelines are still compiled when stopping
+            if (manager.queue.empty()) {
+                return;
+            }
+            entry = manager.queue.front();
+            manager.queue.pop_front();
+        }
+
+        bool compiled = compile_pipeline(manager, *entry, 0) == VK_SUCCESS;
+        {
+            lock_guard lock(manager.mutex);
+            if (compiled) {
+                manager.stats.compiled++;
+            } else {
+                entry->failed = true;
+                manager.stats.failed++;
+            }
+        }
+        manager.finished.notify_all();
+    }
+}
+
+void create_pipeline_manager(
+    VkDevice device, bool cache_control, uint32_t thread_count,
+    const char* cache_path, pipeline_manager& manager
+) {
+    manager.device = device;
+    manager.cache_path = cache_path;
+    manager.cache_control = cache_control;
+    manager.stopping = false;
+    manager.stats = {};
+
+    // a missing file leaves the cache empty
+    vector<char> data;
+    if (cache_path) {
+        ifstream file(cache_path, ios::binary);
+        data.assign(
+            istreambuf_iterator<char>(file), istreambuf_iterator<char>()
+        );
+    }
+    VkPipelineCacheCreateInfo create_info{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+        .initialDataSize = data.size(),
+        .pInitialData = data.data(),
+    };
+    if (
+        vkCreatePipelineCache(
+            device, &create_info, nullptr, &manager.cache
+        ) != VK_SUCCESS
+    ) {
+        throw runtime_error("failed to create pipeline cache");
+    }
+
+    for (auto i = 0u; i < max(thread_count, 1u); i++) {
+        manager.compilers.emplace_back(run_compiler, ref(manager));
+    }
+}
+
+void destroy_pipeline_manager(pipeline_manager& manager) {
+    {
+        lock_guard lock(manager.mutex);
+        manager.stopping = true;
+    }
+    manager.condition.notify_all();
+    for (auto& compiler : manager.compilers) {
+        compiler.join();
+    }
+    manager.compilers.clear();
+
+    vector<char> data;
+    if (manager.cache_path) {
+        size_t size;
+        vkGetPipelineCacheData(manager.device, manager.cache, &size, nullptr);
+        data.resize(size);
+        vkGetPipelineCacheData(
+            manager.device, manager.cache, &size, data.data()
+        );
+        data.resize(size);
+    }
+
+    for (auto& entry : manager.entries) {
+        vkDestroyPipeline(manager.device, entry.pipeline, nullptr);
+    }
+    manager.entries.clear();
+    manager.ids.clear();
+    vkDestroyPipelineCache(manager.device, manager.cache, nullptr);
+
+    if (manager.cache_path) {
+        ofstream file(manager.cache_path, ios::binary);
+        file.write(data.data(), data.size());
+        if (!file) {
+            throw runtime_error("failed to write pipeline cache");
+        }
+    }
+}
+
+uint32_t request_pipeline(
+    pipeline_manager& manager, const VkGraphicsPipelineCreateInfo& info,
+    uint32_t fallback
+) {
+    state_writer writer;
+    write_state(writer, info);
+    auto found = manager.ids.find(writer.bytes);
+    {
+        lock_guard lock(manager.mutex);
+        manager.stats.requests++;
+        if (found != manager.ids.end()) {
+            manager.stats.deduplicated++;
+            return found->second;
+        }
+    }
+    if (fallback != no_pipeline && fallback >= manager.entries.size()) {
+        throw runtime_error("fallback pipeline doesn't exist");
+    }
+
+    // fallbacks always have lower ids, so they can't form cycles
+    uint32_t id = manager.entries.size();
+    auto& entry = manager.entries.emplace_back();
+    copy_state(info, entry.state);
+    entry.fallback = fallback;
+    entry.fallback_entry =
+        fallback == no_pipeline ? nullptr : &manager.entries[fallback];
+    entry.pipeline = VK_NULL_HANDLE;
+    entry.failed = false;
+    manager.ids.emplace(std::move(writer.bytes), id);
+
+    if (
+        manager.cache_control &&
+        compile_pipeline(
+            manager, entry,
+            VK_PIPELINE_CREATE_FAIL_ON_PIPELINE_COMPILE_REQUIRED_BIT_EXT
+        ) == VK_SUCCESS
+    ) {
+        lock_guard lock(manager.mutex);
+        manager.stats.cache_hits++;
+        return id;
+    }
+    {
+        lock_guard lock(manager.mutex);
+        manager.queue.push_back(&entry);
+    }
+    manager.condition.notify_one();
+    return id;
+}
+
+uint32_t get_ready_pipeline(const pipeline_manager& manager, uint32_t id) {
+    while (
+        id != no_pipeline &&
+        manager.entries[id].pipeline.load() == VK_NULL_HANDLE
+    ) {
+        id = manager.entries[id].fallback;
+    }
+    return id;
+}
+
+VkPipeline get_pipeline(const pipeline_manager& manager, uint32_t id) {
+    return manager.entries[id].pipeline;
+}
+
+VkPipeline wait_for_pipeline(pipeline_manager& manager, uint32_t id) {
+    auto& entry = manager.entries[id];
+    unique_lock lock(manager.mutex);
+    manager.finished.wait(lock, [&]() {
+        return entry.pipeline.load() != VK_NULL_HANDLE || entry.failed;
+    });
+    if (entry.failed) {
+        throw runtime_error("failed to create pipeline");
+    }
+    return entry.pipeline;
+}
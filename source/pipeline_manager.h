@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+#include <vulkan/vulkan.h>
+
+// Graphics pipelines are requested with a create info, whose state is
+// copied, so its pointers only have to be valid during the request.
+// Requests with the same state, compared field by field through all
+// pointers, share one pipeline. Pipelines are compiled on background
+// threads, until one is ready its fallback, a pipeline that can be used in
+// its place, is used instead. With VK_EXT_pipeline_creation_cache_control
+// a request first tries the pipeline cache on the calling thread and is
+// only compiled in the background if that misses. The cache is loaded from
+// a file and saved back to it, so that the next run hits it, the driver
+// ignores data of other devices or driver versions. Every pipeline allows
+// derivatives and derives from its fallback if that is ready.
+
+const uint32_t no_pipeline = -1u;
+
+// deep copy of a VkGraphicsPipelineCreateInfo, pNext chains must be null,
+// except for a VkPipelineRenderingCreateInfoKHR chained to the create info
+struct pipeline_state {
+    VkGraphicsPipelineCreateInfo info;
+    VkPipelineRenderingCreateInfoKHR rendering;
+    std::vector<VkFormat> color_formats;
+    std::vector<VkPipelineShaderStageCreateInfo> stages;
+    std::vector<std::string> entry_points;
+    std::vector<VkSpecializationInfo> specializations;
+    std::vector<std::vector<VkSpecializationMapEntry>> map_entries;
+    std::vector<std::vector<char>> specialization_data;
+    VkPipelineVertexInputStateCreateInfo vertex_input;
+    std::vector<VkVertexInputBindingDescription> bindings;
+    std::vector<VkVertexInputAttributeDescription> attributes;
+    VkPipelineInputAssemblyStateCreateInfo input_assembly;
+    VkPipelineTessellationStateCreateInfo tessellation;
+    VkPipelineViewportStateCreateInfo viewport;
+    std::vector<VkViewport> viewports;
+    std::vector<VkRect2D> scissors;
+    VkPipelineRasterizationStateCreateInfo rasterization;
+    VkPipelineMultisampleStateCreateInfo multisample;
+    std::vector<VkSampleMask> sample_mask;
+    VkPipelineDepthStencilStateCreateInfo depth_stencil;
+    VkPipelineColorBlendStateCreateInfo color_blend;
+    std::vector<VkPipelineColorBlendAttachmentState> blend_attachments;
+    VkPipelineDynamicStateCreateInfo dynamic;
+    std::vector<VkDynamicState> dynamic_states;
+};
+
+struct pipeline_entry {
+    pipeline_state state;
+    uint32_t fallback;
+    // for compiler threads, which can't index entries while it grows
+    const pipeline_entry* fallback_entry;
+    // written once by the thread that creates the pipeline
+    std::atomic<VkPipeline> pipeline;
+    std::atomic<bool> failed;
+};
+
+struct pipeline_stats {
+    uint32_t requests, deduplicated;
+    // created on the calling thread from the pipeline cache
+    uint32_t cache_hits;
+    uint32_t compiled, failed;
+};
+
+struct pipeline_manager {
+    VkDevice device;
+    VkPipelineCache cache;
+    // null if the cache isn't stored
+    const char* cache_path;
+    bool cache_control;
+
+    // indexed by pipeline id, elements never move
+    std::deque<pipeline_entry> entries;
+    // pipeline id by the serialized state
+    std::unordered_map<std::string, uint32_t> ids;
+
+    // pipelines waiting for a compiler thread
+    std::deque<pipeline_entry*> queue;
+    std::mutex mutex;
+    std::condition_variable condition, finished;
+    bool stopping;
+    std::vector<std::thread> compilers;
+
+    pipeline_stats stats;
+};
+
+// checks for the extension and the feature, which must then be enabled
+bool supports_pipeline_cache_control(VkPhysicalDevice physical_device);
+
+// cache_path is the file the cache is loaded from, if it exists, and saved
+// to, or null
+void create_pipeline_manager(
+    VkDevice device, bool cache_control, uint32_t thread_count,
+    const char* cache_path, pipeline_manager& manager
+);
+// waits for all compilations, saves the cache, destroys all pipelines,
+// none may be in use. Throws if the cache can't be written.
+void destroy_pipeline_manager(pipeline_manager& manager);
+
+// returns the id of the pipeline, fallback is no_pipeline or the id of a
+// pipeline that may be used until this one is ready. Requests and lookups
+// must all be made from the same thread.
+uint32_t request_pipeline(
+    pipeline_manager& manager, const VkGraphicsPipelineCreateInfo& info,
+    uint32_t fallback = no_pipeline
+);
+
+// the pipeline or its first fallback that is ready, no_pipeline if none is
+uint32_t get_ready_pipeline(const pipeline_manager& manager, uint32_t id);
+// VK_NULL_HANDLE if it isn't ready
+VkPipeline get_pipeline(const pipeline_manager& manager, uint32_t id);
+
+// blocks until the pipeline is compiled, throws if that failed
+VkPipeline wait_for_pipeline(pipeline_manager& manager, uint32_t id);
@@ -0,0 +1,311 @@
+#include "queues.h"
+
+#include <memory>
+#include <stdexcept>
+#include <algorithm>
+
+using namespace std;
+
+static const float queue_priority = 1.0f;
+
+// upper limit of semaphores per submission, including the timeline
+static const uint32_t max_submit_semaphores = 8;
+
+queue_families find_queue_families(
+    VkPhysicalDevice physical_device, VkSurfaceKHR surface
+) {
+    uint32_t family_count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(
+        physical_device, &family_count, nullptr
+    );
+    auto families = make_unique<VkQueueFamilyProperties[]>(family_count);
+    vkGetPhysicalDeviceQueueFamilyProperties(
+        physical_device, &family_count, families.get()
+    );
+
+    const VkQueueFlags graphics_compute =
+        VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT;
+
+    uint32_t
+        graphics = -1u, present = -1u, graphics_present = -1u,
+        compute = -1u, transfer = -1u;
+    for (auto i = 0u; i < family_count; i++) {
+        auto flags = families[i].queueFlags;
+
+        VkBool32 present_support = false;
+        vkGetPhysicalDeviceSurfaceSupportKHR(
+            physical_device, i, surface, &present_support
+        );
+
+        if (flags & VK_QUEUE_GRAPHICS_BIT) {
+            if (graphics == -1u)
+                graphics = i;
+            if (present_support && graphics_present == -1u)
+                graphics_present = i;
+        }
+        if (present_support && present == -1u) {
+            present = i;
+        }
+        // async compute: compute without graphics
+        if (
+            (flags & graphics_compute) == VK_QUEUE_COMPUTE_BIT &&
+            compute == -1u
+        ) {
+            compute = i;
+        }
+        // dedicated transfer: DMA engine without graphics or compute
+        if (
+            (flags & VK_QUEUE_TRANSFER_BIT) && !(flags & graphics_compute) &&
+            transfer == -1u
+        ) {
+            transfer = i;
+        }
+    }
+    if (graphics == -1u) {
+        throw runtime_error("no graphics queue found");
+    }
+    if (present == -1u) {
+        throw runtime_error("no present queue found");
+    }
+
+    // sharing graphics and present avoids ownership transfers
+    if (graphics_present != -1u) {
+        graphics = present = graphics_present;
+    }
+    // every graphics or compute family implicitly supports transfer
+    if (compute == -1u) {
+        compute = graphics;
+    }
+    if (transfer == -1u) {
+        transfer = compute;
+    }
+
+    return {
+        .graphics = graphics,
+        .compute = compute,
+        .transfer = transfer,
+        .present = present,
+    };
+}
+
+uint32_t get_queue_create_infos(
+    const queue_families& families, VkDeviceQueueCreateInfo (&infos)[4]
+) {
+    uint32_t all_families[]{
+        families.graphics, families.compute,
+        families.transfer, families.present,
+    };
+    uint32_t count = 0;
+    for (auto family : all_families) {
+        auto end = infos + count;
+        if (
+            find_if(infos, end, [family](const auto& info) {
+                return info.queueFamilyIndex == family;
+            }) != end
+        ) {
+            continue;
+        }
+        infos[count++] = {
+            .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+            .queueFamilyIndex = family,
+            .queueCount = 1,
+            .pQueuePriorities = &queue_priority,
+        };
+    }
+    return count;
+}
+
+static queue create_queue(VkDevice device, uint32_t family) {
+    queue queue{
+        .family = family,
+        .value = 0,
+    };
+    vkGetDeviceQueue(device, family, 0, &queue.handle);
+
+    VkSemaphoreTypeCreateInfo type_create_info{
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+        .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+        .initialValue = 0,
+    };
+    VkSemaphoreCreateInfo create_info{
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = &type_create_info,
+    };
+    if (
+        vkCreateSemaphore(device, &create_info, nullptr, &queue.timeline) !=
+        VK_SUCCESS
+    ) {
+        throw runtime_error("failed to create timeline semaphore");
+    }
+    return queue;
+}
+
+queues create_queues(VkDevice device, const queue_families& families) {
+    return {
+        .graphics = create_queue(device, families.graphics),
+        .compute = create_queue(device, families.compute),
+        .transfer = create_queue(device, families.transfer),
+        .present = create_queue(device, families.present),
+    };
+}
+
+void destroy_queues(VkDevice device, const queues& queues) {
+    for (auto& queue : {
+        queues.graphics, queues.compute, queues.transfer, queues.present
+    }) {
+        vkDestroySemaphore(device, queue.timeline, nullptr);
+    }
+}
+
+uint64_t submit(queue& queue, const queue_submission& submission) {
+    if (
+        submission.waits.size() > max_submit_semaphores ||
+        submission.signal_semaphores.size() + 1 > max_submit_semaphores
+    ) {
+        throw runtime_error("too many semaphores in submission");
+    }
+
+    VkSemaphore wait_semaphores[max_submit_semaphores];
+    uint64_t wait_values[max_submit_semaphores];
+    VkPipelineStageFlags wait_stages[max_submit_semaphores];
+    auto wait_count = static_cast<uint32_t>(submission.waits.size());
+    for (auto i = 0u; i < wait_count; i++) {
+        auto& wait = submission.waits[i];
+        wait_semaphores[i] = wait.semaphore;
+        wait_values[i] = wait.value;
+        wait_stages[i] = wait.stage;
+    }
+
+    // binary semaphores first, values for them are ignored
+    VkSemaphore signal_semaphores[max_submit_semaphores];
+    uint64_t signal_values[max_submit_semaphores]{};
+    auto signal_count =
+        static_cast<uint32_t>(submission.signal_semaphores.size());
+    copy(
+        submission.signal_semaphores.begin(),
+        submission.signal_semaphores.end(), signal_semaphores
+    );
+    auto value = queue.value + 1;
+    signal_semaphores[signal_count] = queue.timeline;
+    signal_values[signal_count] = value;
+    signal_count++;
+
+    VkTimelineSemaphoreSubmitInfo timeline_info{
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+        .waitSemaphoreValueCount = wait_count,
+        .pWaitSemaphoreValues = wait_values,
+        .signalSemaphoreValueCount = signal_count,
+        .pSignalSemaphoreValues = signal_values,
+    };
+    VkSubmitInfo submit_info{
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext = &timeline_info,
+        .waitSemaphoreCount = wait_count,
+        .pWaitSemaphores = wait_semaphores,
+        .pWaitDstStageMask = wait_stages,
+        .commandBufferCount =
+            static_cast<uint32_t>(submission.command_buffers.size()),
+        .pCommandBuffers = submission.command_buffers.data(),
+        .signalSemaphoreCount = signal_count,
+        .pSignalSemaphores = signal_semaphores,
+    };
+    if (
+        vkQueueSubmit(queue.handle, 1, &submit_info, submission.fence) !=
+        VK_SUCCESS
+    ) {
+        throw runtime_error("failed to submit command buffers");
+    }
+    queue.value = value;
+    return value;
+}
+
+void wait(VkDevice device, const queue& queue, uint64_t value) {
+    VkSemaphoreWaitInfo wait_info{
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+        .semaphoreCount = 1,
+        .pSemaphores = &queue.timeline,
+        .pValues = &value,
+    };
+    vkWaitSemaphores(device, &wait_info, -1ul);
+}
+
+static void image_ownership_barrier(
+    VkCommandBuffer command_buffer, const image_ownership_transfer& transfer,
+    bool release
+) {
+    // the release only makes the source accesses available, the acquire only
+    // makes them visible to the destination accesses
+    VkImageMemoryBarrier barrier{
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = release ? transfer.source_access : 0,
+        .dstAccessMask = release ? 0 : transfer.destination_access,
+        .oldLayout = transfer.old_layout,
+        .newLayout = transfer.new_layout,
+        .srcQueueFamilyIndex = transfer.source_family,
+        .dstQueueFamilyIndex = transfer.destination_family,
+        .image = transfer.image,
+        .subresourceRange{
+            .aspectMask = transfer.aspect,
+            .baseMipLevel = 0,
+            .levelCount = VK_REMAINING_MIP_LEVELS,
+            .baseArrayLayer = 0,
+            .layerCount = VK_REMAINING_ARRAY_LAYERS,
+        },
+    };
+    vkCmdPipelineBarrier(
+        command_buffer,
+        // the acquire chains with the semaphore wait on the destination stage
+        release ? transfer.source_stage : transfer.destination_stage,
+        release ?
+            VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : transfer.destination_stage,
+        0, 0, nullptr, 0, nullptr, 1, &barrier
+    );
+}
+
+void release_ownership(
+    VkCommandBuffer command_buffer, const image_ownership_transfer& transfer
+) {
+    image_ownership_barrier(command_buffer, transfer, true);
+}
+
+void acquire_ownership(
+    VkCommandBuffer command_buffer, const image_ownership_transfer& transfer
+) {
+    image_ownership_barrier(command_buffer, transfer, false);
+}
+
+static void buffer_ownership_barrier(
+    VkCommandBuffer command_buffer, const buffer_ownership_transfer& transfer,
+    bool release
+) {
+    VkBufferMemoryBarrier barrier{
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .srcAccessMask = release ? transfer.source_access : 0,
+        .dstAccessMask = release ? 0 : transfer.destination_access,
+        .srcQueueFamilyIndex = transfer.source_family,
+        .dstQueueFamilyIndex = transfer.destination_family,
+        .buffer = transfer.buffer,
+        .offset = transfer.offset,
+        .size = transfer.size,
+    };
+    vkCmdPipelineBarrier(
+        command_buffer,
+        // the acquire chains with the semaphore wait on the destination stage
+        release ? transfer.source_stage : transfer.destination_stage,
+        release ?
+            VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : transfer.destination_stage,
+        0, 0, nullptr, 1, &barrier, 0, nullptr
+    );
+}
+
+void release_ownership(
+    VkCommandBuffer command_buffer, const buffer_ownership_transfer& transfer
+) {
+    buffer_ownership_barrier(command_buffer, transfer, true);
+}
+
+void acquire_ownership(
+    VkCommandBuffer command_buffer, const buffer_ownership_transfer& transfer
+) {
+    buffer_ownership_barrier(command_buffer, transfer, false);
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+
+#include <vulkan/vulkan.h>
+
+// queue families used for each role, roles may share a family if the device
+// has no dedicated family for them
+struct queue_families {
+    uint32_t graphics, compute, transfer, present;
+};
+
+// finds a family for each role, preferring families that are not shared
+// with graphics for compute and transfer, so that work submitted to them can
+// overlap with rendering
+queue_families find_queue_families(
+    VkPhysicalDevice physical_device, VkSurfaceKHR surface
+);
+
+// fills in one create info per distinct family, returns the number of
+// create infos written
+uint32_t get_queue_create_infos(
+    const queue_families& families, VkDeviceQueueCreateInfo (&infos)[4]
+);
+
+struct queue {
+    VkQueue handle;
+    uint32_t family;
+    // timeline semaphore that is signaled by every submission to this queue
+    VkSemaphore timeline;
+    // value that the last submission signals
+    uint64_t value;
+};
+
+struct queues {
+    queue graphics, compute, transfer, present;
+};
+
+queues create_queues(VkDevice device, const queue_families& families);
+void destroy_queues(VkDevice device, const queues& queues);
+
+struct semaphore_wait {
+    VkSemaphore semaphore;
+    // ignored for binary semaphores
+    uint64_t value;
+    VkPipelineStageFlags stage;
+};
+
+// wait for all work submitted to the queue up to the given timeline value
+inline semaphore_wait wait_for(
+    const queue& queue, uint64_t value, VkPipelineStageFlags stage
+) {
+    return {queue.timeline, value, stage};
+}
+
+struct queue_submission {
+    std::span<const VkCommandBuffer> command_buffers;
+    std::span<const semaphore_wait> waits;
+    // binary semaphores, e.g. for presentation
+    std::span<const VkSemaphore> signal_semaphores;
+    VkFence fence = VK_NULL_HANDLE;
+};
+
+// submits to the queue and signals the next value of its timeline, which is
+// returned so that other queues can wait for it
+uint64_t submit(queue& queue, const queue_submission& submission);
+
+// blocks until the timeline of the queue reaches the given value
+void wait(VkDevice device, const queue& queue, uint64_t value);
+
+// queue family ownership transfer of an image between two queues, only
+// required if the image uses VK_SHARING_MODE_EXCLUSIVE and the families
+// differ
+struct image_ownership_transfer {
+    VkImage image;
+    VkImageAspectFlags aspect;
+    uint32_t source_family, destination_family;
+    VkImageLayout old_layout, new_layout;
+    // stage and access of the last use on the source queue
+    VkPipelineStageFlags source_stage;
+    VkAccessFlags source_access;
+    // stage and access of the first use on the destination queue
+    VkPipelineStageFlags destination_stage;
+    VkAccessFlags destination_access;
+};
+
+// records the release half of the transfer, on the source queue
+void release_ownership(
+    VkCommandBuffer command_buffer, const image_ownership_transfer& transfer
+);
+// records the acquire half of the transfer, on the destination queue
+void acquire_ownership(
+    VkCommandBuffer command_buffer, const image_ownership_transfer& transfer
+);
+
+struct buffer_ownership_transfer {
+    VkBuffer buffer;
+    VkDeviceSize offset, size;
+    uint32_t source_family, destination_family;
+    VkPipelineStageFlags source_stage;
+    VkAccessFlags source_access;
+    VkPipelineStageFlags destination_stage;
+    VkAccessFlags destination_access;
+};
+
+void release_ownership(
+    VkCommandBuffer command_buffer, const buffer_ownership_transfer& transfer
+);
+void acquire_ownership(
+    VkCommandBuffer command_buffer, const buffer_ownership_transfer& transfer
+);
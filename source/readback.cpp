@@ -0,0 +1,227 @@
+#include "readback.h"
+
+#include <stdexcept>
+#include <vector>
+
+#include "image_file.h"
+
+using namespace std;
+
+static bool is_bgra(VkFormat format) {
+    return
+        format == VK_FORMAT_B8G8R8A8_UNORM ||
+        format == VK_FORMAT_B8G8R8A8_SRGB;
+}
+
+bool is_readback_format(VkFormat format) {
+    return
+        is_bgra(format) ||
+        format == VK_FORMAT_R8G8B8A8_UNORM ||
+        format == VK_FORMAT_R8G8B8A8_SRGB ||
+        format == VK_FORMAT_A2B10G10R10_UNORM_PACK32;
+}
+
+static void encode(readback_slot& slot) {
+    auto width = slot.extent.width, height = slot.extent.height;
+    auto path = slot.path;
+    auto pixel_count = uint64_t(width) * height;
+    vector<uint8_t> rgb(pixel_count * 3);
+    if (slot.format == VK_FORMAT_A2B10G10R10_UNORM_PACK32) {
+        // keep the 8 most significant bits of each channel
+        auto pixels = (const uint32_t*)slot.buffer.data;
+        for (uint64_t i = 0; i < pixel_count; i++) {
+            rgb[i * 3] = pixels[i] >> 2;
+            rgb[i * 3 + 1] = pixels[i] >> 12;
+            rgb[i * 3 + 2] = pixels[i] >> 22;
+        }
+    } else {
+        auto pixels = (const uint8_t*)slot.buffer.data;
+        // red and blue are swapped for BGRA
+        auto red = is_bgra(slot.format) ? 2 : 0;
+        for (uint64_t i = 0; i < pixel_count; i++) {
+            rgb[i * 3] = pixels[i * 4 + red];
+            rgb[i * 3 + 1] = pixels[i * 4 + 1];
+            rgb[i * 3 + 2] = pixels[i * 4 + 2 - red];
+        }
+    }
+    // the buffer can be reused as soon as the pixels are copied
+    slot.state.store(readback_state::free, memory_order_release);
+
+    if (path.size() >= 4 && path.compare(path.size() - 4, 4, ".png") == 0) {
+        write_png(path.c_str(), width, height, rgb.data());
+    } else {
+        write_ppm(path.c_str(), width, height, rgb.data());
+    }
+}
+
+static void encode_readbacks(readback_ring& ring) {
+    unique_lock lock(ring.mutex);
+    while (true) {
+        ring.condition.wait(lock, [&]() {
+            return ring.stopping || !ring.queue.empty();
+        });
+        if (ring.queue.empty()) {
+            return;
+        }
+        auto index = ring.queue.front();
+        ring.queue.pop_front();
+        lock.unlock();
+        encode(ring.slots[index]);
+        lock.lock();
+    }
+}
+
+void create_readback_ring(
+    const memory_tracker& tracker, uint32_t slot_count, readback_ring& ring
+) {
+    // the CPU reads every byte, cached memory is much faster for that
+    ring.memory_properties =
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    auto cached = ring.memory_properties | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+    for (auto i = 0u; i < tracker.properties.memoryTypeCount; i++) {
+        auto flags = tracker.properties.memoryTypes[i].propertyFlags;
+        if ((flags & cached) == cached) {
+            ring.memory_properties = cached;
+        }
+    }
+
+    ring.slots = make_unique<readback_slot[]>(slot_count);
+    ring.slot_count = slot_count;
+    for (auto i = 0u; i < slot_count; i++) {
+        ring.slots[i].buffer = {};
+        ring.slots[i].state = readback_state::free;
+    }
+    ring.next = 0;
+    ring.captured = 0;
+    ring.dropped = 0;
+    ring.stopping = false;
+    ring.encoder = thread(encode_readbacks, ref(ring));
+}
+
+void destroy_readback_ring(
+    VkDevice device, memory_tracker& tracker, readback_ring& ring
+) {
+    // submitted captures are complete, since the device is idle
+    for (auto i = 0u; i < ring.slot_count; i++) {
+        auto& slot = ring.slots[i];
+        if (slot.state == readback_state::in_flight) {
+            slot.state = readback_state::encoding;
+            lock_guard lock(ring.mutex);
+            ring.queue.push_back(i);
+        }
+    }
+    {
+        lock_guard lock(ring.mutex);
+        ring.stopping = true;
+    }
+    ring.condition.notify_one();
+    ring.encoder.join();
+
+    for (auto i = 0u; i < ring.slot_count; i++) {
+        if (ring.slots[i].buffer.buffer != VK_NULL_HANDLE) {
+            destroy_mapped_buffer(device, tracker, ring.slots[i].buffer);
+        }
+    }
+    ring.slots.reset();
+}
+
+readback_slot* acquire_readback(
+    VkDevice device, memory_tracker& tracker, readback_ring& ring,
+    VkExtent2D extent, VkFormat format, std::string path
+) {
+    auto& slot = ring.slots[ring.next];
+    if (slot.state.load(memory_order_acquire) != readback_state::free) {
+        ring.dropped++;
+        return nullptr;
+    }
+    ring.next = (ring.next + 1) % ring.slot_count;
+
+    VkDeviceSize size = uint64_t(extent.width) * extent.height * 4;
+    if (slot.buffer.size < size) {
+        if (slot.buffer.buffer != VK_NULL_HANDLE) {
+            destroy_mapped_buffer(device, tracker, slot.buffer);
+        }
+        create_mapped_buffer(
+            device, tracker, memory_tag::readback,
+            size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            slot.buffer, ring.memory_properties
+        );
+    }
+    slot.extent = extent;
+    slot.format = format;
+    slot.path = std::move(path);
+    slot.state = readback_state::recording;
+    ring.captured++;
+    return &slot;
+}
+
+void record_readback(
+    VkCommandBuffer command_buffer, VkImage image, const readback_slot& slot
+) {
+    VkBufferImageCopy region{
+        .bufferOffset = 0,
+        .bufferRowLength = 0,
+        .bufferImageHeight = 0,
+        .imageSubresource{
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .mipLevel = 0,
+            .baseArrayLayer = 0,
+            .layerCount = 1,
+        },
+        .imageOffset = {0, 0, 0},
+        .imageExtent = {slot.extent.width, slot.extent.height, 1},
+    };
+    vkCmdCopyImageToBuffer(
+        command_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        slot.buffer.buffer, 1, &region
+    );
+
+    // make the copy visible to the host
+    VkBufferMemoryBarrier barrier{
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer = slot.buffer.buffer,
+        .offset = 0,
+        .size = VK_WHOLE_SIZE,
+    };
+    vkCmdPipelineBarrier(
+        command_buffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+        0, nullptr, 1, &barrier, 0, nullptr
+    );
+}
+
+void submit_readback(readback_slot& slot, uint64_t value) {
+    slot.value = value;
+    slot.state = readback_state::in_flight;
+}
+
+void poll_readbacks(
+    VkDevice device, readback_ring& ring, VkSemaphore timeline
+) {
+    uint64_t completed;
+    vkGetSemaphoreCounterValue(device, timeline, &completed);
+
+    bool any = false;
+    for (auto i = 0u; i < ring.slot_count; i++) {
+        auto& slot = ring.slots[i];
+        if (
+            slot.state.load(memory_order_relaxed) !=
+                readback_state::in_flight ||
+            slot.value > completed
+        ) {
+            continue;
+        }
+        slot.state.store(readback_state::encoding, memory_order_relaxed);
+        lock_guard lock(ring.mutex);
+        ring.queue.push_back(i);
+        any = true;
+    }
+    if (any) {
+        ring.condition.notify_one();
+    }
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+#include <vulkan/vulkan.h>
+
+#include "buffer.h"
+
+// Copies rendered images into a ring of host visible buffers. The copy is
+// recorded into the frame's command buffer and the result is picked up once
+// the timeline semaphore of the submitting queue passed the frame, so the
+// renderer never waits for it. A background thread converts and writes the
+// images, a capture is dropped if all buffers are still busy.
+
+enum class readback_state : uint8_t {
+    free, recording, in_flight, encoding,
+};
+
+struct readback_slot {
+    mapped_buffer buffer;
+    VkExtent2D extent;
+    VkFormat format;
+    // timeline value of the submission that contains the copy
+    uint64_t value;
+    // .ppm or .png
+    std::string path;
+    // written by the encoder thread only to return the slot
+    std::atomic<readback_state> state;
+};
+
+struct readback_ring {
+    std::unique_ptr<readback_slot[]> slots;
+    uint32_t slot_count, next;
+    VkMemoryPropertyFlags memory_properties;
+
+    // slots waiting to be encoded
+    std::deque<uint32_t> queue;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stopping;
+    std::thread encoder;
+
+    uint64_t captured, dropped;
+};
+
+// 4 byte per pixel color formats the encoder can convert to RGB
+bool is_readback_format(VkFormat format);
+
+// slot_count should be larger than the number of frames in flight
+void create_readback_ring(
+    const memory_tracker& tracker, uint32_t slot_count, readback_ring& ring
+);
+// finishes encoding all pending captures, the device must be idle
+void destroy_readback_ring(
+    VkDevice device, memory_tracker& tracker, readback_ring& ring
+);
+
+// returns nullptr and counts the capture as dropped if the next slot is
+// still in use, format must be a readback format
+readback_slot* acquire_readback(
+    VkDevice device, memory_tracker& tracker, readback_ring& ring,
+    VkExtent2D extent, VkFormat format, std::string path
+);
+
+// copies the image, which must be in TRANSFER_SRC_OPTIMAL layout
+void record_readback(
+    VkCommandBuffer command_buffer, VkImage image, const readback_slot& slot
+);
+
+// value is the timeline value the copy was submitted with
+void submit_readback(readback_slot& slot, uint64_t value);
+
+// hands captures whose submission completed to the encoder thread, call
+// once per frame
+void poll_readbacks(
+    VkDevice device, readback_ring& ring, VkSemaphore timeline
+);
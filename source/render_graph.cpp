@@ -0,0 +1,970 @@
+#include "render_graph.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+struct image_state {
+    VkImageLayout layout;
+    VkPipelineStageFlags stage;
+    VkAccessFlags access;
+    VkImageUsageFlags usage;
+    bool write;
+};
+
+static image_state get_state(render_access access, bool graphics) {
+    VkPipelineStageFlags shader_stage =
+        graphics ?
+            VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT :
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    switch (access) {
+    case render_access::color_attachment:
+    case render_access::resolve_attachment:
+        return {
+            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+            VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+            true,
+        };
+    case render_access::depth_attachment:
+        return {
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+            VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+            true,
+        };
+    case render_access::sampled:
+        return {
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            shader_stage,
+            VK_ACCESS_SHADER_READ_BIT,
+            VK_IMAGE_USAGE_SAMPLED_BIT,
+            false,
+        };
+    case render_access::storage_read:
+        return {
+            VK_IMAGE_LAYOUT_GENERAL,
+            shader_stage,
+            VK_ACCESS_SHADER_READ_BIT,
+            VK_IMAGE_USAGE_STORAGE_BIT,
+            false,
+        };
+    case render_access::storage_write:
+        return {
+            VK_IMAGE_LAYOUT_GENERAL,
+            shader_stage,
+            VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+            VK_IMAGE_USAGE_STORAGE_BIT,
+            true,
+        };
+    case render_access::transfer_read:
+        return {
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_ACCESS_TRANSFER_READ_BIT,
+            VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+            false,
+        };
+    case render_access::transfer_write:
+        return {
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_ACCESS_TRANSFER_WRITE_BIT,
+            VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+            true,
+        };
+    }
+    throw runtime_error("unknown render access");
+}
+
+static bool is_attachment(render_access access) {
+    return
+        access == render_access::color_attachment ||
+        access == render_access::depth_attachment ||
+        access == render_access::resolve_attachment;
+}
+
+// whether the use depends on the previous contents of the image
+static bool reads(const render_use& use) {
+    if (is_attachment(use.access)) {
+        // resolve attachments are overwritten completely
+        return !use.clear && use.access != render_access::resolve_attachment;
+    }
+    return !get_state(use.access, true).write;
+}
+
+bool supports_dynamic_rendering(VkPhysicalDevice physical_device) {
+    uint32_t count;
+    vkEnumerateDeviceExtensionProperties(
+        physical_device, nullptr, &count, nullptr
+    );
+    vector<VkExtensionProperties> extensions(count);
+    vkEnumerateDeviceExtensionProperties(
+        physical_device, nullptr, &count, extensions.data()
+    );
+    bool dynamic_rendering = false, synchronization2 = false;
+    for (auto& extension : extensions) {
+        auto name = extension.extensionName;
+        if (strcmp(name, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME) == 0) {
+            dynamic_rendering = true;
+        } else if (
+            strcmp(name, VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME) == 0
+        ) {
+            synchronization2 = true;
+        }
+    }
+    if (!dynamic_rendering || !synchronization2) {
+        return false;
+    }
+
+    VkPhysicalDeviceSynchronization2FeaturesKHR synchronization2_features{
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR,
+    };
+    VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamic_rendering_features{
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR,
+        .pNext = &synchronization2_features,
+    };
+    VkPhysicalDeviceFeatures2 features{
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &dynamic_rendering_features,
+    };
+    vkGetPhysicalDeviceFeatures2(physical_device, &features);
+    return
+        dynamic_rendering_features.dynamicRendering &&
+        synchronization2_features.synchronization2;
+}
+
+uint32_t add_image(render_graph& graph, const render_image_info& info) {
+    graph.images.push_back({.info = info});
+    return static_cast<uint32_t>(graph.images.size() - 1);
+}
+
+uint32_t add_pass(render_graph& graph, render_pass_info info) {
+    graph.passes.push_back({.info = std::move(info)});
+    return static_cast<uint32_t>(graph.passes.size() - 1);
+}
+
+static void cull(render_graph& graph) {
+    // walk backwards, a pass is needed if it writes an image that a later
+    // needed pass reads, or an imported image
+    vector<bool> needed(graph.images.size());
+    for (auto i = 0u; i < graph.images.size(); i++) {
+        needed[i] = graph.images[i].info.imported;
+    }
+    for (auto p = graph.passes.size(); p-- > 0;) {
+        auto& pass = graph.passes[p];
+        bool live = pass.info.side_effects;
+        for (auto& use : pass.info.uses) {
+            auto state = get_state(use.access, pass.info.graphics);
+            if (state.write && needed[use.image]) {
+                live = true;
+            }
+        }
+        pass.culled = !live;
+        if (!live) {
+            continue;
+        }
+        // contents written here are not needed before this pass, unless
+        // this pass reads them too
+        for (auto& use : pass.info.uses) {
+            if (
+                get_state(use.access, pass.info.graphics).write &&
+                !graph.images[use.image].info.imported
+            ) {
+                needed[use.image] = false;
+            }
+        }
+        for (auto& use : pass.info.uses) {
+            if (reads(use)) {
+                needed[use.image] = true;
+            }
+        }
+    }
+}
+
+// the attachments of a graphics pass with their load and store ops
+static void add_attachments(
+    render_graph& graph, uint32_t pass_index, const vector<bool>& has_contents
+) {
+    auto& pass = graph.passes[pass_index];
+    for (auto& use : pass.info.uses) {
+        if (!is_attachment(use.access)) {
+            continue;
+        }
+        auto& image = graph.images[use.image];
+        VkAttachmentLoadOp load_op =
+            use.clear ?
+                VK_ATTACHMENT_LOAD_OP_CLEAR :
+            has_contents[use.image] ?
+                VK_ATTACHMENT_LOAD_OP_LOAD :
+                VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        // transient contents that no later pass reads are never written to
+        // memory, which saves bandwidth on tilers
+        VkAttachmentStoreOp store_op =
+            image.info.imported || image.last_pass > pass_index ?
+                VK_ATTACHMENT_STORE_OP_STORE :
+                VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        pass.attachments.push_back({
+            .image = use.image,
+            .access = use.access,
+            .load_op = load_op,
+            .store_op = store_op,
+            .clear_value = use.clear_value,
+        });
+        pass.clear_values.push_back(use.clear_value);
+    }
+
+    uint32_t colors = 0, resolves = 0;
+    for (auto& attachment : pass.attachments) {
+        colors += attachment.access == render_access::color_attachment;
+        resolves += attachment.access == render_access::resolve_attachment;
+    }
+    if (resolves != 0 && resolves != colors) {
+        throw runtime_error(
+            "resolve attachments don't match color attachments"
+        );
+    }
+}
+
+static void create_render_pass(
+    VkDevice device, render_graph& graph, uint32_t pass_index
+) {
+    auto& pass = graph.passes[pass_index];
+    vector<VkAttachmentDescription> attachments;
+    vector<VkAttachmentReference> colors, resolves;
+    VkAttachmentReference depth{
+        .attachment = VK_ATTACHMENT_UNUSED,
+    };
+
+    for (auto& attachment : pass.attachments) {
+        auto& image = graph.images[attachment.image];
+        auto state = get_state(attachment.access, true);
+        bool stencil = image.info.aspect & VK_IMAGE_ASPECT_STENCIL_BIT;
+
+        VkAttachmentReference reference{
+            .attachment = static_cast<uint32_t>(attachments.size()),
+            .layout = state.layout,
+        };
+        attachments.push_back({
+            .format = image.info.format,
+            .samples = image.info.samples,
+            .loadOp = attachment.load_op,
+            .storeOp = attachment.store_op,
+            .stencilLoadOp =
+                stencil ? attachment.load_op : VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+            .stencilStoreOp =
+                stencil ?
+                    attachment.store_op : VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            // layout transitions are done by the barriers of the graph
+            .initialLayout = state.layout,
+            .finalLayout = state.layout,
+        });
+
+        if (attachment.access == render_access::color_attachment) {
+            colors.push_back(reference);
+        } else if (attachment.access == render_access::resolve_attachment) {
+            resolves.push_back(reference);
+        } else {
+            depth = reference;
+        }
+    }
+
+    VkSubpassDescription subpass{
+        .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+        .colorAttachmentCount = static_cast<uint32_t>(colors.size()),
+        .pColorAttachments = colors.data(),
+        .pResolveAttachments = resolves.empty() ? nullptr : resolves.data(),
+        .pDepthStencilAttachment =
+            depth.attachment == VK_ATTACHMENT_UNUSED ? nullptr : &depth,
+    };
+    VkRenderPassCreateInfo create_info{
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+        .attachmentCount = static_cast<uint32_t>(attachments.size()),
+        .pAttachments = attachments.data(),
+        .subpassCount = 1,
+        .pSubpasses = &subpass,
+    };
+    if (
+        vkCreateRenderPass(device, &create_info, nullptr, &pass.render_pass) !=
+        VK_SUCCESS
+    ) {
+        throw runtime_error("failed to create render pass");
+    }
+}
+
+// the formats pipelines of the pass need with dynamic rendering
+static void set_rendering_info(render_graph& graph, uint32_t pass_index) {
+    auto& pass = graph.passes[pass_index];
+    pass.color_formats.clear();
+    pass.rendering = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR,
+        .depthAttachmentFormat = VK_FORMAT_UNDEFINED,
+        .stencilAttachmentFormat = VK_FORMAT_UNDEFINED,
+    };
+    for (auto& attachment : pass.attachments) {
+        auto& image = graph.images[attachment.image];
+        if (attachment.access == render_access::color_attachment) {
+            pass.color_formats.push_back(image.info.format);
+        } else if (attachment.access == render_access::depth_attachment) {
+            pass.rendering.depthAttachmentFormat = image.info.format;
+            if (image.info.aspect & VK_IMAGE_ASPECT_STENCIL_BIT) {
+                pass.rendering.stencilAttachmentFormat = image.info.format;
+            }
+        }
+    }
+    pass.rendering.colorAttachmentCount = pass.color_formats.size();
+    pass.rendering.pColorAttachmentFormats = pass.color_formats.data();
+}
+
+// combines all uses of each image in the pass
+static vector<pair<uint32_t, image_state>> get_pass_states(
+    const render_graph_pass& pass
+) {
+    vector<pair<uint32_t, image_state>> states;
+    for (auto& use : pass.info.uses) {
+        auto state = get_state(use.access, pass.info.graphics);
+        auto existing = find_if(
+            states.begin(), states.end(),
+            [&](const auto& entry) { return entry.first == use.image; }
+        );
+        if (existing == states.end()) {
+            states.push_back({use.image, state});
+            continue;
+        }
+        if (existing->second.layout != state.layout) {
+            throw runtime_error("conflicting image layouts in one pass");
+        }
+        existing->second.stage |= state.stage;
+        existing->second.access |= state.access;
+        existing->second.usage |= state.usage;
+        existing->second.write = existing->second.write || state.write;
+    }
+    return states;
+}
+
+void compile_render_graph(VkDevice device, render_graph& graph) {
+    graph.begin_rendering = nullptr;
+    graph.end_rendering = nullptr;
+    graph.pipeline_barrier = nullptr;
+    if (graph.dynamic_rendering) {
+        graph.begin_rendering = (PFN_vkCmdBeginRenderingKHR)
+            vkGetDeviceProcAddr(device, "vkCmdBeginRenderingKHR");
+        graph.end_rendering = (PFN_vkCmdEndRenderingKHR)
+            vkGetDeviceProcAddr(device, "vkCmdEndRenderingKHR");
+        graph.pipeline_barrier = (PFN_vkCmdPipelineBarrier2KHR)
+            vkGetDeviceProcAddr(device, "vkCmdPipelineBarrier2KHR");
+        if (
+            !graph.begin_rendering || !graph.end_rendering ||
+            !graph.pipeline_barrier
+        ) {
+            throw runtime_error("failed to load dynamic rendering functions");
+        }
+    }
+
+    cull(graph);
+
+    // lifetimes and the state after the last use, which is also the state
+    // transient images are in before their first use in the next frame
+    for (auto& image : graph.images) {
+        image.usage = 0;
+        image.first_pass = -1u;
+        image.last_pass = 0;
+        image.last_layout = image.info.initial_layout;
+        image.last_stage = image.info.initial_stage;
+        image.last_access = 0;
+    }
+    for (auto p = 0u; p < graph.passes.size(); p++) {
+        auto& pass = graph.passes[p];
+        if (pass.culled) {
+            continue;
+        }
+        for (auto& [index, state] : get_pass_states(pass)) {
+            auto& image = graph.images[index];
+            image.usage |= state.usage;
+            image.first_pass = min(image.first_pass, p);
+            image.last_pass = p;
+            image.last_layout = state.layout;
+            image.last_stage = state.stage;
+            image.last_access = state.write ? state.access : 0;
+        }
+    }
+    for (auto& image : graph.images) {
+        // images that are only ever attachments can live in tile memory
+        const VkImageUsageFlags attachment_usage =
+            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+            VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+        if (
+            !image.info.imported && image.usage != 0 &&
+            (image.usage & ~attachment_usage) == 0 &&
+            image.first_pass == image.last_pass
+        ) {
+            image.usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+        }
+    }
+
+    // barriers between uses, transient images start out undefined but still
+    // have to wait for their last use in the previous frame
+    vector<image_state> states(graph.images.size());
+    vector<bool> has_contents(graph.images.size());
+    vector<bool> used(graph.images.size());
+    for (auto i = 0u; i < graph.images.size(); i++) {
+        auto& image = graph.images[i];
+        bool transient = !image.info.imported;
+        states[i] = {
+            .layout =
+                transient ? VK_IMAGE_LAYOUT_UNDEFINED : image.info.initial_layout,
+            .stage = transient ? image.last_stage : image.info.initial_stage,
+            .access = transient ? image.last_access : 0,
+            .usage = 0,
+            .write = transient,
+        };
+        has_contents[i] =
+            !transient &&
+            image.info.initial_layout != VK_IMAGE_LAYOUT_UNDEFINED;
+    }
+    for (auto p = 0u; p < graph.passes.size(); p++) {
+        auto& pass = graph.passes[p];
+        pass.barriers.clear();
+        pass.attachments.clear();
+        pass.clear_values.clear();
+        pass.render_pass = VK_NULL_HANDLE;
+        if (pass.culled) {
+            continue;
+        }
+        auto pass_states = get_pass_states(pass);
+        for (auto& [index, state] : pass_states) {
+            auto& current = states[index];
+            bool first_use = !used[index] && !graph.images[index].info.imported;
+            // read after read in the same layout needs no barrier
+            if (
+                first_use || current.layout != state.layout ||
+                current.write || state.write
+            ) {
+                pass.barriers.push_back({
+                    .image = index,
+                    .first_use = first_use,
+                    .old_layout = current.layout,
+                    .new_layout = state.layout,
+                    .source_stage = current.stage,
+                    .destination_stage = state.stage,
+                    .source_access = current.write ? current.access : 0,
+                    .destination_access = state.access,
+                });
+            }
+        }
+        if (pass.info.graphics) {
+            add_attachments(graph, p, has_contents);
+            if (graph.dynamic_rendering) {
+                set_rendering_info(graph, p);
+            } else {
+                create_render_pass(device, graph, p);
+            }
+        }
+        for (auto& [index, state] : pass_states) {
+            auto& current = states[index];
+            if (!current.write && !state.write && used[index]) {
+                // consecutive reads, the next writer has to wait for all
+                current.stage |= state.stage;
+                current.access |= state.access;
+            } else {
+                current = state;
+            }
+            used[index] = true;
+            has_contents[index] = true;
+        }
+    }
+
+    graph.final_barriers.clear();
+    for (auto i = 0u; i < graph.images.size(); i++) {
+        auto& image = graph.images[i];
+        if (
+            image.info.imported &&
+            image.info.final_layout != VK_IMAGE_LAYOUT_UNDEFINED &&
+            image.info.final_layout != states[i].layout
+        ) {
+            graph.final_barriers.push_back({
+                .image = i,
+                .first_use = false,
+                .old_layout = states[i].layout,
+                .new_layout = image.info.final_layout,
+                .source_stage = states[i].stage,
+                .destination_stage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                .source_access = states[i].write ? states[i].access : 0,
+                .destination_access = 0,
+            });
+        }
+    }
+}
+
+void destroy_render_graph(VkDevice device, render_graph& graph) {
+    for (auto& pass : graph.passes) {
+        if (pass.render_pass != VK_NULL_HANDLE) {
+            vkDestroyRenderPass(device, pass.render_pass, nullptr);
+            pass.render_pass = VK_NULL_HANDLE;
+        }
+    }
+}
+
+static VkExtent2D scale_extent(VkExtent2D extent, float scale) {
+    return {
+        max(static_cast<uint32_t>(extent.width * scale), 1u),
+        max(static_cast<uint32_t>(extent.height * scale), 1u),
+    };
+}
+
+void create_render_graph_instance(
+    VkDevice device, memory_tracker& tracker,
+    const render_graph& graph, VkExtent2D extent,
+    span<const render_graph_imported_image> imported_images,
+    render_graph_instance& instance
+) {
+    instance.extent = extent;
+    instance.images.assign(graph.images.size(), {});
+    instance.framebuffers.assign(graph.passes.size(), VK_NULL_HANDLE);
+    instance.alias_stages.assign(graph.images.size(), 0);
+    instance.alias_access.assign(graph.images.size(), 0);
+    instance.memory = VK_NULL_HANDLE;
+    instance.memory_size = 0;
+    instance.peak_memory_size = 0;
+    instance.unaliased_memory_size = 0;
+
+    for (auto& imported : imported_images) {
+        instance.images[imported.image] = {
+            .image = imported.handle,
+            .view = imported.view,
+            .extent = extent,
+            .mip_levels = 1,
+        };
+    }
+
+    // create transient images
+    vector<uint32_t> transient;
+    uint32_t memory_type_bits = -1u;
+    VkDeviceSize alignment = 1;
+    for (auto i = 0u; i < graph.images.size(); i++) {
+        auto& image = graph.images[i];
+        if (image.info.imported || image.first_pass == -1u) {
+            continue;
+        }
+        auto& image_instance = instance.images[i];
+        image_instance.extent = scale_extent(extent, image.info.scale);
+        image_instance.mip_levels = image.info.mip_levels;
+        if (image_instance.mip_levels == 0) {
+            auto size = max(
+                image_instance.extent.width, image_instance.extent.height
+            );
+            while (size >> image_instance.mip_levels) {
+                image_instance.mip_levels++;
+            }
+        }
+        VkImageCreateInfo image_info{
+            .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+            .imageType = VK_IMAGE_TYPE_2D,
+            .format = image.info.format,
+            .extent = {
+                image_instance.extent.width, image_instance.extent.height, 1
+            },
+            .mipLevels = image_instance.mip_levels,
+            .arrayLayers = 1,
+            .samples = image.info.samples,
+            .tiling = VK_IMAGE_TILING_OPTIMAL,
+            .usage = image.usage,
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        };
+        if (
+            vkCreateImage(
+                device, &image_info, nullptr, &image_instance.image
+            ) != VK_SUCCESS
+        ) {
+            throw runtime_error("failed to create image");
+        }
+        VkMemoryRequirements requirements;
+        vkGetImageMemoryRequirements(
+            device, image_instance.image, &requirements
+        );
+        image_instance.size = requirements.size;
+        memory_type_bits &= requirements.memoryTypeBits;
+        alignment = max(alignment, requirements.alignment);
+        instance.unaliased_memory_size += requirements.size;
+        transient.push_back(i);
+    }
+    if (!transient.empty() && memory_type_bits == 0) {
+        throw runtime_error("transient images have no common memory type");
+    }
+
+    // place large images first, each at the lowest offset that doesn't
+    // overlap an image with an overlapping lifetime
+    sort(transient.begin(), transient.end(), [&](uint32_t a, uint32_t b) {
+        return instance.images[a].size > instance.images[b].size;
+    });
+    auto overlaps = [&](uint32_t a, uint32_t b) {
+        auto& image_a = graph.images[a], & image_b = graph.images[b];
+        return
+            image_a.first_pass <= image_b.last_pass &&
+            image_b.first_pass <= image_a.last_pass;
+    };
+    vector<uint32_t> placed;
+    for (auto i : transient) {
+        auto& image_instance = instance.images[i];
+        vector<pair<VkDeviceSize, VkDeviceSize>> occupied;
+        for (auto other : placed) {
+            if (overlaps(i, other)) {
+                auto& other_instance = instance.images[other];
+                occupied.push_back({
+                    other_instance.offset,
+                    other_instance.offset + other_instance.size
+                });
+            }
+        }
+        sort(occupied.begin(), occupied.end());
+        VkDeviceSize offset = 0;
+        for (auto [begin, end] : occupied) {
+            if (offset + image_instance.size <= begin) {
+                break;
+            }
+            offset = max(offset, (end + alignment - 1) / alignment * alignment);
+        }
+        image_instance.offset = offset;
+        instance.memory_size =
+            max(instance.memory_size, offset + image_instance.size);
+        placed.push_back(i);
+    }
+
+    for (auto i : transient) {
+        for (auto j : transient) {
+            auto& a = instance.images[i], & b = instance.images[j];
+            if (a.offset < b.offset + b.size && b.offset < a.offset + a.size) {
+                instance.alias_stages[i] |= graph.images[j].last_stage;
+                instance.alias_access[i] |= graph.images[j].last_access;
+            }
+        }
+    }
+
+    for (auto p = 0u; p < graph.passes.size(); p++) {
+        if (graph.passes[p].culled) {
+            continue;
+        }
+        VkDeviceSize alive = 0;
+        for (auto i : transient) {
+            auto& image = graph.images[i];
+            if (image.first_pass <= p && p <= image.last_pass) {
+                alive += instance.images[i].size;
+            }
+        }
+        instance.peak_memory_size = max(instance.peak_memory_size, alive);
+    }
+
+    if (!transient.empty()) {
+        VkMemoryRequirements requirements{
+            .size = instance.memory_size,
+            .alignment = alignment,
+            .memoryTypeBits = memory_type_bits,
+        };
+        instance.memory = allocate_tracked_memory(
+            device, tracker, requirements,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, memory_tag::render_target
+        );
+    }
+
+    for (auto i : transient) {
+        auto& image = graph.images[i];
+        auto& image_instance = instance.images[i];
+        vkBindImageMemory(
+            device, image_instance.image, instance.memory,
+            image_instance.offset
+        );
+
+        // views of depth stencil images only see depth, so that they can
+        // also be sampled
+        VkImageAspectFlags aspect = image.info.aspect;
+        if (aspect & VK_IMAGE_ASPECT_DEPTH_BIT) {
+            aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+        }
+        VkImageViewCreateInfo create_info{
+            .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+            .image = image_instance.image,
+            .viewType = VK_IMAGE_VIEW_TYPE_2D,
+            .format = image.info.format,
+            .subresourceRange{
+                .aspectMask = aspect,
+                .baseMipLevel = 0,
+                .levelCount = image_instance.mip_levels,
+                .baseArrayLayer = 0,
+                .layerCount = 1,
+            }
+        };
+        if (
+            vkCreateImageView(
+                device, &create_info, nullptr, &image_instance.view
+            ) != VK_SUCCESS
+        ) {
+            throw runtime_error("failed to create image view");
+        }
+    }
+
+    // framebuffers
+    for (auto p = 0u; p < graph.passes.size(); p++) {
+        auto& pass = graph.passes[p];
+        if (pass.culled || !pass.info.graphics || graph.dynamic_rendering) {
+            continue;
+        }
+        vector<VkImageView> attachments;
+        VkExtent2D pass_extent = extent;
+        for (auto& attachment : pass.attachments) {
+            auto& image = instance.images[attachment.image];
+            attachments.push_back(image.view);
+            pass_extent = image.extent;
+        }
+        VkFramebufferCreateInfo create_info{
+            .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+            .renderPass = pass.render_pass,
+            .attachmentCount = static_cast<uint32_t>(attachments.size()),
+            .pAttachments = attachments.data(),
+            .width = pass_extent.width,
+            .height = pass_extent.height,
+            .layers = 1,
+        };
+        if (
+            vkCreateFramebuffer(
+                device, &create_info, nullptr, &instance.framebuffers[p]
+            ) != VK_SUCCESS
+        ) {
+            throw runtime_error("failed to create framebuffer");
+        }
+    }
+}
+
+void destroy_render_graph_instance(
+    VkDevice device, memory_tracker& tracker, const render_graph& graph,
+    const render_graph_instance& instance
+) {
+    for (auto framebuffer : instance.framebuffers) {
+        if (framebuffer != VK_NULL_HANDLE) {
+            vkDestroyFramebuffer(device, framebuffer, nullptr);
+        }
+    }
+    for (auto i = 0u; i < graph.images.size(); i++) {
+        auto& image = graph.images[i];
+        if (image.info.imported || image.first_pass == -1u) {
+            continue;
+        }
+        vkDestroyImageView(device, instance.images[i].view, nullptr);
+        vkDestroyImage(device, instance.images[i].image, nullptr);
+    }
+    free_tracked_memory(device, tracker, instance.memory);
+}
+
+static void record_barriers(
+    VkCommandBuffer command_buffer,
+    const render_graph& graph, const render_graph_instance& instance,
+    const vector<render_graph_barrier>& barriers, frame_arena& scratch
+) {
+    if (barriers.empty()) {
+        return;
+    }
+    VkPipelineStageFlags source_stage = 0, destination_stage = 0;
+    arena_vector<VkImageMemoryBarrier> image_barriers(scratch);
+    image_barriers.reserve(barriers.size());
+    for (auto& barrier : barriers) {
+        auto source_access = barrier.source_access;
+        source_stage |= barrier.source_stage;
+        if (barrier.first_use) {
+            source_stage |= instance.alias_stages[barrier.image];
+            source_access |= instance.alias_access[barrier.image];
+        }
+        destination_stage |= barrier.destination_stage;
+        image_barriers.push_back({
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .srcAccessMask = source_access,
+            .dstAccessMask = barrier.destination_access,
+            .oldLayout = barrier.old_layout,
+            .newLayout = barrier.new_layout,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = instance.images[barrier.image].image,
+            .subresourceRange{
+                .aspectMask = graph.images[barrier.image].info.aspect,
+                .baseMipLevel = 0,
+                .levelCount = VK_REMAINING_MIP_LEVELS,
+                .baseArrayLayer = 0,
+                .layerCount = 1,
+            },
+        });
+    }
+    vkCmdPipelineBarrier(
+        command_buffer,
+        source_stage ? source_stage : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        destination_stage, 0, 0, nullptr, 0, nullptr,
+        static_cast<uint32_t>(image_barriers.size()), image_barriers.data()
+    );
+}
+
+// the legacy stage bits are valid synchronization2 stages, except for top
+// and bottom of pipe which only mean no stage
+static VkPipelineStageFlags2 get_stage2(VkPipelineStageFlags stage) {
+    return stage & ~(
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT | VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT
+    );
+}
+
+// each image only waits for its own stages, instead of every image waiting
+// for the stages of all images in the batch
+static void record_barriers2(
+    VkCommandBuffer command_buffer,
+    const render_graph& graph, const render_graph_instance& instance,
+    const vector<render_graph_barrier>& barriers, frame_arena& scratch
+) {
+    if (barriers.empty()) {
+        return;
+    }
+    arena_vector<VkImageMemoryBarrier2KHR> image_barriers(scratch);
+    image_barriers.reserve(barriers.size());
+    for (auto& barrier : barriers) {
+        auto source_stage = barrier.source_stage;
+        auto source_access = barrier.source_access;
+        if (barrier.first_use) {
+            source_stage |= instance.alias_stages[barrier.image];
+            source_access |= instance.alias_access[barrier.image];
+        }
+        image_barriers.push_back({
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR,
+            .srcStageMask = get_stage2(source_stage),
+            .srcAccessMask = source_access,
+            .dstStageMask = get_stage2(barrier.destination_stage),
+            .dstAccessMask = barrier.destination_access,
+            .oldLayout = barrier.old_layout,
+            .newLayout = barrier.new_layout,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = instance.images[barrier.image].image,
+            .subresourceRange{
+                .aspectMask = graph.images[barrier.image].info.aspect,
+                .baseMipLevel = 0,
+                .levelCount = VK_REMAINING_MIP_LEVELS,
+                .baseArrayLayer = 0,
+                .layerCount = 1,
+            },
+        });
+    }
+    VkDependencyInfoKHR dependency_info{
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR,
+        .imageMemoryBarrierCount =
+            static_cast<uint32_t>(image_barriers.size()),
+        .pImageMemoryBarriers = image_barriers.data(),
+    };
+    graph.pipeline_barrier(command_buffer, &dependency_info);
+}
+
+static void begin_rendering(
+    VkCommandBuffer command_buffer,
+    const render_graph& graph, const render_graph_instance& instance,
+    const render_graph_pass& pass, VkExtent2D extent, frame_arena& scratch
+) {
+    arena_vector<VkRenderingAttachmentInfoKHR> colors(scratch);
+    colors.reserve(pass.attachments.size());
+    VkRenderingAttachmentInfoKHR depth{
+        .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR,
+    };
+    bool stencil = false;
+    // resolve attachments belong to the color attachments in order
+    uint32_t resolved = 0;
+    for (auto& attachment : pass.attachments) {
+        auto& image = graph.images[attachment.image];
+        VkRenderingAttachmentInfoKHR info{
+            .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR,
+            .imageView = instance.images[attachment.image].view,
+            .imageLayout = get_state(attachment.access, true).layout,
+            .loadOp = attachment.load_op,
+            .storeOp = attachment.store_op,
+            .clearValue = attachment.clear_value,
+        };
+        if (attachment.access == render_access::color_attachment) {
+            colors.push_back(info);
+        } else if (attachment.access == render_access::resolve_attachment) {
+            auto& color = colors[resolved++];
+            color.resolveMode = VK_RESOLVE_MODE_AVERAGE_BIT;
+            color.resolveImageView = info.imageView;
+            color.resolveImageLayout = info.imageLayout;
+        } else {
+            depth = info;
+            stencil = image.info.aspect & VK_IMAGE_ASPECT_STENCIL_BIT;
+        }
+    }
+
+    bool has_depth = depth.imageView != VK_NULL_HANDLE;
+    VkRenderingInfoKHR rendering_info{
+        .sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR,
+        .renderArea{
+            .offset = {0, 0},
+            .extent = extent,
+        },
+        .layerCount = 1,
+        .colorAttachmentCount = static_cast<uint32_t>(colors.size()),
+        .pColorAttachments = colors.data(),
+        .pDepthAttachment = has_depth ? &depth : nullptr,
+        .pStencilAttachment = stencil ? &depth : nullptr,
+    };
+    graph.begin_rendering(command_buffer, &rendering_info);
+}
+
+void record_render_graph(
+    VkCommandBuffer command_buffer,
+    const render_graph& graph, const render_graph_instance& instance,
+    frame_arena& scratch
+) {
+    auto barriers =
+        graph.dynamic_rendering ? record_barriers2 : record_barriers;
+    for (auto p = 0u; p < graph.passes.size(); p++) {
+        auto& pass = graph.passes[p];
+        if (pass.culled) {
+            continue;
+        }
+        barriers(command_buffer, graph, instance, pass.barriers, scratch);
+
+        VkExtent2D extent = instance.extent;
+        if (!pass.attachments.empty()) {
+            extent = instance.images[pass.attachments.back().image].extent;
+        }
+        render_pass_context context{instance, extent};
+
+        if (pass.info.graphics && graph.dynamic_rendering) {
+            begin_rendering(
+                command_buffer, graph, instance, pass, extent, scratch
+            );
+        } else if (pass.info.graphics) {
+            VkRenderPassBeginInfo begin_info{
+                .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+                .renderPass = pass.render_pass,
+                .framebuffer = instance.framebuffers[p],
+                .renderArea{
+                    .offset = {0, 0},
+                    .extent = extent,
+                },
+                .clearValueCount =
+                    static_cast<uint32_t>(pass.clear_values.size()),
+                .pClearValues = pass.clear_values.data(),
+            };
+            vkCmdBeginRenderPass(
+                command_buffer, &begin_info, VK_SUBPASS_CONTENTS_INLINE
+            );
+        }
+        if (pass.info.record) {
+            pass.info.record(command_buffer, context);
+        }
+        if (pass.info.graphics && graph.dynamic_rendering) {
+            graph.end_rendering(command_buffer);
+        } else if (pass.info.graphics) {
+            vkCmdEndRenderPass(command_buffer);
+        }
+    }
+    barriers(command_buffer, graph, instance, graph.final_barriers, scratch);
+}
@@ -0,0 +1,222 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "memory_budget.h"
+#include "frame_arena.h"
+
+// A render graph is a list of passes, each declaring which images it reads
+// and writes. Compiling it removes passes that don't contribute to an
+// imported image and creates the render passes. Instantiating it for an
+// extent creates the transient images, with the memory of images that are
+// never alive at the same time aliased, and the framebuffers. Recording it
+// inserts the barriers and layout transitions between passes.
+//
+// With dynamic rendering there are no render passes and framebuffers,
+// passes begin rendering with their attachments directly, and barriers
+// wait for the stages of each image instead of those of all images of the
+// pass.
+
+enum class render_access {
+    color_attachment,
+    depth_attachment,
+    resolve_attachment,
+    sampled,
+    storage_read,
+    storage_write,
+    transfer_read,
+    transfer_write,
+};
+
+struct render_image_info {
+    VkFormat format;
+    VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+    VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+    // 0 for a full mip chain, which depends on the extent
+    uint32_t mip_levels = 1;
+    // transient images are sized relative to the extent of the instance
+    float scale = 1.0f;
+    // imported images are created outside of the graph, e.g. swapchain images
+    // and are always considered to be used after the graph ends
+    bool imported = false;
+    // state of imported images before the graph starts, the stage has to
+    // match the semaphore wait that makes the image available
+    VkImageLayout initial_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VkPipelineStageFlags initial_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    // layout imported images are transitioned to after the graph ends
+    VkImageLayout final_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+};
+
+struct render_use {
+    uint32_t image;
+    render_access access;
+    // attachments are cleared instead of loaded if set
+    bool clear = false;
+    VkClearValue clear_value{};
+};
+
+struct render_graph_instance;
+
+struct render_pass_context {
+    const render_graph_instance& instance;
+    VkExtent2D extent;
+};
+
+struct render_pass_info {
+    const char* name;
+    // graphics passes are recorded inside of a render pass or dynamic
+    // rendering with their attachments, others outside of both
+    bool graphics = true;
+    // passes with side effects, e.g. readbacks, are never culled
+    bool side_effects = false;
+    std::vector<render_use> uses;
+    std::function<void(VkCommandBuffer, const render_pass_context&)> record;
+};
+
+struct render_graph_barrier {
+    uint32_t image;
+    // first use of a transient image
+    bool first_use;
+    VkImageLayout old_layout, new_layout;
+    VkPipelineStageFlags source_stage, destination_stage;
+    VkAccessFlags source_access, destination_access;
+};
+
+struct render_graph_attachment {
+    uint32_t image;
+    render_access access;
+    VkAttachmentLoadOp load_op;
+    VkAttachmentStoreOp store_op;
+    VkClearValue clear_value;
+};
+
+struct render_graph_pass {
+    render_pass_info info;
+    bool culled;
+    // null with dynamic rendering
+    VkRenderPass render_pass;
+    std::vector<VkClearValue> clear_values;
+    // in the order of the render pass attachments
+    std::vector<render_graph_attachment> attachments;
+    // attachment formats for pipelines, only with dynamic rendering
+    std::vector<VkFormat> color_formats;
+    VkPipelineRenderingCreateInfoKHR rendering;
+    std::vector<render_graph_barrier> barriers;
+};
+
+struct render_graph_image {
+    render_image_info info;
+    VkImageUsageFlags usage;
+    // first and last pass that uses the image, after culling
+    uint32_t first_pass, last_pass;
+    // state after the last use
+    VkImageLayout last_layout;
+    VkPipelineStageFlags last_stage;
+    VkAccessFlags last_access;
+};
+
+struct render_graph {
+    std::vector<render_graph_image> images;
+    std::vector<render_graph_pass> passes;
+    // barriers that transition imported images to their final layout
+    std::vector<render_graph_barrier> final_barriers;
+
+    // set before compiling, the device needs the extensions and features
+    // that supports_dynamic_rendering checks for
+    bool dynamic_rendering = false;
+    PFN_vkCmdBeginRenderingKHR begin_rendering;
+    PFN_vkCmdEndRenderingKHR end_rendering;
+    PFN_vkCmdPipelineBarrier2KHR pipeline_barrier;
+};
+
+// checks for VK_KHR_dynamic_rendering and VK_KHR_synchronization2 and
+// their features
+bool supports_dynamic_rendering(VkPhysicalDevice physical_device);
+
+uint32_t add_image(render_graph& graph, const render_image_info& info);
+uint32_t add_pass(render_graph& graph, render_pass_info info);
+
+void compile_render_graph(VkDevice device, render_graph& graph);
+void destroy_render_graph(VkDevice device, render_graph& graph);
+
+struct render_graph_image_instance {
+    VkImage image;
+    VkImageView view;
+    VkExtent2D extent;
+    uint32_t mip_levels;
+    // offset into the shared memory, for transient images
+    VkDeviceSize offset, size;
+};
+
+struct render_graph_instance {
+    VkExtent2D extent;
+    std::vector<render_graph_image_instance> images;
+    // one per pass, null for culled and non-graphics passes and with
+    // dynamic rendering
+    std::vector<VkFramebuffer> framebuffers;
+    // all transient images are bound to this memory
+    VkDeviceMemory memory;
+    VkDeviceSize memory_size;
+    // largest sum of transient image sizes alive during any one pass, which
+    // is the lower bound for memory_size
+    VkDeviceSize peak_memory_size;
+    // memory size that would be required without aliasing
+    VkDeviceSize unaliased_memory_size;
+    // the first use of a transient image has to wait for the last use of all
+    // images that share its memory, including itself in the previous frame
+    std::vector<VkPipelineStageFlags> alias_stages;
+    std::vector<VkAccessFlags> alias_access;
+};
+
+struct render_graph_imported_image {
+    uint32_t image;
+    VkImage handle;
+    VkImageView view;
+};
+
+void create_render_graph_instance(
+    VkDevice device, memory_tracker& tracker,
+    const render_graph& graph, VkExtent2D extent,
+    std::span<const render_graph_imported_image> imported_images,
+    render_graph_instance& instance
+);
+void destroy_render_graph_instance(
+    VkDevice device, memory_tracker& tracker, const render_graph& graph,
+    const render_graph_instance& instance
+);
+
+// barriers are built in scratch, which must live until the frame is reset
+void record_render_graph(
+    VkCommandBuffer command_buffer,
+    const render_graph& graph, const render_graph_instance& instance,
+    frame_arena& scratch
+);
+
+inline VkImageView get_view(
+    const render_pass_context& context, uint32_t image
+) {
+    return context.instance.images[image].view;
+}
+
+// what the graphics pipelines of a pass are created for, rendering is
+// chained into the pipeline create info and render_pass is its render pass
+struct render_target {
+    VkRenderPass render_pass;
+    // only with dynamic rendering, null otherwise
+    const VkPipelineRenderingCreateInfoKHR* rendering;
+};
+
+inline render_target get_render_target(
+    const render_graph& graph, uint32_t pass
+) {
+    auto& graph_pass = graph.passes[pass];
+    return {
+        graph_pass.render_pass,
+        graph.dynamic_rendering ? &graph_pass.rendering : nullptr,
+    };
+}
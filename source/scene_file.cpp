@@ -0,0 +1,315 @@
+#include "scene_file.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <random>
+#include <cmath>
+
+using namespace std;
+
+static runtime_error scene_error(const char* message, uint32_t line) {
+    return runtime_error(
+        string(message) + " in line " + to_string(line) + " of scene file"
+    );
+}
+
+// -1 for none, otherwise below limit
+static uint32_t read_index(istream& stream, uint32_t limit, bool& valid) {
+    int64_t index = -1;
+    valid = valid && (stream >> index) && index >= -1 && index < limit;
+    return index == -1 ? -1u : uint32_t(index);
+}
+
+template<size_t size>
+static void read_floats(istream& stream, float (&values)[size], bool& valid) {
+    for (auto& value : values) {
+        valid = valid && (stream >> value);
+    }
+}
+
+void read_scene(const char* path, scene_description& scene) {
+    ifstream file(path);
+    if (!file) {
+        throw runtime_error("failed to open scene file");
+    }
+    scene = {};
+
+    string line;
+    uint32_t line_number = 0;
+    while (getline(file, line)) {
+        line_number++;
+        line = line.substr(0, line.find('#'));
+        istringstream stream(line);
+        string keyword;
+        if (!(stream >> keyword)) {
+            continue;
+        }
+
+        bool valid = true;
+        if (keyword == "mesh") {
+            string name;
+            valid = bool(stream >> name);
+            scene.meshes.push_back(name);
+
+        } else if (keyword == "node") {
+            scene_node node;
+            node.parent = read_index(stream, scene.nodes.size(), valid);
+            node.mesh = read_index(stream, scene.meshes.size(), valid);
+            valid = valid && (stream >> node.material);
+            read_floats(stream, node.translation, valid);
+            read_floats(stream, node.rotation, valid);
+            read_floats(stream, node.scale, valid);
+            scene.nodes.push_back(node);
+
+        } else if (keyword == "light") {
+            scene_light light;
+            read_floats(stream, light.position, valid);
+            read_floats(stream, light.color, valid);
+            valid = valid && (stream >> light.radius);
+            scene.lights.push_back(light);
+
+        } else if (keyword == "camera") {
+            camera_key key;
+            valid = bool(stream >> key.time);
+            read_floats(stream, key.eye, valid);
+            read_floats(stream, key.target, valid);
+            if (
+                valid && !scene.camera_path.empty() &&
+                key.time < scene.camera_path.back().time
+            ) {
+                throw scene_error("camera keys out of order", line_number);
+            }
+            scene.camera_path.push_back(key);
+
+        } else if (keyword == "texture") {
+            string path;
+            valid = bool(stream >> path);
+            scene.textures.push_back(path);
+
+        } else {
+            throw scene_error("unknown element", line_number);
+        }
+
+        string rest;
+        if (!valid || stream >> rest) {
+            throw scene_error("malformed element", line_number);
+        }
+    }
+}
+
+static void write_floats(ostream& stream, const float* values, size_t count) {
+    for (auto i = 0u; i < count; i++) {
+        stream << ' ' << values[i];
+    }
+}
+
+static int64_t index_or_minus_one(uint32_t index) {
+    return index == -1u ? -1 : int64_t(index);
+}
+
+void write_scene(const char* path, const scene_description& scene) {
+    ofstream file(path);
+    if (!file) {
+        throw runtime_error("failed to open scene file");
+    }
+    // enough digits to read back the same floats
+    file.precision(9);
+
+    for (auto& mesh : scene.meshes) {
+        file << "mesh " << mesh << '\n';
+    }
+    for (auto& node : scene.nodes) {
+        file <<
+            "node " << index_or_minus_one(node.parent) << ' ' <<
+            index_or_minus_one(node.mesh) << ' ' << node.material;
+        write_floats(file, node.translation, 3);
+        write_floats(file, node.rotation, 4);
+        write_floats(file, node.scale, 3);
+        file << '\n';
+    }
+    for (auto& light : scene.lights) {
+        file << "light";
+        write_floats(file, light.position, 3);
+        write_floats(file, light.color, 3);
+        file << ' ' << light.radius << '\n';
+    }
+    for (auto& key : scene.camera_path) {
+        file << "camera " << key.time;
+        write_floats(file, key.eye, 3);
+        write_floats(file, key.target, 3);
+        file << '\n';
+    }
+    for (auto& texture : scene.textures) {
+        file << "texture " << texture << '\n';
+    }
+
+    if (!file) {
+        throw runtime_error("failed to write scene file");
+    }
+}
+
+float get_camera_path_duration(const scene_description& scene) {
+    return scene.camera_path.empty() ? 0 : scene.camera_path.back().time;
+}
+
+void sample_camera_path(
+    const scene_description& scene, float time, float eye[3], float target[3]
+) {
+    auto& path = scene.camera_path;
+    // last key at or before time
+    auto next = upper_bound(
+        path.begin(), path.end(), time,
+        [](float time, const camera_key& key) { return time < key.time; }
+    );
+    size_t i = next == path.begin() ? 0 : next - path.begin() - 1;
+    size_t last = path.size() - 1;
+    auto& k0 = path[i > 0 ? i - 1 : 0];
+    auto& k1 = path[i];
+    auto& k2 = path[min(i + 1, last)];
+    auto& k3 = path[min(i + 2, last)];
+
+    float u = 0;
+    if (k2.time > k1.time) {
+        u = clamp((time - k1.time) / (k2.time - k1.time), 0.f, 1.f);
+    }
+    auto interpolate = [u](float p0, float p1, float p2, float p3) {
+        return 0.5f * (
+            2 * p1 + (p2 - p0) * u +
+            (2 * p0 - 5 * p1 + 4 * p2 - p3) * u * u +
+            (3 * p1 - p0 - 3 * p2 + p3) * u * u * u
+        );
+    };
+    for (auto c = 0u; c < 3; c++) {
+        eye[c] = interpolate(k0.eye[c], k1.eye[c], k2.eye[c], k3.eye[c]);
+        target[c] = interpolate(
+            k0.target[c], k1.target[c], k2.target[c], k3.target[c]
+        );
+    }
+}
+
+// uniform in [0, 1), unlike uniform_real_distribution the result is the
+// same with every standard library
+static float uniform(mt19937& random) {
+    return (random() >> 8) * (1.0f / (1 << 24));
+}
+
+void generate_stress_scene(
+    const stress_parameters& parameters, const char* mesh_name,
+    scene_description& scene
+) {
+    scene = {};
+    scene.meshes.push_back(mesh_name);
+    mt19937 random(parameters.seed);
+    auto material = [&]() {
+        return 1 + uint32_t(uniform(random) * parameters.material_count);
+    };
+    auto add_node = [&](
+        uint32_t parent, uint32_t mesh, float x, float y, float z
+    ) {
+        scene.nodes.push_back({
+            .parent = parent,
+            .mesh = mesh,
+            .material = mesh == no_scene_mesh ? 0 : material(),
+            .translation = {x, y, z},
+            .rotation = {0, 0, 0, 1},
+            .scale = {1, 1, 1},
+        });
+        return uint32_t(scene.nodes.size() - 1);
+    };
+
+    auto count = parameters.instance_count;
+    auto spacing = parameters.spacing;
+    // half of the width of the scene, the camera circles outside of it
+    float extent = 0;
+
+    if (parameters.layout == stress_layout::grid) {
+        auto side = uint32_t(ceil(sqrt(double(count))));
+        extent = side * spacing / 2;
+        for (auto i = 0u; i < count; i++) {
+            add_node(
+                no_scene_node, 0,
+                (i % side + 0.5f) * spacing - extent,
+                (i / side + 0.5f) * spacing - extent, 0
+            );
+        }
+
+    } else if (parameters.layout == stress_layout::random) {
+        extent = float(cbrt(double(count))) * spacing / 2;
+        for (auto i = 0u; i < count; i++) {
+            float position[3];
+            for (auto& p : position) {
+                p = (uniform(random) * 2 - 1) * extent;
+            }
+            auto node = add_node(
+                no_scene_node, 0, position[0], position[1], position[2]
+            );
+            // uniformly distributed orientation
+            float u[3]{uniform(random), uniform(random), uniform(random)};
+            const float tau = 6.28318531f;
+            auto& rotation = scene.nodes[node].rotation;
+            rotation[0] = sqrt(1 - u[0]) * sin(tau * u[1]);
+            rotation[1] = sqrt(1 - u[0]) * cos(tau * u[1]);
+            rotation[2] = sqrt(u[0]) * sin(tau * u[2]);
+            rotation[3] = sqrt(u[0]) * cos(tau * u[2]);
+        }
+
+    } else {
+        // chains on a grid, each link turned and shrunk relative to its
+        // parent, so that every level has to be propagated
+        auto depth = max(parameters.depth, 1u);
+        auto chain_count = (count + depth - 1) / depth;
+        auto side = uint32_t(ceil(sqrt(double(chain_count))));
+        extent = side * spacing / 2;
+        for (auto c = 0u; c < chain_count; c++) {
+            auto parent = add_node(
+                no_scene_node, no_scene_mesh,
+                (c % side + 0.5f) * spacing - extent,
+                (c / side + 0.5f) * spacing - extent, 0
+            );
+            auto links = min(depth, count - c * depth);
+            for (auto l = 0u; l < links; l++) {
+                parent = add_node(parent, 0, 0, 0, l > 0 ? 0.5f : 0);
+                auto& node = scene.nodes[parent];
+                float angle = (uniform(random) - 0.5f) * 0.5f;
+                node.rotation[2] = sin(angle / 2);
+                node.rotation[3] = cos(angle / 2);
+                if (l > 0) {
+                    fill(begin(node.scale), end(node.scale), 0.9f);
+                }
+            }
+        }
+    }
+
+    for (auto i = 0u; i < parameters.light_count; i++) {
+        scene_light light;
+        for (auto c = 0u; c < 2; c++) {
+            light.position[c] = (uniform(random) * 2 - 1) * extent;
+        }
+        light.position[2] = 2;
+        for (auto& c : light.color) {
+            c = 0.5f + uniform(random) * 0.5f;
+        }
+        light.radius = spacing * 4;
+        scene.lights.push_back(light);
+    }
+
+    // circles the scene once while moving in and out, always looking at the
+    // center, so that the visible set changes over the whole path
+    const uint32_t key_count = 17;
+    auto radius = extent + 2;
+    for (auto k = 0u; k < key_count; k++) {
+        float t = float(k) / (key_count - 1);
+        float angle = t * 6.28318531f;
+        float distance = radius * (1 + 0.5f * sin(2 * angle));
+        scene.camera_path.push_back({
+            .time = t * parameters.duration,
+            .eye = {
+                cos(angle) * distance, sin(angle) * distance,
+                1 + radius * 0.3f,
+            },
+            .target = {0, 0, 0.5f},
+        });
+    }
+}
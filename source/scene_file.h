@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Plain text scene description, so that benchmark scenes can be generated
+// once and rendered the same way by every build. One element per line,
+// everything after a '#' is a comment:
+//
+//   mesh <name>
+//   node <parent> <mesh> <material> <tx ty tz> <qx qy qz qw> <sx sy sz>
+//   light <x y z> <r g b> <radius>
+//   camera <time> <eye x y z> <target x y z>
+//   texture <path>
+//
+// Nodes are numbered in the order they appear and parents have to come
+// before their children, -1 is no parent. Nodes with mesh -1 only transform
+// their children. Camera keys have to be sorted by time, in seconds.
+// Textures are KTX2 files, material i uses texture i modulo their count.
+
+const uint32_t no_scene_node = -1u;
+const uint32_t no_scene_mesh = -1u;
+
+struct scene_node {
+    uint32_t parent;
+    uint32_t mesh;
+    uint32_t material;
+    float translation[3];
+    // quaternion
+    float rotation[4];
+    float scale[3];
+};
+
+struct scene_light {
+    float position[3];
+    float color[3];
+    float radius;
+};
+
+struct camera_key {
+    float time;
+    float eye[3], target[3];
+};
+
+struct scene_description {
+    std::vector<std::string> meshes;
+    std::vector<scene_node> nodes;
+    std::vector<scene_light> lights;
+    std::vector<camera_key> camera_path;
+    std::vector<std::string> textures;
+};
+
+// throws if the file can't be read or is malformed
+void read_scene(const char* path, scene_description& scene);
+void write_scene(const char* path, const scene_description& scene);
+
+// time of the last camera key, 0 without a camera path
+float get_camera_path_duration(const scene_description& scene);
+// Catmull-Rom interpolation between the keys around time, clamped to the
+// ends of the path, which must not be empty
+void sample_camera_path(
+    const scene_description& scene, float time, float eye[3], float target[3]
+);
+
+enum class stress_layout {
+    // instances evenly spaced on a square grid
+    grid,
+    // instances at random positions and orientations in a cube
+    random,
+    // chains of nodes, each rotated and offset from its parent
+    hierarchy,
+};
+
+struct stress_parameters {
+    stress_layout layout = stress_layout::grid;
+    uint32_t instance_count = 1024;
+    // length of each chain, for hierarchy layouts
+    uint32_t depth = 16;
+    uint32_t material_count = 64;
+    uint32_t light_count = 16;
+    float spacing = 1.5f;
+    // of the camera fly-through, in seconds
+    float duration = 20;
+    uint32_t seed = 1;
+};
+
+// instances of one mesh named mesh_name, with a camera circling the scene.
+// The output only depends on the parameters.
+void generate_stress_scene(
+    const stress_parameters& parameters, const char* mesh_name,
+    scene_description& scene
+);
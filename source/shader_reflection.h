@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+
+#include <vulkan/vulkan.h>
+
+// Tables generated from the compiled shaders by tools/shader_reflect.cpp,
+// included as "shaders/<name>.glsl.h" from the build directory. Each header
+// defines, with the file name as prefix:
+//   <name>_stage, the VkShaderStageFlagBits of the shader
+//   <name>_inputs, the shader_input of each location, sorted by location
+//   <name>_push_constant_size, in bytes, 0 without push constants
+//   <name>_bindings, the shader_binding of each descriptor it uses
+
+// matrices take one input per column
+struct shader_input {
+    uint32_t location;
+    // matching the type in the shader, 32 bit components
+    VkFormat format;
+    uint32_t size;
+    const char* name;
+};
+
+struct shader_binding {
+    uint32_t set, binding;
+    VkDescriptorType type;
+    // 0 for runtime sized arrays
+    uint32_t count;
+};
+
+// the inputs with the input at location stored in the vertex buffer with a
+// different format of the given size, like normalized bytes for a vec4
+template<size_t count>
+constexpr std::array<shader_input, count> with_format(
+    std::array<shader_input, count> inputs, uint32_t location,
+    VkFormat format, uint32_t size
+) {
+    for (auto& input : inputs) {
+        if (input.location == location) {
+            input.format = format;
+            input.size = size;
+        }
+    }
+    return inputs;
+}
+
+// index of the binding of an input, bindings start at the locations in
+// first_locations, which must be sorted
+template<size_t binding_count>
+constexpr uint32_t get_input_binding(
+    const uint32_t (&first_locations)[binding_count], uint32_t location
+) {
+    uint32_t binding = 0;
+    while (
+        binding + 1 < binding_count &&
+        location >= first_locations[binding + 1]
+    ) {
+        binding++;
+    }
+    return binding;
+}
+
+// attribute descriptions with the inputs of each binding tightly packed in
+// the order of their locations
+template<size_t count, size_t binding_count>
+constexpr std::array<VkVertexInputAttributeDescription, count>
+get_vertex_attributes(
+    const std::array<shader_input, count>& inputs,
+    const uint32_t (&first_locations)[binding_count]
+) {
+    std::array<VkVertexInputAttributeDescription, count> attributes{};
+    uint32_t offsets[binding_count]{};
+    for (size_t i = 0; i < count; i++) {
+        auto binding = get_input_binding(first_locations, inputs[i].location);
+        attributes[i] = {
+            .location = inputs[i].location,
+            .binding = binding,
+            .format = inputs[i].format,
+            .offset = offsets[binding],
+        };
+        offsets[binding] += inputs[i].size;
+    }
+    return attributes;
+}
+
+// bytes used by the attributes of a binding, at most its stride
+template<size_t count, size_t binding_count>
+constexpr uint32_t get_binding_size(
+    const std::array<shader_input, count>& inputs,
+    const uint32_t (&first_locations)[binding_count], uint32_t binding
+) {
+    uint32_t size = 0;
+    for (auto& input : inputs) {
+        if (get_input_binding(first_locations, input.location) == binding) {
+            size += input.size;
+        }
+    }
+    return size;
+}
+
+// offset of the attribute at location, for checking it against offsetof
+template<size_t count>
+constexpr uint32_t get_attribute_offset(
+    const std::array<VkVertexInputAttributeDescription, count>& attributes,
+    uint32_t location
+) {
+    for (auto& attribute : attributes) {
+        if (attribute.location == location) {
+            return attribute.offset;
+        }
+    }
+    return -1u;
+}
+
+// whether every descriptor the shader uses in set is in layout, with the
+// same type
+template<size_t count, size_t layout_count>
+constexpr bool fits_layout(
+    const std::array<shader_binding, count>& bindings, uint32_t set,
+    const shader_binding (&layout)[layout_count]
+) {
+    for (auto& binding : bindings) {
+        if (binding.set != set) {
+            continue;
+        }
+        bool found = false;
+        for (auto& l : layout) {
+            found = found || (
+                l.set == set && l.binding == binding.binding &&
+                l.type == binding.type
+            );
+        }
+        if (!found) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,21 @@
+#extension GL_EXT_nonuniform_qualifier : require
+
+// must match bindless.h
+
+struct material {
+    vec4 color;
+    uint texture;
+};
+
+const uint bindless_material_buffer = 0;
+const uint no_texture = 0xffffffffu;
+
+layout(set = 0, binding = 0, std430) readonly buffer material_buffer {
+    material materials[];
+} buffers[];
+
+layout(set = 0, binding = 1) uniform sampler2D textures[];
+
+material get_material(uint index) {
+    return buffers[bindless_material_buffer].materials[index];
+}
@@ -0,0 +1,45 @@
+#version 450
+#pragma shader_stage(compute)
+#extension GL_GOOGLE_include_directive : require
+
+#include "occlusion.glsl"
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(push_constant) uniform hiz_constants {
+    uint level;
+    // of the depth buffer
+    uint samples;
+} constants;
+
+// each texel is the farthest depth of the texels it covers in the previous
+// level, level 0 is the farthest sample of each pixel of the depth buffer
+void main() {
+    ivec2 size = imageSize(destination);
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+    if (any(greaterThanEqual(texel, size))) {
+        return;
+    }
+
+    float depth = 0.0;
+    if (constants.level == 0) {
+        for (int i = 0; i < int(constants.samples); i++) {
+            depth = max(depth, texelFetch(depth_buffer, texel, i).r);
+        }
+    } else {
+        // levels are rounded down, so the last texel of a row or column
+        // also covers the remaining texel of an odd sized previous level
+        ivec2 source_size = imageSize(source);
+        ivec2 end = min(
+            texel * 2 + 2 +
+                ivec2(equal(texel, size - 1)) * (source_size & 1),
+            source_size
+        );
+        for (int y = texel.y * 2; y < end.y; y++) {
+            for (int x = texel.x * 2; x < end.x; x++) {
+                depth = max(depth, imageLoad(source, ivec2(x, y)).r);
+            }
+        }
+    }
+    imageStore(destination, texel, vec4(depth));
+}
@@ -0,0 +1,95 @@
+#version 450
+#pragma shader_stage(fragment)
+
+layout(location = 0) in vec2 vertex_cell;
+layout(location = 1) flat in uint vertex_glyph;
+layout(location = 2) in vec4 vertex_color;
+
+layout(location = 0) out vec4 color;
+
+const uint solid = 0xffffffffu;
+
+// ASCII 32 to 95, bit row * 5 + column is set if the pixel is lit, rows 0 to
+// 3 are in x, rows 4 to 6 in y
+const uvec2 font[64] = uvec2[](
+    uvec2(0x00000u, 0x0000u), // space
+    uvec2(0x21084u, 0x1004u), // !
+    uvec2(0x0014au, 0x0000u), // "
+    uvec2(0x57d4au, 0x295fu), // #
+    uvec2(0x717c4u, 0x11f4u), // $
+    uvec2(0x22263u, 0x6322u), // %
+    uvec2(0x11526u, 0x5935u), // &
+    uvec2(0x00084u, 0x0000u), // '
+    uvec2(0x10888u, 0x2082u), // (
+    uvec2(0x42082u, 0x0888u), // )
+    uvec2(0x75480u, 0x0095u), // *
+    uvec2(0xf9080u, 0x0084u), // +
+    uvec2(0x00000u, 0x0886u), // ,
+    uvec2(0xf8000u, 0x0000u), // -
+    uvec2(0x00000u, 0x18c0u), // .
+    uvec2(0x22200u, 0x0022u), // /
+    uvec2(0xae62eu, 0x3a33u), // 0
+    uvec2(0x210c4u, 0x3884u), // 1
+    uvec2(0x4422eu, 0x7c44u), // 2
+    uvec2(0x4111fu, 0x3a30u), // 3
+    uvec2(0x4a988u, 0x211fu), // 4
+    uvec2(0x83c3fu, 0x3a30u), // 5
+    uvec2(0x7844cu, 0x3a31u), // 6
+    uvec2(0x2221fu, 0x0842u), // 7
+    uvec2(0x7462eu, 0x3a31u), // 8
+    uvec2(0xf462eu, 0x1910u), // 9
+    uvec2(0x018c0u, 0x00c6u), // :
+    uvec2(0x018c0u, 0x0886u), // ;
+    uvec2(0x08888u, 0x2082u), // <
+    uvec2(0x07c00u, 0x001fu), // =
+    uvec2(0x82082u, 0x0888u), // >
+    uvec2(0x4422eu, 0x1004u), // ?
+    uvec2(0xb422eu, 0x3ab5u), // @
+    uvec2(0xfc62eu, 0x4631u), // A
+    uvec2(0x7c62fu, 0x3e31u), // B
+    uvec2(0x0862eu, 0x3a21u), // C
+    uvec2(0x8c527u, 0x1d31u), // D
+    uvec2(0x7843fu, 0x7c21u), // E
+    uvec2(0x7843fu, 0x0421u), // F
+    uvec2(0xe862eu, 0x7a31u), // G
+    uvec2(0xfc631u, 0x4631u), // H
+    uvec2(0x2108eu, 0x3884u), // I
+    uvec2(0x4211cu, 0x1928u), // J
+    uvec2(0x19531u, 0x4525u), // K
+    uvec2(0x08421u, 0x7c21u), // L
+    uvec2(0xad771u, 0x4631u), // M
+    uvec2(0xace31u, 0x4639u), // N
+    uvec2(0x8c62eu, 0x3a31u), // O
+    uvec2(0x7c62fu, 0x0421u), // P
+    uvec2(0x8c62eu, 0x5935u), // Q
+    uvec2(0x7c62fu, 0x4525u), // R
+    uvec2(0x7043eu, 0x3e10u), // S
+    uvec2(0x2109fu, 0x1084u), // T
+    uvec2(0x8c631u, 0x3a31u), // U
+    uvec2(0x8c631u, 0x1151u), // V
+    uvec2(0xac631u, 0x2ab5u), // W
+    uvec2(0x22a31u, 0x462au), // X
+    uvec2(0x22a31u, 0x1084u), // Y
+    uvec2(0x2221fu, 0x7c22u), // Z
+    uvec2(0x1084eu, 0x3842u), // [
+    uvec2(0x20820u, 0x0208u), // backslash
+    uvec2(0x4210eu, 0x3908u), // ]
+    uvec2(0x04544u, 0x0000u), // ^
+    uvec2(0x00000u, 0x7c00u)  // _
+);
+
+void main() {
+    if (vertex_glyph != solid) {
+        ivec2 cell = ivec2(vertex_cell);
+        if (cell.x >= 5 || cell.y >= 7) {
+            discard;
+        }
+        uint bit = uint(cell.y * 5 + cell.x);
+        uvec2 rows = font[vertex_glyph];
+        uint value = bit < 20u ? rows.x >> bit : rows.y >> (bit - 20u);
+        if ((value & 1u) == 0u) {
+            discard;
+        }
+    }
+    color = vertex_color;
+}
@@ -0,0 +1,28 @@
+#version 450
+#pragma shader_stage(vertex)
+
+// one instance per quad, either a glyph or a solid rectangle
+layout(location = 0) in vec4 rectangle; // x, y, width, height in pixels
+layout(location = 1) in uint glyph;
+layout(location = 2) in vec4 color;
+
+layout(push_constant) uniform hud_constants {
+    vec2 screen_size;
+};
+
+layout(location = 0) out vec2 vertex_cell;
+layout(location = 1) flat out uint vertex_glyph;
+layout(location = 2) out vec4 vertex_color;
+
+void main() {
+    // two triangles, corners (0 0) (1 0) (0 1) (0 1) (1 0) (1 1)
+    vec2 corner = vec2(
+        (0x32 >> gl_VertexIndex) & 1, (0x2c >> gl_VertexIndex) & 1
+    );
+    vec2 position = rectangle.xy + corner * rectangle.zw;
+    gl_Position = vec4(position / screen_size * 2.0 - 1.0, 0.0, 1.0);
+    // glyphs are 5 by 7 pixels in a 6 by 8 cell
+    vertex_cell = corner * vec2(6.0, 8.0);
+    vertex_glyph = glyph;
+    vertex_color = color;
+}
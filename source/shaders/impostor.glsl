@@ -0,0 +1,56 @@
+// must match impostor.h
+
+// the atlas has tiles by tiles views of the mesh, the view direction of each
+// tile is the center of its cell of the octahedral map of the unit sphere
+
+// fraction of a tile covered by the bounding sphere, the rest keeps
+// filtering from reaching into the neighbouring tiles
+const float impostor_tile_scale = 15.0 / 16.0;
+
+const uint no_buffer = 0xffffffffu;
+
+vec2 sign_not_zero(vec2 value) {
+    return vec2(value.x >= 0.0 ? 1.0 : -1.0, value.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// from the unit sphere to -1 to 1
+vec2 encode_octahedral(vec3 direction) {
+    direction /= abs(direction.x) + abs(direction.y) + abs(direction.z);
+    if (direction.z < 0.0) {
+        return (1.0 - abs(direction.yx)) * sign_not_zero(direction.xy);
+    }
+    return direction.xy;
+}
+
+vec3 decode_octahedral(vec2 position) {
+    vec3 direction =
+        vec3(position, 1.0 - abs(position.x) - abs(position.y));
+    if (direction.z < 0.0) {
+        direction.xy = (1.0 - abs(direction.yx)) * sign_not_zero(direction.xy);
+    }
+    return normalize(direction);
+}
+
+uvec2 get_impostor_tile(vec3 direction, uint tiles) {
+    vec2 cell = floor((encode_octahedral(direction) * 0.5 + 0.5) * tiles);
+    return uvec2(clamp(cell, vec2(0.0), vec2(tiles - 1)));
+}
+
+vec3 get_tile_direction(uvec2 tile, uint tiles) {
+    return decode_octahedral((vec2(tile) + 0.5) / tiles * 2.0 - 1.0);
+}
+
+// right and up of the image plane when looking along -direction
+void get_impostor_axes(vec3 direction, out vec3 right, out vec3 up) {
+    vec3 reference =
+        abs(direction.y) < 0.99 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0);
+    right = normalize(cross(reference, direction));
+    up = cross(direction, right);
+}
+
+// position is in the image plane of the tile, relative to the bounding
+// sphere, from -1 to 1
+vec2 get_atlas_position(uvec2 tile, vec2 position, uint tiles) {
+    return
+        (vec2(tile) + position * (0.5 * impostor_tile_scale) + 0.5) / tiles;
+}
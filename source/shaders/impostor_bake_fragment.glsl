@@ -0,0 +1,12 @@
+#version 450
+#pragma shader_stage(fragment)
+
+layout(location = 0) in vec3 vertex_normal;
+
+// object space normal, with coverage in alpha. The atlas is cleared to 0,
+// so texels are premultiplied and can be filtered.
+layout(location = 0) out vec4 color;
+
+void main() {
+    color = vec4(normalize(vertex_normal) * 0.5 + 0.5, 1.0);
+}
@@ -0,0 +1,52 @@
+#version 450
+#pragma shader_stage(vertex)
+#extension GL_GOOGLE_include_directive : require
+
+#include "storage.glsl"
+#include "impostor.glsl"
+
+// draws the mesh once per tile of the atlas, the instance is the tile.
+// Orthographic along the view direction of the tile, the bounding sphere
+// fills the tile and the depth range. Vertices are pulled as in
+// solid_pulled_vertex.glsl.
+
+layout(push_constant) uniform impostor_bake_constants {
+    // object space, center and radius
+    vec4 sphere;
+    uint vertex_buffer;
+    // in floats
+    uint vertex_stride;
+    uint tiles;
+} constants;
+
+layout(location = 0) out vec3 vertex_normal;
+
+void main() {
+    uint base = uint(gl_VertexIndex) * constants.vertex_stride;
+    vec3 position = vec3(
+        float_buffers[constants.vertex_buffer].floats[base],
+        float_buffers[constants.vertex_buffer].floats[base + 1],
+        float_buffers[constants.vertex_buffer].floats[base + 2]
+    );
+    vec3 normal = vec3(
+        float_buffers[constants.vertex_buffer].floats[base + 3],
+        float_buffers[constants.vertex_buffer].floats[base + 4],
+        float_buffers[constants.vertex_buffer].floats[base + 5]
+    );
+
+    uint tiles = constants.tiles;
+    uint index = uint(gl_InstanceIndex);
+    uvec2 tile = uvec2(index % tiles, index / tiles);
+    vec3 direction = get_tile_direction(tile, tiles);
+    vec3 right, up;
+    get_impostor_axes(direction, right, up);
+
+    vec3 offset = (position - constants.sphere.xyz) / constants.sphere.w;
+    vec2 atlas = get_atlas_position(
+        tile, vec2(dot(offset, right), dot(offset, up)), tiles
+    );
+    // nearer to the viewer is smaller
+    gl_Position =
+        vec4(atlas * 2.0 - 1.0, 0.5 - 0.5 * dot(offset, direction), 1.0);
+    vertex_normal = normal;
+}
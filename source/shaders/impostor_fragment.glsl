@@ -0,0 +1,40 @@
+#version 450
+#pragma shader_stage(fragment)
+#extension GL_GOOGLE_include_directive : require
+
+#include "shading.glsl"
+#include "impostor.glsl"
+
+layout(location = 0) in vec2 vertex_position;
+layout(location = 1) flat in uvec2 vertex_tile;
+layout(location = 2) flat in uint vertex_material;
+layout(location = 3) flat in float vertex_fade;
+layout(location = 4) flat in uint vertex_atlas;
+layout(location = 5) flat in uint vertex_tiles;
+
+layout(location = 0) out vec3 color;
+
+// 4 by 4 ordered dither, the fade is the fraction of pixels that are drawn
+const uint bayer[16] = uint[](
+    0, 8, 2, 10, 12, 4, 14, 6, 3, 11, 1, 9, 15, 7, 13, 5
+);
+
+void main() {
+    uvec2 pixel = uvec2(gl_FragCoord.xy) & 3;
+    if (
+        (bayer[pixel.y * 4 + pixel.x] + 0.5) / 16.0 >= vertex_fade ||
+        any(greaterThan(abs(vertex_position), vec2(1.0)))
+    ) {
+        discard;
+    }
+
+    vec4 texel = texture(
+        textures[nonuniformEXT(vertex_atlas)],
+        get_atlas_position(vertex_tile, vertex_position, vertex_tiles)
+    );
+    if (texel.a < 0.5) {
+        discard;
+    }
+    vec3 normal = normalize(texel.rgb / texel.a * 2.0 - 1.0);
+    color = shade_solid(normal, vertex_material);
+}
@@ -0,0 +1,80 @@
+#version 450
+#pragma shader_stage(vertex)
+#extension GL_GOOGLE_include_directive : require
+
+#include "storage.glsl"
+#include "impostor.glsl"
+
+// one camera facing quad per instance in the impostor list, which has the
+// instance and the fade of each impostor. The quad goes through the center
+// of the bounding sphere and is textured with the tile whose view direction
+// is nearest to the camera.
+
+// buffers are slots in the bindless set
+layout(push_constant) uniform impostor_constants {
+    // object space, center and radius
+    vec4 sphere;
+    uint instance_buffer, impostor_buffer;
+    // instances that failed the occlusion test are skipped, unless no_buffer
+    uint visibility_buffer;
+    uint first_impostor;
+    uint atlas, tiles;
+} constants;
+
+// in the image plane of the tile, relative to the bounding sphere
+layout(location = 0) out vec2 vertex_position;
+layout(location = 1) flat out uvec2 vertex_tile;
+layout(location = 2) flat out uint vertex_material;
+layout(location = 3) flat out float vertex_fade;
+layout(location = 4) flat out uint vertex_atlas;
+layout(location = 5) flat out uint vertex_tiles;
+
+void main() {
+    uint impostor = (constants.first_impostor + uint(gl_InstanceIndex)) * 2;
+    uint instance = uint_buffers[constants.impostor_buffer].uints[impostor];
+    if (
+        constants.visibility_buffer != no_buffer &&
+        uint_buffers[constants.visibility_buffer].uints[instance] == 0
+    ) {
+        // all corners in the same place, nothing is rasterized
+        gl_Position = vec4(0.0, 0.0, 0.0, 1.0);
+        return;
+    }
+    mat4 matrix = get_instance_matrix(constants.instance_buffer, instance);
+    vec3 center = constants.sphere.xyz;
+    float radius = constants.sphere.w;
+
+    // the camera is the point projected to (0, 0, 1, 0), or a direction
+    // away from the viewer if it is at infinity
+    vec4 camera = inverse(matrix)[2];
+    vec3 direction = normalize(
+        abs(camera.w) > 1e-6 ? camera.xyz / camera.w - center : -camera.xyz
+    );
+    vec3 right, up;
+    get_impostor_axes(direction, right, up);
+
+    // two triangles, corners (0 0) (1 0) (0 1) (0 1) (1 0) (1 1)
+    vec2 corner = vec2(
+        (0x32 >> gl_VertexIndex) & 1, (0x2c >> gl_VertexIndex) & 1
+    ) * 2.0 - 1.0;
+    vec3 offset = (right * corner.x + up * corner.y) * radius;
+    gl_Position = matrix * vec4(center + offset, 1.0);
+
+    // projected along the view direction of the tile, which is linear, so
+    // it can be interpolated
+    uvec2 tile = get_impostor_tile(direction, constants.tiles);
+    vec3 tile_right, tile_up;
+    get_impostor_axes(
+        get_tile_direction(tile, constants.tiles), tile_right, tile_up
+    );
+    vertex_position =
+        vec2(dot(offset, tile_right), dot(offset, tile_up)) / radius;
+    vertex_tile = tile;
+    vertex_material =
+        get_instance_material(constants.instance_buffer, instance);
+    vertex_fade = uintBitsToFloat(
+        uint_buffers[constants.impostor_buffer].uints[impostor + 1]
+    );
+    vertex_atlas = constants.atlas;
+    vertex_tiles = constants.tiles;
+}
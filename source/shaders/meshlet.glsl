@@ -0,0 +1,37 @@
+#include "storage.glsl"
+
+// must match meshlet.h
+
+const uint meshlet_task_size = 32;
+const uint max_meshlet_vertices = 64;
+const uint max_meshlet_triangles = 124;
+
+struct meshlet {
+    // center and radius
+    vec4 sphere;
+    // axis and cutoff
+    vec4 cone;
+    uint vertex_offset, triangle_offset;
+    uint vertex_count, triangle_count;
+};
+
+// meshlets that passed culling, passed from the task to the mesh shader
+struct meshlet_payload {
+    uint meshlets[meshlet_task_size];
+};
+
+// buffers are slots in the bindless set
+layout(push_constant) uniform meshlet_constants {
+    uint meshlet_buffer, meshlet_vertex_buffer, meshlet_triangle_buffer;
+    uint vertex_buffer, instance_buffer, counter_buffer;
+    uint meshlet_count, vertex_offset, vertex_stride;
+    uint instance;
+    // instances that failed the occlusion test are skipped, unless no_buffer
+    uint visibility_buffer;
+} constants;
+
+const uint no_buffer = 0xffffffffu;
+
+layout(set = 0, binding = 0, std430) readonly buffer meshlet_block {
+    meshlet meshlets[];
+} meshlet_buffers[];
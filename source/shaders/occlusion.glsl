@@ -0,0 +1,6 @@
+// must match occlusion.h
+
+layout(set = 1, binding = 0) uniform sampler2DMS depth_buffer;
+layout(set = 1, binding = 1, r32f) uniform readonly image2D source;
+layout(set = 1, binding = 2, r32f) uniform writeonly image2D destination;
+layout(set = 1, binding = 3) uniform sampler2D pyramid;
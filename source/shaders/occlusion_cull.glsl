@@ -0,0 +1,123 @@
+#version 450
+#pragma shader_stage(compute)
+#extension GL_GOOGLE_include_directive : require
+
+#include "storage.glsl"
+#include "occlusion.glsl"
+
+layout(local_size_x = 64) in;
+
+// buffers are slots in the bindless set
+layout(push_constant) uniform occlusion_constants {
+    uint instance_buffer, bounds_buffer, visibility_buffer, counter_buffer;
+    uint command_buffer;
+    uint instance_count, command_offset, command_count;
+    // 0 tests instances, 1 filters commands
+    uint stage;
+} constants;
+
+// whether any part of the bounding box of the sphere could be in front of
+// the farthest depth in the pyramid texels that cover it on screen
+bool is_visible(mat4 matrix, vec4 sphere) {
+    vec3 low = sphere.xyz - sphere.w, high = sphere.xyz + sphere.w;
+    vec2 screen_low = vec2(1.0), screen_high = vec2(-1.0);
+    float nearest = 1.0;
+    for (uint i = 0; i < 8; i++) {
+        vec3 corner = mix(low, high, vec3(i & 1, (i >> 1) & 1, (i >> 2) & 1));
+        vec4 clip = matrix * vec4(corner, 1.0);
+        if (clip.w <= 1e-5) {
+            // crosses the camera plane, can't be projected
+            return true;
+        }
+        vec3 ndc = clip.xyz / clip.w;
+        screen_low = min(screen_low, ndc.xy);
+        screen_high = max(screen_high, ndc.xy);
+        nearest = min(nearest, ndc.z);
+    }
+    if (
+        any(greaterThan(screen_low, vec2(1.0))) ||
+        any(lessThan(screen_high, vec2(-1.0))) ||
+        nearest > 1.0
+    ) {
+        // outside of the frustum
+        return false;
+    }
+    if (nearest <= 0.0) {
+        return true;
+    }
+
+    // the level where the rectangle covers at most 2 by 2 texels
+    ivec2 size = textureSize(pyramid, 0);
+    screen_low = clamp(screen_low * 0.5 + 0.5, 0.0, 1.0);
+    screen_high = clamp(screen_high * 0.5 + 0.5, 0.0, 1.0);
+    ivec2 begin = min(ivec2(screen_low * size), size - 1);
+    ivec2 end = min(ivec2(screen_high * size), size - 1);
+    int level = 0;
+    int levels = textureQueryLevels(pyramid);
+    while (
+        level + 1 < levels &&
+        any(greaterThan((end >> level) - (begin >> level), ivec2(1)))
+    ) {
+        level++;
+    }
+
+    ivec2 level_size = textureSize(pyramid, level);
+    ivec2 low_texel = min(begin >> level, level_size - 1);
+    ivec2 high_texel = min(end >> level, level_size - 1);
+    float farthest = max(
+        max(
+            texelFetch(pyramid, low_texel, level).r,
+            texelFetch(pyramid, ivec2(high_texel.x, low_texel.y), level).r
+        ),
+        max(
+            texelFetch(pyramid, ivec2(low_texel.x, high_texel.y), level).r,
+            texelFetch(pyramid, high_texel, level).r
+        )
+    );
+    return nearest <= farthest;
+}
+
+void main() {
+    uint index = gl_GlobalInvocationID.x;
+
+    if (constants.stage == 0) {
+        // test instances
+        if (index >= constants.instance_count) {
+            return;
+        }
+        mat4 matrix = get_instance_matrix(constants.instance_buffer, index);
+        vec4 sphere = vec4(
+            float_buffers[constants.bounds_buffer].floats[index * 4],
+            float_buffers[constants.bounds_buffer].floats[index * 4 + 1],
+            float_buffers[constants.bounds_buffer].floats[index * 4 + 2],
+            float_buffers[constants.bounds_buffer].floats[index * 4 + 3]
+        );
+        bool visible = is_visible(matrix, sphere);
+        writable_buffers[constants.visibility_buffer].uints[index] =
+            visible ? 1 : 0;
+        if (!visible) {
+            atomicAdd(writable_buffers[constants.counter_buffer].uints[0], 1);
+        }
+
+    } else {
+        // hide late draws of instances that are still occluded, commands
+        // are VkDrawIndexedIndirectCommand, 5 uints each
+        if (index >= constants.command_count) {
+            return;
+        }
+        uint base = (constants.command_offset + index) * 5;
+        uint instance_count =
+            writable_buffers[constants.command_buffer].uints[base + 1];
+        uint first_instance =
+            writable_buffers[constants.command_buffer].uints[base + 4];
+        bool visible = false;
+        for (uint i = 0; i < instance_count; i++) {
+            visible = visible || uint_buffers[
+                constants.visibility_buffer
+            ].uints[first_instance + i] != 0;
+        }
+        if (!visible) {
+            writable_buffers[constants.command_buffer].uints[base + 1] = 0;
+        }
+    }
+}
@@ -0,0 +1,24 @@
+#include "bindless.glsl"
+
+// lighting of the solid passes, fixed in object space, so that impostors
+// can reuse it with the normals of their atlas
+vec3 shade_solid(vec3 normal, uint material_index) {
+    material material = get_material(material_index);
+
+    vec3 color = vec3(0);
+    color = vec3(max(dot(normalize(vec3(1, -1, 1)), normal), 0.0));
+    color += vec3(max(dot(normalize(vec3(-1, -1, 1)), normal), 0.0));
+    color *= normal * 0.5 + 0.5;
+    color *= material.color.rgb;
+
+    if (material.texture != no_texture) {
+        // no texture coordinates in the mesh, so project the texture along
+        // the object space z axis onto the normal, it stays fixed to the
+        // model like the lighting
+        color *= texture(
+            textures[nonuniformEXT(material.texture)], normal.xy * 0.5 + 0.5
+        ).rgb;
+    }
+
+    return pow(color, vec3(1.0 / 2.2));
+}
@@ -0,0 +1,79 @@
+#version 450
+#pragma shader_stage(compute)
+#extension GL_GOOGLE_include_directive : require
+
+#include "storage.glsl"
+
+layout(local_size_x = 64) in;
+
+// buffers are slots in the bindless set, offsets are in vertices
+layout(push_constant) uniform skin_constants {
+    uint vertex_buffer, vertex_stride, skin_buffer, palette_buffer;
+    uint source_offset, vertex_count, joint_count, first_matrix;
+} constants;
+
+// palettes are 3 by 4 row major matrices
+const uint palette_matrix_size = 12;
+
+void main() {
+    uint vertex = gl_GlobalInvocationID.x;
+    if (vertex >= constants.vertex_count) {
+        return;
+    }
+    uint pose = gl_WorkGroupID.y;
+
+    // 4 joints and 4 weights per vertex, 8 bits each
+    uint joints = uint_buffers[constants.skin_buffer].uints[vertex * 2];
+    vec4 weights = unpackUnorm4x8(
+        uint_buffers[constants.skin_buffer].uints[vertex * 2 + 1]
+    );
+    uint palette =
+        (constants.first_matrix + pose * constants.joint_count) *
+        palette_matrix_size;
+    vec4 rows[3] = vec4[3](vec4(0.0), vec4(0.0), vec4(0.0));
+    for (uint i = 0; i < 4; i++) {
+        if (weights[i] == 0.0) {
+            continue;
+        }
+        uint joint = (joints >> (i * 8)) & 0xff;
+        uint base = palette + joint * palette_matrix_size;
+        for (uint row = 0; row < 3; row++) {
+            uint r = base + row * 4;
+            rows[row] += weights[i] * vec4(
+                float_buffers[constants.palette_buffer].floats[r],
+                float_buffers[constants.palette_buffer].floats[r + 1],
+                float_buffers[constants.palette_buffer].floats[r + 2],
+                float_buffers[constants.palette_buffer].floats[r + 3]
+            );
+        }
+    }
+
+    // vertices start with the position and normal, the rest was copied when
+    // the pose mesh was created
+    uint source = (constants.source_offset + vertex) * constants.vertex_stride;
+    vec4 position = vec4(
+        float_buffers[constants.vertex_buffer].floats[source],
+        float_buffers[constants.vertex_buffer].floats[source + 1],
+        float_buffers[constants.vertex_buffer].floats[source + 2],
+        1.0
+    );
+    vec3 normal = vec3(
+        float_buffers[constants.vertex_buffer].floats[source + 3],
+        float_buffers[constants.vertex_buffer].floats[source + 4],
+        float_buffers[constants.vertex_buffer].floats[source + 5]
+    );
+    uint target_offset = uint_buffers[constants.skin_buffer].uints[
+        constants.vertex_count * 2 + pose
+    ];
+    uint target = (target_offset + vertex) * constants.vertex_stride;
+    vec3 skinned_normal = normalize(vec3(
+        dot(rows[0].xyz, normal), dot(rows[1].xyz, normal),
+        dot(rows[2].xyz, normal)
+    ));
+    for (uint i = 0; i < 3; i++) {
+        writable_buffers[constants.vertex_buffer].uints[target + i] =
+            floatBitsToUint(dot(rows[i], position));
+        writable_buffers[constants.vertex_buffer].uints[target + 3 + i] =
+            floatBitsToUint(skinned_normal[i]);
+    }
+}
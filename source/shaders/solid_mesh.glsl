@@ -0,0 +1,66 @@
+#version 450
+#pragma shader_stage(mesh)
+#extension GL_EXT_mesh_shader : require
+#extension GL_GOOGLE_include_directive : require
+
+#include "meshlet.glsl"
+
+layout(local_size_x = meshlet_task_size) in;
+layout(
+    triangles,
+    max_vertices = max_meshlet_vertices,
+    max_primitives = max_meshlet_triangles
+) out;
+
+taskPayloadSharedEXT meshlet_payload payload;
+
+// same outputs as solid_vertex.glsl
+layout(location = 0) out vec3 vertex_normal[];
+layout(location = 1) flat out uint vertex_material[];
+
+void main() {
+    meshlet meshlet = meshlet_buffers[constants.meshlet_buffer].meshlets[
+        payload.meshlets[gl_WorkGroupID.x]
+    ];
+    mat4 matrix =
+        get_instance_matrix(constants.instance_buffer, constants.instance);
+    uint material =
+        get_instance_material(constants.instance_buffer, constants.instance);
+
+    SetMeshOutputsEXT(meshlet.vertex_count, meshlet.triangle_count);
+
+    for (
+        uint i = gl_LocalInvocationIndex; i < meshlet.vertex_count;
+        i += meshlet_task_size
+    ) {
+        uint vertex = constants.vertex_offset + uint_buffers[
+            constants.meshlet_vertex_buffer
+        ].uints[meshlet.vertex_offset + i];
+        uint base = vertex * constants.vertex_stride;
+        vec3 position = vec3(
+            float_buffers[constants.vertex_buffer].floats[base],
+            float_buffers[constants.vertex_buffer].floats[base + 1],
+            float_buffers[constants.vertex_buffer].floats[base + 2]
+        );
+        vec3 normal = vec3(
+            float_buffers[constants.vertex_buffer].floats[base + 3],
+            float_buffers[constants.vertex_buffer].floats[base + 4],
+            float_buffers[constants.vertex_buffer].floats[base + 5]
+        );
+        gl_MeshVerticesEXT[i].gl_Position = matrix * vec4(position, 1.0);
+        vertex_normal[i] = normalize(normal);
+        vertex_material[i] = material;
+    }
+
+    for (
+        uint i = gl_LocalInvocationIndex; i < meshlet.triangle_count;
+        i += meshlet_task_size
+    ) {
+        uint triangle = uint_buffers[constants.meshlet_triangle_buffer].uints[
+            meshlet.triangle_offset + i
+        ];
+        gl_PrimitiveTriangleIndicesEXT[i] = uvec3(
+            triangle & 0xff, (triangle >> 8) & 0xff, (triangle >> 16) & 0xff
+        );
+    }
+}
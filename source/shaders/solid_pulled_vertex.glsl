@@ -0,0 +1,42 @@
+#version 450
+#pragma shader_stage(vertex)
+#extension GL_GOOGLE_include_directive : require
+
+#include "storage.glsl"
+
+// same as solid_vertex.glsl, but vertices and instances are read from
+// storage buffers instead of vertex input, so that the encoding is up to the
+// shader. Indexed draws with a vertex offset and first instance, as for
+// fixed function input.
+
+// buffers are slots in the bindless set
+layout(push_constant) uniform pulled_vertex_constants {
+    uint vertex_buffer;
+    // in floats
+    uint vertex_stride;
+    uint instance_buffer;
+} constants;
+
+layout(location = 0) out vec3 vertex_normal;
+layout(location = 1) flat out uint vertex_material;
+
+void main() {
+    uint base = uint(gl_VertexIndex) * constants.vertex_stride;
+    uint instance = uint(gl_InstanceIndex);
+    vec3 position = vec3(
+        float_buffers[constants.vertex_buffer].floats[base],
+        float_buffers[constants.vertex_buffer].floats[base + 1],
+        float_buffers[constants.vertex_buffer].floats[base + 2]
+    );
+    vec3 normal = vec3(
+        float_buffers[constants.vertex_buffer].floats[base + 3],
+        float_buffers[constants.vertex_buffer].floats[base + 4],
+        float_buffers[constants.vertex_buffer].floats[base + 5]
+    );
+    mat4 matrix = get_instance_matrix(constants.instance_buffer, instance);
+
+    gl_Position = matrix * vec4(position, 1.0);
+    vertex_normal = normalize(normal);
+    vertex_material =
+        get_instance_material(constants.instance_buffer, instance);
+}
@@ -0,0 +1,81 @@
+#version 450
+#pragma shader_stage(task)
+#extension GL_EXT_mesh_shader : require
+#extension GL_GOOGLE_include_directive : require
+
+#include "meshlet.glsl"
+
+// one invocation per meshlet
+layout(local_size_x = meshlet_task_size) in;
+
+taskPayloadSharedEXT meshlet_payload payload;
+
+shared uint visible_count;
+
+bool is_visible(meshlet meshlet, mat4 matrix) {
+    vec3 center = meshlet.sphere.xyz;
+    float radius = meshlet.sphere.w;
+
+    // frustum planes in object space from the rows of the matrix, the near
+    // plane is z > -w, which is conservative for both depth ranges
+    mat4 rows = transpose(matrix);
+    vec4 planes[6] = vec4[](
+        rows[3] + rows[0], rows[3] - rows[0],
+        rows[3] + rows[1], rows[3] - rows[1],
+        rows[3] + rows[2], rows[3] - rows[2]
+    );
+    for (uint i = 0; i < 6; i++) {
+        if (dot(planes[i].xyz, center) + planes[i].w <
+            -radius * length(planes[i].xyz)) {
+            return false;
+        }
+    }
+
+    // the camera is the point projected to (0, 0, 1, 0)
+    vec4 camera = inverse(matrix)[2];
+    if (abs(camera.w) > 1e-6) {
+        vec3 view = center - camera.xyz / camera.w;
+        float cutoff = meshlet.cone.w;
+        if (dot(view, meshlet.cone.xyz) >
+            cutoff * length(view) + radius * (1.0 + cutoff)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void main() {
+    // the instance was tested against the depth pyramid of this frame
+    if (
+        constants.visibility_buffer != no_buffer &&
+        uint_buffers[constants.visibility_buffer].uints[constants.instance] ==
+            0
+    ) {
+        EmitMeshTasksEXT(0, 1, 1);
+        return;
+    }
+
+    if (gl_LocalInvocationIndex == 0) {
+        visible_count = 0;
+    }
+    barrier();
+
+    uint index = gl_GlobalInvocationID.x;
+    if (index < constants.meshlet_count) {
+        meshlet meshlet =
+            meshlet_buffers[constants.meshlet_buffer].meshlets[index];
+        mat4 matrix =
+            get_instance_matrix(constants.instance_buffer, constants.instance);
+        if (is_visible(meshlet, matrix)) {
+            payload.meshlets[atomicAdd(visible_count, 1)] = index;
+        }
+    }
+    barrier();
+
+    if (gl_LocalInvocationIndex == 0) {
+        atomicAdd(
+            writable_buffers[constants.counter_buffer].uints[0], visible_count
+        );
+    }
+    EmitMeshTasksEXT(visible_count, 1, 1);
+}
@@ -0,0 +1,31 @@
+#extension GL_EXT_nonuniform_qualifier : require
+
+// views of the bindless storage buffers, indexed by slot
+
+layout(set = 0, binding = 0, std430) readonly buffer uint_block {
+    uint uints[];
+} uint_buffers[];
+
+layout(set = 0, binding = 0, std430) readonly buffer float_block {
+    float floats[];
+} float_buffers[];
+
+layout(set = 0, binding = 0, std430) buffer writable_block {
+    uint uints[];
+} writable_buffers[];
+
+// instances are a column major matrix followed by the material index
+const uint instance_size = 17;
+
+mat4 get_instance_matrix(uint buffer, uint instance) {
+    uint base = instance * instance_size;
+    mat4 matrix;
+    for (uint i = 0; i < 16; i++) {
+        matrix[i / 4][i % 4] = float_buffers[buffer].floats[base + i];
+    }
+    return matrix;
+}
+
+uint get_instance_material(uint buffer, uint instance) {
+    return uint_buffers[buffer].uints[instance * instance_size + 16];
+}
@@ -0,0 +1,227 @@
+#include "skinning.h"
+
+#include <stdexcept>
+#include <algorithm>
+
+#include "ge1/shader_module.h"
+
+#include "animation.h"
+#include "shaders/skin.glsl.h"
+
+using namespace std;
+
+extern char _binary_shaders_skin_glsl_spv_start;
+extern char _binary_shaders_skin_glsl_spv_end;
+
+static_assert(skin_push_constant_size == sizeof(skin_constants));
+
+void create_skin_pipeline(
+    VkDevice device, const bindless_set& bindless, skin_pipeline& pipeline
+) {
+    pipeline.module = ge1::create_shader_module(device, {
+        &_binary_shaders_skin_glsl_spv_start,
+        &_binary_shaders_skin_glsl_spv_end
+    });
+
+    {
+        VkPushConstantRange push_constant_range{
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .offset = 0,
+            .size = sizeof(skin_constants),
+        };
+        VkPipelineLayoutCreateInfo create_info{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .setLayoutCount = 1,
+            .pSetLayouts = &bindless.layout,
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &push_constant_range,
+        };
+        if (
+            vkCreatePipelineLayout(
+                device, &create_info, nullptr, &pipeline.layout
+            ) != VK_SUCCESS
+        ) {
+            throw runtime_error("failed to create pipeline layout");
+        }
+    }
+
+    VkComputePipelineCreateInfo create_info{
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .stage = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+            .module = pipeline.module,
+            .pName = "main",
+        },
+        .layout = pipeline.layout,
+    };
+    if (
+        vkCreateComputePipelines(
+            device, VK_NULL_HANDLE, 1, &create_info, nullptr,
+            &pipeline.pipeline
+        ) != VK_SUCCESS
+    ) {
+        throw runtime_error("failed to create compute pipeline");
+    }
+}
+
+void destroy_skin_pipeline(VkDevice device, const skin_pipeline& pipeline) {
+    vkDestroyPipeline(device, pipeline.pipeline, nullptr);
+    vkDestroyPipelineLayout(device, pipeline.layout, nullptr);
+    vkDestroyShaderModule(device, pipeline.module, nullptr);
+}
+
+void create_skinned_mesh(
+    VkDevice device, memory_tracker& tracker, bindless_set& bindless,
+    geometry_arena& arena, uint32_t source, span<const uint32_t> weights,
+    uint32_t joint_count, uint32_t pose_count, skinned_mesh& mesh
+) {
+    auto vertex_count = arena.meshes[source].vertex_count;
+    auto index_count = arena.meshes[source].index_count;
+    if (weights.size() != size_t(vertex_count) * 2) {
+        throw runtime_error("skin weights don't match the mesh");
+    }
+    if (joint_count == 0 || joint_count > max_joints) {
+        throw runtime_error("joint count out of range");
+    }
+    mesh.source = source;
+    mesh.joint_count = joint_count;
+    mesh.poses.clear();
+    auto vertex_data = (char*)arena.vertex_buffer.data;
+    auto index_data = (uint32_t*)arena.index_buffer.data;
+    for (auto p = 0u; p < pose_count; p++) {
+        auto pose = reserve_mesh(arena, vertex_count, index_count);
+        // reserving may have moved the source
+        auto& from = arena.meshes[source];
+        auto& to = arena.meshes[pose];
+        auto vertices =
+            vertex_data + uint64_t(from.vertex_offset) * arena.vertex_stride;
+        copy(
+            vertices, vertices + uint64_t(vertex_count) * arena.vertex_stride,
+            vertex_data + uint64_t(to.vertex_offset) * arena.vertex_stride
+        );
+        copy(
+            index_data + from.first_index,
+            index_data + from.first_index + index_count,
+            index_data + to.first_index
+        );
+        mesh.poses.push_back(pose);
+    }
+
+    auto size = sizeof(uint32_t) * (weights.size() + pose_count);
+    create_mapped_buffer(
+        device, tracker, memory_tag::geometry, size,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, mesh.buffer
+    );
+    auto data = (uint32_t*)mesh.buffer.data;
+    copy(weights.begin(), weights.end(), data);
+    // after all reservations, which may have moved earlier poses
+    for (auto p = 0u; p < pose_count; p++) {
+        data[weights.size() + p] = arena.meshes[mesh.poses[p]].vertex_offset;
+    }
+    mesh.slot = add_buffer(device, bindless, mesh.buffer.buffer, 0, size);
+}
+
+void destroy_skinned_mesh(
+    VkDevice device, memory_tracker& tracker, bindless_set& bindless,
+    geometry_arena& arena, const skinned_mesh& mesh
+) {
+    for (auto pose : mesh.poses) {
+        remove_mesh(arena, pose);
+    }
+    remove_buffer(bindless, mesh.slot);
+    destroy_mapped_buffer(device, tracker, mesh.buffer);
+}
+
+void create_palette_buffer(
+    VkDevice device, memory_tracker& tracker, bindless_set& bindless,
+    uint32_t capacity, palette_buffer& buffer
+) {
+    // the slot needs a non-zero range
+    auto size = sizeof(float) * palette_matrix_size * max(capacity, 1u);
+    create_mapped_buffer(
+        device, tracker, memory_tag::instances, size,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, buffer.buffer
+    );
+    buffer.palettes = (float*)buffer.buffer.data;
+    buffer.capacity = capacity;
+    buffer.slot = add_buffer(device, bindless, buffer.buffer.buffer, 0, size);
+}
+
+void destroy_palette_buffer(
+    VkDevice device, memory_tracker& tracker, bindless_set& bindless,
+    const palette_buffer& buffer
+) {
+    remove_buffer(bindless, buffer.slot);
+    destroy_mapped_buffer(device, tracker, buffer.buffer);
+}
+
+uint32_t get_palette_size(span<const skinned_mesh> meshes) {
+    uint32_t size = 0;
+    for (auto& mesh : meshes) {
+        size += mesh.joint_count * uint32_t(mesh.poses.size());
+    }
+    return size;
+}
+
+void record_skinning(
+    VkCommandBuffer command_buffer, const skin_pipeline& pipeline,
+    const bindless_set& bindless, const geometry_arena& arena,
+    uint32_t vertices, span<const skinned_mesh> meshes,
+    const palette_buffer& palettes, VkPipelineStageFlags draw_stage
+) {
+    if (get_palette_size(meshes) > palettes.capacity) {
+        throw runtime_error("palette buffer too small");
+    }
+    // the draws of the previous frame read the vertices that are written,
+    // a write after read only needs an execution dependency
+    vkCmdPipelineBarrier(
+        command_buffer, draw_stage, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+        0, nullptr, 0, nullptr, 0, nullptr
+    );
+
+    vkCmdBindPipeline(
+        command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.pipeline
+    );
+    vkCmdBindDescriptorSets(
+        command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.layout,
+        0, 1, &bindless.set, 0, nullptr
+    );
+    skin_constants constants{
+        .vertices = vertices,
+        .vertex_stride = uint32_t(arena.vertex_stride / sizeof(float)),
+        .palettes = palettes.slot,
+        .first_matrix = 0,
+    };
+    for (auto& mesh : meshes) {
+        auto& source = arena.meshes[mesh.source];
+        constants.skin = mesh.slot;
+        constants.source_offset = source.vertex_offset;
+        constants.vertex_count = source.vertex_count;
+        constants.joint_count = mesh.joint_count;
+        vkCmdPushConstants(
+            command_buffer, pipeline.layout, VK_SHADER_STAGE_COMPUTE_BIT,
+            0, sizeof(constants), &constants
+        );
+        // one row of workgroups per pose
+        vkCmdDispatch(
+            command_buffer, (source.vertex_count + 63) / 64,
+            uint32_t(mesh.poses.size()), 1
+        );
+        constants.first_matrix +=
+            mesh.joint_count * uint32_t(mesh.poses.size());
+    }
+
+    // vertex input reads the vertices as attributes, the pulling vertex
+    // shader and mesh shaders as storage buffers
+    VkMemoryBarrier barrier{
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask =
+            VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_SHADER_READ_BIT,
+    };
+    vkCmdPipelineBarrier(
+        command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, draw_stage, 0,
+        1, &barrier, 0, nullptr, 0, nullptr
+    );
+}
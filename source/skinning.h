@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "buffer.h"
+#include "bindless.h"
+#include "geometry_arena.h"
+
+// Skeletal meshes are skinned by a compute shader into meshes of the
+// geometry arena, one per pose, so every vertex path draws them like any
+// other mesh and all instances with the same pose share the skinned
+// vertices. Each pose has a joint palette, see animation.h, which the CPU
+// writes every frame.
+
+// must match the push constants in skin.glsl, buffers are bindless slots
+// and offsets are in vertices
+struct skin_constants {
+    uint32_t vertices, vertex_stride, skin, palettes;
+    uint32_t source_offset, vertex_count, joint_count, first_matrix;
+};
+
+struct skin_pipeline {
+    VkShaderModule module;
+    VkPipelineLayout layout;
+    VkPipeline pipeline;
+};
+
+void create_skin_pipeline(
+    VkDevice device, const bindless_set& bindless, skin_pipeline& pipeline
+);
+void destroy_skin_pipeline(VkDevice device, const skin_pipeline& pipeline);
+
+struct skinned_mesh {
+    // bind pose in the arena, not drawn itself
+    uint32_t source;
+    uint32_t joint_count;
+    // mesh ids of the skinned copies, with the indices of source
+    std::vector<uint32_t> poses;
+    // joints and weights of each vertex, followed by the first vertex of
+    // each pose mesh
+    mapped_buffer buffer;
+    uint32_t slot;
+};
+
+// weights are two packed values per vertex, see create_chain_skeleton. The
+// offsets of the pose meshes are written once, so the arena must not be
+// defragmented while the skinned mesh exists.
+void create_skinned_mesh(
+    VkDevice device, memory_tracker& tracker, bindless_set& bindless,
+    geometry_arena& arena, uint32_t source, std::span<const uint32_t> weights,
+    uint32_t joint_count, uint32_t pose_count, skinned_mesh& mesh
+);
+// also removes the pose meshes from the arena
+void destroy_skinned_mesh(
+    VkDevice device, memory_tracker& tracker, bindless_set& bindless,
+    geometry_arena& arena, const skinned_mesh& mesh
+);
+
+// palettes of all poses of all skinned meshes, in the order of the meshes,
+// then poses, then joints, one per frame in flight
+struct palette_buffer {
+    mapped_buffer buffer;
+    // palette_matrix_size floats per matrix
+    float* palettes;
+    uint32_t capacity;
+    uint32_t slot;
+};
+
+// capacity is in matrices
+void create_palette_buffer(
+    VkDevice device, memory_tracker& tracker, bindless_set& bindless,
+    uint32_t capacity, palette_buffer& buffer
+);
+void destroy_palette_buffer(
+    VkDevice device, memory_tracker& tracker, bindless_set& bindless,
+    const palette_buffer& buffer
+);
+
+// number of matrices the poses of the meshes need
+uint32_t get_palette_size(std::span<const skinned_mesh> meshes);
+
+// skins every pose of the meshes, vertices is the slot of the arena's
+// vertex buffer. Waits for the draws of earlier frames, which read the same
+// vertices, and makes the results available to draw_stage. Must be recorded
+// outside of a render pass.
+void record_skinning(
+    VkCommandBuffer command_buffer, const skin_pipeline& pipeline,
+    const bindless_set& bindless, const geometry_arena& arena,
+    uint32_t vertices, std::span<const skinned_mesh> meshes,
+    const palette_buffer& palettes, VkPipelineStageFlags draw_stage
+);
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <utility>
+
+// Background thread of the geometry and the texture stream. The render
+// thread queues loads, the loader thread reads them one after the other
+// and hands them back, and the render thread takes the finished ones at
+// the start of a frame.
+
+template<class T>
+struct stream_loader {
+    // loads waiting for the loader thread and loads it finished
+    std::deque<T> queue;
+    std::vector<T> finished;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stopping;
+    // set if any load failed
+    bool failed;
+    std::thread thread;
+};
+
+// load(T&) runs on the loader thread and returns false if it failed, the
+// load is finished either way
+template<class T, class F>
+void start_stream_loader(stream_loader<T>& loader, F&& load) {
+    loader.stopping = false;
+    loader.failed = false;
+    loader.thread = std::thread(
+        [&loader, load = std::forward<F>(load)]() mutable {
+            std::unique_lock lock(loader.mutex);
+            while (true) {
+                loader.condition.wait(lock, [&]() {
+                    return loader.stopping || !loader.queue.empty();
+                });
+                if (loader.stopping) {
+                    return;
+                }
+                auto item = std::move(loader.queue.front());
+                loader.queue.pop_front();
+                lock.unlock();
+
+                bool loaded = load(item);
+
+                lock.lock();
+                loader.failed = loader.failed || !loaded;
+                loader.finished.push_back(std::move(item));
+            }
+        }
+    );
+}
+
+// waits for the current load, the others stay in the queue and the
+// finished ones in finished
+template<class T>
+void stop_stream_loader(stream_loader<T>& loader) {
+    {
+        std::lock_guard lock(loader.mutex);
+        loader.stopping = true;
+    }
+    loader.condition.notify_one();
+    loader.thread.join();
+}
+
+template<class T, class R>
+void queue_loads(stream_loader<T>& loader, const R& loads) {
+    {
+        std::lock_guard lock(loader.mutex);
+        loader.queue.insert(loader.queue.end(), loads.begin(), loads.end());
+    }
+    loader.condition.notify_one();
+}
+
+// moves the finished loads into finished, returns false without taking
+// them if any load failed
+template<class T, class C>
+bool take_finished_loads(stream_loader<T>& loader, C& finished) {
+    std::lock_guard lock(loader.mutex);
+    if (loader.failed) {
+        return false;
+    }
+    finished.assign(loader.finished.begin(), loader.finished.end());
+    loader.finished.clear();
+    return true;
+}
@@ -0,0 +1,584 @@
+#include "texture_blocks.h"
+
+#include <stdexcept>
+#include <algorithm>
+
+using namespace std;
+
+uint32_t get_block_size(VkFormat format) {
+    switch (format) {
+    case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+        return 8;
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+        return 16;
+    default:
+        return 0;
+    }
+}
+
+bool can_decode_blocks(VkFormat format) {
+    return get_block_size(format) != 0;
+}
+
+VkFormat get_decoded_format(VkFormat format) {
+    switch (format) {
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+        return VK_FORMAT_R8G8B8A8_SRGB;
+    default:
+        return VK_FORMAT_R8G8B8A8_UNORM;
+    }
+}
+
+uint64_t get_level_size(VkFormat format, uint32_t width, uint32_t height) {
+    auto blocks_x = (width + texture_block_texels - 1) / texture_block_texels;
+    auto blocks_y = (height + texture_block_texels - 1) / texture_block_texels;
+    return uint64_t(blocks_x) * blocks_y * get_block_size(format);
+}
+
+static uint8_t clamp_channel(int value) {
+    return uint8_t(clamp(value, 0, 255));
+}
+
+// texels of a block are written to rgba with 4 bytes each, row by row
+
+// one channel of a BC4 block, as used twice by BC5
+static void decode_bc4(const uint8_t* block, uint8_t* rgba, uint32_t channel) {
+    int values[8]{block[0], block[1]};
+    if (values[0] > values[1]) {
+        for (auto i = 1; i < 7; i++) {
+            values[i + 1] = ((7 - i) * values[0] + i * values[1] + 3) / 7;
+        }
+    } else {
+        for (auto i = 1; i < 5; i++) {
+            values[i + 1] = ((5 - i) * values[0] + i * values[1] + 2) / 5;
+        }
+        values[6] = 0;
+        values[7] = 255;
+    }
+    uint64_t indices = 0;
+    for (auto i = 0u; i < 6; i++) {
+        indices |= uint64_t(block[2 + i]) << (i * 8);
+    }
+    for (auto texel = 0u; texel < 16; texel++) {
+        rgba[texel * 4 + channel] = uint8_t(values[indices >> texel * 3 & 7]);
+    }
+}
+
+static uint64_t read_big_endian(const uint8_t* bytes) {
+    uint64_t value = 0;
+    for (auto i = 0u; i < 8; i++) {
+        value = value << 8 | bytes[i];
+    }
+    return value;
+}
+
+static int get_bits(uint64_t value, uint32_t high, uint32_t low) {
+    return int(value >> low & ((1ull << (high - low + 1)) - 1));
+}
+
+static int extend_4(int value) {
+    return value * 17;
+}
+
+static int extend_5(int value) {
+    return value << 3 | value >> 2;
+}
+
+static int extend_6(int value) {
+    return value << 2 | value >> 4;
+}
+
+static int extend_7(int value) {
+    return value << 1 | value >> 6;
+}
+
+// the color of texel x, y is paints[index(x, y)], with the index from the
+// two bit planes in the low half of the block
+static void write_paints(
+    uint64_t block, const int (&paints)[4][3], uint8_t* rgba
+) {
+    for (auto x = 0u; x < 4; x++) {
+        for (auto y = 0u; y < 4; y++) {
+            auto i = x * 4 + y;
+            auto index = (block >> (16 + i) & 1) << 1 | (block >> i & 1);
+            auto texel = &rgba[(y * 4 + x) * 4];
+            for (auto c = 0u; c < 3; c++) {
+                texel[c] = clamp_channel(paints[index][c]);
+            }
+        }
+    }
+}
+
+static void decode_etc2_planar(uint64_t block, uint8_t* rgba) {
+    int origin[3]{
+        extend_6(get_bits(block, 62, 57)),
+        extend_7(get_bits(block, 56, 56) << 6 | get_bits(block, 54, 49)),
+        extend_6(
+            get_bits(block, 48, 48) << 5 | get_bits(block, 44, 43) << 3 |
+            get_bits(block, 41, 39)
+        ),
+    };
+    int horizontal[3]{
+        extend_6(get_bits(block, 38, 34) << 1 | get_bits(block, 32, 32)),
+        extend_7(get_bits(block, 31, 25)),
+        extend_6(get_bits(block, 24, 19)),
+    };
+    int vertical[3]{
+        extend_6(get_bits(block, 18, 13)),
+        extend_7(get_bits(block, 12, 6)),
+        extend_6(get_bits(block, 5, 0)),
+    };
+    for (auto y = 0; y < 4; y++) {
+        for (auto x = 0; x < 4; x++) {
+            auto texel = &rgba[(y * 4 + x) * 4];
+            for (auto c = 0u; c < 3; c++) {
+                texel[c] = clamp_channel(
+                    (
+                        x * (horizontal[c] - origin[c]) +
+                        y * (vertical[c] - origin[c]) + 4 * origin[c] + 2
+                    ) >> 2
+                );
+            }
+        }
+    }
+}
+
+// T and H modes, two base colors and a distance give the four paints
+static void decode_etc2_th(uint64_t block, bool t_mode, uint8_t* rgba) {
+    static const int distances[8]{3, 6, 11, 16, 23, 32, 41, 64};
+    int colors[2][3];
+    uint32_t distance_index;
+    if (t_mode) {
+        colors[0][0] =
+            get_bits(block, 60, 59) << 2 | get_bits(block, 57, 56);
+        colors[0][1] = get_bits(block, 55, 52);
+        colors[0][2] = get_bits(block, 51, 48);
+        colors[1][0] = get_bits(block, 47, 44);
+        colors[1][1] = get_bits(block, 43, 40);
+        colors[1][2] = get_bits(block, 39, 36);
+        distance_index =
+            get_bits(block, 35, 34) << 1 | get_bits(block, 32, 32);
+    } else {
+        colors[0][0] = get_bits(block, 62, 59);
+        colors[0][1] =
+            get_bits(block, 58, 56) << 1 | get_bits(block, 52, 52);
+        colors[0][2] =
+            get_bits(block, 51, 51) << 3 | get_bits(block, 49, 47);
+        colors[1][0] = get_bits(block, 46, 43);
+        colors[1][1] = get_bits(block, 42, 39);
+        colors[1][2] = get_bits(block, 38, 35);
+        // the order of the colors holds the lowest bit of the distance
+        auto first = colors[0][0] << 8 | colors[0][1] << 4 | colors[0][2];
+        auto second = colors[1][0] << 8 | colors[1][1] << 4 | colors[1][2];
+        distance_index =
+            get_bits(block, 34, 34) << 2 | get_bits(block, 32, 32) << 1 |
+            (first >= second);
+    }
+    auto distance = distances[distance_index];
+    int paints[4][3];
+    for (auto c = 0u; c < 3; c++) {
+        auto first = extend_4(colors[0][c]);
+        auto second = extend_4(colors[1][c]);
+        if (t_mode) {
+            paints[0][c] = first;
+            paints[1][c] = second + distance;
+            paints[2][c] = second;
+            paints[3][c] = second - distance;
+        } else {
+            paints[0][c] = first + distance;
+            paints[1][c] = first - distance;
+            paints[2][c] = second + distance;
+            paints[3][c] = second - distance;
+        }
+    }
+    write_paints(block, paints, rgba);
+}
+
+static void decode_etc2_rgb(const uint8_t* bytes, uint8_t* rgba) {
+    static const int modifiers[8][2]{
+        {2, 8}, {5, 17}, {9, 29}, {13, 42},
+        {18, 60}, {24, 80}, {33, 106}, {47, 183},
+    };
+    auto block = read_big_endian(bytes);
+    bool differential = block >> 33 & 1;
+    bool flip = block >> 32 & 1;
+    int bases[2][3];
+    if (differential) {
+        for (auto c = 0u; c < 3; c++) {
+            auto high = 63 - c * 8;
+            auto base = get_bits(block, high, high - 4);
+            // 3 bit two's complement
+            auto delta = get_bits(block, high - 5, high - 7);
+            delta -= delta >> 2 << 3;
+            auto second = base + delta;
+            if (second < 0 || second > 31) {
+                // an overflowing red selects T, green H and blue planar
+                if (c == 2) {
+                    decode_etc2_planar(block, rgba);
+                } else {
+                    decode_etc2_th(block, c == 0, rgba);
+                }
+                return;
+            }
+            bases[0][c] = extend_5(base);
+            bases[1][c] = extend_5(second);
+        }
+    } else {
+        for (auto c = 0u; c < 3; c++) {
+            auto high = 63 - c * 8;
+            bases[0][c] = extend_4(get_bits(block, high, high - 3));
+            bases[1][c] = extend_4(get_bits(block, high - 4, high - 7));
+        }
+    }
+    int tables[2]{get_bits(block, 39, 37), get_bits(block, 36, 34)};
+    for (auto x = 0u; x < 4; x++) {
+        for (auto y = 0u; y < 4; y++) {
+            auto i = x * 4 + y;
+            // two 2 by 4 halves, or two 4 by 2 halves if flipped
+            auto half = (flip ? y : x) >= 2;
+            auto& modifier = modifiers[tables[half]];
+            auto magnitude = modifier[block >> i & 1];
+            auto sign = block >> (16 + i) & 1;
+            auto texel = &rgba[(y * 4 + x) * 4];
+            for (auto c = 0u; c < 3; c++) {
+                texel[c] = clamp_channel(
+                    bases[half][c] + (sign ? -magnitude : magnitude)
+                );
+            }
+        }
+    }
+}
+
+// EAC alpha, the first half of ETC2 RGBA blocks
+static void decode_eac_alpha(const uint8_t* bytes, uint8_t* rgba) {
+    static const int modifiers[16][8]{
+        {-3, -6, -9, -15, 2, 5, 8, 14},
+        {-3, -7, -10, -13, 2, 6, 9, 12},
+        {-2, -5, -8, -13, 1, 4, 7, 12},
+        {-2, -4, -6, -13, 1, 3, 5, 12},
+        {-3, -6, -8, -12, 2, 5, 7, 11},
+        {-3, -7, -9, -11, 2, 6, 8, 10},
+        {-4, -7, -8, -11, 3, 6, 7, 10},
+        {-3, -5, -8, -11, 2, 4, 7, 10},
+        {-2, -6, -8, -10, 1, 5, 7, 9},
+        {-2, -5, -8, -10, 1, 4, 7, 9},
+        {-2, -4, -8, -10, 1, 3, 7, 9},
+        {-2, -5, -7, -10, 1, 4, 6, 9},
+        {-3, -4, -7, -10, 2, 3, 6, 9},
+        {-1, -2, -3, -10, 0, 1, 2, 9},
+        {-4, -6, -8, -9, 3, 5, 7, 8},
+        {-3, -5, -7, -9, 2, 4, 6, 8},
+    };
+    auto block = read_big_endian(bytes);
+    auto base = get_bits(block, 63, 56);
+    auto multiplier = get_bits(block, 55, 52);
+    auto& modifier = modifiers[get_bits(block, 51, 48)];
+    for (auto x = 0u; x < 4; x++) {
+        for (auto y = 0u; y < 4; y++) {
+            auto i = x * 4 + y;
+            auto index = block >> (45 - i * 3) & 7;
+            rgba[(y * 4 + x) * 4 + 3] =
+                clamp_channel(base + modifier[index] * multiplier);
+        }
+    }
+}
+
+// BC7 modes, the bits of each field of a block
+struct bc7_mode {
+    uint32_t subsets, partition_bits, rotation_bits, selection_bits;
+    uint32_t color_bits, alpha_bits;
+    // per endpoint or per subset
+    uint32_t endpoint_p_bits, shared_p_bits;
+    uint32_t index_bits, secondary_index_bits;
+};
+
+static const bc7_mode bc7_modes[8]{
+    {3, 4, 0, 0, 4, 0, 1, 0, 3, 0},
+    {2, 6, 0, 0, 6, 0, 0, 1, 3, 0},
+    {3, 6, 0, 0, 5, 0, 0, 0, 2, 0},
+    {2, 6, 0, 0, 7, 0, 1, 0, 2, 0},
+    {1, 0, 2, 1, 5, 6, 0, 0, 2, 3},
+    {1, 0, 2, 0, 7, 8, 0, 0, 2, 2},
+    {1, 0, 0, 0, 7, 7, 1, 0, 4, 0},
+    {2, 6, 0, 0, 5, 5, 1, 0, 2, 0},
+};
+
+// subset of each texel in row order, one bit per texel for two subsets
+static const uint16_t bc7_partitions_2[64]{
+    0xcccc, 0x8888, 0xeeee, 0xecc8, 0xc880, 0xfeec, 0xfec8, 0xec80,
+    0xc800, 0xffec, 0xfe80, 0xe800, 0xffe8, 0xff00, 0xfff0, 0xf000,
+    0xf710, 0x008e, 0x7100, 0x08ce, 0x008c, 0x7310, 0x3100, 0x8cce,
+    0x088c, 0x3110, 0x6666, 0x366c, 0x17e8, 0x0ff0, 0x718e, 0x399c,
+    0xaaaa, 0xf0f0, 0x5a5a, 0x33cc, 0x3c3c, 0x55aa, 0x9696, 0xa55a,
+    0x73ce, 0x13c8, 0x324c, 0x3bdc, 0x6996, 0xc33c, 0x9966, 0x0660,
+    0x0272, 0x04e4, 0x4e40, 0x2720, 0xc936, 0x936c, 0x39c6, 0x639c,
+    0x9336, 0x9cc6, 0x817e, 0xe718, 0xccf0, 0x0fcc, 0x7744, 0xee22,
+};
+
+// two bits per texel for three subsets
+static const uint32_t bc7_partitions_3[64]{
+    0xaa685050, 0x6a5a5040, 0x5a5a4200, 0x5450a0a8,
+    0xa5a50000, 0xa0a05050, 0x5555a0a0, 0x5a5a5050,
+    0xaa550000, 0xaa555500, 0xaaaa5500, 0x90909090,
+    0x94949494, 0xa4a4a4a4, 0xa9a59450, 0x2a0a4250,
+    0xa5945040, 0x0a425054, 0xa5a5a500, 0x55a0a0a0,
+    0xa8a85454, 0x6a6a4040, 0xa4a45000, 0x1a1a0500,
+    0x0050a4a4, 0xaaa59090, 0x14696914, 0x69691400,
+    0xa08585a0, 0xaa821414, 0x50a4a450, 0x6a5a0200,
+    0xa9a58000, 0x5090a0a8, 0xa8a09050, 0x24242424,
+    0x00aa5500, 0x24924924, 0x24499224, 0x50a50a50,
+    0x500aa550, 0xaaaa4444, 0x66660000, 0xa5a0a5a0,
+    0x50a050a0, 0x69286928, 0x44aaaa44, 0x66666600,
+    0xaa444444, 0x54a854a8, 0x95809580, 0x96969600,
+    0xa85454a8, 0x80959580, 0xaa141414, 0x96960000,
+    0xaaaa1414, 0xa05050a0, 0xa0a5a5a0, 0x96000000,
+    0x40804080, 0xa9a8a9a8, 0xaaaaaa44, 0x2a4a5254,
+};
+
+// the index of the first texel of a subset lacks its highest bit, which is
+// always 0. Subset 0 starts with texel 0, these are the others.
+static const uint8_t bc7_anchors_2[64]{
+    15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+    15, 2, 8, 2, 2, 8, 8, 15, 2, 8, 2, 2, 8, 8, 2, 2,
+    15, 15, 6, 8, 2, 8, 15, 15, 2, 8, 2, 2, 2, 15, 15, 6,
+    6, 2, 6, 8, 15, 15, 2, 2, 15, 15, 15, 15, 15, 2, 2, 15,
+};
+
+static const uint8_t bc7_anchors_3[2][64]{
+    {
+        3, 3, 15, 15, 8, 3, 15, 15, 8, 8, 6, 6, 6, 5, 3, 3,
+        3, 3, 8, 15, 3, 3, 6, 10, 5, 8, 8, 6, 8, 5, 15, 15,
+        8, 15, 3, 5, 6, 10, 8, 15, 15, 3, 15, 5, 15, 15, 15, 15,
+        3, 15, 5, 5, 5, 8, 5, 10, 5, 10, 8, 13, 15, 12, 3, 3,
+    }, {
+        15, 8, 8, 3, 15, 15, 3, 8, 15, 15, 15, 15, 15, 15, 15, 8,
+        15, 8, 15, 3, 15, 8, 15, 8, 3, 15, 6, 10, 15, 15, 10, 8,
+        15, 3, 15, 10, 10, 8, 9, 10, 6, 15, 8, 15, 3, 6, 6, 8,
+        15, 3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 3, 15, 15, 8,
+    },
+};
+
+// weight of the second endpoint in 64ths, by index bits and index
+static int get_bc7_weight(uint32_t bits, uint32_t index) {
+    static const int weights_2[4]{0, 21, 43, 64};
+    static const int weights_3[8]{0, 9, 18, 27, 37, 46, 55, 64};
+    static const int weights_4[16]{
+        0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64,
+    };
+    switch (bits) {
+    case 2:
+        return weights_2[index];
+    case 3:
+        return weights_3[index];
+    default:
+        return weights_4[index];
+    }
+}
+
+// fields are stored from the lowest bit of the first byte on, the bits
+// that weren't read yet are shifted down
+struct bit_reader {
+    uint64_t low, high;
+};
+
+static uint64_t read_little_endian(const uint8_t* bytes) {
+    uint64_t value = 0;
+    for (auto i = 0u; i < 8; i++) {
+        value |= uint64_t(bytes[i]) << (i * 8);
+    }
+    return value;
+}
+
+static uint32_t read_bits(bit_reader& reader, uint32_t count) {
+    if (count == 0) {
+        return 0;
+    }
+    auto value = uint32_t(reader.low & ((1ull << count) - 1));
+    reader.low = reader.low >> count | reader.high << (64 - count);
+    reader.high >>= count;
+    return value;
+}
+
+static void decode_bc7(const uint8_t* block, uint8_t* rgba) {
+    // the mode is the number of 0 bits before the first 1
+    auto mode_index = 0u;
+    while (mode_index < 8 && !(block[0] >> mode_index & 1)) {
+        mode_index++;
+    }
+    if (mode_index == 8) {
+        // reserved, decodes to transparent black
+        fill_n(rgba, 16 * 4, uint8_t(0));
+        return;
+    }
+    auto& mode = bc7_modes[mode_index];
+    bit_reader reader{
+        read_little_endian(block), read_little_endian(block + 8)
+    };
+    read_bits(reader, mode_index + 1);
+    auto partition = read_bits(reader, mode.partition_bits);
+    auto rotation = read_bits(reader, mode.rotation_bits);
+    auto selection = read_bits(reader, mode.selection_bits);
+
+    // two per subset, channels are stored one after the other
+    auto endpoint_count = mode.subsets * 2;
+    int endpoints[6][4];
+    for (auto c = 0u; c < 4; c++) {
+        auto bits = c < 3 ? mode.color_bits : mode.alpha_bits;
+        for (auto e = 0u; e < endpoint_count; e++) {
+            endpoints[e][c] = read_bits(reader, bits);
+        }
+    }
+    uint32_t p_bits[6]{};
+    for (auto e = 0u; e < endpoint_count; e++) {
+        p_bits[e] = read_bits(reader, mode.endpoint_p_bits);
+    }
+    if (mode.shared_p_bits) {
+        for (auto s = 0u; s < mode.subsets; s++) {
+            p_bits[s * 2] = p_bits[s * 2 + 1] = read_bits(reader, 1);
+        }
+    }
+    // the p-bit is the lowest bit of each channel, then the highest bits
+    // are repeated below
+    bool has_p_bits = mode.endpoint_p_bits + mode.shared_p_bits > 0;
+    for (auto e = 0u; e < endpoint_count; e++) {
+        for (auto c = 0u; c < 4; c++) {
+            int bits = c < 3 ? mode.color_bits : mode.alpha_bits;
+            if (bits == 0) {
+                endpoints[e][c] = 255;
+                continue;
+            }
+            auto& value = endpoints[e][c];
+            if (has_p_bits) {
+                value = value << 1 | p_bits[e];
+                bits++;
+            }
+            value = value << (8 - bits) | value >> (2 * bits - 8);
+        }
+    }
+
+    auto get_subset = [&](uint32_t texel) -> uint32_t {
+        switch (mode.subsets) {
+        case 2:
+            return bc7_partitions_2[partition] >> texel & 1;
+        case 3:
+            return bc7_partitions_3[partition] >> texel * 2 & 3;
+        default:
+            return 0;
+        }
+    };
+    auto is_anchor = [&](uint32_t texel) {
+        switch (mode.subsets) {
+        case 2:
+            return texel == 0 || texel == bc7_anchors_2[partition];
+        case 3:
+            return
+                texel == 0 || texel == bc7_anchors_3[0][partition] ||
+                texel == bc7_anchors_3[1][partition];
+        default:
+            return texel == 0;
+        }
+    };
+    uint32_t indices[16], secondary_indices[16];
+    for (auto texel = 0u; texel < 16; texel++) {
+        indices[texel] = read_bits(
+            reader, mode.index_bits - is_anchor(texel)
+        );
+    }
+    if (mode.secondary_index_bits) {
+        for (auto texel = 0u; texel < 16; texel++) {
+            secondary_indices[texel] = read_bits(
+                reader, mode.secondary_index_bits - (texel == 0)
+            );
+        }
+    }
+
+    for (auto texel = 0u; texel < 16; texel++) {
+        auto subset = get_subset(texel);
+        auto& first = endpoints[subset * 2];
+        auto& second = endpoints[subset * 2 + 1];
+        // modes with two index sets use the primary one for color and the
+        // secondary one for alpha, unless the selection bit swaps them
+        auto color_weight = get_bc7_weight(mode.index_bits, indices[texel]);
+        auto alpha_weight = color_weight;
+        if (mode.secondary_index_bits) {
+            auto secondary_weight = get_bc7_weight(
+                mode.secondary_index_bits, secondary_indices[texel]
+            );
+            if (selection) {
+                alpha_weight = color_weight;
+                color_weight = secondary_weight;
+            } else {
+                alpha_weight = secondary_weight;
+            }
+        }
+        auto out = &rgba[texel * 4];
+        for (auto c = 0u; c < 4; c++) {
+            auto weight = c < 3 ? color_weight : alpha_weight;
+            out[c] = uint8_t(
+                ((64 - weight) * first[c] + weight * second[c] + 32) >> 6
+            );
+        }
+        // swaps alpha with red, green or blue
+        if (rotation) {
+            swap(out[3], out[rotation - 1]);
+        }
+    }
+}
+
+void decode_blocks(
+    VkFormat format, uint32_t width, uint32_t height, const uint8_t* blocks,
+    uint8_t* rgba
+) {
+    if (!can_decode_blocks(format)) {
+        throw runtime_error("texture format can't be decoded");
+    }
+    auto block_size = get_block_size(format);
+    auto blocks_x = (width + 3) / 4, blocks_y = (height + 3) / 4;
+    uint8_t texels[16 * 4];
+    for (auto by = 0u; by < blocks_y; by++) {
+        for (auto bx = 0u; bx < blocks_x; bx++) {
+            auto block = blocks + (size_t(by) * blocks_x + bx) * block_size;
+            switch (format) {
+            case VK_FORMAT_BC5_UNORM_BLOCK:
+                decode_bc4(block, texels, 0);
+                decode_bc4(block + 8, texels, 1);
+                for (auto i = 0u; i < 16; i++) {
+                    texels[i * 4 + 2] = 0;
+                    texels[i * 4 + 3] = 255;
+                }
+                break;
+            case VK_FORMAT_BC7_UNORM_BLOCK:
+            case VK_FORMAT_BC7_SRGB_BLOCK:
+                decode_bc7(block, texels);
+                break;
+            case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+            case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+                decode_etc2_rgb(block, texels);
+                for (auto i = 0u; i < 16; i++) {
+                    texels[i * 4 + 3] = 255;
+                }
+                break;
+            default:
+                decode_eac_alpha(block, texels);
+                decode_etc2_rgb(block + 8, texels);
+                break;
+            }
+            // blocks at the right and bottom edges may be cut off
+            auto columns = min(4u, width - bx * 4);
+            auto rows = min(4u, height - by * 4);
+            for (auto y = 0u; y < rows; y++) {
+                copy_n(
+                    &texels[y * 16], columns * 4,
+                    &rgba[((size_t(by) * 4 + y) * width + bx * 4) * 4]
+                );
+            }
+        }
+    }
+}
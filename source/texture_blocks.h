@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+
+#include <vulkan/vulkan.h>
+
+// Block compressed texture formats and CPU decoders for devices that can't
+// sample them. All formats have 4 by 4 texel blocks and decode to R8G8B8A8
+// in the same color space.
+
+const uint32_t texture_block_texels = 4;
+
+// bytes per block, 0 for formats that aren't supported
+uint32_t get_block_size(VkFormat format);
+bool can_decode_blocks(VkFormat format);
+// the format of decoded texels
+VkFormat get_decoded_format(VkFormat format);
+
+// bytes of a width by height level, in blocks of format
+uint64_t get_level_size(VkFormat format, uint32_t width, uint32_t height);
+
+// decodes a width by height level to 4 bytes per texel, rows are stored
+// top to bottom without padding
+void decode_blocks(
+    VkFormat format, uint32_t width, uint32_t height, const uint8_t* blocks,
+    uint8_t* rgba
+);
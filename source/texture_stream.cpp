@@ -0,0 +1,645 @@
+#include "texture_stream.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+
+#include "texture_blocks.h"
+
+using namespace std;
+
+// of levels in staging buffers, enough for every block size
+static const VkDeviceSize staging_alignment = 16;
+
+// bytes of a level in the format of the image
+static VkDeviceSize get_image_level_size(
+    const stream_texture& texture, uint32_t level
+) {
+    auto& entry = texture.file.levels[level];
+    if (texture.decoded) {
+        return VkDeviceSize(entry.width) * entry.height * 4;
+    }
+    return entry.size;
+}
+
+// of the levels from first_level to the last one
+static VkDeviceSize get_image_size(
+    const stream_texture& texture, uint32_t first_level
+) {
+    VkDeviceSize size = 0;
+    auto& levels = texture.file.levels;
+    for (auto level = first_level; level < levels.size(); level++) {
+        size += get_image_level_size(texture, level);
+    }
+    return size;
+}
+
+static void read_levels(
+    const stream_texture& texture, const texture_load& load,
+    vector<uint8_t>& blocks
+) {
+    auto data = (uint8_t*)load.staging.data;
+    auto& levels = texture.file.levels;
+    for (auto level = load.first_level; level < levels.size(); level++) {
+        auto& entry = levels[level];
+        auto target = data + load.offsets[level - load.first_level];
+        if (!texture.decoded) {
+            read_ktx2_level(texture.file, level, span(target, entry.size));
+            continue;
+        }
+        blocks.resize(entry.size);
+        read_ktx2_level(texture.file, level, blocks);
+        decode_blocks(
+            texture.file.format, entry.width, entry.height, blocks.data(),
+            target
+        );
+    }
+}
+
+// formats that aren't filterable count as unsupported, like the shaders
+// sample them
+static bool can_sample(VkPhysicalDevice physical_device, VkFormat format) {
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(physical_device, format, &properties);
+    const VkFormatFeatureFlags features =
+        VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT |
+        VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    return (properties.optimalTilingFeatures & features) == features;
+}
+
+void create_texture_stream(
+    VkDevice device, VkPhysicalDevice physical_device,
+    const queue& graphics, const queue& transfer,
+    span<const string> paths, VkDeviceSize budget,
+    uint32_t frames_in_flight, texture_stream& stream
+) {
+    stream.stats = {};
+    stream.tail_size = 0;
+    stream.textures.resize(paths.size());
+    for (auto i = 0u; i < paths.size(); i++) {
+        auto& texture = stream.textures[i];
+        read_ktx2_header(paths[i].c_str(), texture.file);
+        auto format = texture.file.format;
+        texture.decoded = !can_sample(physical_device, format);
+        if (texture.decoded) {
+            if (!can_decode_blocks(format)) {
+                throw runtime_error("texture format not supported by device");
+            }
+            texture.format = get_decoded_format(format);
+            stream.stats.decoded_textures++;
+        } else {
+            texture.format = format;
+        }
+        auto& levels = texture.file.levels;
+        uint32_t level_count = levels.size();
+        texture.tail_level = level_count - 1;
+        while (
+            texture.tail_level > 0 &&
+            max(
+                levels[texture.tail_level - 1].width,
+                levels[texture.tail_level - 1].height
+            ) <= texture_tail_size
+        ) {
+            texture.tail_level--;
+        }
+        stream.tail_size += get_image_size(texture, texture.tail_level);
+        texture.resident_level = level_count;
+        texture.requested_level = level_count;
+        texture.requested = 0;
+        texture.loading = false;
+        texture.image = VK_NULL_HANDLE;
+        texture.memory = VK_NULL_HANDLE;
+        texture.view = VK_NULL_HANDLE;
+        texture.slot = no_texture;
+        texture.size = 0;
+    }
+
+    // the shaders look textures up by the normal, which shouldn't wrap
+    // around
+    VkSamplerCreateInfo sampler_info{
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .magFilter = VK_FILTER_LINEAR,
+        .minFilter = VK_FILTER_LINEAR,
+        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR,
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .maxLod = VK_LOD_CLAMP_NONE,
+    };
+    if (
+        vkCreateSampler(device, &sampler_info, nullptr, &stream.sampler) !=
+        VK_SUCCESS
+    ) {
+        throw runtime_error("failed to create sampler");
+    }
+    VkCommandPoolCreateInfo pool_info{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+        .queueFamilyIndex = transfer.family,
+    };
+    if (
+        vkCreateCommandPool(
+            device, &pool_info, nullptr, &stream.command_pool
+        ) != VK_SUCCESS
+    ) {
+        throw runtime_error("failed to create command pool");
+    }
+    stream.families[0] = graphics.family;
+    stream.families[1] = transfer.family;
+    stream.family_count = graphics.family == transfer.family ? 1 : 2;
+
+    // 0 is never
+    stream.frame = 1;
+    stream.frames_in_flight = frames_in_flight;
+    stream.budget = budget;
+    stream.reserved = 0;
+    stream.allocated = 0;
+    stream.heap = -1u;
+    stream.max_loads = 8;
+    stream.loading = 0;
+    stream.copies.clear();
+    stream.retired.clear();
+    stream.changed.clear();
+    stream.wait_value = 0;
+
+    // compressed levels before decoding
+    vector<uint8_t> blocks;
+    start_stream_loader(
+        stream.loader,
+        [&stream, blocks](const texture_load& load) mutable {
+            // only the render thread changes textures, but never their
+            // files, and the vector isn't resized while the stream exists
+            auto& texture = stream.textures[load.texture];
+            try {
+                read_levels(texture, load, blocks);
+            } catch (const exception&) {
+                return false;
+            }
+            return true;
+        }
+    );
+}
+
+static void destroy_load(
+    VkDevice device, memory_tracker& tracker, texture_stream& stream,
+    const texture_load& load
+) {
+    if (load.command_buffer != VK_NULL_HANDLE) {
+        vkFreeCommandBuffers(
+            device, stream.command_pool, 1, &load.command_buffer
+        );
+    }
+    destroy_mapped_buffer(device, tracker, load.staging);
+}
+
+static void destroy_retired(
+    VkDevice device, memory_tracker& tracker, bindless_set& bindless,
+    const retired_texture& retired
+) {
+    remove_texture(bindless, retired.slot);
+    vkDestroyImageView(device, retired.view, nullptr);
+    vkDestroyImage(device, retired.image, nullptr);
+    free_tracked_memory(device, tracker, retired.memory);
+}
+
+void destroy_texture_stream(
+    VkDevice device, memory_tracker& tracker, bindless_set& bindless,
+    texture_stream& stream
+) {
+    stop_stream_loader(stream.loader);
+
+    // loads that weren't adopted still own their images
+    auto destroy_loads = [&](const auto& loads) {
+        for (auto& load : loads) {
+            destroy_load(device, tracker, stream, load);
+            vkDestroyImage(device, load.image, nullptr);
+            free_tracked_memory(device, tracker, load.memory);
+        }
+    };
+    destroy_loads(stream.loader.queue);
+    destroy_loads(stream.loader.finished);
+    destroy_loads(stream.copies);
+    for (auto& retired : stream.retired) {
+        destroy_retired(device, tracker, bindless, retired);
+    }
+    for (auto& texture : stream.textures) {
+        if (texture.image != VK_NULL_HANDLE) {
+            destroy_retired(device, tracker, bindless, {
+                .image = texture.image,
+                .memory = texture.memory,
+                .view = texture.view,
+                .slot = texture.slot,
+                .size = texture.size,
+                .frame = 0,
+            });
+        }
+    }
+    stream.loader.queue.clear();
+    stream.loader.finished.clear();
+    stream.copies.clear();
+    stream.retired.clear();
+    stream.textures.clear();
+    vkDestroyCommandPool(device, stream.command_pool, nullptr);
+    vkDestroySampler(device, stream.sampler, nullptr);
+}
+
+static void record_levels_barrier(
+    VkCommandBuffer command_buffer, VkImage image, uint32_t level_count,
+    VkImageLayout old_layout, VkImageLayout new_layout,
+    VkPipelineStageFlags source_stage, VkPipelineStageFlags destination_stage,
+    VkAccessFlags source_access, VkAccessFlags destination_access
+) {
+    VkImageMemoryBarrier barrier{
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = source_access,
+        .dstAccessMask = destination_access,
+        .oldLayout = old_layout,
+        .newLayout = new_layout,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = image,
+        .subresourceRange = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .baseMipLevel = 0,
+            .levelCount = level_count,
+            .baseArrayLayer = 0,
+            .layerCount = 1,
+        },
+    };
+    vkCmdPipelineBarrier(
+        command_buffer, source_stage, destination_stage, 0,
+        0, nullptr, 0, nullptr, 1, &barrier
+    );
+}
+
+static void submit_copy(
+    VkDevice device, queue& transfer, texture_stream& stream,
+    texture_load& load
+) {
+    auto& texture = stream.textures[load.texture];
+    VkCommandBufferAllocateInfo allocate_info{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = stream.command_pool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1,
+    };
+    if (
+        vkAllocateCommandBuffers(
+            device, &allocate_info, &load.command_buffer
+        ) != VK_SUCCESS
+    ) {
+        throw runtime_error("failed to allocate command buffers");
+    }
+    VkCommandBufferBeginInfo begin_info{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    vkBeginCommandBuffer(load.command_buffer, &begin_info);
+
+    uint32_t level_count = texture.file.levels.size() - load.first_level;
+    record_levels_barrier(
+        load.command_buffer, load.image, level_count,
+        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0, VK_ACCESS_TRANSFER_WRITE_BIT
+    );
+    // whole levels, which any transfer granularity allows
+    VkBufferImageCopy regions[max_ktx2_levels];
+    for (auto i = 0u; i < level_count; i++) {
+        auto& level = texture.file.levels[load.first_level + i];
+        regions[i] = {
+            .bufferOffset = load.offsets[i],
+            .bufferRowLength = 0,
+            .bufferImageHeight = 0,
+            .imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, i, 0, 1},
+            .imageOffset = {0, 0, 0},
+            .imageExtent = {level.width, level.height, 1},
+        };
+    }
+    vkCmdCopyBufferToImage(
+        load.command_buffer, load.staging.buffer, load.image,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, level_count, regions
+    );
+    // a transfer queue can't name the fragment shader stage, the graphics
+    // queue waits for the timeline instead
+    record_levels_barrier(
+        load.command_buffer, load.image, level_count,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+        VK_ACCESS_TRANSFER_WRITE_BIT, 0
+    );
+    if (vkEndCommandBuffer(load.command_buffer) != VK_SUCCESS) {
+        throw runtime_error("failed to record command buffer");
+    }
+    load.value = submit(
+        transfer, {.command_buffers = {&load.command_buffer, 1}}
+    );
+}
+
+// the copy completed, the image of the load replaces that of the texture
+static void adopt_load(
+    VkDevice device, memory_tracker& tracker, bindless_set& bindless,
+    texture_stream& stream, const texture_load& load
+) {
+    auto& texture = stream.textures[load.texture];
+    if (texture.image != VK_NULL_HANDLE) {
+        stream.retired.push_back({
+            .image = texture.image,
+            .memory = texture.memory,
+            .view = texture.view,
+            .slot = texture.slot,
+            .size = texture.size,
+            .frame = stream.frame,
+        });
+    }
+    uint32_t level_count = texture.file.levels.size() - load.first_level;
+    VkImageViewCreateInfo view_info{
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .image = load.image,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format = texture.format,
+        .subresourceRange = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .baseMipLevel = 0,
+            .levelCount = level_count,
+            .baseArrayLayer = 0,
+            .layerCount = 1,
+        },
+    };
+    if (
+        vkCreateImageView(device, &view_info, nullptr, &texture.view) !=
+        VK_SUCCESS
+    ) {
+        throw runtime_error("failed to create image view");
+    }
+    texture.image = load.image;
+    texture.memory = load.memory;
+    texture.slot = add_texture(device, bindless, texture.view, stream.sampler);
+    stream.stats.resident_bytes += load.size - texture.size;
+    texture.size = load.size;
+    texture.resident_level = load.first_level;
+    texture.loading = false;
+
+    stream.loading--;
+    stream.changed.push_back(load.texture);
+    stream.wait_value = max(stream.wait_value, load.value);
+    stream.stats.uploads++;
+    stream.stats.uploaded_bytes += load.staging.size;
+    destroy_load(device, tracker, stream, load);
+}
+
+void begin_texture_frame(
+    VkDevice device, memory_tracker& tracker, bindless_set& bindless,
+    queue& transfer, texture_stream& stream, frame_arena& scratch
+) {
+    stream.frame++;
+    stream.changed.clear();
+
+    // frames recorded before the image was replaced may still sample it
+    size_t kept = 0;
+    for (auto& retired : stream.retired) {
+        if (stream.frame < retired.frame + stream.frames_in_flight) {
+            stream.retired[kept++] = retired;
+        } else {
+            destroy_retired(device, tracker, bindless, retired);
+            stream.allocated -= retired.size;
+        }
+    }
+    stream.retired.resize(kept);
+
+    uint64_t completed;
+    vkGetSemaphoreCounterValue(device, transfer.timeline, &completed);
+    kept = 0;
+    for (auto& load : stream.copies) {
+        if (load.value <= completed) {
+            adopt_load(device, tracker, bindless, stream, load);
+        } else {
+            stream.copies[kept++] = load;
+        }
+    }
+    stream.copies.resize(kept);
+
+    arena_vector<texture_load> finished(scratch);
+    if (!take_finished_loads(stream.loader, finished)) {
+        throw runtime_error("failed to read texture file");
+    }
+    for (auto& load : finished) {
+        submit_copy(device, transfer, stream, load);
+        stream.copies.push_back(load);
+    }
+}
+
+void request_texture(texture_stream& stream, uint32_t texture, float pixels) {
+    auto& target = stream.textures[texture];
+    auto& file = target.file;
+    auto last = uint32_t(file.levels.size() - 1);
+    auto level = last;
+    if (pixels > 0) {
+        auto size = float(max(file.width, file.height));
+        level = uint32_t(clamp(floor(log2(size / pixels)), 0.0f, float(last)));
+    }
+    if (target.requested != stream.frame) {
+        target.requested = stream.frame;
+        target.requested_level = level;
+    } else {
+        target.requested_level = min(target.requested_level, level);
+    }
+}
+
+VkDeviceSize shrink_texture_budget(
+    texture_stream& stream, uint32_t heap, VkDeviceSize size
+) {
+    if (heap != stream.heap) {
+        return 0;
+    }
+    // images of dropped levels that wait for frames in flight already
+    // release some
+    auto releasing = stream.allocated - min(stream.allocated, stream.reserved);
+    if (releasing < size) {
+        auto target = stream.reserved - min(stream.reserved, size - releasing);
+        stream.budget = min(stream.budget, max(target, stream.tail_size));
+    }
+    auto kept = min(stream.reserved, stream.budget);
+    return stream.allocated - min(stream.allocated, kept);
+}
+
+// the largest level the texture should have, the tail is always loaded
+static uint32_t get_wanted_level(
+    const texture_stream& stream, const stream_texture& texture
+) {
+    if (texture.requested != stream.frame) {
+        return texture.tail_level;
+    }
+    return min(texture.requested_level, texture.tail_level);
+}
+
+static void start_load(
+    VkDevice device, memory_tracker& tracker, texture_stream& stream,
+    uint32_t index, uint32_t first_level
+) {
+    auto& texture = stream.textures[index];
+    auto& base = texture.file.levels[first_level];
+    uint32_t level_count = texture.file.levels.size() - first_level;
+    texture_load load{
+        .texture = index,
+        .first_level = first_level,
+        .size = get_image_size(texture, first_level),
+        .offsets = {},
+        .command_buffer = VK_NULL_HANDLE,
+        .value = 0,
+    };
+
+    VkImageCreateInfo image_info{
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = texture.format,
+        .extent = {base.width, base.height, 1},
+        .mipLevels = level_count,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        // written by the transfer queue and sampled by the graphics queue
+        // without ownership transfers
+        .sharingMode = stream.family_count > 1 ?
+            VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = stream.family_count,
+        .pQueueFamilyIndices = stream.families,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+    };
+    if (
+        vkCreateImage(device, &image_info, nullptr, &load.image) != VK_SUCCESS
+    ) {
+        throw runtime_error("failed to create image");
+    }
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(device, load.image, &requirements);
+    load.memory = allocate_tracked_memory(
+        device, tracker, requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        memory_tag::textures
+    );
+    vkBindImageMemory(device, load.image, load.memory, 0);
+    stream.heap = tracker.allocations[load.memory].heap;
+    stream.allocated += load.size;
+
+    VkDeviceSize staging_size = 0;
+    for (auto i = 0u; i < level_count; i++) {
+        load.offsets[i] = staging_size;
+        staging_size += get_image_level_size(texture, first_level + i);
+        staging_size =
+            (staging_size + staging_alignment - 1) & ~(staging_alignment - 1);
+    }
+    create_mapped_buffer(
+        device, tracker, memory_tag::staging, staging_size,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT, load.staging
+    );
+
+    stream.reserved += load.size - texture.size;
+    texture.loading = true;
+    stream.loading++;
+    queue_loads(stream.loader, span(&load, 1));
+}
+
+void dispatch_texture_loads(
+    VkDevice device, memory_tracker& tracker, texture_stream& stream,
+    frame_arena& scratch
+) {
+    // the budget shrank, drops a level of the least recently requested
+    // textures beyond their tail until the resident levels fit
+    while (
+        stream.reserved > stream.budget && stream.loading < stream.max_loads
+    ) {
+        auto victim = -1u;
+        for (auto i = 0u; i < stream.textures.size(); i++) {
+            auto& texture = stream.textures[i];
+            if (
+                !texture.loading && texture.image != VK_NULL_HANDLE &&
+                texture.resident_level < texture.tail_level &&
+                (
+                    victim == -1u ||
+                    texture.requested < stream.textures[victim].requested
+                )
+            ) {
+                victim = i;
+            }
+        }
+        if (victim == -1u) {
+            break;
+        }
+        auto& evicted = stream.textures[victim];
+        start_load(
+            device, tracker, stream, victim,
+            max(get_wanted_level(stream, evicted), evicted.resident_level + 1)
+        );
+        stream.stats.evictions++;
+    }
+
+    arena_vector<uint32_t> candidates(scratch);
+    stream.stats.missing_levels = 0;
+    for (auto i = 0u; i < stream.textures.size(); i++) {
+        auto& texture = stream.textures[i];
+        auto wanted = get_wanted_level(stream, texture);
+        if (texture.requested == stream.frame) {
+            stream.stats.missing_levels +=
+                texture.resident_level - min(texture.resident_level, wanted);
+        }
+        if (!texture.loading && wanted < texture.resident_level) {
+            candidates.push_back(i);
+        }
+    }
+    // textures without levels first, then those missing the most levels
+    auto get_missing = [&](uint32_t index) {
+        auto& texture = stream.textures[index];
+        return texture.resident_level - get_wanted_level(stream, texture);
+    };
+    sort(
+        candidates.begin(), candidates.end(), [&](uint32_t a, uint32_t b) {
+            auto empty_a = stream.textures[a].image == VK_NULL_HANDLE;
+            auto empty_b = stream.textures[b].image == VK_NULL_HANDLE;
+            if (empty_a != empty_b) {
+                return empty_a;
+            }
+            return get_missing(a) > get_missing(b);
+        }
+    );
+
+    for (auto index : candidates) {
+        if (stream.loading >= stream.max_loads) {
+            return;
+        }
+        auto& texture = stream.textures[index];
+        auto level = texture.image == VK_NULL_HANDLE ?
+            texture.tail_level : texture.resident_level - 1;
+        auto growth = get_image_size(texture, level) - texture.size;
+        // drops the levels of the least recently requested texture that has
+        // more than it needs, until the load fits
+        while (stream.reserved + growth > stream.budget) {
+            auto victim = -1u;
+            for (auto i = 0u; i < stream.textures.size(); i++) {
+                auto& other = stream.textures[i];
+                if (
+                    i != index && !other.loading &&
+                    other.image != VK_NULL_HANDLE &&
+                    get_wanted_level(stream, other) > other.resident_level &&
+                    (
+                        victim == -1u ||
+                        other.requested < stream.textures[victim].requested
+                    )
+                ) {
+                    victim = i;
+                }
+            }
+            if (victim == -1u || stream.loading + 1 >= stream.max_loads) {
+                return;
+            }
+            auto& evicted = stream.textures[victim];
+            start_load(
+                device, tracker, stream, victim,
+                get_wanted_level(stream, evicted)
+            );
+            stream.stats.evictions++;
+        }
+        start_load(device, tracker, stream, index, level);
+    }
+}
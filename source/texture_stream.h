@@ -0,0 +1,174 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "ktx_file.h"
+#include "buffer.h"
+#include "bindless.h"
+#include "queues.h"
+#include "frame_arena.h"
+#include "stream_loader.h"
+
+// Textures streamed from KTX2 files by mip level. A texture starts out with
+// its coarse tail of small levels, and finer levels are loaded one at a
+// time while instances on screen request them. A background thread reads
+// the levels into a staging buffer, decoding formats the device can't
+// sample, and the transfer queue copies them into a new image that holds
+// all resident levels. Once the copy completed the new image replaces the
+// old one in the bindless set. When the resident levels would exceed the
+// budget, textures that weren't requested recently drop back to their tail.
+
+// levels up to this size are loaded together as the first upload
+const uint32_t texture_tail_size = 64;
+
+struct stream_texture {
+    ktx2_file file;
+    // of the image, R8G8B8A8 if the blocks are decoded
+    VkFormat format;
+    bool decoded;
+    // largest level of the tail
+    uint32_t tail_level;
+    // largest resident level, the level count if none are resident
+    uint32_t resident_level;
+    // largest level requested in frame requested
+    uint32_t requested_level;
+    uint64_t requested;
+    bool loading;
+
+    // the resident levels, level 0 of the image is resident_level
+    VkImage image;
+    VkDeviceMemory memory;
+    VkImageView view;
+    // no_texture until the tail is resident
+    uint32_t slot;
+    // of the resident levels in the format of the image, without the
+    // alignment of the allocation
+    VkDeviceSize size;
+};
+
+// levels from first_level to the last one of a texture, read into the
+// staging buffer by the loader thread and copied into a new image
+struct texture_load {
+    uint32_t texture, first_level;
+    VkImage image;
+    VkDeviceMemory memory;
+    VkDeviceSize size;
+    mapped_buffer staging;
+    // of each level in the staging buffer, starting with first_level
+    VkDeviceSize offsets[max_ktx2_levels];
+    VkCommandBuffer command_buffer;
+    // transfer timeline value that signals the copy, 0 until submitted
+    uint64_t value;
+};
+
+// replaced images are destroyed once no frame in flight can sample them
+struct retired_texture {
+    VkImage image;
+    VkDeviceMemory memory;
+    VkImageView view;
+    uint32_t slot;
+    VkDeviceSize size;
+    uint64_t frame;
+};
+
+struct texture_stats {
+    // like stream_texture::size
+    VkDeviceSize resident_bytes;
+    uint64_t uploaded_bytes, uploads;
+    // loads that dropped levels to stay within the budget
+    uint64_t evictions;
+    uint32_t decoded_textures;
+    // levels requested in the last frame that aren't resident
+    uint32_t missing_levels;
+};
+
+struct texture_stream {
+    std::vector<stream_texture> textures;
+    VkSampler sampler;
+    // of the transfer queue
+    VkCommandPool command_pool;
+    // images are shared between the graphics and the transfer family, if
+    // they differ
+    uint32_t families[2];
+    uint32_t family_count;
+
+    uint64_t frame;
+    // frames that are recorded before waiting for the oldest one, replaced
+    // images are kept for as long
+    uint32_t frames_in_flight;
+    // of the resident levels once all loads completed, the budget shrinks
+    // under memory pressure but not below the size of all tails
+    VkDeviceSize budget, reserved, tail_size;
+    // of all images, including those of loads and retired ones
+    VkDeviceSize allocated;
+    // of the images, -1u before the first load
+    uint32_t heap;
+    uint32_t max_loads;
+    // loads that weren't adopted yet
+    uint32_t loading;
+    // loads submitted to the transfer queue
+    std::vector<texture_load> copies;
+    std::vector<retired_texture> retired;
+    // textures whose slot changed in this frame, materials using them need
+    // to be updated
+    std::vector<uint32_t> changed;
+    // transfer timeline value of the last adopted load, submissions that
+    // sample the textures have to wait for it
+    uint64_t wait_value;
+
+    // reads and decodes levels into the staging buffers of the loads
+    stream_loader<texture_load> loader;
+
+    texture_stats stats;
+};
+
+// reads the headers of the files and starts the loader thread, nothing is
+// resident before the first requests. Files in formats the device can't
+// sample are decoded, throws if that isn't possible.
+void create_texture_stream(
+    VkDevice device, VkPhysicalDevice physical_device,
+    const queue& graphics, const queue& transfer,
+    std::span<const std::string> paths, VkDeviceSize budget,
+    uint32_t frames_in_flight, texture_stream& stream
+);
+// the textures must not be in use by the GPU
+void destroy_texture_stream(
+    VkDevice device, memory_tracker& tracker, bindless_set& bindless,
+    texture_stream& stream
+);
+
+// submits finished loads to the transfer queue, swaps in the images of
+// completed copies and destroys replaced images that the oldest frame in
+// flight was the last to sample, so its fence must have been waited for.
+// Throws if a texture couldn't be read.
+void begin_texture_frame(
+    VkDevice device, memory_tracker& tracker, bindless_set& bindless,
+    queue& transfer, texture_stream& stream, frame_arena& scratch
+);
+
+// lowers the budget so that the next dispatches drop size bytes of levels
+// if the images are on heap, returns the bytes that are released once the
+// replaced images are destroyed. Serves as evictor of the memory tracker,
+// the budget stays lowered.
+VkDeviceSize shrink_texture_budget(
+    texture_stream& stream, uint32_t heap, VkDeviceSize size
+);
+
+// the texture covers about pixels texels on screen, requests the smallest
+// level that is at least as large
+void request_texture(texture_stream& stream, uint32_t texture, float pixels);
+
+// loads one level more for requested textures, those without resident
+// levels first, dropping levels of textures that weren't requested if the
+// budget requires it. Drops levels of the least recently requested
+// textures first if the budget shrank. Call after all requests of the
+// frame.
+void dispatch_texture_loads(
+    VkDevice device, memory_tracker& tracker, texture_stream& stream,
+    frame_arena& scratch
+);
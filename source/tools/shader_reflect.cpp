@@ -0,0 +1,462 @@
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+
+using namespace std;
+
+// reads a SPIR-V module and writes a header with its vertex inputs, push
+// constant size and descriptor bindings as constexpr tables, see
+// shader_reflection.h
+//   shader_reflect <input.spv> <output.h> <prefix>
+// only runs at build time, so it doesn't depend on the Vulkan headers and
+// writes the enumerator names as text
+
+// the few parts of the SPIR-V specification that are needed
+const uint32_t spirv_magic = 0x07230203;
+
+enum spirv_op : uint16_t {
+    op_name = 5,
+    op_entry_point = 15,
+    op_type_int = 21,
+    op_type_float = 22,
+    op_type_vector = 23,
+    op_type_matrix = 24,
+    op_type_image = 25,
+    op_type_sampler = 26,
+    op_type_sampled_image = 27,
+    op_type_array = 28,
+    op_type_runtime_array = 29,
+    op_type_struct = 30,
+    op_type_pointer = 32,
+    op_constant = 43,
+    op_variable = 59,
+    op_decorate = 71,
+    op_member_decorate = 72,
+};
+
+enum spirv_decoration : uint32_t {
+    decoration_block = 2,
+    decoration_buffer_block = 3,
+    decoration_array_stride = 6,
+    decoration_matrix_stride = 7,
+    decoration_built_in = 11,
+    decoration_location = 30,
+    decoration_binding = 33,
+    decoration_descriptor_set = 34,
+    decoration_offset = 35,
+};
+
+enum spirv_storage_class : uint32_t {
+    storage_uniform_constant = 0,
+    storage_input = 1,
+    storage_uniform = 2,
+    storage_push_constant = 9,
+    storage_storage_buffer = 12,
+};
+
+const uint32_t image_dim_buffer = 5;
+
+struct spirv_type {
+    uint16_t op = 0;
+    // operands after the result id
+    vector<uint32_t> operands;
+};
+
+struct spirv_variable {
+    uint32_t type, storage_class;
+};
+
+struct spirv_module {
+    uint32_t execution_model = 0;
+    set<uint32_t> interface;
+    map<uint32_t, string> names;
+    map<uint32_t, spirv_type> types;
+    map<uint32_t, uint32_t> constants;
+    map<uint32_t, spirv_variable> variables;
+    // id to decoration to value, 1 for decorations without value
+    map<uint32_t, map<uint32_t, uint32_t>> decorations;
+    // struct id to member to decoration to value
+    map<uint32_t, map<uint32_t, map<uint32_t, uint32_t>>> member_decorations;
+};
+
+static string read_string(const uint32_t* words, size_t count) {
+    auto characters = reinterpret_cast<const char*>(words);
+    return string(characters, strnlen(characters, count * 4));
+}
+
+static void parse_module(const vector<uint32_t>& words, spirv_module& module) {
+    if (words.size() < 5 || words[0] != spirv_magic) {
+        throw runtime_error("failed to parse SPIR-V module");
+    }
+    bool found_entry_point = false;
+    for (size_t i = 5; i < words.size();) {
+        uint16_t op = words[i] & 0xffff;
+        uint16_t count = words[i] >> 16;
+        if (count == 0 || i + count > words.size()) {
+            throw runtime_error("failed to parse SPIR-V module");
+        }
+        auto operands = &words[i + 1];
+        size_t operand_count = count - 1;
+
+        if (op == op_name && operand_count >= 1) {
+            module.names[operands[0]] =
+                read_string(operands + 1, operand_count - 1);
+
+        } else if (op == op_entry_point && !found_entry_point) {
+            // only the first entry point, glslc only writes one
+            found_entry_point = true;
+            module.execution_model = operands[0];
+            // skip the name, the interface ids follow it
+            auto name_words =
+                read_string(operands + 2, operand_count - 2).size() / 4 + 1;
+            for (auto o = 2 + name_words; o < operand_count; o++) {
+                module.interface.insert(operands[o]);
+            }
+
+        } else if (op >= op_type_int && op <= op_type_pointer) {
+            module.types[operands[0]] = {
+                op, vector<uint32_t>(operands + 1, operands + operand_count),
+            };
+
+        } else if (op == op_constant && operand_count >= 3) {
+            // 32 bit constants are enough for array lengths
+            module.constants[operands[1]] = operands[2];
+
+        } else if (op == op_variable && operand_count >= 3) {
+            module.variables[operands[1]] = {operands[0], operands[2]};
+
+        } else if (op == op_decorate && operand_count >= 2) {
+            module.decorations[operands[0]][operands[1]] =
+                operand_count >= 3 ? operands[2] : 1;
+
+        } else if (op == op_member_decorate && operand_count >= 3) {
+            module.member_decorations[operands[0]][operands[1]][operands[2]] =
+                operand_count >= 4 ? operands[3] : 1;
+        }
+        i += count;
+    }
+    if (!found_entry_point) {
+        throw runtime_error("SPIR-V module has no entry point");
+    }
+}
+
+static const spirv_type& get_type(const spirv_module& module, uint32_t id) {
+    auto type = module.types.find(id);
+    if (type == module.types.end()) {
+        throw runtime_error("SPIR-V module references unknown type");
+    }
+    return type->second;
+}
+
+static bool has_decoration(
+    const spirv_module& module, uint32_t id, uint32_t decoration
+) {
+    auto decorations = module.decorations.find(id);
+    return
+        decorations != module.decorations.end() &&
+        decorations->second.count(decoration);
+}
+
+static uint32_t get_decoration(
+    const spirv_module& module, uint32_t id, uint32_t decoration
+) {
+    return module.decorations.at(id).at(decoration);
+}
+
+// size of a type in an explicitly laid out block, matrix_stride comes from
+// the member that contains the matrix
+static uint32_t get_size(
+    const spirv_module& module, uint32_t id, uint32_t matrix_stride = 0
+) {
+    auto& type = get_type(module, id);
+    switch (type.op) {
+    case op_type_int:
+    case op_type_float:
+        return type.operands[0] / 8;
+    case op_type_vector:
+        return get_size(module, type.operands[0]) * type.operands[1];
+    case op_type_matrix:
+        if (matrix_stride == 0) {
+            matrix_stride = get_size(module, type.operands[0]);
+        }
+        return matrix_stride * type.operands[1];
+    case op_type_array:
+        return
+            get_decoration(module, id, decoration_array_stride) *
+            module.constants.at(type.operands[1]);
+    case op_type_runtime_array:
+        return 0;
+    case op_type_struct: {
+        uint32_t size = 0;
+        auto& members = module.member_decorations.at(id);
+        for (auto m = 0u; m < type.operands.size(); m++) {
+            auto& decorations = members.at(m);
+            auto stride = decorations.find(decoration_matrix_stride);
+            size = max(
+                size,
+                decorations.at(decoration_offset) + get_size(
+                    module, type.operands[m],
+                    stride == decorations.end() ? 0 : stride->second
+                )
+            );
+        }
+        return size;
+    }
+    default:
+        throw runtime_error("SPIR-V block has unsupported member type");
+    }
+}
+
+struct reflected_input {
+    uint32_t location;
+    string format;
+    uint32_t size;
+    string name;
+};
+
+// format and size of a scalar or vector input
+static void get_input_format(
+    const spirv_module& module, uint32_t id,
+    string& format, uint32_t& size
+) {
+    auto& type = get_type(module, id);
+    uint32_t components = 1;
+    auto* component = &type;
+    if (type.op == op_type_vector) {
+        components = type.operands[1];
+        component = &get_type(module, type.operands[0]);
+    }
+    if (
+        (component->op != op_type_int && component->op != op_type_float) ||
+        component->operands[0] != 32
+    ) {
+        throw runtime_error("vertex input has unsupported type");
+    }
+    const char* channels[]{"R32", "R32G32", "R32G32B32", "R32G32B32A32"};
+    string numeric =
+        component->op == op_type_float ? "SFLOAT" :
+        component->operands[1] ? "SINT" : "UINT";
+    format =
+        string("VK_FORMAT_") + channels[components - 1] + "_" + numeric;
+    size = 4 * components;
+}
+
+static vector<reflected_input> get_inputs(const spirv_module& module) {
+    vector<reflected_input> inputs;
+    for (auto& [id, variable] : module.variables) {
+        if (
+            variable.storage_class != storage_input ||
+            !module.interface.count(id) ||
+            has_decoration(module, id, decoration_built_in) ||
+            !has_decoration(module, id, decoration_location)
+        ) {
+            continue;
+        }
+        auto location = get_decoration(module, id, decoration_location);
+        auto name_entry = module.names.find(id);
+        auto name =
+            name_entry != module.names.end() && !name_entry->second.empty() ?
+            name_entry->second : "input_" + to_string(location);
+
+        auto& pointer = get_type(module, variable.type);
+        auto type_id = pointer.operands[1];
+        auto& type = get_type(module, type_id);
+        if (type.op == op_type_matrix) {
+            // one location per column
+            for (auto c = 0u; c < type.operands[1]; c++) {
+                reflected_input input{
+                    location + c, "", 0, name + "_" + to_string(c),
+                };
+                get_input_format(
+                    module, type.operands[0], input.format, input.size
+                );
+                inputs.push_back(input);
+            }
+        } else {
+            reflected_input input{location, "", 0, name};
+            get_input_format(module, type_id, input.format, input.size);
+            inputs.push_back(input);
+        }
+    }
+    sort(
+        inputs.begin(), inputs.end(),
+        [](const reflected_input& a, const reflected_input& b) {
+            return a.location < b.location;
+        }
+    );
+    return inputs;
+}
+
+static uint32_t get_push_constant_size(const spirv_module& module) {
+    for (auto& [id, variable] : module.variables) {
+        if (variable.storage_class == storage_push_constant) {
+            auto& pointer = get_type(module, variable.type);
+            return get_size(module, pointer.operands[1]);
+        }
+    }
+    return 0;
+}
+
+struct reflected_binding {
+    uint32_t set, binding;
+    string type;
+    // 0 for runtime arrays
+    uint32_t count;
+};
+
+static string get_descriptor_type(
+    const spirv_module& module, uint32_t storage_class, uint32_t type_id
+) {
+    auto& type = get_type(module, type_id);
+    if (storage_class == storage_storage_buffer) {
+        return "VK_DESCRIPTOR_TYPE_STORAGE_BUFFER";
+    } else if (storage_class == storage_uniform) {
+        return
+            has_decoration(module, type_id, decoration_buffer_block) ?
+            "VK_DESCRIPTOR_TYPE_STORAGE_BUFFER" :
+            "VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER";
+    } else if (type.op == op_type_sampled_image) {
+        return "VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER";
+    } else if (type.op == op_type_sampler) {
+        return "VK_DESCRIPTOR_TYPE_SAMPLER";
+    } else if (type.op == op_type_image) {
+        // operands are sampled type, dim, depth, arrayed, ms, sampled
+        bool storage = type.operands[5] == 2;
+        if (type.operands[1] == image_dim_buffer) {
+            return storage ?
+                "VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER" :
+                "VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER";
+        }
+        return storage ?
+            "VK_DESCRIPTOR_TYPE_STORAGE_IMAGE" :
+            "VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE";
+    }
+    throw runtime_error("descriptor has unsupported type");
+}
+
+static vector<reflected_binding> get_bindings(const spirv_module& module) {
+    // several variables may alias the same binding, like the bindless set
+    map<pair<uint32_t, uint32_t>, reflected_binding> bindings;
+    for (auto& [id, variable] : module.variables) {
+        if (
+            !module.interface.count(id) ||
+            !has_decoration(module, id, decoration_descriptor_set) ||
+            !has_decoration(module, id, decoration_binding)
+        ) {
+            continue;
+        }
+        reflected_binding binding{
+            get_decoration(module, id, decoration_descriptor_set),
+            get_decoration(module, id, decoration_binding),
+            "", 1,
+        };
+        auto type_id = get_type(module, variable.type).operands[1];
+        auto* type = &get_type(module, type_id);
+        if (type->op == op_type_array) {
+            binding.count = module.constants.at(type->operands[1]);
+            type_id = type->operands[0];
+        } else if (type->op == op_type_runtime_array) {
+            binding.count = 0;
+            type_id = type->operands[0];
+        }
+        binding.type =
+            get_descriptor_type(module, variable.storage_class, type_id);
+        bindings[{binding.set, binding.binding}] = binding;
+    }
+    vector<reflected_binding> result;
+    for (auto& [key, binding] : bindings) {
+        result.push_back(binding);
+    }
+    return result;
+}
+
+static const char* get_stage(uint32_t execution_model) {
+    switch (execution_model) {
+    case 0: return "VK_SHADER_STAGE_VERTEX_BIT";
+    case 4: return "VK_SHADER_STAGE_FRAGMENT_BIT";
+    case 5: return "VK_SHADER_STAGE_COMPUTE_BIT";
+    case 5364: return "VK_SHADER_STAGE_TASK_BIT_EXT";
+    case 5365: return "VK_SHADER_STAGE_MESH_BIT_EXT";
+    default: throw runtime_error("shader has unsupported stage");
+    }
+}
+
+static void write_header(
+    ostream& out, const spirv_module& module, const string& source,
+    const string& prefix
+) {
+    auto inputs = get_inputs(module);
+    auto bindings = get_bindings(module);
+
+    out <<
+        "// generated by shader_reflect from " << source <<
+        ", do not edit\n"
+        "#pragma once\n\n"
+        "#include \"shader_reflection.h\"\n\n";
+
+    out <<
+        "constexpr VkShaderStageFlagBits " << prefix << "_stage =\n"
+        "    " << get_stage(module.execution_model) << ";\n\n";
+
+    out <<
+        "constexpr std::array<shader_input, " << inputs.size() << "> " <<
+        prefix << "_inputs{{\n";
+    for (auto& input : inputs) {
+        out <<
+            "    {" << input.location << ", " << input.format << ", " <<
+            input.size << ", \"" << input.name << "\"},\n";
+    }
+    out << "}};\n\n";
+
+    out <<
+        "constexpr uint32_t " << prefix << "_push_constant_size = " <<
+        get_push_constant_size(module) << ";\n\n";
+
+    out <<
+        "constexpr std::array<shader_binding, " << bindings.size() << "> " <<
+        prefix << "_bindings{{\n";
+    for (auto& binding : bindings) {
+        out <<
+            "    {" << binding.set << ", " << binding.binding << ", " <<
+            binding.type << ", " << binding.count << "},\n";
+    }
+    out << "}};\n";
+}
+
+int main(int argc, char** argv) {
+    if (argc != 4) {
+        cerr <<
+            "usage: shader_reflect <input.spv> <output.h> <prefix>" << endl;
+        return 1;
+    }
+
+    try {
+        ifstream file(argv[1], ios::binary);
+        if (!file) {
+            throw runtime_error("failed to open SPIR-V module");
+        }
+        string bytes{istreambuf_iterator<char>(file), {}};
+        vector<uint32_t> words(bytes.size() / 4);
+        copy(bytes.begin(), bytes.begin() + words.size() * 4,
+            reinterpret_cast<char*>(words.data()));
+
+        spirv_module module;
+        parse_module(words, module);
+
+        ofstream output(argv[2]);
+        write_header(output, module, argv[1], argv[3]);
+        if (!output) {
+            throw runtime_error("failed to write header");
+        }
+    } catch (const exception& e) {
+        cerr << argv[1] << ": " << e.what() << endl;
+        return 1;
+    }
+}
@@ -0,0 +1,382 @@
+#include "transform_hierarchy.h"
+
+#include <algorithm>
+#include <numeric>
+#include <cstring>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <immintrin.h>
+#define TRANSFORM_SSE
+#endif
+
+using namespace std;
+
+static const float identity_matrix[16]{
+    1, 0, 0, 0,
+    0, 1, 0, 0,
+    0, 0, 1, 0,
+    0, 0, 0, 1,
+};
+
+uint32_t add_node(
+    transform_hierarchy& hierarchy, uint32_t parent, uint32_t instance
+) {
+    auto& h = hierarchy;
+    if (h.slots.empty()) {
+        copy(begin(identity_matrix), end(identity_matrix), h.root_matrix);
+    }
+    auto id = static_cast<uint32_t>(h.slots.size());
+    auto slot = static_cast<uint32_t>(h.ids.size());
+    h.slots.push_back(slot);
+    h.ids.push_back(id);
+
+    auto parent_slot = parent == no_node ? no_node : h.slots[parent];
+    h.parents.push_back(parent_slot);
+    h.depths.push_back(
+        parent == no_node ? 0 : h.depths[parent_slot] + 1
+    );
+    h.instances.push_back(instance);
+    h.dirty.push_back(1);
+
+    h.translation_x.push_back(0);
+    h.translation_y.push_back(0);
+    h.translation_z.push_back(0);
+    h.rotation_x.push_back(0);
+    h.rotation_y.push_back(0);
+    h.rotation_z.push_back(0);
+    h.rotation_w.push_back(1);
+    h.scale_x.push_back(1);
+    h.scale_y.push_back(1);
+    h.scale_z.push_back(1);
+    h.local_matrices.insert(
+        h.local_matrices.end(), begin(identity_matrix), end(identity_matrix)
+    );
+    h.world_matrices.insert(
+        h.world_matrices.end(), begin(identity_matrix), end(identity_matrix)
+    );
+
+    // appending keeps the order as long as depths don't decrease
+    if (slot > 0 && h.depths[slot - 1] > h.depths[slot]) {
+        h.unsorted = true;
+    }
+    return id;
+}
+
+void set_translation(
+    transform_hierarchy& hierarchy, uint32_t node, float x, float y, float z
+) {
+    auto slot = hierarchy.slots[node];
+    hierarchy.translation_x[slot] = x;
+    hierarchy.translation_y[slot] = y;
+    hierarchy.translation_z[slot] = z;
+    hierarchy.dirty[slot] = 1;
+}
+
+void set_rotation(
+    transform_hierarchy& hierarchy, uint32_t node,
+    float x, float y, float z, float w
+) {
+    auto slot = hierarchy.slots[node];
+    hierarchy.rotation_x[slot] = x;
+    hierarchy.rotation_y[slot] = y;
+    hierarchy.rotation_z[slot] = z;
+    hierarchy.rotation_w[slot] = w;
+    hierarchy.dirty[slot] = 1;
+}
+
+void set_scale(
+    transform_hierarchy& hierarchy, uint32_t node, float x, float y, float z
+) {
+    auto slot = hierarchy.slots[node];
+    hierarchy.scale_x[slot] = x;
+    hierarchy.scale_y[slot] = y;
+    hierarchy.scale_z[slot] = z;
+    hierarchy.dirty[slot] = 1;
+}
+
+template<class T>
+static void permute(vector<T>& values, const vector<uint32_t>& order) {
+    vector<T> sorted(values.size());
+    for (auto i = 0u; i < order.size(); i++) {
+        sorted[i] = values[order[i]];
+    }
+    values = move(sorted);
+}
+
+static void permute_matrices(
+    vector<float>& matrices, const vector<uint32_t>& order
+) {
+    vector<float> sorted(matrices.size());
+    for (auto i = 0u; i < order.size(); i++) {
+        copy_n(&matrices[order[i] * 16], 16, &sorted[i * 16]);
+    }
+    matrices = move(sorted);
+}
+
+static void sort_by_depth(transform_hierarchy& h) {
+    vector<uint32_t> order(h.ids.size());
+    iota(order.begin(), order.end(), 0);
+    stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return h.depths[a] < h.depths[b];
+    });
+    vector<uint32_t> new_slots(order.size());
+    for (auto i = 0u; i < order.size(); i++) {
+        new_slots[order[i]] = i;
+    }
+
+    permute(h.translation_x, order);
+    permute(h.translation_y, order);
+    permute(h.translation_z, order);
+    permute(h.rotation_x, order);
+    permute(h.rotation_y, order);
+    permute(h.rotation_z, order);
+    permute(h.rotation_w, order);
+    permute(h.scale_x, order);
+    permute(h.scale_y, order);
+    permute(h.scale_z, order);
+    permute(h.parents, order);
+    permute(h.depths, order);
+    permute(h.instances, order);
+    permute(h.ids, order);
+    permute(h.dirty, order);
+    permute_matrices(h.local_matrices, order);
+    permute_matrices(h.world_matrices, order);
+
+    for (auto slot = 0u; slot < h.ids.size(); slot++) {
+        h.slots[h.ids[slot]] = slot;
+    }
+    for (auto& parent : h.parents) {
+        if (parent != no_node) {
+            parent = new_slots[parent];
+        }
+    }
+    h.unsorted = false;
+}
+
+static void compute_local_matrix(transform_hierarchy& h, uint32_t slot) {
+    float
+        x = h.rotation_x[slot], y = h.rotation_y[slot],
+        z = h.rotation_z[slot], w = h.rotation_w[slot];
+    // scaling by 2 / |q|^2 normalizes the quaternion
+    float s = 2 / (x * x + y * y + z * z + w * w);
+    float
+        xx = s * x * x, yy = s * y * y, zz = s * z * z,
+        xy = s * x * y, xz = s * x * z, yz = s * y * z,
+        wx = s * w * x, wy = s * w * y, wz = s * w * z;
+    float sx = h.scale_x[slot], sy = h.scale_y[slot], sz = h.scale_z[slot];
+    float* m = &h.local_matrices[slot * 16];
+    m[0] = (1 - yy - zz) * sx;
+    m[1] = (xy + wz) * sx;
+    m[2] = (xz - wy) * sx;
+    m[3] = 0;
+    m[4] = (xy - wz) * sy;
+    m[5] = (1 - xx - zz) * sy;
+    m[6] = (yz + wx) * sy;
+    m[7] = 0;
+    m[8] = (xz + wy) * sz;
+    m[9] = (yz - wx) * sz;
+    m[10] = (1 - xx - yy) * sz;
+    m[11] = 0;
+    m[12] = h.translation_x[slot];
+    m[13] = h.translation_y[slot];
+    m[14] = h.translation_z[slot];
+    m[15] = 1;
+}
+
+#ifdef TRANSFORM_SSE
+// computes the local matrices of 4 consecutive slots at once, one slot per
+// lane, then transposes them into the per slot matrices
+static void compute_local_matrices_4(transform_hierarchy& h, uint32_t slot) {
+    __m128
+        x = _mm_loadu_ps(&h.rotation_x[slot]),
+        y = _mm_loadu_ps(&h.rotation_y[slot]),
+        z = _mm_loadu_ps(&h.rotation_z[slot]),
+        w = _mm_loadu_ps(&h.rotation_w[slot]);
+    __m128 length =
+        _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)),
+            _mm_add_ps(_mm_mul_ps(z, z), _mm_mul_ps(w, w))
+        );
+    __m128 s = _mm_div_ps(_mm_set1_ps(2), length);
+    __m128 sx = _mm_mul_ps(s, x), sy = _mm_mul_ps(s, y);
+    __m128 sz = _mm_mul_ps(s, z);
+    __m128
+        xx = _mm_mul_ps(sx, x), yy = _mm_mul_ps(sy, y),
+        zz = _mm_mul_ps(sz, z),
+        xy = _mm_mul_ps(sx, y), xz = _mm_mul_ps(sx, z),
+        yz = _mm_mul_ps(sy, z),
+        wx = _mm_mul_ps(sx, w), wy = _mm_mul_ps(sy, w),
+        wz = _mm_mul_ps(sz, w);
+    __m128 one = _mm_set1_ps(1), zero = _mm_setzero_ps();
+    __m128
+        scale_x = _mm_loadu_ps(&h.scale_x[slot]),
+        scale_y = _mm_loadu_ps(&h.scale_y[slot]),
+        scale_z = _mm_loadu_ps(&h.scale_z[slot]);
+
+    // element e of all 4 matrices
+    __m128 e[16]{
+        _mm_mul_ps(_mm_sub_ps(_mm_sub_ps(one, yy), zz), scale_x),
+        _mm_mul_ps(_mm_add_ps(xy, wz), scale_x),
+        _mm_mul_ps(_mm_sub_ps(xz, wy), scale_x),
+        zero,
+        _mm_mul_ps(_mm_sub_ps(xy, wz), scale_y),
+        _mm_mul_ps(_mm_sub_ps(_mm_sub_ps(one, xx), zz), scale_y),
+        _mm_mul_ps(_mm_add_ps(yz, wx), scale_y),
+        zero,
+        _mm_mul_ps(_mm_add_ps(xz, wy), scale_z),
+        _mm_mul_ps(_mm_sub_ps(yz, wx), scale_z),
+        _mm_mul_ps(_mm_sub_ps(_mm_sub_ps(one, xx), yy), scale_z),
+        zero,
+        _mm_loadu_ps(&h.translation_x[slot]),
+        _mm_loadu_ps(&h.translation_y[slot]),
+        _mm_loadu_ps(&h.translation_z[slot]),
+        one,
+    };
+
+    float* m = &h.local_matrices[slot * 16];
+    for (auto column = 0u; column < 4; column++) {
+        auto c = e + column * 4;
+        _MM_TRANSPOSE4_PS(c[0], c[1], c[2], c[3]);
+        for (auto lane = 0u; lane < 4; lane++) {
+            _mm_storeu_ps(m + lane * 16 + column * 4, c[lane]);
+        }
+    }
+}
+#endif
+
+// result = a * b, result may not alias a or b
+static void multiply(const float* a, const float* b, float* result) {
+#if defined(TRANSFORM_SSE) && defined(__AVX__)
+    // two result columns per register
+    __m256 a_columns[4];
+    for (auto k = 0u; k < 4; k++) {
+        a_columns[k] = _mm256_broadcast_ps((const __m128*)(a + k * 4));
+    }
+    for (auto j = 0u; j < 4; j += 2) {
+        __m256 column = _mm256_setzero_ps();
+        for (auto k = 0u; k < 4; k++) {
+            __m256 factor = _mm256_setr_m128(
+                _mm_set1_ps(b[j * 4 + k]), _mm_set1_ps(b[j * 4 + 4 + k])
+            );
+            column = _mm256_add_ps(
+                column, _mm256_mul_ps(a_columns[k], factor)
+            );
+        }
+        _mm256_storeu_ps(result + j * 4, column);
+    }
+#elif defined(TRANSFORM_SSE)
+    __m128 a_columns[4]{
+        _mm_loadu_ps(a), _mm_loadu_ps(a + 4),
+        _mm_loadu_ps(a + 8), _mm_loadu_ps(a + 12),
+    };
+    for (auto j = 0u; j < 4; j++) {
+        __m128 column = _mm_mul_ps(a_columns[0], _mm_set1_ps(b[j * 4]));
+        for (auto k = 1u; k < 4; k++) {
+            column = _mm_add_ps(
+                column, _mm_mul_ps(a_columns[k], _mm_set1_ps(b[j * 4 + k]))
+            );
+        }
+        _mm_storeu_ps(result + j * 4, column);
+    }
+#else
+    for (auto j = 0u; j < 4; j++) {
+        for (auto i = 0u; i < 4; i++) {
+            float sum = 0;
+            for (auto k = 0u; k < 4; k++) {
+                sum += a[k * 4 + i] * b[j * 4 + k];
+            }
+            result[j * 4 + i] = sum;
+        }
+    }
+#endif
+}
+
+uint32_t update_transforms(
+    transform_hierarchy& hierarchy, const float root_matrix[16],
+    void* instances, size_t stride
+) {
+    auto& h = hierarchy;
+    if (h.unsorted) {
+        sort_by_depth(h);
+    }
+    auto count = static_cast<uint32_t>(h.ids.size());
+
+    bool root_changed =
+        !equal(root_matrix, root_matrix + 16, h.root_matrix);
+    if (root_changed) {
+        copy(root_matrix, root_matrix + 16, h.root_matrix);
+    }
+
+    // local matrices of nodes that changed themselves
+    uint32_t slot = 0;
+#ifdef TRANSFORM_SSE
+    for (; slot + 4 <= count; slot += 4) {
+        uint32_t any_dirty;
+        memcpy(&any_dirty, &h.dirty[slot], 4);
+        if (any_dirty) {
+            compute_local_matrices_4(h, slot);
+        }
+    }
+#endif
+    for (; slot < count; slot++) {
+        if (h.dirty[slot]) {
+            compute_local_matrix(h, slot);
+        }
+    }
+
+    // world matrices of nodes whose local or parent matrix changed, parents
+    // come first, so their flags are final when the children are reached
+    uint32_t updated = 0;
+    for (slot = 0; slot < count; slot++) {
+        auto parent = h.parents[slot];
+        if (parent == no_node) {
+            if (!h.dirty[slot] && !root_changed) {
+                continue;
+            }
+            h.dirty[slot] = 1;
+            multiply(
+                h.root_matrix, &h.local_matrices[slot * 16],
+                &h.world_matrices[slot * 16]
+            );
+        } else {
+            if (!h.dirty[slot] && !h.dirty[parent]) {
+                continue;
+            }
+            h.dirty[slot] = 1;
+            multiply(
+                &h.world_matrices[parent * 16], &h.local_matrices[slot * 16],
+                &h.world_matrices[slot * 16]
+            );
+        }
+        updated++;
+
+        auto instance = h.instances[slot];
+        if (instance != no_instance && instances) {
+            memcpy(
+                (char*)instances + instance * stride,
+                &h.world_matrices[slot * 16], sizeof(float) * 16
+            );
+        }
+    }
+
+    fill(h.dirty.begin(), h.dirty.end(), 0);
+    return updated;
+}
+
+void multiply_instances(
+    const float matrix[16], const void* source, void* destination,
+    size_t count, size_t stride
+) {
+    for (size_t i = 0; i < count; i++) {
+        multiply(
+            matrix, (const float*)((const char*)source + i * stride),
+            (float*)((char*)destination + i * stride)
+        );
+    }
+}
+
+const float* get_world_matrix(
+    const transform_hierarchy& hierarchy, uint32_t node
+) {
+    return &hierarchy.world_matrices[hierarchy.slots[node] * 16];
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// Scene graph of translation, rotation and scale nodes. Local transforms are
+// stored as structure of arrays, sorted by depth so that parents always come
+// before their children, and world matrices are computed with SSE/AVX.
+// Only nodes that changed, and their descendants, are recomputed. Matrices
+// are column major, like glm.
+
+const uint32_t no_node = -1u;
+const uint32_t no_instance = -1u;
+
+struct transform_hierarchy {
+    // indexed by slot, slots are sorted by depth
+    std::vector<float>
+        translation_x, translation_y, translation_z,
+        rotation_x, rotation_y, rotation_z, rotation_w,
+        scale_x, scale_y, scale_z;
+    std::vector<uint32_t> parents, depths, instances, ids;
+    std::vector<uint8_t> dirty;
+    // 16 floats per slot
+    std::vector<float> local_matrices, world_matrices;
+
+    // indexed by node id, ids are stable across sorting
+    std::vector<uint32_t> slots;
+    bool unsorted = false;
+
+    // matrix applied to all root nodes, changing it recomputes every node,
+    // so per frame matrices like the camera are applied by
+    // multiply_instances instead
+    float root_matrix[16];
+};
+
+// parent is no_node for root nodes. If instance is not no_instance the world
+// matrix is written to that instance by update_transforms.
+uint32_t add_node(
+    transform_hierarchy& hierarchy, uint32_t parent,
+    uint32_t instance = no_instance
+);
+
+void set_translation(
+    transform_hierarchy& hierarchy, uint32_t node, float x, float y, float z
+);
+// quaternion, doesn't need to be normalized
+void set_rotation(
+    transform_hierarchy& hierarchy, uint32_t node,
+    float x, float y, float z, float w
+);
+void set_scale(
+    transform_hierarchy& hierarchy, uint32_t node, float x, float y, float z
+);
+
+// recomputes the world matrices of dirty subtrees and writes those with an
+// instance to instances + instance * stride, returns the number of nodes
+// that were recomputed
+uint32_t update_transforms(
+    transform_hierarchy& hierarchy, const float root_matrix[16],
+    void* instances, size_t stride
+);
+
+// writes matrix times the matrix of each of count instances of source to
+// destination, other members of the instances are left as they are. Both
+// have the matrix at the start of every stride bytes and may not overlap.
+void multiply_instances(
+    const float matrix[16], const void* source, void* destination,
+    size_t count, size_t stride
+);
+
+const float* get_world_matrix(
+    const transform_hierarchy& hierarchy, uint32_t node
+);
@@ -0,0 +1,63 @@
+#include "triple_buffer.h"
+
+using namespace std;
+
+void create_triple_buffer(triple_buffer& buffer) {
+    buffer.back = 0;
+    buffer.state.store(1, memory_order_relaxed);
+    buffer.front = 2;
+}
+
+bool publish_triple_buffer(triple_buffer& buffer) {
+    auto state = buffer.state.load(memory_order_acquire);
+    // the consumer only changes a fresh state, or closes the buffer
+    if (state & (triple_buffer_fresh | triple_buffer_closed)) {
+        return false;
+    }
+    if (
+        !buffer.state.compare_exchange_strong(
+            state, buffer.back | triple_buffer_fresh,
+            memory_order_acq_rel, memory_order_acquire
+        )
+    ) {
+        // closed in the meantime
+        return false;
+    }
+    buffer.back = state & triple_buffer_index_mask;
+    buffer.state.notify_one();
+    return true;
+}
+
+bool take_triple_buffer(triple_buffer& buffer) {
+    auto state = buffer.state.load(memory_order_acquire);
+    while (true) {
+        if (state & triple_buffer_closed) {
+            return false;
+        }
+        if (!(state & triple_buffer_fresh)) {
+            buffer.state.wait(state, memory_order_acquire);
+            state = buffer.state.load(memory_order_acquire);
+            continue;
+        }
+        // the producer only changes a state that isn't fresh, or closes
+        // the buffer, which makes this fail and return above
+        if (
+            buffer.state.compare_exchange_weak(
+                state, buffer.front,
+                memory_order_acq_rel, memory_order_acquire
+            )
+        ) {
+            buffer.front = state & triple_buffer_index_mask;
+            return true;
+        }
+    }
+}
+
+void close_triple_buffer(triple_buffer& buffer) {
+    buffer.state.fetch_or(triple_buffer_closed, memory_order_acq_rel);
+    buffer.state.notify_all();
+}
+
+bool is_triple_buffer_closed(const triple_buffer& buffer) {
+    return buffer.state.load(memory_order_acquire) & triple_buffer_closed;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Hands snapshots from one producer thread to one consumer thread without
+// locks. The caller keeps three slots, the producer writes the back slot,
+// the consumer reads the front slot and the third is the latest published
+// snapshot. Publishing and taking each swap their slot with the published
+// one in a single atomic operation. A published snapshot is never
+// overwritten before it was taken, so none are dropped, instead publishing
+// fails and the producer decides how to wait.
+
+// flags in triple_buffer::state next to the index of the published slot
+const uint32_t triple_buffer_index_mask = 3;
+// the published slot hasn't been taken yet
+const uint32_t triple_buffer_fresh = 4;
+const uint32_t triple_buffer_closed = 8;
+
+struct triple_buffer {
+    std::atomic<uint32_t> state;
+    // only touched by the producer and the consumer respectively
+    uint32_t back, front;
+};
+
+// back is slot 0, the published slot 1 and front 2, nothing is fresh
+void create_triple_buffer(triple_buffer& buffer);
+
+// producer: makes the back slot the published one and returns true, or
+// returns false if the last published slot wasn't taken yet or the buffer
+// was closed. The new back slot is the one the consumer read last.
+bool publish_triple_buffer(triple_buffer& buffer);
+
+// consumer: waits until a slot is published and makes it the front slot,
+// returns false once the buffer was closed
+bool take_triple_buffer(triple_buffer& buffer);
+
+// either side, wakes a consumer waiting in take_triple_buffer
+void close_triple_buffer(triple_buffer& buffer);
+bool is_triple_buffer_closed(const triple_buffer& buffer);
@@ -0,0 +1,165 @@
+#include "tuning.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cstdio>
+
+using namespace std;
+
+void get_tuning_candidates(
+    VkSampleCountFlags sample_counts,
+    span<const VkPresentModeKHR> present_modes, bool scaling,
+    vector<render_settings>& candidates
+) {
+    candidates.clear();
+    for (auto scale : {1.0f, 0.75f, 0.5f}) {
+        if (scale != 1 && !scaling) {
+            continue;
+        }
+        for (auto samples : {
+            VK_SAMPLE_COUNT_64_BIT, VK_SAMPLE_COUNT_32_BIT,
+            VK_SAMPLE_COUNT_16_BIT, VK_SAMPLE_COUNT_8_BIT,
+            VK_SAMPLE_COUNT_4_BIT, VK_SAMPLE_COUNT_2_BIT,
+        }) {
+            if (!(sample_counts & samples)) {
+                continue;
+            }
+            // one frame in flight leaves the GPU idle while recording
+            for (auto frames_in_flight : {2u, 3u}) {
+                // the others tear
+                for (auto present_mode : {
+                    VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_MAILBOX_KHR,
+                    VK_PRESENT_MODE_IMMEDIATE_KHR,
+                }) {
+                    if (
+                        find(
+                            present_modes.begin(), present_modes.end(),
+                            present_mode
+                        ) == present_modes.end()
+                    ) {
+                        continue;
+                    }
+                    candidates.push_back({
+                        .samples = samples,
+                        .frames_in_flight = frames_in_flight,
+                        .present_mode = present_mode,
+                        .resolution_scale = scale,
+                    });
+                }
+            }
+        }
+    }
+}
+
+static float get_tuning_time(const tuning_result& result) {
+    return result.gpu_time >= 0 ? result.gpu_time : result.frame_time;
+}
+
+bool meets_tuning_target(const tuning_result& result, float target) {
+    if (result.gpu_time >= 0) {
+        return result.gpu_time <= target;
+    }
+    // covers 59.94 Hz and jitter around the refresh interval
+    if (result.settings.present_mode == VK_PRESENT_MODE_FIFO_KHR) {
+        target *= 1.05f;
+    }
+    return result.frame_time <= target;
+}
+
+render_settings pick_tuning(span<const tuning_result> results, float target) {
+    if (results.empty()) {
+        throw runtime_error("no tuning results");
+    }
+    auto fastest = &results[0];
+    for (auto& result : results) {
+        if (meets_tuning_target(result, target)) {
+            return result.settings;
+        }
+        if (get_tuning_time(result) < get_tuning_time(*fastest)) {
+            fastest = &result;
+        }
+    }
+    return fastest->settings;
+}
+
+static string format_uuid(const uint8_t (&uuid)[VK_UUID_SIZE]) {
+    string text;
+    for (auto byte : uuid) {
+        char digits[3];
+        snprintf(digits, sizeof(digits), "%02x", byte);
+        text += digits;
+    }
+    return text;
+}
+
+bool read_tuning(
+    const char* path, const uint8_t (&uuid)[VK_UUID_SIZE],
+    render_settings& settings
+) {
+    ifstream file(path);
+    if (!file) {
+        return false;
+    }
+    auto device = format_uuid(uuid);
+    string line;
+    while (getline(file, line)) {
+        istringstream stream(line);
+        string key;
+        if (!(stream >> key) || key != device) {
+            continue;
+        }
+        uint32_t samples, present_mode;
+        if (
+            !(
+                stream >> samples >> settings.frames_in_flight >>
+                present_mode >> settings.resolution_scale
+            ) ||
+            samples < 2 || (samples & (samples - 1)) != 0 ||
+            settings.frames_in_flight == 0 ||
+            settings.resolution_scale <= 0 || settings.resolution_scale > 1
+        ) {
+            throw runtime_error("malformed line in tuning file");
+        }
+        settings.samples = VkSampleCountFlagBits(samples);
+        settings.present_mode = VkPresentModeKHR(present_mode);
+        return true;
+    }
+    return false;
+}
+
+void write_tuning(
+    const char* path, const uint8_t (&uuid)[VK_UUID_SIZE],
+    const render_settings& settings
+) {
+    // lines of other devices are kept
+    auto device = format_uuid(uuid);
+    vector<string> lines;
+    {
+        ifstream file(path);
+        string line;
+        while (getline(file, line)) {
+            istringstream stream(line);
+            string key;
+            if (stream >> key && key != device) {
+                lines.push_back(line);
+            }
+        }
+    }
+    ostringstream entry;
+    entry <<
+        device << " " << uint32_t(settings.samples) << " " <<
+        settings.frames_in_flight << " " <<
+        uint32_t(settings.present_mode) << " " << settings.resolution_scale;
+    lines.push_back(entry.str());
+
+    ofstream file(path);
+    for (auto& line : lines) {
+        file << line << "\n";
+    }
+    if (!file) {
+        throw runtime_error("failed to write tuning file");
+    }
+}
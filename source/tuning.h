@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+// Settings that trade image quality and latency for frame time. The auto
+// tuner renders the scene with one candidate after the other, in order of
+// preference, and keeps the first one that meets a target frame time. GPU
+// time is compared against the target, FIFO paces the frame time to the
+// refresh interval however idle the GPU is. The
+// result is stored per device in a plain text file, one line per device:
+//
+//   <device uuid> <samples> <frames in flight> <present mode> <scale>
+//
+// The uuid is 32 hex digits, the present mode is a VkPresentModeKHR value.
+
+struct render_settings {
+    VkSampleCountFlagBits samples;
+    // frames that are recorded before waiting for the oldest one
+    uint32_t frames_in_flight;
+    VkPresentModeKHR present_mode;
+    // of the solid passes, relative to the swapchain, below 1 the scene is
+    // scaled up to the swapchain
+    float resolution_scale;
+};
+
+struct tuning_result {
+    render_settings settings;
+    // means, in milliseconds, gpu_time is negative if the queue has no
+    // timestamps
+    float frame_time;
+    float gpu_time;
+};
+
+// compares the GPU time against the target, or the frame time if there is
+// none, with some tolerance for FIFO whose frame time is the refresh
+// interval
+bool meets_tuning_target(const tuning_result& result, float target);
+
+// full resolution before lower scales, more samples before fewer, fewer
+// frames in flight before more, FIFO before mailbox before immediate.
+// sample_counts are the supported counts, 1 is skipped because the solid
+// passes resolve. Lower scales are only added if scaling is supported.
+void get_tuning_candidates(
+    VkSampleCountFlags sample_counts,
+    std::span<const VkPresentModeKHR> present_modes, bool scaling,
+    std::vector<render_settings>& candidates
+);
+
+// the first result that meets the target, results are in order of
+// preference, or the fastest if none does
+render_settings pick_tuning(
+    std::span<const tuning_result> results, float target
+);
+
+// false if there is no file or the device isn't in it, throws if the line
+// of the device is malformed
+bool read_tuning(
+    const char* path, const uint8_t (&uuid)[VK_UUID_SIZE],
+    render_settings& settings
+);
+// replaces the line of the device, throws if the file can't be written
+void write_tuning(
+    const char* path, const uint8_t (&uuid)[VK_UUID_SIZE],
+    const render_settings& settings
+);